@@ -0,0 +1,377 @@
+/*
+ ============================================================================
+ Name        : micro_bench.c
+ Author      : Martin Patarinski
+ Version     :
+ Copyright   : Open source. Further copyright shall be approved by the author
+ Description : Microbenchmarks of the primitives of the NVManager on the flash
+               simulator. Every case is warmed up and repeated, the results
+               are printed as JSON in ns/op and bytes/s
+ ============================================================================
+ */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L /* clock_gettime */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+/* The NVManager is compiled into this file, so that its local primitives can be measured too */
+#include "src/nvm.c"
+
+#define MICRO_DEFAULT_REPS      31
+#define MICRO_DEFAULT_WARMUP    3
+#define MICRO_WRITES_PER_REP    200   // writes of eNvmBlock2, which fit into one logical page without an overflow
+#define MICRO_OPS_PER_REP       1000
+
+/* A type for a microbenchmark case. The setup prepares the flash before every repetition and is not measured */
+typedef struct
+{
+	const char* name;
+	uint32_t arg;              /* parameter of the operation, i.e. a size */
+	uint32_t bytesPerOp;       /* processed bytes of one operation for the throughput, 0 if it is not relevant */
+	uint32_t opsPerRep;        /* operations of one measured repetition */
+	void (*setup)(uint32_t arg);
+	void (*op)(uint32_t arg);
+} MicroCase_t;
+
+/* A type for the parameters of a benchmark run */
+typedef struct
+{
+	uint32_t reps;             /* measured repetitions of every case */
+	uint32_t warmup;           /* repetitions before the measurement */
+	const char* filter;        /* only the cases with this text into the name or NULL */
+	const char* output;        /* JSON file or NULL for stdout */
+} MicroParams_t;
+
+static MicroParams_t Params = { MICRO_DEFAULT_REPS, MICRO_DEFAULT_WARMUP, NULL, NULL };
+
+static uint8_t MicroData[MAX_DR_SIZE];
+static uint8_t MicroBuffer[FLASH_SECTOR_SIZE];
+static uint16_t MicroSize = 0;
+static volatile uint32_t MicroSink = 0;
+
+static bool parseArgs(int argc, char* argv[]);
+static double getTimeNs(void);
+static int compareDouble(const void* a, const void* b);
+static void eraseFlash(void);
+static void fillPage(uint32_t percent);
+static void setupNone(uint32_t arg);
+static void setupWritten(uint32_t arg);
+static void setupFreshPage(uint32_t arg);
+static void setupNearlyFullPage(uint32_t arg);
+static void setupInit(uint32_t arg);
+static void opCrc32(uint32_t arg);
+static void opIsBlockEmpty(uint32_t arg);
+static void opGetBlockInfo(uint32_t arg);
+static void opRead(uint32_t arg);
+static void opWrite(uint32_t arg);
+static void opWriteUnchanged(uint32_t arg);
+static void opInit(uint32_t arg);
+static bool runCase(FILE* out, const MicroCase_t* microCase, bool bFirst);
+
+/* main function of the microbenchmarks */
+int main(int argc, char* argv[])
+{
+	static const MicroCase_t cases[] = {
+		{ "crc32_16",               16,                16,                MICRO_OPS_PER_REP,    setupNone,           opCrc32 },
+		{ "crc32_64",               64,                64,                MICRO_OPS_PER_REP,    setupNone,           opCrc32 },
+		{ "crc32_256",              256,               256,               MICRO_OPS_PER_REP,    setupNone,           opCrc32 },
+		{ "crc32_1024",             1024,              1024,              MICRO_OPS_PER_REP,    setupNone,           opCrc32 },
+		{ "crc32_4096",             4096,              4096,              MICRO_OPS_PER_REP,    setupNone,           opCrc32 },
+		{ "is_block_empty_64",      64,                64,                MICRO_OPS_PER_REP,    setupWritten,        opIsBlockEmpty },
+		{ "is_block_empty_1024",    1024,              1024,              MICRO_OPS_PER_REP,    setupWritten,        opIsBlockEmpty },
+		{ "is_block_empty_4096",    4096,              4096,              MICRO_OPS_PER_REP,    setupWritten,        opIsBlockEmpty },
+		{ "get_block_info",         0,                 0,                 MICRO_OPS_PER_REP,    setupWritten,        opGetBlockInfo },
+		{ "nvm_read_hit",           eNvmBlock2,        NVM_BLOCK_2_SIZE,  MICRO_OPS_PER_REP,    setupWritten,        opRead },
+		{ "nvm_write",              eNvmBlock2,        NVM_BLOCK_2_SIZE,  MICRO_WRITES_PER_REP, setupFreshPage,      opWrite },
+		{ "nvm_write_overflow",     eNvmBlock1,        NVM_BLOCK_1_SIZE,  1,                    setupNearlyFullPage, opWrite },
+		{ "nvm_write_unchanged",    eNvmBlock2,        NVM_BLOCK_2_SIZE,  MICRO_OPS_PER_REP,    setupWritten,        opWriteUnchanged },
+		{ "nvm_init_empty",         0,                 0,                 1,                    setupInit,           opInit },
+		{ "nvm_init_half_full",     50,                0,                 1,                    setupInit,           opInit },
+		{ "nvm_init_full",          100,               0,                 1,                    setupInit,           opInit }
+	};
+	const uint32_t caseCount = sizeof(cases) / sizeof(cases[0]);
+	FILE* out = stdout;
+	uint32_t idx;
+	bool bFirst = true;
+	bool bResult = true;
+
+	if(false == parseArgs(argc, argv))
+	{
+		fprintf(stderr, "Usage: %s [--reps N] [--warmup N] [--filter TEXT] [--output FILE]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if(NULL != Params.output)
+	{
+		out = fopen(Params.output, "w");
+		if(NULL == out)
+		{
+			fprintf(stderr, "Can't open %s!\n", Params.output);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for(idx = 0; idx < sizeof(MicroBuffer); idx++)
+	{
+		MicroBuffer[idx] = (uint8_t)(idx * 31u);
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"benchmark\": \"nvm_micro\",\n");
+	fprintf(out, "  \"parameters\": {\"reps\": %u, \"warmup\": %u},\n", (unsigned)Params.reps, (unsigned)Params.warmup);
+	fprintf(out, "  \"cases\": [\n");
+
+	for(idx = 0; idx < caseCount; idx++)
+	{
+		if( (NULL == Params.filter) || (NULL != strstr(cases[idx].name, Params.filter)) )
+		{
+			bResult &= runCase(out, &cases[idx], bFirst);
+			bFirst = false;
+		}
+	}
+
+	fprintf(out, "\n  ]\n");
+	fprintf(out, "}\n");
+
+	if(stdout != out)
+	{
+		fclose(out);
+	}
+
+	return (true == bResult) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Parse the command line into the parameters of the run */
+static bool parseArgs(int argc, char* argv[])
+{
+	int idx;
+
+	for(idx = 1; idx < argc; idx++)
+	{
+		if( (0 == strcmp(argv[idx], "--reps")) && ((idx + 1) < argc) )
+		{
+			Params.reps = (uint32_t)strtoul(argv[++idx], NULL, 0);
+		}
+		else if( (0 == strcmp(argv[idx], "--warmup")) && ((idx + 1) < argc) )
+		{
+			Params.warmup = (uint32_t)strtoul(argv[++idx], NULL, 0);
+		}
+		else if( (0 == strcmp(argv[idx], "--filter")) && ((idx + 1) < argc) )
+		{
+			Params.filter = argv[++idx];
+		}
+		else if( (0 == strcmp(argv[idx], "--output")) && ((idx + 1) < argc) )
+		{
+			Params.output = argv[++idx];
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return (0 < Params.reps);
+}
+
+/* Monotonic time of the PC in ns */
+static double getTimeNs(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((double)now.tv_sec * 1000000000.0) + (double)now.tv_nsec;
+#else
+	return ((double)clock() * 1000000000.0) / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Comparison of two measurements for qsort */
+static int compareDouble(const void* a, const void* b)
+{
+	double valA = *(const double*)a;
+	double valB = *(const double*)b;
+
+	return (valA > valB) - (valA < valB);
+}
+
+/* Start on erased flash with an initialized NVManager */
+static void eraseFlash(void)
+{
+	FlsDrv_Init();
+	nvm_init();
+}
+
+/* Write eNvmBlock1 with changing data until the given part of the current logical page is used */
+static void fillPage(uint32_t percent)
+{
+	uint32_t pageAddr = GET_PAGE_ADDR(NvmManagerDescriptor.writePointer);
+	uint32_t recordSize = NVM_BLOCK_1_SIZE + BLOCK_HEADER_SIZE + NVM_CRC_LEN;
+	uint32_t fillAddr = pageAddr + ((LOGICAL_PAGE_SIZE * percent) / 100);
+
+	/* the next record of a full page would overflow it */
+	if(fillAddr > (pageAddr + LOGICAL_PAGE_SIZE - recordSize))
+	{
+		fillAddr = pageAddr + LOGICAL_PAGE_SIZE - recordSize;
+	}
+
+	while(NvmManagerDescriptor.writePointer < fillAddr)
+	{
+		MicroData[0]++;
+		nvm_write(eNvmBlock1, MicroData, NVM_BLOCK_1_SIZE);
+	}
+}
+
+/* No preparation of the flash */
+static void setupNone(uint32_t arg)
+{
+	(void)arg;
+}
+
+/* The blocks eNvmBlock1..eNvmBlock15 are written once, the second half of the page stays erased */
+static void setupWritten(uint32_t arg)
+{
+	NvmBlocksId_t bIdx;
+
+	(void)arg;
+	eraseFlash();
+	for(bIdx = eNvmBlock1; bIdx <= eNvmBlock15; bIdx++)
+	{
+		nvm_write(bIdx, MicroData, (uint16_t)NvmBlocks[bIdx].size);
+	}
+}
+
+/* The page is erased, so all writes of the repetition fit into it */
+static void setupFreshPage(uint32_t arg)
+{
+	(void)arg;
+	eraseFlash();
+}
+
+/* The next write of eNvmBlock1 overflows the page and the garbage collection runs */
+static void setupNearlyFullPage(uint32_t arg)
+{
+	(void)arg;
+	eraseFlash();
+	fillPage(100);
+}
+
+/* The page is filled to the given percentage before the initialization is measured */
+static void setupInit(uint32_t arg)
+{
+	eraseFlash();
+	fillPage(arg);
+}
+
+static void opCrc32(uint32_t arg)
+{
+	MicroSink += CRC32_Calculate(MicroBuffer, arg);
+}
+
+static void opIsBlockEmpty(uint32_t arg)
+{
+	/* the end of the current page is erased */
+	MicroSink += _isNvmBlockEmpty(GET_PAGE_ADDR(NvmManagerDescriptor.writePointer) + LOGICAL_PAGE_SIZE - arg, arg);
+}
+
+static void opGetBlockInfo(uint32_t arg)
+{
+	NvmBlocksId_t bIdx;
+	uint16_t occCtr;
+	uint32_t dataSize;
+
+	(void)arg;
+	MicroSink += _getBlockInfo(NvmBlocks[eNvmBlock7].readPointer, &bIdx, &occCtr, &dataSize);
+}
+
+static void opRead(uint32_t arg)
+{
+	MicroSink += nvm_read((NvmBlocksId_t)arg, MicroData, &MicroSize);
+}
+
+static void opWrite(uint32_t arg)
+{
+	MicroData[0]++;
+	MicroSink += nvm_write((NvmBlocksId_t)arg, MicroData, (uint16_t)NvmBlocks[arg].size);
+}
+
+static void opWriteUnchanged(uint32_t arg)
+{
+	MicroSink += nvm_write((NvmBlocksId_t)arg, MicroData, (uint16_t)NvmBlocks[arg].size);
+}
+
+static void opInit(uint32_t arg)
+{
+	(void)arg;
+	nvm_init();
+	MicroSink += NvmManagerDescriptor.bIsInitialized;
+}
+
+/* Warm up, measure and print one case. The host time shows the cost of the code, the flash time is the one of the latency model */
+static bool runCase(FILE* out, const MicroCase_t* microCase, bool bFirst)
+{
+	FlsSimu_Stats_t before;
+	FlsSimu_Stats_t after;
+	double* samples = (double*)malloc(sizeof(double) * Params.reps);
+	double startTime;
+	double mean = 0.0;
+	double deviation = 0.0;
+	double flashNs = 0.0;
+	double median;
+	uint32_t rep;
+	uint32_t op;
+
+	if(NULL == samples)
+	{
+		return false;
+	}
+
+	for(rep = 0; rep < (Params.warmup + Params.reps); rep++)
+	{
+		microCase->setup(microCase->arg);
+		FlsSimu_getStats(&before);
+
+		startTime = getTimeNs();
+		for(op = 0; op < microCase->opsPerRep; op++)
+		{
+			microCase->op(microCase->arg);
+		}
+
+		if(rep >= Params.warmup)
+		{
+			samples[rep - Params.warmup] = (getTimeNs() - startTime) / (double)microCase->opsPerRep;
+			FlsSimu_getStats(&after);
+			flashNs += ((double)(after.busyTimeUs - before.busyTimeUs) * 1000.0) / (double)microCase->opsPerRep;
+		}
+	}
+
+	for(rep = 0; rep < Params.reps; rep++)
+	{
+		mean += samples[rep];
+	}
+	mean /= (double)Params.reps;
+	for(rep = 0; rep < Params.reps; rep++)
+	{
+		deviation += (samples[rep] - mean) * (samples[rep] - mean);
+	}
+	deviation = sqrt(deviation / (double)Params.reps);
+	flashNs /= (double)Params.reps;
+
+	qsort(samples, Params.reps, sizeof(double), compareDouble);
+	median = samples[Params.reps / 2];
+
+	fprintf(out, "%s    {\"name\": \"%s\", \"ops_per_rep\": %u, \"ns_per_op\": {\"median\": %.1f, \"min\": %.1f, \"mean\": %.1f, \"stddev\": %.1f}, ",
+	        (true == bFirst) ? "" : ",\n", microCase->name, (unsigned)microCase->opsPerRep, median, samples[0], mean, deviation);
+	fprintf(out, "\"bytes_per_s\": %.0f, \"flash_ns_per_op\": %.0f}",
+	        ((0 < microCase->bytesPerOp) && (0.0 < median)) ? (((double)microCase->bytesPerOp * 1000000000.0) / median) : 0.0, flashNs);
+
+	free(samples);
+
+	return true;
+}
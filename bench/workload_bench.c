@@ -0,0 +1,692 @@
+/*
+ ============================================================================
+ Name        : workload_bench.c
+ Author      : Martin Patarinski
+ Version     :
+ Copyright   : Open source. Further copyright shall be approved by the author
+ Description : Workload benchmark of the NVManager on the flash simulator.
+               The results are printed as JSON, so that configurations and
+               versions of the NVManager can be compared
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "stubs/stubs.h"
+#include "src/nvm.h"
+
+#define BENCH_DEFAULT_WRITES     20000
+#define BENCH_DEFAULT_SEED       1
+#define BENCH_DEFAULT_INTERVAL_S 1     // simulated time between two writes, needed by the coalescing windows of the endurance budget
+#define BENCH_DEFAULT_ZIPF_S     1.0
+#define BENCH_FILL_LEVELS        10    // mount time is measured at every 10% of the fill of a logical page
+#define BENCH_FIRST_BLOCK        eNvmBlock1
+#define BENCH_LAST_BLOCK         eNvmBlock15
+#define BENCH_BLOCK_COUNT        (BENCH_LAST_BLOCK - BENCH_FIRST_BLOCK + 1)
+
+/* A type for the parameters of a benchmark run */
+typedef struct
+{
+	const char* workload;      /* name of the workload or "all" */
+	uint32_t writes;           /* nvm_write calls per workload */
+	uint32_t seed;             /* seed of the random generator, so the runs are reproducible */
+	uint32_t intervalS;        /* simulated seconds between two writes */
+	double zipfS;              /* exponent of the Zipf distribution */
+	bool bTiming;              /* false disables the latency model of the flash */
+	const char* output;        /* JSON file or NULL for stdout */
+	const char* record;        /* trace file of the calls of the API or NULL */
+} BenchParams_t;
+
+/* A type for the results of one workload */
+typedef struct
+{
+	uint32_t writes;
+	uint32_t failedWrites;
+	uint32_t requestedBytes;   /* payload bytes of the successful nvm_write calls, like bytesRequested of nvm_get_stats */
+	uint32_t elapsedUs;
+	uint32_t* latencies;       /* latency of every nvm_write in us */
+	uint32_t mountTimeUs;      /* nvm_init after the workload */
+	uint32_t mountTimeVsFill[BENCH_FILL_LEVELS];
+	bool bMountVsFill;
+	bool bVerified;            /* all blocks are read back with the latest data after the mount */
+	FlsSimu_Stats_t flash;     /* flash operations of the workload */
+} BenchResult_t;
+
+/* A type for a workload. It selects the block of the next write and updates its data */
+typedef NvmBlocksId_t (*BenchWorkload_t)(uint32_t writeIdx);
+
+static BenchParams_t Params = { "all", BENCH_DEFAULT_WRITES, BENCH_DEFAULT_SEED, BENCH_DEFAULT_INTERVAL_S, BENCH_DEFAULT_ZIPF_S, true, NULL, NULL };
+
+/* Latest data of every block. The buffers stay valid, because a deferred write is programmed later from them */
+static uint8_t BlockData[eNvmBlockCount][MAX_DR_SIZE];
+
+static double ZipfCdf[BENCH_BLOCK_COUNT];
+
+#ifdef NVM_USE_RECORDER
+static FILE* RecordFile = NULL;
+#endif
+
+static bool parseArgs(int argc, char* argv[]);
+static uint32_t benchRandom(void);
+static NvmBlocksId_t uniformWorkload(uint32_t writeIdx);
+static NvmBlocksId_t zipfWorkload(uint32_t writeIdx);
+static NvmBlocksId_t keypadWorkload(uint32_t writeIdx);
+static NvmBlocksId_t stringWorkload(uint32_t writeIdx);
+static void fillRandom(NvmBlocksId_t bIdx);
+static void incrementCounter(NvmBlocksId_t bIdx);
+static void startWorkload(BenchResult_t* result);
+static bool writeBlock(NvmBlocksId_t bIdx, BenchResult_t* result);
+static void finishWorkload(BenchResult_t* result, const FlsSimu_Stats_t* before);
+static bool runWorkload(BenchWorkload_t workload, BenchResult_t* result);
+static bool runFillToWrap(BenchResult_t* result);
+static uint32_t measureMount(void);
+static int compareU32(const void* a, const void* b);
+static void printResult(FILE* out, const char* name, BenchResult_t* result, bool bLast);
+#ifdef NVM_USE_RECORDER
+static bool startRecording(const char* path);
+static void recordSink(const uint8_t* record, uint32_t len);
+#endif
+
+/* Random generator of the benchmark (xorshift32), independent of the rand() of the C library */
+static uint32_t RandomState = BENCH_DEFAULT_SEED;
+
+/* main function of the benchmark */
+int main(int argc, char* argv[])
+{
+	static const struct
+	{
+		const char* name;
+		BenchWorkload_t workload;
+	} workloads[] = {
+		{ "uniform", uniformWorkload },
+		{ "zipf", zipfWorkload },
+		{ "keypad_counter", keypadWorkload },
+		{ "string_update", stringWorkload },
+		{ "fill_to_wrap", NULL }
+	};
+	const uint32_t workloadCount = sizeof(workloads) / sizeof(workloads[0]);
+	const FlsSimu_Timing_t noTiming = { 0, 0, 0, 0, 0 };
+	BenchResult_t result;
+	FILE* out = stdout;
+	uint32_t idx;
+	uint32_t last = 0;
+	bool bSelected = false;
+	bool bResult = true;
+	double sum = 0.0;
+
+	if(false == parseArgs(argc, argv))
+	{
+		fprintf(stderr, "Usage: %s [--workload uniform|zipf|keypad_counter|string_update|fill_to_wrap|all] [--writes N] [--seed N]\n"
+		                "          [--interval S] [--zipf S] [--no-timing] [--output FILE] [--record FILE]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if(NULL != Params.output)
+	{
+		out = fopen(Params.output, "w");
+		if(NULL == out)
+		{
+			fprintf(stderr, "Can't open %s!\n", Params.output);
+			return EXIT_FAILURE;
+		}
+	}
+
+	FlsSimu_setTiming((true == Params.bTiming) ? NULL : &noTiming);
+
+	/* the block with the lowest index is the most frequent one */
+	for(idx = 0; idx < BENCH_BLOCK_COUNT; idx++)
+	{
+		sum += 1.0 / pow((double)(idx + 1), Params.zipfS);
+		ZipfCdf[idx] = sum;
+	}
+	for(idx = 0; idx < BENCH_BLOCK_COUNT; idx++)
+	{
+		ZipfCdf[idx] /= sum;
+	}
+
+	result.latencies = (uint32_t*)malloc(sizeof(uint32_t) * (Params.writes + 1));
+	if(NULL == result.latencies)
+	{
+		return EXIT_FAILURE;
+	}
+
+	for(idx = 0; idx < workloadCount; idx++)
+	{
+		if( (0 == strcmp(Params.workload, "all")) || (0 == strcmp(Params.workload, workloads[idx].name)) )
+		{
+			bSelected = true;
+			last = idx;
+		}
+	}
+	if(false == bSelected)
+	{
+		fprintf(stderr, "Unknown workload %s!\n", Params.workload);
+		return EXIT_FAILURE;
+	}
+
+	if(NULL != Params.record)
+	{
+#ifdef NVM_USE_RECORDER
+		/* every workload starts on erased flash, so a trace can contain only one of them */
+		if( (0 == strcmp(Params.workload, "all")) || (false == startRecording(Params.record)) )
+		{
+			fprintf(stderr, "Can't record %s into %s!\n", Params.workload, Params.record);
+			return EXIT_FAILURE;
+		}
+#else
+		fprintf(stderr, "The recorder is not enabled (NVM_USE_RECORDER)!\n");
+		return EXIT_FAILURE;
+#endif
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"benchmark\": \"nvm_workload\",\n");
+	fprintf(out, "  \"config\": {\"nvm_area_size\": %u, \"logical_page_size\": %u, \"flash_sector_size\": %u, \"program_page_size\": %u, "
+	             "\"timing\": %s, \"features\": [",
+	        (unsigned)(NVM_MANAGER_END_ADDR - NVM_MANAGER_START_ADDR), (unsigned)LOGICAL_PAGE_SIZE, (unsigned)FLASH_SECTOR_SIZE,
+	        (unsigned)FLS_SIMU_PROGRAM_PAGE_SIZE, (true == Params.bTiming) ? "true" : "false");
+	fprintf(out, "\"base\"");
+#ifdef NVM_USE_BACKGROUND_ERASE
+	fprintf(out, ", \"background_erase\"");
+#endif
+#ifdef NVM_USE_WEAR_BUDGET
+	fprintf(out, ", \"wear_budget\"");
+#endif
+#ifdef NVM_USE_FLS_BLANK_CHECK
+	fprintf(out, ", \"fls_blank_check\"");
+#endif
+#ifdef NVM_USE_TRACE
+	fprintf(out, ", \"trace\"");
+#endif
+	fprintf(out, "]},\n");
+	fprintf(out, "  \"parameters\": {\"writes\": %u, \"seed\": %u, \"interval_s\": %u, \"zipf_s\": %.2f},\n",
+	        (unsigned)Params.writes, (unsigned)Params.seed, (unsigned)Params.intervalS, Params.zipfS);
+	fprintf(out, "  \"workloads\": [\n");
+
+	for(idx = 0; idx < workloadCount; idx++)
+	{
+		if( (0 != strcmp(Params.workload, "all")) && (0 != strcmp(Params.workload, workloads[idx].name)) )
+		{
+			continue;
+		}
+
+		RandomState = (0 != Params.seed) ? Params.seed : BENCH_DEFAULT_SEED;
+
+		if(NULL != workloads[idx].workload)
+		{
+			bResult &= runWorkload(workloads[idx].workload, &result);
+		}
+		else
+		{
+			bResult &= runFillToWrap(&result);
+		}
+
+		printResult(out, workloads[idx].name, &result, (idx == last));
+	}
+
+	fprintf(out, "  ]\n");
+	fprintf(out, "}\n");
+
+	if(stdout != out)
+	{
+		fclose(out);
+	}
+	free(result.latencies);
+
+#ifdef NVM_USE_RECORDER
+	if(NULL != RecordFile)
+	{
+		nvm_record_register(NULL);
+		fclose(RecordFile);
+	}
+#endif
+
+	return (true == bResult) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Parse the command line into the parameters of the run */
+static bool parseArgs(int argc, char* argv[])
+{
+	int idx;
+
+	for(idx = 1; idx < argc; idx++)
+	{
+		if( (0 == strcmp(argv[idx], "--workload")) && ((idx + 1) < argc) )
+		{
+			Params.workload = argv[++idx];
+		}
+		else if( (0 == strcmp(argv[idx], "--writes")) && ((idx + 1) < argc) )
+		{
+			Params.writes = (uint32_t)strtoul(argv[++idx], NULL, 0);
+		}
+		else if( (0 == strcmp(argv[idx], "--seed")) && ((idx + 1) < argc) )
+		{
+			Params.seed = (uint32_t)strtoul(argv[++idx], NULL, 0);
+		}
+		else if( (0 == strcmp(argv[idx], "--interval")) && ((idx + 1) < argc) )
+		{
+			Params.intervalS = (uint32_t)strtoul(argv[++idx], NULL, 0);
+		}
+		else if( (0 == strcmp(argv[idx], "--zipf")) && ((idx + 1) < argc) )
+		{
+			Params.zipfS = strtod(argv[++idx], NULL);
+		}
+		else if(0 == strcmp(argv[idx], "--no-timing"))
+		{
+			Params.bTiming = false;
+		}
+		else if( (0 == strcmp(argv[idx], "--output")) && ((idx + 1) < argc) )
+		{
+			Params.output = argv[++idx];
+		}
+		else if( (0 == strcmp(argv[idx], "--record")) && ((idx + 1) < argc) )
+		{
+			Params.record = argv[++idx];
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return (0 < Params.writes);
+}
+
+/* Random generator of the benchmark (xorshift32) */
+static uint32_t benchRandom(void)
+{
+	RandomState ^= RandomState << 13;
+	RandomState ^= RandomState >> 17;
+	RandomState ^= RandomState << 5;
+
+	return RandomState;
+}
+
+/* All blocks are written equally often with new random data */
+static NvmBlocksId_t uniformWorkload(uint32_t writeIdx)
+{
+	NvmBlocksId_t bIdx = (NvmBlocksId_t)(BENCH_FIRST_BLOCK + (benchRandom() % BENCH_BLOCK_COUNT));
+
+	(void)writeIdx;
+	fillRandom(bIdx);
+
+	return bIdx;
+}
+
+/* The blocks are written with a Zipf-skewed frequency with new random data - a few blocks are hot, the most are cold */
+static NvmBlocksId_t zipfWorkload(uint32_t writeIdx)
+{
+	double rnd = (double)benchRandom() / 4294967296.0;
+	uint32_t idx = 0;
+
+	(void)writeIdx;
+	while( (idx < (BENCH_BLOCK_COUNT - 1)) && (rnd >= ZipfCdf[idx]) )
+	{
+		idx++;
+	}
+
+	fillRandom((NvmBlocksId_t)(BENCH_FIRST_BLOCK + idx));
+
+	return (NvmBlocksId_t)(BENCH_FIRST_BLOCK + idx);
+}
+
+/* Every key press of the coffee machine increments the counter of its group (GR1 50%, GR2 25%, GR3 15%, tea 10%) and the write
+   cycle counter. The temperature is logged every 50 presses and the doses are changed every 500 presses */
+static NvmBlocksId_t keypadWorkload(uint32_t writeIdx)
+{
+	static const NvmBlocksId_t counters[] = { eNvmBlock3, eNvmBlock3, eNvmBlock3, eNvmBlock3, eNvmBlock3,
+	                                          eNvmBlock4, eNvmBlock4, eNvmBlock5, eNvmBlock5, eNvmBlock6 };
+	uint32_t press = writeIdx / 2;
+	NvmBlocksId_t bIdx;
+
+	if(0 != (writeIdx % 2))
+	{
+		incrementCounter(eNvmBlock14);
+		return eNvmBlock14;
+	}
+
+	if(0 == ((press + 1) % 500))
+	{
+		bIdx = (0 != ((press / 500) % 2)) ? eNvmBlock9 : eNvmBlock8;
+		fillRandom(bIdx);
+	}
+	else if(0 == ((press + 1) % 50))
+	{
+		bIdx = eNvmBlock7;
+		fillRandom(bIdx);
+	}
+	else
+	{
+		bIdx = counters[benchRandom() % (sizeof(counters) / sizeof(counters[0]))];
+		incrementCounter(bIdx);
+	}
+
+	return bIdx;
+}
+
+/* The configuration strings are updated with a new length and content, every fourth update writes the same string again */
+static NvmBlocksId_t stringWorkload(uint32_t writeIdx)
+{
+	static const NvmBlocksId_t strings[] = { eNvmBlock13, eNvmBlock15 };
+	NvmBlocksId_t bIdx = strings[benchRandom() % (sizeof(strings) / sizeof(strings[0]))];
+	uint32_t len;
+	uint32_t idx;
+
+	(void)writeIdx;
+	if(0 != (benchRandom() % 4))
+	{
+		len = 1 + (benchRandom() % (NvmBlocks[bIdx].size - 1));
+		memset(BlockData[bIdx], 0, NvmBlocks[bIdx].size);
+
+		for(idx = 0; idx < len; idx++)
+		{
+			BlockData[bIdx][idx] = (uint8_t)('a' + (benchRandom() % 26));
+		}
+	}
+
+	return bIdx;
+}
+
+/* Fill the data of a block with random bytes */
+static void fillRandom(NvmBlocksId_t bIdx)
+{
+	uint32_t idx;
+
+	for(idx = 0; idx < NvmBlocks[bIdx].size; idx++)
+	{
+		BlockData[bIdx][idx] = (uint8_t)benchRandom();
+	}
+}
+
+/* Increment the little-endian counter at the beginning of the data of a block */
+static void incrementCounter(NvmBlocksId_t bIdx)
+{
+	uint32_t idx;
+
+	for(idx = 0; (idx < NvmBlocks[bIdx].size) && (0 == ++BlockData[bIdx][idx]); idx++)
+	{
+		/* carry to the next byte */
+	}
+}
+
+/* Start a workload on erased flash */
+static void startWorkload(BenchResult_t* result)
+{
+	FlsDrv_Init();
+	SysTimeSimu = 0;
+	memset(BlockData, 0, sizeof(BlockData));
+#ifdef NVM_USE_RECORDER
+	if(NULL != RecordFile)
+	{
+		nvm_record_register(recordSink);
+	}
+#endif
+	nvm_init();
+
+	result->writes = 0;
+	result->failedWrites = 0;
+	result->requestedBytes = 0;
+	result->mountTimeUs = 0;
+	result->bMountVsFill = false;
+	result->bVerified = false;
+}
+
+/* Write a block as the application does and measure the latency of nvm_write */
+static bool writeBlock(NvmBlocksId_t bIdx, BenchResult_t* result)
+{
+	uint32_t startTime = SysTime_getMicroseconds();
+	bool bResult = nvm_write(bIdx, BlockData[bIdx], (uint16_t)NvmBlocks[bIdx].size);
+
+	result->latencies[result->writes] = SysTime_getMicroseconds() - startTime;
+	result->writes++;
+	if(false == bResult)
+	{
+		result->failedWrites++;
+	}
+	else
+	{
+		result->requestedBytes += NvmBlocks[bIdx].size;
+	}
+
+	/* the cyclic tasks of the application between two writes */
+	SysTimeSimu += Params.intervalS;
+#ifdef NVM_USE_WEAR_BUDGET
+	nvm_write_step();
+#endif
+#ifdef NVM_USE_BACKGROUND_ERASE
+	nvm_erase_step();
+#endif
+
+	return bResult;
+}
+
+/* Finish a workload - program the deferred writes, mount again and check that the latest data of all blocks is read */
+static void finishWorkload(BenchResult_t* result, const FlsSimu_Stats_t* before)
+{
+	uint8_t readData[MAX_DR_SIZE];
+	uint16_t readSize = 0;
+	FlsSimu_Stats_t after;
+	uint32_t idx;
+	NvmBlocksId_t bIdx;
+
+#ifdef NVM_USE_WEAR_BUDGET
+	nvm_write_flush();
+#endif
+	FlsSimu_getStats(&after);
+
+	/* the counters of the workload only */
+	result->flash = after;
+	result->flash.reads -= before->reads;
+	result->flash.readBytes -= before->readBytes;
+	result->flash.programs -= before->programs;
+	result->flash.programBytes -= before->programBytes;
+	result->flash.programViolations -= before->programViolations;
+	result->flash.busyTimeUs -= before->busyTimeUs;
+	for(idx = 0; idx < FLS_SIMU_SECTOR_COUNT; idx++)
+	{
+		result->flash.sectorErases[idx] -= before->sectorErases[idx];
+	}
+
+	result->mountTimeUs = measureMount();
+	result->bVerified = (0 == result->flash.programViolations);
+	for(bIdx = BENCH_FIRST_BLOCK; bIdx <= BENCH_LAST_BLOCK; bIdx++)
+	{
+		/* a block, which is never written, is not found */
+		if( (true == nvm_read(bIdx, readData, &readSize)) && (0 != memcmp(readData, BlockData[bIdx], NvmBlocks[bIdx].size)) )
+		{
+			result->bVerified = false;
+		}
+	}
+}
+
+/* Run a workload with the configured number of writes */
+static bool runWorkload(BenchWorkload_t workload, BenchResult_t* result)
+{
+	FlsSimu_Stats_t before;
+	uint32_t startTime;
+	uint32_t writeIdx;
+
+	startWorkload(result);
+	FlsSimu_getStats(&before);
+	startTime = SysTime_getMicroseconds();
+
+	for(writeIdx = 0; writeIdx < Params.writes; writeIdx++)
+	{
+		writeBlock(workload(writeIdx), result);
+	}
+
+	result->elapsedUs = SysTime_getMicroseconds() - startTime;
+	finishWorkload(result, &before);
+
+	return (0 == result->failedWrites) && (true == result->bVerified);
+}
+
+/* Write all blocks in turn until the write pointer wraps to the first logical page again. The mount time is measured whenever
+   the fill of the current page reaches the next level */
+static bool runFillToWrap(BenchResult_t* result)
+{
+	FlsSimu_Stats_t before;
+	uint32_t mountTimeSum[BENCH_FILL_LEVELS];
+	uint32_t mountCount[BENCH_FILL_LEVELS];
+	uint32_t startTime;
+	uint32_t elapsedUs = 0;
+	uint32_t pageAddr;
+	uint32_t level;
+	uint32_t nextLevel = 0;
+	bool bLeftFirstPage = false;
+	NvmBlocksId_t bIdx = BENCH_FIRST_BLOCK;
+
+	startWorkload(result);
+	FlsSimu_getStats(&before);
+	memset(mountTimeSum, 0, sizeof(mountTimeSum));
+	memset(mountCount, 0, sizeof(mountCount));
+	pageAddr = GET_PAGE_ADDR(NvmManagerDescriptor.writePointer);
+
+	while(result->writes < Params.writes)
+	{
+		level = ((NvmManagerDescriptor.writePointer - GET_PAGE_ADDR(NvmManagerDescriptor.writePointer)) * BENCH_FILL_LEVELS) / LOGICAL_PAGE_SIZE;
+
+		if(GET_PAGE_ADDR(NvmManagerDescriptor.writePointer) != pageAddr)
+		{
+			pageAddr = GET_PAGE_ADDR(NvmManagerDescriptor.writePointer);
+			nextLevel = 0;
+
+			if(NVM_MANAGER_START_ADDR != pageAddr)
+			{
+				bLeftFirstPage = true;
+			}
+			else if(true == bLeftFirstPage)
+			{
+				/* all logical pages are written once */
+				break;
+			}
+		}
+
+		if( (level >= nextLevel) && (level < BENCH_FILL_LEVELS) )
+		{
+			mountTimeSum[level] += measureMount();
+			mountCount[level]++;
+			nextLevel = level + 1;
+		}
+
+		fillRandom(bIdx);
+		startTime = SysTime_getMicroseconds();
+		writeBlock(bIdx, result);
+		elapsedUs += SysTime_getMicroseconds() - startTime;
+		bIdx = (BENCH_LAST_BLOCK == bIdx) ? BENCH_FIRST_BLOCK : (NvmBlocksId_t)(bIdx + 1);
+	}
+
+	result->elapsedUs = elapsedUs;
+	for(level = 0; level < BENCH_FILL_LEVELS; level++)
+	{
+		result->mountTimeVsFill[level] = (0 < mountCount[level]) ? (mountTimeSum[level] / mountCount[level]) : 0;
+	}
+	result->bMountVsFill = true;
+	finishWorkload(result, &before);
+
+	return (0 == result->failedWrites) && (true == result->bVerified);
+}
+
+/* Measure the initialization of the NVManager after a reset */
+static uint32_t measureMount(void)
+{
+	uint32_t startTime;
+
+#ifdef NVM_USE_WEAR_BUDGET
+	/* the deferred writes would be lost by the reset */
+	nvm_write_flush();
+#endif
+	startTime = SysTime_getMicroseconds();
+	nvm_init();
+
+	return SysTime_getMicroseconds() - startTime;
+}
+
+/* Comparison of two latencies for qsort */
+static int compareU32(const void* a, const void* b)
+{
+	uint32_t valA = *(const uint32_t*)a;
+	uint32_t valB = *(const uint32_t*)b;
+
+	return (valA > valB) - (valA < valB);
+}
+
+/* Print the results of one workload as a JSON object */
+static void printResult(FILE* out, const char* name, BenchResult_t* result, bool bLast)
+{
+	uint32_t erases = 0;
+	uint32_t maxSectorErases = 0;
+	uint32_t idx;
+	double writesPerS = 0.0;
+	double writeAmplification = 0.0;
+
+	for(idx = 0; idx < FLS_SIMU_SECTOR_COUNT; idx++)
+	{
+		erases += result->flash.sectorErases[idx];
+		maxSectorErases = (result->flash.sectorErases[idx] > maxSectorErases) ? result->flash.sectorErases[idx] : maxSectorErases;
+	}
+	if(0 < result->elapsedUs)
+	{
+		writesPerS = ((double)result->writes * 1000000.0) / (double)result->elapsedUs;
+	}
+	if(0 < result->requestedBytes)
+	{
+		writeAmplification = (double)result->flash.programBytes / (double)result->requestedBytes;
+	}
+	qsort(result->latencies, result->writes, sizeof(uint32_t), compareU32);
+
+	fprintf(out, "    {\"name\": \"%s\", \"writes\": %u, \"failed_writes\": %u, \"verified\": %s, \"writes_per_s\": %.1f,\n",
+	        name, (unsigned)result->writes, (unsigned)result->failedWrites, (true == result->bVerified) ? "true" : "false", writesPerS);
+	if(0 < result->writes)
+	{
+		fprintf(out, "     \"write_latency_us\": {\"p50\": %u, \"p99\": %u, \"max\": %u},\n", (unsigned)result->latencies[(result->writes - 1) / 2],
+		        (unsigned)result->latencies[((result->writes - 1) * 99) / 100], (unsigned)result->latencies[result->writes - 1]);
+	}
+	fprintf(out, "     \"erases_per_1k_writes\": %.2f, \"max_sector_erases\": %u, \"write_amplification\": %.3f,\n",
+	        (0 < result->writes) ? (((double)erases * 1000.0) / (double)result->writes) : 0.0, (unsigned)maxSectorErases, writeAmplification);
+	fprintf(out, "     \"flash\": {\"reads\": %u, \"read_bytes\": %u, \"programs\": %u, \"program_bytes\": %u, \"program_violations\": %u, \"busy_time_us\": %u},\n",
+	        (unsigned)result->flash.reads, (unsigned)result->flash.readBytes, (unsigned)result->flash.programs, (unsigned)result->flash.programBytes,
+	        (unsigned)result->flash.programViolations, (unsigned)result->flash.busyTimeUs);
+	fprintf(out, "     \"mount_time_us\": %u", (unsigned)result->mountTimeUs);
+	if(true == result->bMountVsFill)
+	{
+		fprintf(out, ",\n     \"mount_time_vs_fill\": [");
+		for(idx = 0; idx < BENCH_FILL_LEVELS; idx++)
+		{
+			fprintf(out, "%s{\"fill_percent\": %u, \"mount_time_us\": %u}", (0 == idx) ? "" : ", ", (unsigned)((idx * 100) / BENCH_FILL_LEVELS),
+			        (unsigned)result->mountTimeVsFill[idx]);
+		}
+		fprintf(out, "]");
+	}
+	fprintf(out, "}%s\n", (true == bLast) ? "" : ",");
+}
+
+#ifdef NVM_USE_RECORDER
+/* Create a trace file and write its header */
+static bool startRecording(const char* path)
+{
+	uint8_t header[NVM_REC_HEADER_SIZE] = { 0 };
+
+	RecordFile = fopen(path, "wb");
+	if(NULL == RecordFile)
+	{
+		return false;
+	}
+
+	memcpy(header, NVM_REC_MAGIC, 4);
+	header[4] = (uint8_t)NVM_REC_VERSION;
+	header[5] = (uint8_t)(NVM_REC_VERSION >> 8);
+	header[6] = (uint8_t)NVM_REC_SIZE;
+	header[7] = (uint8_t)(NVM_REC_SIZE >> 8);
+
+	return (NVM_REC_HEADER_SIZE == fwrite(header, 1, NVM_REC_HEADER_SIZE, RecordFile));
+}
+
+/* Sink of the recorder, which appends the records to the trace file */
+static void recordSink(const uint8_t* record, uint32_t len)
+{
+	fwrite(record, 1, len, RecordFile);
+}
+#endif
@@ -24,47 +24,223 @@
 #include "nvm.h"
 #include "nvm_cfg.h"
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef NVM_USE_TRACE_USDT
+#include <sys/sdt.h>
+#endif
+
+/**********************************
+* Local macros
+***********************************/
+#ifdef NVM_USE_STATS
+#define NVM_STATS_ADD(counter, value)   (NvmStats.counter += (uint32_t)(value))
+#else
+#define NVM_STATS_ADD(counter, value)
+#endif
+
+#ifdef NVM_USE_RECORDER
+#define NVM_RECORD(op, bIdx, data, len, result)  _recordCall((op), (bIdx), (data), (len), (result))
+#else
+#define NVM_RECORD(op, bIdx, data, len, result)
+#endif
+
+#ifdef NVM_USE_TRACE
+#define NVM_TRACE_BEGIN(op, arg)            _traceBegin((op), (uint32_t)(arg))
+#define NVM_TRACE_END(op, startTime, arg)   _traceEnd((op), (startTime), (uint32_t)(arg))
+#else
+#define NVM_TRACE_BEGIN(op, arg)            0u
+#define NVM_TRACE_END(op, startTime, arg)   ((void)(startTime))
+#endif
+
 /**********************************
 * Local variables
 ***********************************/
 /* Data definition */
-uint8_t NvmRamBuffer[NVM_BLOCK_MAX_SIZE] = {0};
-uint8_t NvmGbcBuffer[NVM_BLOCK_MAX_SIZE] = {0};
+/* The only RAM buffer of the NVManager. All flash data is checked, compared and relocated chunk by chunk through it */
+static uint32_t NvmChunkBuffer[NVM_CHUNK_SIZE/sizeof(uint32_t)];
+#ifdef NVM_USE_LARGE_OBJECTS
+/* Source of the filling of the last chunk of a large object. It is constant, so it is not located in the RAM */
+static const uint8_t NvmZeroPadding[NVM_LO_CHUNK_SIZE] = {0};
+#endif
+#ifdef NVM_USE_KV_STORE
+/* Hash index of the key-value store. It is rebuilt by nvm_init and updated on every write */
+static NvmKvIndexEntry_t NvmKvIndex[NVM_KV_INDEX_SIZE];
+#endif
+#ifdef NVM_USE_EMERGENCY_FLUSH
+/* RAM locations of the logical blocks, which are changed but not written yet */
+static const uint8_t* NvmDirtyData[eNvmBlockCount];
+static uint32_t NvmDirtyCount = 0;
+static uint32_t NvmDirtySize = 0;
+#endif
+#ifdef NVM_USE_LAZY_MOUNT
+/* Logical blocks, whose latest instance is already found, while the records are not searched completely */
+static uint32_t NvmBlockResolved[(eNvmBlockCount + 31)/32];
+#endif
+#ifdef NVM_USE_WEAR_BUDGET
+/* Copies of the deferred writes of the throttleable blocks, their RAM locations and operating times of the last programming of the blocks */
+static uint8_t NvmPendingShadow[NVM_WEAR_SHADOW_SIZE];
+static const uint8_t* NvmPendingData[eNvmBlockCount];
+static uint32_t NvmLastWriteTime[eNvmBlockCount];
+#endif
+#ifdef NVM_USE_STATS
+/* Runtime counters since the last initialization. The usage of the page and the write amplification are calculated by nvm_get_stats */
+static NvmStats_t NvmStats;
+#endif
+#ifdef NVM_USE_RECORDER
+/* Sink of the recorder and the time of the previous record */
+static NvmRecordSink_t NvmRecordSink = NULL;
+static uint32_t NvmRecordLastTime = 0;
+static uint32_t NvmRecordLastSeconds = 0;
+static bool NvmRecordStarted = false;
+#endif
+#ifdef NVM_USE_TRACE
+/* Registered hooks of the trace points and log2 histograms of the latencies */
+static NvmTraceCallback_t NvmTraceCallback = NULL;
+static NvmTraceClock_t NvmTraceClock = NULL;
+static uint32_t NvmTraceHistogram[NVM_TRACE_OP_COUNT][NVM_TRACE_HIST_BUCKETS];
+#endif
+/* Live records and valid bytes of every logical page */
+static NvmPageInfo_t NvmPageInfo[NVM_PAGE_COUNT];
 NvmManagerDescriptor_t NvmManagerDescriptor = {0};
 static uint16_t Nvm_blockCounter = 0;
 
 /**********************************
 * Local functions prototypes
 ***********************************/
-static bool _getBlockInfo(uint32_t addr, NvmBlocksId_t* blockIdx, uint16_t* occCtr);
-static void _garbageCollection(uint32_t pageAddr, uint8_t currentBlockIdx);
+static bool _findBlockByPattern(uint16_t pattern, NvmBlocksId_t* blockIdx);
+static bool _getBlockInfo(uint32_t addr, NvmBlocksId_t* blockIdx, uint16_t* occCtr, uint32_t* dataSize);
+static bool _isRecordValid(uint32_t addr, uint32_t pageEndAddr, NvmBlocksId_t* blockIdx, uint16_t* occCtr, uint32_t* dataSize);
+static uint32_t _findNextValidRecord(uint32_t addr, uint32_t endAddr, uint32_t pageEndAddr);
+static bool _garbageCollection(uint32_t pageAddr, uint32_t currentRecordIdx);
+static bool _relocateRecord(uint32_t srcAddr, uint16_t pattern, uint16_t occCntr, uint32_t size);
+static bool _relocateNvmBlock(NvmBlocksId_t bIdx, uint32_t srcAddr, uint16_t occCntr);
+static bool _copyFlashData(uint32_t dstAddr, uint32_t srcAddr, uint32_t size);
+static void _advanceWritePointer(uint32_t len, bool bProgrammed);
+static void _setRecordLive(uint32_t recordIdx, uint32_t addr, uint32_t size);
+static void _clearRecordLive(uint32_t recordIdx, uint32_t addr, uint32_t size);
+static uint32_t _getLowestBit(uint32_t bits);
+static bool _isLiveDataFitting(uint32_t newSize, uint32_t oldSize);
+static bool _ensurePageSpace(uint32_t recordSize, uint32_t currentRecordIdx);
+static void _abortPageSwitch(uint32_t currPage, uint32_t nextPageAddr);
+static void _resetReadPointers(void);
+static bool _resetNvm(void);
+static bool _isNvmBlockCrcValid(uint32_t addr, uint32_t size);
+static bool _readNvmBlock(const NvmBlocksId_t bIdx, uint8_t* data, uint16_t *size);
+static bool _writeNvmBlock(const NvmBlocksId_t bIdx, const uint8_t* data, uint16_t len);
+static bool _programBlock(NvmBlocksId_t bIdx, const uint8_t* data, uint16_t len);
+#if defined(NVM_USE_LARGE_OBJECTS) || defined(NVM_USE_KV_STORE)
+static bool _readRecordPart(uint32_t addr, uint32_t size, uint16_t offset, uint8_t* data, uint16_t len);
+#endif
+#ifdef NVM_USE_EMERGENCY_FLUSH
+static void _clearDirty(NvmBlocksId_t bIdx);
+static void _mergeEmergencyRecords(void);
+#endif
+#ifdef NVM_USE_WEAR_BUDGET
+static uint32_t _getOperatingTime(void);
+static uint32_t _getWearStretch(void);
+static bool _deferWrite(NvmBlocksId_t bIdx, const uint8_t* data);
+static bool _writePendingBlocks(bool bForce);
+static bool _writeWearInfo(void);
+static void _loadWearInfo(void);
+#endif
+#ifdef NVM_USE_KV_STORE
+static uint32_t _kvHash(uint8_t keyType, const uint8_t* key, uint8_t keyLen);
+static bool _kvIsKeyEqual(uint32_t addr, uint8_t keyType, const uint8_t* key, uint8_t keyLen);
+static NvmKvIndexEntry_t* _kvFind(uint32_t hash, uint8_t keyType, const uint8_t* key, uint8_t keyLen, NvmKvIndexEntry_t** freeSlot);
+static bool _kvIndexRecord(uint32_t addr, uint16_t occCtr);
+static uint32_t _getKvRecordSize(const NvmKvIndexEntry_t* entry);
+static bool _relocateKvRecord(NvmKvIndexEntry_t* entry);
+static bool _kvWrite(uint8_t keyType, const uint8_t* key, uint8_t keyLen, const uint8_t* data, uint16_t len, bool bDelete);
+static bool _kvRead(uint8_t keyType, const uint8_t* key, uint8_t keyLen, uint8_t* data, uint16_t size, uint16_t* len);
+#endif
+#ifdef NVM_USE_TRACE
+static uint32_t _traceBegin(NvmTraceOp_t op, uint32_t arg);
+static void _traceEnd(NvmTraceOp_t op, uint32_t startTime, uint32_t arg);
+#endif
+#ifdef NVM_USE_RECORDER
+static void _recordCall(NvmRecordOp_t op, NvmBlocksId_t bIdx, const uint8_t* data, uint16_t len, bool bResult);
+#endif
+static bool _suspendErase(void);
+static void _resumeErase(bool bSuspended);
+static bool _readBytes(uint32_t addr, uint8_t* dest, uint32_t len);
+static bool _readBytesv(uint32_t addr, const FlsDrv_IoVec_t* iov, uint32_t iovCnt);
 static bool _writeBytes(uint32_t addr, uint8_t *buf, uint16_t len);
+static bool _writeBytesv(uint32_t addr, const FlsDrv_IoVec_t* iov, uint32_t iovCnt);
+static bool _isNvmBlockEqual(uint32_t addr, const uint8_t* data, uint16_t size);
+static bool _erasePage(uint32_t pageAddr);
+#ifdef NVM_USE_BACKGROUND_ERASE
+static bool _stepBackgroundErase(void);
+static void _completeBackgroundErase(void);
+static void _startBackgroundErase(uint32_t pageAddr);
+#endif
 static void _nvmCrc32(uint8_t* buffer, uint32_t bufferSize, uint32_t* calculatedCrc);
-static bool _isNvmBlockEmpty(uint32_t addr, uint16_t size);
+static bool _isNvmBlockEmpty(uint32_t addr, uint32_t size);
+#ifndef NVM_USE_FLS_BLANK_CHECK
+static bool _isErasedBuffer(const uint8_t* buf, uint32_t len);
+#endif
+static uint32_t _findErasedBoundary(uint32_t startAddr, uint32_t endAddr);
+static bool _mountBegin(void);
+static void _mountRecord(uint32_t addr, NvmBlocksId_t bIdx, uint16_t occCntr, uint32_t dataSize);
+static uint32_t _searchRecords(uint32_t addr, uint32_t maxRecords);
+static bool _mountRecords(uint32_t maxRecords);
+static void _completeMount(void);
+#ifdef NVM_USE_LAZY_MOUNT
+static void _resolveBlock(NvmBlocksId_t bIdx);
+#endif
 
 /**********************************
 * Local functions definition
 ***********************************/
+/**
+* @brief    Find the logical block with a given pattern through the hash index of the block patterns
+*
+* @param    [in]pattern : ID pattern from the header of a block
+*           [out]blockIdx : index of the block in the configuration
+*
+* @return   true if a block with this pattern is configured, otherwise - false
+*/
+static bool _findBlockByPattern(uint16_t pattern, NvmBlocksId_t* blockIdx)
+{
+    uint16_t entry = NvmPatternIndex[GET_PATTERN_SLOT(pattern)];
+
+    /* the index is free of collisions, so only the pattern of the indexed block has to be compared */
+    if( (0 != entry) && (pattern == NvmBlocks[entry - 1].pattern) )
+    {
+        *blockIdx = (NvmBlocksId_t)(entry - 1);
+        return true;
+    }
+
+    return false;
+}
+
 /**
 * @brief    A function to get a block info from NVM
 *
 * @param    [in]addr : start address of the logical page
-*           [out]blockIdx : index of the block in the configuration
+*           [out]blockIdx : index of the block in the configuration or NVM_KV_RECORD for a record of the key-value store
 *           [out]occCtr - occurece couter of the block
+*           [out]dataSize - size of the data between the header and the checksum of the block
 *
-* @return   true if the information (header) of the block is extracted correctly, otherwise - false (perhaps no block is written)
+* @return   true if the information (header) of the block is extracted correctly, otherwise - false (perhaps no block is written).
+*           The checksum of the block is not checked
 */
-static bool _getBlockInfo(uint32_t addr, NvmBlocksId_t* blockIdx, uint16_t* occCtr)
+static bool _getBlockInfo(uint32_t addr, NvmBlocksId_t* blockIdx, uint16_t* occCtr, uint32_t* dataSize)
 {
     uint8_t blockHeader[BLOCK_HEADER_SIZE] = { 0 };
-    uint32_t existingCrc = 0;
-    uint32_t calcCrc = 0;
+#ifdef NVM_USE_KV_STORE
+    NvmKvHeader_t kvHeader;
+#endif
     uint16_t occCntr = 0;
     uint16_t blockPatt = 0;
     NvmBlocksId_t bIdx;
     bool bResult = false;
 
-    FlsDrv_readBytes( addr, blockHeader, BLOCK_HEADER_SIZE );
+    _readBytes( addr, blockHeader, BLOCK_HEADER_SIZE );
 
     if(0 == memcmp(blockHeader, (uint8_t*)BLOCK_NOT_INIT, BLOCK_HEADER_SIZE))
     {
@@ -75,510 +251,3310 @@ static bool _getBlockInfo(uint32_t addr, NvmBlocksId_t* blockIdx, uint16_t* occC
     memcpy((uint8_t*)&blockPatt, blockHeader, BLOCK_HEADER_HALF_SIZE);
     memcpy((uint8_t*)&occCntr, blockHeader+BLOCK_HEADER_HALF_SIZE, BLOCK_HEADER_HALF_SIZE);
 
-    for(bIdx = (NvmBlocksId_t)0; bIdx < eNvmBlockCount; bIdx++)
+#ifdef NVM_USE_KV_STORE
+    if(NVM_KV_PATTERN == blockPatt)
     {
-        if(blockPatt == NvmBlocks[bIdx].pattern)
+        /* the size of a key-value record is stored in its own header */
+        _readBytes( addr + BLOCK_HEADER_SIZE, (uint8_t*)&kvHeader, NVM_KV_HEADER_SIZE );
+
+        if( (0 < kvHeader.keyLen) && (kvHeader.keyLen <= NVM_KV_MAX_KEY_SIZE) && (kvHeader.dataLen <= NVM_KV_MAX_DATA_SIZE) )
         {
-            *blockIdx = bIdx;
-            *occCtr = occCntr;
+            *blockIdx = NVM_KV_RECORD;
+            *dataSize = NVM_KV_HEADER_SIZE + kvHeader.keyLen + kvHeader.dataLen;
             bResult = true;
-            break;
         }
     }
-
-    if(bResult == false)
+    else
+#endif
+    if(true == _findBlockByPattern(blockPatt, &bIdx))
     {
-        /* invalid block found. Reset all NvM */
-        NvmManagerDescriptor.bErrorDetected = true;
+        *blockIdx = bIdx;
+        *dataSize = NvmBlocks[bIdx].size;
+        bResult = true;
     }
-    else
+
+    *occCtr = occCntr;
+
+    return bResult;
+}
+
+/**
+* @brief    Check whether a record on a given address is valid: its header is known, it ends into the page and its checksum matches
+*
+* @param    [in]addr : address of the header of the record
+*           [in]pageEndAddr : end address of the logical page
+*           [out]blockIdx : index of the block in the configuration or NVM_KV_RECORD for a record of the key-value store
+*           [out]occCtr - occurece couter of the block
+*           [out]dataSize - size of the data between the header and the checksum of the block
+*
+* @return   true if the record is valid, otherwise - false (torn or damaged record)
+*/
+static bool _isRecordValid(uint32_t addr, uint32_t pageEndAddr, NvmBlocksId_t* blockIdx, uint16_t* occCtr, uint32_t* dataSize)
+{
+    return (true == _getBlockInfo(addr, blockIdx, occCtr, dataSize)) &&
+           ((addr + *dataSize + BLOCK_HEADER_SIZE + NVM_CRC_LEN) <= pageEndAddr) &&
+           (true == _isNvmBlockCrcValid(addr, *dataSize));
+}
+
+/**
+* @brief    Search the next valid record after a damaged one. The size of the damaged record can not be trusted and the records 
+*           are not aligned, so every address is checked until a valid record is found
+*
+* @param    [in]addr : first address after the header of the damaged record
+*           [in]endAddr : address, after which the page is erased
+*           [in]pageEndAddr : end address of the logical page
+*
+* @return   address of the next valid record or endAddr if there is no one
+*/
+static uint32_t _findNextValidRecord(uint32_t addr, uint32_t endAddr, uint32_t pageEndAddr)
+{
+    NvmBlocksId_t bIdx;
+    uint16_t occCntr;
+    uint32_t dataSize;
+
+    for(; addr < endAddr; addr++)
     {
-        /* check CRC match  */
-        FlsDrv_readBytes( addr, NvmRamBuffer, BLOCK_HEADER_SIZE+NvmBlocks[*blockIdx].size+NVM_CRC_LEN );
-        memcpy(&existingCrc, NvmRamBuffer+BLOCK_HEADER_SIZE+NvmBlocks[*blockIdx].size, NVM_CRC_LEN);
-        
-        _nvmCrc32(NvmRamBuffer+BLOCK_HEADER_SIZE, NvmBlocks[*blockIdx].size, &calcCrc);
-        
-        if(existingCrc != calcCrc)
+        if(true == _isRecordValid(addr, pageEndAddr, &bIdx, &occCntr, &dataSize))
         {
-            /* invalid CRC found. Reset all NvM */
-            NvmManagerDescriptor.bErrorDetected = true;
+            break;
         }
     }
 
-    return bResult;
+    return (addr < endAddr) ? addr : endAddr;
 }
 
+#ifndef NVM_USE_FLS_BLANK_CHECK
 /**
-* @brief    Check whether the logical block on a given address is empty or not
+* @brief    Check whether all bytes of a RAM buffer are erased (0xFF). The check is done with the widest 
+*           data type available on the target (AVX2/SSE2/NEON or 32-bit words) and stops on the first written byte
 *
-* @param    [in]addr : address of the header of the logical block
-*           [in]size : the assumable size of the existin logical block
+* @param    [in]buf : buffer with the data read from the flash
+*           [in]len : size of the data into the buffer
 * 
-* @return   true if the block is empty(not written after the last erase), otherwise - false
+* @return   true if all bytes are erased, otherwise - false
 */
-static bool _isNvmBlockEmpty(uint32_t addr, uint16_t size)
+static bool _isErasedBuffer(const uint8_t* buf, uint32_t len)
 {
-    uint8_t tempBuffer[256];
-    uint32_t counter  = 0;
-    uint16_t remainingSize = 0;
-    uint32_t currentAddress = 0;
-    uint16_t currentSize = 0;
-    bool isBlockErased = true;
-    
-    remainingSize = size;
-    currentAddress = addr;
-    
-    
-    if(remainingSize > 256)
+    uint32_t idx = 0;
+    uint32_t word;
+
+#if defined(__AVX2__)
+    const __m256i erased256 = _mm256_set1_epi8((char)0xFF);
+
+    for(; (idx + sizeof(__m256i)) <= len; idx += sizeof(__m256i))
     {
-        currentSize = (uint16_t)256;
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(buf + idx));
+
+        if(-1 != _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, erased256)))
+        {
+            return false;
+        }
     }
-    else
+#endif
+
+#if defined(__SSE2__)
+    const __m128i erased128 = _mm_set1_epi8((char)0xFF);
+
+    for(; (idx + sizeof(__m128i)) <= len; idx += sizeof(__m128i))
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(buf + idx));
+
+        if(0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, erased128)))
+        {
+            return false;
+        }
+    }
+#elif defined(__ARM_NEON)
+    for(; (idx + sizeof(uint8x16_t)) <= len; idx += sizeof(uint8x16_t))
     {
-        currentSize = remainingSize;
+        uint64x2_t chunk = vreinterpretq_u64_u8(vld1q_u8(buf + idx));
+
+        if(0xFFFFFFFFFFFFFFFFull != (vgetq_lane_u64(chunk, 0) & vgetq_lane_u64(chunk, 1)))
+        {
+            return false;
+        }
     }
-    
-    while(remainingSize > 256)
+#endif
+
+    /* portable fallback: compare word by word */
+    for(; (idx + sizeof(uint32_t)) <= len; idx += sizeof(uint32_t))
     {
-        /* first check if this chunk is already written to the memory */
-        FlsDrv_readBytes( currentAddress, tempBuffer, currentSize);
-    
-        /*check if all bytes are erased */
-        for(counter = 0; counter < currentSize; counter++)
+        memcpy(&word, buf + idx, sizeof(uint32_t));
+
+        if(0xFFFFFFFF != word)
         {
-            isBlockErased &= (0xFF == tempBuffer[counter]);
+            return false;
         }
-        
-        remainingSize -=  currentSize;
-        currentAddress += currentSize;
     }
-    
-    if(remainingSize > 0)
+
+    /* the rest of the bytes, which are not aligned to a word */
+    for(; idx < len; idx++)
     {
-        /* first check if this chunk is already written to the memory */
-        FlsDrv_readBytes( currentAddress, tempBuffer, remainingSize);
-    
-        /*check if all bytes are erased */
-        for(counter = 0; counter < remainingSize; counter++)
+        if(0xFF != buf[idx])
         {
-            isBlockErased &= (0xFF == tempBuffer[counter]);
+            return false;
         }
     }
-    
-    return isBlockErased;
+
+    return true;
 }
+#endif
 
 /**
-* @brief    Write the information (header) of a logical block from NVManager
-*           OR Write the new data into the body of the logical block
+* @brief    Check whether the logical block on a given address is empty or not
 *
 * @param    [in]addr : address of the header of the logical block
-*           [in]buf  : source buffer, that contains the data to be written
-*           [in]len  : size of the data to be written
-*
-* @return   true if the writting was successful, otherwise - false
+*           [in]size : the assumable size of the existin logical block
+* 
+* @return   true if the block is empty(not written after the last erase), otherwise - false
 */
-static bool _writeBytes(uint32_t addr, uint8_t *buf, uint16_t len)
+static bool _isNvmBlockEmpty(uint32_t addr, uint32_t size)
 {
-    bool result = false;
+#ifdef NVM_USE_FLS_BLANK_CHECK
+    /* the flash driver performs the check by HW command */
+    bool bSuspended = _suspendErase();
+    bool result = FlsDrv_blankCheck(addr, size);
+
+    _resumeErase(bSuspended);
+
+    return result;
+#else
+    uint32_t currentAddress = addr;
+    uint32_t remainingSize = size;
+    uint32_t currentSize;
     
-    /* check if we are not trying to write out of the boundaries */
-    if((addr + len) < NVM_MANAGER_END_ADDR)
+    while(remainingSize > 0)
     {
-       result = FlsDrv_writeBytes(addr, buf, len);
+        currentSize = (remainingSize > NVM_CHUNK_SIZE) ? NVM_CHUNK_SIZE : remainingSize;
+
+        _readBytes( currentAddress, (uint8_t*)NvmChunkBuffer, currentSize);
+    
+        /* stop on the first chunk, which is already written */
+        if(false == _isErasedBuffer((const uint8_t*)NvmChunkBuffer, currentSize))
+        {
+            return false;
+        }
+        
+        remainingSize -= currentSize;
+        currentAddress += currentSize;
     }
     
-    return result;
+    return true;
+#endif
 }
 
 /**
-* @brief    A function to take all data from a NVManager page and transfer it to the other NVManager page
-*           A page or sector is considered to be te minimal eraseable size as per the specification of the Flash driver and the FLASH itself
-*
-* @param    [in]pageAddr : address of the current page
-*           [in]currentBlockIdx : the block which is currently written
+* @brief    Compare the data of a logical block in the flash with data in the RAM chunk by chunk
 *
-* @return   none
+* @param    [in]addr : address of the data of the logical block
+*           [in]data : data to be compared
+*           [in]size : size of the data
+* 
+* @return   true if the data is the same, otherwise - false
 */
-static void _garbageCollection(uint32_t pageAddr, uint8_t currentBlockIdx)
+static bool _isNvmBlockEqual(uint32_t addr, const uint8_t* data, uint16_t size)
 {
-    NvmBlocksId_t bIdx;
-    uint16_t size;
-    
-    /* this allows the memory compare of the current block data while overtaking in the new page to be suppressed */
-    NvmManagerDescriptor.bgarbageCollect = true;
+    uint16_t offset = 0;
+    uint16_t currentSize;
 
-    for(bIdx = (NvmBlocksId_t)0; bIdx < eNvmBlockCount; bIdx++)
+    while(offset < size)
     {
-        if( (pageAddr < NvmBlocks[bIdx].readPointer) && (NvmBlocks[bIdx].readPointer < pageAddr+FLASH_SECTOR_SIZE) && (bIdx != currentBlockIdx))
-        {
-            nvm_read(bIdx, NvmGbcBuffer, &size);
+        currentSize = ((size - offset) > NVM_CHUNK_SIZE) ? (uint16_t)NVM_CHUNK_SIZE : (uint16_t)(size - offset);
 
-            /* reset occurrence counter so that the latest data is always with higher occurrence number */
-            NvmBlocks[bIdx].occurrenceCntr = 0;
+        _readBytes( addr + offset, (uint8_t*)NvmChunkBuffer, currentSize);
 
-            /* attention: Recursion here */
-            nvm_write(bIdx, NvmGbcBuffer, NvmBlocks[bIdx].size);
+        if(0 != memcmp(NvmChunkBuffer, data + offset, currentSize))
+        {
+            return false;
         }
+
+        offset += currentSize;
     }
-    
-    NvmManagerDescriptor.bgarbageCollect = false;
+
+    return true;
 }
 
 /**
-* @brief    Performs calculation of checksum CRC32(helper function)
+* @brief    Check the checksum of a logical block in the flash. The data is read and checksummed chunk by chunk
 *
-* @param    [in]buffer: buffer with data that will be checksummed
-*           [in]bufferSize: size of the data into the buffer
-*           [out]calculatedCrc: calculated CRC32
+* @param    [in]addr : address of the header of the logical block
+*           [in]size : size of the data of the logical block
 * 
-* @return   none
+* @return   true if the stored checksum matches the data, otherwise - false. A record with erased data and checksum is torn 
+*           by a power cut after its header, even if the checksum of 4 erased bytes matches
 */
-/*  */
-static void _nvmCrc32(uint8_t* buffer, uint32_t bufferSize, uint32_t* calculatedCrc)
+static bool _isNvmBlockCrcValid(uint32_t addr, uint32_t size)
 {
+    uint32_t existingCrc = 0;
     uint32_t calcCrc = 0;
+    uint32_t offset = 0;
+    uint32_t currentSize;
 
-	calcCrc = CRC32_Calculate(buffer, bufferSize);
-    
-    *calculatedCrc = calcCrc;
-}
-
-/**********************************
-* Interface functions definition
-***********************************/
+    addr += BLOCK_HEADER_SIZE;
 
-/**
-* @brief    Initialize NVManager once after power-on. It searches the current read and write pointers and sets them into a structure in RAM
-* 
-* @param     none
-*
-* @return    none
-*/
-void nvm_init(void)
-{
-    uint8_t  pageHeader[PAGE_HEADER_SIZE] = { 0 };
-    uint32_t idx;
-    uint32_t currBlockAddr;
-    uint16_t currOccCntr;
-    NvmBlocksId_t bIdx;
-    bool bWritePointerFound = false;
-    bool bOpResult = false;
+    while(offset < size)
+    {
+        currentSize = ((size - offset) > NVM_CHUNK_SIZE) ? NVM_CHUNK_SIZE : (size - offset);
 
-    memset(NvmRamBuffer, 0, NVM_BLOCK_MAX_SIZE);
+        _readBytes( addr + offset, (uint8_t*)NvmChunkBuffer, currentSize);
+        calcCrc = CRC32_Update(calcCrc, (uint8_t*)NvmChunkBuffer, currentSize);
 
-    NvmManagerDescriptor.writePointer = 0;
-    NvmManagerDescriptor.bIsInitialized = false;
-    NvmManagerDescriptor.bErrorDetected = false;
-    
-    /* set the read point to not initialized */
-    for(bIdx = (NvmBlocksId_t)0; bIdx < eNvmBlockCount; bIdx++)
-    {
-        NvmBlocks[bIdx].readPointer = READ_POINTER_NOT_SET;
+        offset += currentSize;
     }
 
-	/* go through all pages in te flash */
-    for(idx=NVM_MANAGER_START_ADDR; idx<NVM_MANAGER_END_ADDR; idx+=FLASH_SECTOR_SIZE)
-    {
-        FlsDrv_readBytes( idx, pageHeader, PAGE_HEADER_SIZE );
+    _readBytes( addr + size, (uint8_t*)&existingCrc, NVM_CRC_LEN);
 
-        if(memcmp(pageHeader, (uint8_t*)PAGE_WRITTEN, PAGE_HEADER_SIZE) == 0)
-        {
-            /* page contains unprocessed data */
-            NvmManagerDescriptor.writePointer = idx;
-            bWritePointerFound = true;
-        }
-    }
+    return (existingCrc == calcCrc) && ((NVM_CRC_ERASED != existingCrc) || (false == _isNvmBlockEmpty(addr, size)));
+}
 
-    if(false == bWritePointerFound)
+/**
+* @brief    Find the beginning of the erased area at the end of a memory range by binary search
+*           The data is always written one after another, so once an address is followed only by erased bytes, 
+*           all of the addresses after it are followed only by erased bytes too. Every probe checks only the bytes up to the lowest 
+*           address known to be followed by erased bytes, so every erased byte is checked once. 
+*           The records up to the boundary are still walked by _mountRecords, because they restore the read pointers and 
+*           their sizes are known only from their patterns. The last record may end after the boundary, if its checksum ends 
+*           with erased bytes, so the write pointer is taken from the end of the last record and not from the boundary
+*
+* @param    [in]startAddr : first address of the range (i.e. the first DR in a page)
+*           [in]endAddr : first address after the range (i.e. end of the page)
+* 
+* @return   the lowest address, from which up to endAddr all bytes are erased. endAddr if the last byte is written
+*/
+static uint32_t _findErasedBoundary(uint32_t startAddr, uint32_t endAddr)
+{
+    uint32_t low = startAddr;
+    uint32_t high = endAddr;
+    uint32_t middle;
+
+    while(low < high)
     {
-        bOpResult = false;
-        /* erase the whole flash page by page and start from scratch */
-        for(idx=NVM_MANAGER_START_ADDR; idx< NVM_MANAGER_END_ADDR; idx += FLASH_SECTOR_SIZE)
-        {
-            bOpResult |= FlsDrv_eraseBlock4K(idx);
-        }
+        middle = low + ((high - low) / 2u);
 
-        if(true == bOpResult)
+        if(true == _isNvmBlockEmpty(middle, high - middle))
         {
-            NvmManagerDescriptor.writePointer = NVM_MANAGER_START_ADDR;
+            high = middle;
         }
         else
         {
-            NvmManagerDescriptor.bErrorDetected = true;
+            low = middle + 1u;
         }
     }
 
-    /* within the page that is currently written search for the first unoccupied NvM block 
-	*  check if write pointer was found */
-    if(false == bWritePointerFound)
-    {
-        /* locate the pointer at the first address after header of second Page */
-        NvmManagerDescriptor.writePointer = NVM_MANAGER_START_ADDR + PAGE_HEADER_SIZE;
+    return low;
+}
 
-        /* erase page 0 */
-        FlsDrv_eraseBlock4K(NVM_MANAGER_START_ADDR);
-        /* set page header of the first page */
-        FlsDrv_writeBytes( NVM_MANAGER_START_ADDR, (uint8_t*)PAGE_WRITTEN, PAGE_HEADER_HALF_SIZE);
-        
-#ifdef NVM_USE_DEFAULTS
-        memcpy(NvmRamBuffer, nvmDefaults, DEFAULTS_SIZE);
-        FlsDrv_writeBytes(DEFAULTS_START_ADDRESS , NvmRamBuffer, DEFAULTS_SIZE);
-        NvmManagerDescriptor.writePointer += DEFAULTS_SIZE;
+/**
+* @brief    Suspend the erase, which is running in the background, so that the flash can be accessed
+*
+* @param    none
+*
+* @return   true if the erase is suspended and has to be resumed after the access, otherwise - false
+*/
+static bool _suspendErase(void)
+{
+#ifdef NVM_USE_BACKGROUND_ERASE
+    /* the driver rejects the suspending if the erase is already finished */
+    return (true == NvmManagerDescriptor.bEraseRunning) && (true == FlsDrv_eraseSuspend());
+#else
+    return false;
 #endif
-    }
-    else
+}
+
+/**
+* @brief    Resume the erase, which was suspended for an access to the flash
+*
+* @param    [in]bSuspended : result of _suspendErase
+*
+* @return   none
+*/
+static void _resumeErase(bool bSuspended)
+{
+#ifdef NVM_USE_BACKGROUND_ERASE
+    if(true == bSuspended)
     {
-        /* add offset so that write pointer is set to the first DR */
-        NvmManagerDescriptor.writePointer += PAGE_HEADER_SIZE;
+        (void)FlsDrv_eraseResume();
+    }
+#else
+    (void)bSuspended;
+#endif
+}
 
-        currBlockAddr = NvmManagerDescriptor.writePointer;
+#ifdef NVM_USE_TRACE
+/**
+* @brief    Trace the begin of an operation
+*
+* @param    [in]op : the operation
+*           [in]arg : argument of the operation for the callback
+*
+* @return   timestamp of the begin
+*/
+static uint32_t _traceBegin(NvmTraceOp_t op, uint32_t arg)
+{
+    uint32_t timestamp = (NULL != NvmTraceClock) ? NvmTraceClock() : 0;
 
-        for(idx=PAGE_HEADER_SIZE; idx<FLASH_SECTOR_SIZE; )
-        {
-            if(false == _getBlockInfo(currBlockAddr, &bIdx, &currOccCntr))
-            {
-                /* first unoccupied block space found - this is the first possible writing address */
-                NvmManagerDescriptor.writePointer = currBlockAddr;
-                idx = FLASH_SECTOR_SIZE;
-                continue;
-            }
+#ifdef NVM_USE_TRACE_USDT
+    DTRACE_PROBE3(nvm, op__begin, op, arg, timestamp);
+#endif
 
-            currBlockAddr += (NvmBlocks[bIdx].size+BLOCK_HEADER_SIZE+NVM_CRC_LEN);
-            idx += (NvmBlocks[bIdx].size+BLOCK_HEADER_SIZE+NVM_CRC_LEN);
-        }
+    if(NULL != NvmTraceCallback)
+    {
+        NvmTraceCallback(op, NVM_TRACE_EVENT_BEGIN, timestamp, arg);
     }
 
-    currBlockAddr = (NvmManagerDescriptor.writePointer&GET_FLASH_PAGE_MASK) + PAGE_HEADER_SIZE;
-    
-    /* Check if the rest of the page is empty : all bytes equal to 0xFF 
-    *  if the rest of the page is not empty then error detected has to be true
+    return timestamp;
+}
+
+/**
+* @brief    Trace the end of an operation and count its latency into the histogram
+*
+* @param    [in]op : the operation
+*           [in]startTime : timestamp of the begin
+*           [in]arg : argument of the operation for the callback
+*
+* @return   none
+*/
+static void _traceEnd(NvmTraceOp_t op, uint32_t startTime, uint32_t arg)
+{
+    uint32_t timestamp;
+    uint32_t latency;
+    uint32_t bucket = 0;
+
+    if(NULL != NvmTraceClock)
+    {
+        timestamp = NvmTraceClock();
+        latency = timestamp - startTime;
+
+        /* position of the highest set bit */
+        while( (latency > 1u) && (bucket < (NVM_TRACE_HIST_BUCKETS - 1u)) )
+        {
+            latency >>= 1;
+            bucket++;
+        }
+
+        NvmTraceHistogram[op][bucket]++;
+    }
+    else
+    {
+        timestamp = 0;
+    }
+
+#ifdef NVM_USE_TRACE_USDT
+    DTRACE_PROBE4(nvm, op__end, op, arg, timestamp, timestamp - startTime);
+#endif
+
+    if(NULL != NvmTraceCallback)
+    {
+        NvmTraceCallback(op, NVM_TRACE_EVENT_END, timestamp, arg);
+    }
+}
+#endif
+
+#ifdef NVM_USE_RECORDER
+/**
+* @brief    Pass a call of the API to the sink of the recorder
+*
+* @param    [in]op : the call
+*           [in]bIdx : index of the logical block, ignored for an initialization
+*           [in]data : data of the block or NULL, if there is no data
+*           [in]len : size of the data. A shorter chunk of a large object is checksummed with its filling of zeros
+*           [in]bResult : result of the call
+*
+* @return   none
+*/
+static void _recordCall(NvmRecordOp_t op, NvmBlocksId_t bIdx, const uint8_t* data, uint16_t len, bool bResult)
+{
+    uint8_t record[NVM_REC_SIZE];
+    uint32_t timestamp;
+    uint32_t seconds;
+    uint32_t timeDiff;
+    uint32_t dataCrc = 0;
+    uint16_t size = 0;
+
+    if(NULL == NvmRecordSink)
+    {
+        return;
+    }
+
+    timestamp = SysTime_getMicroseconds();
+    seconds = SysTime_getSeconds();
+    timeDiff = (true == NvmRecordStarted) ? (timestamp - NvmRecordLastTime) : 0;
+
+    /* the microsecond timer wraps around after 71 minutes, so a longer pause is taken from the seconds */
+    if( (true == NvmRecordStarted) && ((seconds - NvmRecordLastSeconds) > (timeDiff / 1000000u)) )
+    {
+        timeDiff = ((seconds - NvmRecordLastSeconds) < 4294u) ? ((seconds - NvmRecordLastSeconds) * 1000000u) : 0xFFFFFFFFu;
+    }
+    NvmRecordLastTime = timestamp;
+    NvmRecordLastSeconds = seconds;
+    NvmRecordStarted = true;
+
+    if( (NVM_REC_WRITE == op) || (NVM_REC_READ == op) )
+    {
+        size = (uint16_t)NvmBlocks[bIdx].size;
+
+        if(NULL != data)
+        {
+            _nvmCrc32((uint8_t*)data, len, &dataCrc);
+#ifdef NVM_USE_LARGE_OBJECTS
+            dataCrc = CRC32_Update(dataCrc, (uint8_t*)NvmZeroPadding, (uint32_t)(size - len));
+#endif
+        }
+    }
+    else
+    {
+        bIdx = (NvmBlocksId_t)0;
+    }
+
+    /* the record does not depend on the endianness of the device */
+    record[0] = (uint8_t)op | ((true == bResult) ? 0 : NVM_REC_FAILED);
+    record[1] = (uint8_t)bIdx;
+    record[2] = (uint8_t)size;
+    record[3] = (uint8_t)(size >> 8);
+    record[4] = (uint8_t)timeDiff;
+    record[5] = (uint8_t)(timeDiff >> 8);
+    record[6] = (uint8_t)(timeDiff >> 16);
+    record[7] = (uint8_t)(timeDiff >> 24);
+    record[8] = (uint8_t)dataCrc;
+    record[9] = (uint8_t)(dataCrc >> 8);
+    record[10] = (uint8_t)(dataCrc >> 16);
+    record[11] = (uint8_t)(dataCrc >> 24);
+
+    NvmRecordSink(record, NVM_REC_SIZE);
+}
+#endif
+
+/**
+* @brief    Read bytes from the flash. A running erase is suspended during the reading
+*
+* @param    [in]addr : source address into the flash
+*           [out]dest : destination buffer
+*           [in]len : number of bytes to be read
+*
+* @return   true if the reading was successful, otherwise - false
+*/
+static bool _readBytes(uint32_t addr, uint8_t* dest, uint32_t len)
+{
+    uint32_t traceStart = NVM_TRACE_BEGIN(NVM_TRACE_READ, addr);
+    bool bSuspended = _suspendErase();
+    bool result = FlsDrv_readBytes(addr, dest, len);
+
+    _resumeErase(bSuspended);
+    NVM_TRACE_END(NVM_TRACE_READ, traceStart, addr);
+
+    return result;
+}
+
+/**
+* @brief    Read consecutive flash data into several buffers (header, data, checksum) with one flash operation. A running erase is suspended during the reading
+*
+* @param    [in]addr : source address into the flash
+*           [in]iov  : list of the destination buffers in the order they have to be filled
+*           [in]iovCnt : number of the destination buffers
+*
+* @return   true if the reading was successful, otherwise - false
+*/
+static bool _readBytesv(uint32_t addr, const FlsDrv_IoVec_t* iov, uint32_t iovCnt)
+{
+    uint32_t traceStart = NVM_TRACE_BEGIN(NVM_TRACE_READ, addr);
+    bool bSuspended = _suspendErase();
+    bool result = FlsDrv_readv(addr, iov, iovCnt);
+
+    _resumeErase(bSuspended);
+    NVM_TRACE_END(NVM_TRACE_READ, traceStart, addr);
+
+    return result;
+}
+
+/**
+* @brief    Write the information (header) of a logical block from NVManager
+*           OR Write the new data into the body of the logical block
+*
+* @param    [in]addr : address of the header of the logical block
+*           [in]buf  : source buffer, that contains the data to be written
+*           [in]len  : size of the data to be written
+*
+* @return   true if the writting was successful, otherwise - false
+*/
+static bool _writeBytes(uint32_t addr, uint8_t *buf, uint16_t len)
+{
+    uint32_t traceStart;
+    bool result = false;
+    bool bSuspended;
+    
+    /* check if we are not trying to write out of the boundaries of the NVM area and of the emergency region */
+    if( ((addr + len) <= NVM_MANAGER_END_ADDR)
+#ifdef NVM_USE_EMERGENCY_FLUSH
+        || ((addr >= NVM_EMERGENCY_START_ADDR) && ((addr + len) <= NVM_EMERGENCY_END_ADDR))
+#endif
+      )
+    {
+       /* the programming is done while the erase of another sector is suspended */
+       traceStart = NVM_TRACE_BEGIN(NVM_TRACE_PROGRAM, addr);
+       bSuspended = _suspendErase();
+       result = FlsDrv_writeBytes(addr, buf, len);
+       _resumeErase(bSuspended);
+       NVM_TRACE_END(NVM_TRACE_PROGRAM, traceStart, addr);
+
+       NVM_STATS_ADD(bytesProgrammed, (true == result) ? len : 0);
+    }
+    
+    return result;
+}
+
+/**
+* @brief    Write a logical block, which is scattered in several buffers (header, data, checksum), with one flash operation
+*
+* @param    [in]addr : address of the header of the logical block
+*           [in]iov  : list of the source buffers in the order they have to be written
+*           [in]iovCnt : number of the source buffers
+*
+* @return   true if the writting was successful, otherwise - false
+*/
+static bool _writeBytesv(uint32_t addr, const FlsDrv_IoVec_t* iov, uint32_t iovCnt)
+{
+    uint32_t len = 0;
+    uint32_t idx;
+    uint32_t traceStart;
+    bool result = false;
+    bool bSuspended;
+
+    for(idx = 0; idx < iovCnt; idx++)
+    {
+        len += iov[idx].len;
+    }
+    
+    /* check if we are not trying to write out of the boundaries */
+    if((addr + len) <= NVM_MANAGER_END_ADDR)
+    {
+       traceStart = NVM_TRACE_BEGIN(NVM_TRACE_PROGRAM, addr);
+       bSuspended = _suspendErase();
+       result = FlsDrv_writev(addr, iov, iovCnt);
+       _resumeErase(bSuspended);
+       NVM_TRACE_END(NVM_TRACE_PROGRAM, traceStart, addr);
+
+       NVM_STATS_ADD(bytesProgrammed, (true == result) ? len : 0);
+    }
+    
+    return result;
+}
+
+/**
+* @brief    Erase one logical page of the NVManager. Every erase relocates or drops NVM blocks, therefore the generation 
+*           of the NVManager is incremented so that the read views to the flash memory can be invalidated
+*
+* @param    [in]pageAddr : address of the page
+*
+* @return   true if the erasing was successful, otherwise - false
+*/
+static bool _erasePage(uint32_t pageAddr)
+{
+    uint32_t sectorAddr;
+    uint32_t traceStart;
+    bool result = true;
+
+    NvmManagerDescriptor.generation++;
+
+#ifdef NVM_USE_BACKGROUND_ERASE
+    /* the flash driver erases only one sector at a time */
+    _completeBackgroundErase();
+
+    if(pageAddr == NvmManagerDescriptor.erasePageAddr)
+    {
+        /* the page is already erased in the background */
+        NvmManagerDescriptor.erasePageAddr = NVM_ERASE_NONE;
+        return true;
+    }
+#endif
+
+    /* a logical page consists of one or more physical sectors */
+    for(sectorAddr = pageAddr; sectorAddr < (pageAddr + LOGICAL_PAGE_SIZE); sectorAddr += FLASH_SECTOR_SIZE)
+    {
+        traceStart = NVM_TRACE_BEGIN(NVM_TRACE_ERASE, sectorAddr);
+        result &= FlsDrv_eraseBlock4K(sectorAddr);
+        NVM_TRACE_END(NVM_TRACE_ERASE, traceStart, sectorAddr);
+        NVM_STATS_ADD(sectorErases[GET_SECTOR_IDX(sectorAddr)], 1);
+    }
+
+#ifdef NVM_USE_WEAR_BUDGET
+    NvmManagerDescriptor.eraseCount++;
+#endif
+
+    return result;
+}
+
+#ifdef NVM_USE_BACKGROUND_ERASE
+/**
+* @brief    Make one step of the erasing in the background: check whether the running sector erase is finished and start the next one
+*
+* @param    none
+*
+* @return   true if the released page is erased or there is no released page, otherwise - false
+*/
+static bool _stepBackgroundErase(void)
+{
+    if(true == NvmManagerDescriptor.bEraseRunning)
+    {
+        if(FLS_ERASE_IDLE != FlsDrv_eraseStatus())
+        {
+            return false;
+        }
+
+        NvmManagerDescriptor.bEraseRunning = false;
+        NvmManagerDescriptor.eraseAddr += FLASH_SECTOR_SIZE;
+    }
+
+    if( (NVM_ERASE_NONE == NvmManagerDescriptor.erasePageAddr) || 
+        (NvmManagerDescriptor.eraseAddr >= (NvmManagerDescriptor.erasePageAddr + LOGICAL_PAGE_SIZE)) )
+    {
+        return true;
+    }
+
+    NvmManagerDescriptor.bEraseRunning = FlsDrv_eraseStart(NvmManagerDescriptor.eraseAddr);
+
+    if(false == NvmManagerDescriptor.bEraseRunning)
+    {
+        /* the page is erased synchronously, when it is needed */
+        NvmManagerDescriptor.erasePageAddr = NVM_ERASE_NONE;
+        return true;
+    }
+
+    NVM_STATS_ADD(sectorErases[GET_SECTOR_IDX(NvmManagerDescriptor.eraseAddr)], 1);
+
+    return false;
+}
+
+/**
+* @brief    Wait until the released page is erased
+*
+* @param    none
+*
+* @return   none
+*/
+static void _completeBackgroundErase(void)
+{
+    while(false == _stepBackgroundErase())
+    {
+        /* polling of the flash driver */
+    }
+}
+
+/**
+* @brief    Release a logical page, so that it is erased in the background. Only one page is erased at a time, so the erasing 
+*           of the previous one is completed first
+*
+* @param    [in]pageAddr : address of the page
+*
+* @return   none
+*/
+static void _startBackgroundErase(uint32_t pageAddr)
+{
+    _completeBackgroundErase();
+
+    /* the read views to the page are not valid any more */
+    NvmManagerDescriptor.generation++;
+    NvmManagerDescriptor.erasePageAddr = pageAddr;
+    NvmManagerDescriptor.eraseAddr = pageAddr;
+#ifdef NVM_USE_WEAR_BUDGET
+    NvmManagerDescriptor.eraseCount++;
+#endif
+
+    (void)_stepBackgroundErase();
+}
+#endif
+
+/**
+* @brief    Move the write pointer after a logical block, which was just written
+*
+* @param    [in]len : size of the written logical block (header, data and checksum)
+*           [in]bProgrammed : false if the programming failed and only the space of the logical block is skipped
+*
+* @return   none
+*/
+static void _advanceWritePointer(uint32_t len, bool bProgrammed)
+{
+    NvmManagerDescriptor.writePointer += len;
+
+    if(true == bProgrammed)
+    {
+        NVM_STATS_ADD(recordsProgrammed, 1);
+        NVM_STATS_ADD(gcRecordsRelocated, (true == NvmManagerDescriptor.bgarbageCollect) ? 1 : 0);
+        NVM_STATS_ADD(gcBytesRelocated, (true == NvmManagerDescriptor.bgarbageCollect) ? len : 0);
+    }
+
+    if( 0 == GET_OFFSET_IN_PAGE(NvmManagerDescriptor.writePointer) )
+    {
+        /* page overflow will be performed on the next write operation */
+        NvmManagerDescriptor.writePointer -= BLOCK_HEADER_HALF_SIZE;
+    }
+}
+
+/**
+* @brief    Mark a record as live into the page of its new instance
+*
+* @param    [in]recordIdx : index of the logical block or eNvmBlockCount + entry of the hash index of the key-value store
+*           [in]addr : address of the header of the new instance
+*           [in]size : size of the new instance (header, data and checksum). 0 for a record, which is not live data (tombstone)
+*
+* @return   none
+*/
+static void _setRecordLive(uint32_t recordIdx, uint32_t addr, uint32_t size)
+{
+    NvmPageInfo_t* pageInfo = &NvmPageInfo[GET_PAGE_IDX(addr)];
+
+    pageInfo->liveRecords[recordIdx/32u] |= (1uL << (recordIdx%32u));
+    pageInfo->validBytes += size;
+}
+
+/**
+* @brief    Remove a record from the live records of the page of its old instance
+*
+* @param    [in]recordIdx : index of the logical block or eNvmBlockCount + entry of the hash index of the key-value store
+*           [in]addr : address of the header of the old instance
+*           [in]size : size of the old instance, as it was given to _setRecordLive
+*
+* @return   none
+*/
+static void _clearRecordLive(uint32_t recordIdx, uint32_t addr, uint32_t size)
+{
+    NvmPageInfo_t* pageInfo = &NvmPageInfo[GET_PAGE_IDX(addr)];
+
+    pageInfo->liveRecords[recordIdx/32u] &= ~(1uL << (recordIdx%32u));
+    pageInfo->validBytes -= size;
+}
+
+/**
+* @brief    Get the position of the lowest bit, which is set (De Bruijn multiplication)
+*
+* @param    [in]bits : a word, which is not 0
+*
+* @return   position of the lowest bit, which is set
+*/
+static uint32_t _getLowestBit(uint32_t bits)
+{
+    static const uint8_t bitPosition[32] = 
+    {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8, 
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+    };
+
+    return bitPosition[((bits & (0u - bits)) * 0x077CB531u) >> 27];
+}
+
+/**
+* @brief    Check whether all live data still fits into one logical page after a record is replaced, 
+*           so that the next garbage collection can not fail due to lack of space
+*
+* @param    [in]newSize : size of the new instance of the record
+*           [in]oldSize : size of the live instance of the record, which is replaced. 0 if there is none
+*
+* @return   true if the live data fits, otherwise - false
+*/
+static bool _isLiveDataFitting(uint32_t newSize, uint32_t oldSize)
+{
+    uint32_t validBytes = 0;
+    uint32_t pageIdx;
+
+    for(pageIdx = 0; pageIdx < NVM_PAGE_COUNT; pageIdx++)
+    {
+        validBytes += NvmPageInfo[pageIdx].validBytes;
+    }
+
+    return ((PAGE_HEADER_SIZE + validBytes + newSize - oldSize) <= LOGICAL_PAGE_SIZE);
+}
+
+/**
+* @brief    Copy data from one place of the flash to another chunk by chunk
+*
+* @param    [in]dstAddr : destination address
+*           [in]srcAddr : source address
+*           [in]size : size of the data
+*
+* @return   true if the data is copied, otherwise - false
+*/
+static bool _copyFlashData(uint32_t dstAddr, uint32_t srcAddr, uint32_t size)
+{
+    uint32_t offset = 0;
+    uint32_t currentSize;
+    bool result = true;
+
+    while((true == result) && (offset < size))
+    {
+        currentSize = ((size - offset) > NVM_CHUNK_SIZE) ? NVM_CHUNK_SIZE : (size - offset);
+
+        _readBytes( srcAddr + offset, (uint8_t*)NvmChunkBuffer, currentSize);
+        result = _writeBytes(dstAddr + offset, (uint8_t*)NvmChunkBuffer, (uint16_t)currentSize);
+
+        offset += currentSize;
+    }
+
+    return result;
+}
+
+/**
+* @brief    Copy a record from its current place to the write pointer as it is. Only the header is written again with a new 
+*           occurrence counter. The checksum covers only the data, so it is still valid and is copied together with the data
+*
+* @param    [in]srcAddr : address of the header of the record
+*           [in]pattern : pattern of the record
+*           [in]occCntr : new occurrence counter of the record
+*           [in]size : size of the record (header, data and checksum)
+*
+* @return   true if the record is copied, otherwise - false
+*/
+static bool _relocateRecord(uint32_t srcAddr, uint16_t pattern, uint16_t occCntr, uint32_t size)
+{
+    uint8_t blockHeader[BLOCK_HEADER_SIZE];
+    uint32_t dstAddr = NvmManagerDescriptor.writePointer;
+
+    if((GET_OFFSET_IN_PAGE(dstAddr) + size) > LOGICAL_PAGE_SIZE)
+    {
+        /* the live data does not fit into one page */
+        return false;
+    }
+
+    memcpy(blockHeader, (uint8_t*)&pattern, BLOCK_HEADER_HALF_SIZE);
+    memcpy(blockHeader+BLOCK_HEADER_HALF_SIZE, (uint8_t*)&occCntr, BLOCK_HEADER_HALF_SIZE);
+
+    return ( (true == _writeBytes(dstAddr, blockHeader, BLOCK_HEADER_SIZE)) &&
+             (true == _copyFlashData(dstAddr + BLOCK_HEADER_SIZE, srcAddr + BLOCK_HEADER_SIZE, size - BLOCK_HEADER_SIZE)) );
+}
+
+/**
+* @brief    Copy an instance of a logical block to the write pointer and make it the latest one
+*
+* @param    [in]bIdx : index of the logical block
+*           [in]srcAddr : address of the instance to be copied
+*           [in]occCntr : occurrence counter of the new instance
+*
+* @return   true if the logical block is copied, otherwise - false
+*/
+static bool _relocateNvmBlock(NvmBlocksId_t bIdx, uint32_t srcAddr, uint16_t occCntr)
+{
+    uint32_t size = NvmRecordSizes[bIdx];
+
+    if(true == _relocateRecord(srcAddr, NvmBlocks[bIdx].pattern, occCntr, size))
+    {
+        NvmBlocks[bIdx].occurrenceCntr = occCntr;
+
+        if(READ_POINTER_NOT_SET != NvmBlocks[bIdx].readPointer)
+        {
+            _clearRecordLive(bIdx, NvmBlocks[bIdx].readPointer, size);
+        }
+        _setRecordLive(bIdx, NvmManagerDescriptor.writePointer, size);
+        NvmBlocks[bIdx].readPointer = NvmManagerDescriptor.writePointer;
+        _advanceWritePointer(size, true);
+
+        return true;
+    }
+
+    return false;
+}
+
+/**
+* @brief    A function to take all data from a NVManager page and transfer it to the other NVManager page
+*           A page or sector is considered to be te minimal eraseable size as per the specification of the Flash driver and the FLASH itself
+*
+* @param    [in]pageAddr : address of the current page
+*           [in]currentRecordIdx : the block (or eNvmBlockCount + entry of the key-value index) which is currently written 
+*                                  and is not transferred, or NVM_RECORD_COUNT
+*
+* @return   true if all blocks are transferred, otherwise - false
+*/
+static bool _garbageCollection(uint32_t pageAddr, uint32_t currentRecordIdx)
+{
+    const NvmPageInfo_t* pageInfo = &NvmPageInfo[GET_PAGE_IDX(pageAddr)];
+    uint32_t word;
+    uint32_t bits;
+    uint32_t recordIdx;
+    uint32_t traceStart = NVM_TRACE_BEGIN(NVM_TRACE_GC, pageAddr);
+    bool result = true;
+    
+    /* this allows the memory compare of the current block data while overtaking in the new page to be suppressed */
+    NvmManagerDescriptor.bgarbageCollect = true;
+
+    NVM_STATS_ADD(gcRuns, 1);
+
+    /* only the live records of the page are visited. A relocated record is removed from the page, so a copy of the bitmap word is processed */
+    for(word = 0; word < NVM_LIVE_MAP_WORDS; word++)
+    {
+        bits = pageInfo->liveRecords[word];
+
+        while(0 != bits)
+        {
+            recordIdx = (word * 32u) + _getLowestBit(bits);
+            bits &= (bits - 1u);
+
+            if(recordIdx < eNvmBlockCount)
+            {
+#ifdef NVM_USE_WEAR_BUDGET
+                if( (eNvmWearInfo == recordIdx) && (recordIdx != currentRecordIdx) )
+                {
+                    /* the wear info is written with the actual values instead of being copied */
+                    NvmBlocks[recordIdx].occurrenceCntr = 0;
+                    result &= _writeWearInfo();
+                }
+                else
+#endif
+                if(recordIdx != currentRecordIdx)
+                {
+                    result &= _relocateNvmBlock((NvmBlocksId_t)recordIdx, NvmBlocks[recordIdx].readPointer, 1);
+                }
+            }
+#ifdef NVM_USE_KV_STORE
+            else if(recordIdx == currentRecordIdx)
+            {
+                /* the key is written right after the garbage collection */
+            }
+            else if(true == NvmKvIndex[recordIdx - eNvmBlockCount].bDeleted)
+            {
+                /* no older record of a deleted key is transferred, so its tombstone is not needed any more */
+                _clearRecordLive(recordIdx, NvmKvIndex[recordIdx - eNvmBlockCount].addr, 0);
+                NvmKvIndex[recordIdx - eNvmBlockCount].addr = NVM_KV_SLOT_VACATED;
+            }
+            else
+            {
+                result &= _relocateKvRecord(&NvmKvIndex[recordIdx - eNvmBlockCount]);
+            }
+#endif
+        }
+    }
+    
+    NvmManagerDescriptor.bgarbageCollect = false;
+
+    NVM_TRACE_END(NVM_TRACE_GC, traceStart, pageAddr);
+
+    return result;
+}
+
+/**
+* @brief    Make sure that a record fits between the write pointer and the end of the page. Otherwise the next page is prepared 
+*           and all live data is transferred into it by the garbage collection
+*
+* @param    [in]recordSize : size of the record to be written (header, data and checksum)
+*           [in]currentRecordIdx : the block (or eNvmBlockCount + entry of the key-value index) which is currently written. 
+*                                  Its old instance is not transferred, if it does not fit together with the new one
+*
+* @return   true if the write pointer is ready for the record, otherwise - false. The live data is never erased by a failed 
+*           page switch - the NVManager continues with the page, which has the complete data, and the switch is repeated by the next write
+*/
+static bool _ensurePageSpace(uint32_t recordSize, uint32_t currentRecordIdx)
+{
+    uint32_t currPage;
+    uint32_t nextPageAddr;
+    uint32_t skipRecordIdx;
+    bool writeResult;
+
+    if( (GET_OFFSET_IN_PAGE(NvmManagerDescriptor.writePointer) + recordSize) > LOGICAL_PAGE_SIZE )
+    {
+        /* page overflow */
+        currPage = GET_PAGE_ADDR(NvmManagerDescriptor.writePointer);
+
+        /* the old instance of the current record is transferred as well, so it is not lost by a power cut before the new one 
+        *  is written. It is dropped only if it does not fit into the next page together with the new one */
+        skipRecordIdx = (true == _isLiveDataFitting(recordSize, 0)) ? NVM_RECORD_COUNT : currentRecordIdx;
+
+        if(currPage + LOGICAL_PAGE_SIZE >= NVM_MANAGER_END_ADDR)
+        {
+            nextPageAddr = NVM_MANAGER_START_ADDR;
+        }
+        else
+        {
+            nextPageAddr = currPage + LOGICAL_PAGE_SIZE;
+        }
+
+        /* erase next page. Nothing is changed if it fails, so the current page stays the page with data */
+        if(false == _erasePage(nextPageAddr))
+        {
+            NvmManagerDescriptor.bErrorDetected = true;
+            return false;
+        }
+
+        /* mark this page as the one with the complete data, until the garbage collection is finished. After a power cut
+        *  in between, both pages are marked as written and the next page misses the records, which are not transferred yet.
+        *  The next page is marked as written after it */
+        if( (false == _writeBytes( currPage+PAGE_HEADER_HALF_SIZE, (uint8_t*)PAGE_MARK_AS_LAST, PAGE_HEADER_ONE_BYTE)) ||
+            (false == _writeBytes( nextPageAddr, (uint8_t*)PAGE_MARK_AS_WRITTEN, PAGE_HEADER_HALF_SIZE)) )
+        {
+            /* no record is transferred yet, so the read pointers into the current page are still valid */
+            NvmManagerDescriptor.bErrorDetected = true;
+            return false;
+        }
+
+        NvmManagerDescriptor.writePointer = nextPageAddr + PAGE_HEADER_SIZE;
+
+        /* ensure that all NvM blocks are updated in the next page */
+        writeResult = _garbageCollection(currPage, skipRecordIdx);
+
+        /* mark this page as ready to be erased */
+        writeResult = (true == writeResult) && 
+                      (true == _writeBytes( currPage+PAGE_HEADER_SIZE-PAGE_HEADER_ONE_BYTE, (uint8_t*)PAGE_MARK_AS_READ, PAGE_HEADER_ONE_BYTE));
+
+        if(false == writeResult)
+        {
+            /* the marks of the pages are left as they are, so the next switch starts again with the erase of the next page */
+            _abortPageSwitch(currPage, nextPageAddr);
+            return false;
+        }
+
+        if(skipRecordIdx < eNvmBlockCount)
+        {
+            /* set the current occurance counter to 0 */
+            NvmBlocks[currentRecordIdx].occurrenceCntr = 0;
+        }
+
+#ifdef NVM_USE_BACKGROUND_ERASE
+        /* the page is erased before it is needed again */
+        _startBackgroundErase(currPage);
+#endif
+    }
+
+    return true;
+}
+
+/**
+* @brief    Continue with the page, which has the complete data after a failed page switch. Its records are searched again 
+*           like after power-on, so no live data is erased. The garbage collection is complete only if the read mark of the old 
+*           page is programmed - a torn mark counts as programmed, like by the search after power-on
+*
+* @param    [in]currPage : address of the page, which was collected
+*           [in]nextPageAddr : address of the page, into which the live data was transferred
+*
+* @return   none
+*/
+static void _abortPageSwitch(uint32_t currPage, uint32_t nextPageAddr)
+{
+    uint8_t readMark = 0xFF;
+    uint32_t pageAddr = currPage;
+    uint32_t addr;
+
+    NvmManagerDescriptor.bErrorDetected = true;
+    NvmManagerDescriptor.bgarbageCollect = false;
+
+    _readBytes( currPage+PAGE_HEADER_SIZE-PAGE_HEADER_ONE_BYTE, &readMark, PAGE_HEADER_ONE_BYTE);
+    if(0xFF != readMark)
+    {
+        pageAddr = nextPageAddr;
+    }
+
+    _resetReadPointers();
+    NvmManagerDescriptor.mountPageEndAddr = pageAddr + LOGICAL_PAGE_SIZE;
+    NvmManagerDescriptor.mountEndAddr = _findErasedBoundary(pageAddr + PAGE_HEADER_SIZE, NvmManagerDescriptor.mountPageEndAddr);
+
+    addr = _searchRecords(pageAddr + PAGE_HEADER_SIZE, 0xFFFFFFFF);
+    NvmManagerDescriptor.mountPointer = addr;
+
+    /* a full page is switched again by the next write */
+    NvmManagerDescriptor.writePointer = (addr >= NvmManagerDescriptor.mountPageEndAddr) ? (NvmManagerDescriptor.mountPageEndAddr - BLOCK_HEADER_HALF_SIZE) : addr;
+}
+
+/**
+* @brief    Forget the locations of all logical blocks and key-value records
+*
+* @param    none
+*
+* @return   none
+*/
+static void _resetReadPointers(void)
+{
+    NvmBlocksId_t bIdx;
+#ifdef NVM_USE_KV_STORE
+    uint32_t slot;
+#endif
+
+    for(bIdx = (NvmBlocksId_t)0; bIdx < eNvmBlockCount; bIdx++)
+    {
+        NvmBlocks[bIdx].readPointer = READ_POINTER_NOT_SET;
+        /* the search after power-on takes the instance with the biggest occurence counter */
+        NvmBlocks[bIdx].occurrenceCntr = 0;
+    }
+
+    memset(NvmPageInfo, 0, sizeof(NvmPageInfo));
+
+#ifdef NVM_USE_KV_STORE
+    for(slot = 0; slot < NVM_KV_INDEX_SIZE; slot++)
+    {
+        NvmKvIndex[slot].addr = NVM_KV_SLOT_FREE;
+        NvmKvIndex[slot].bDeleted = false;
+    }
+#endif
+}
+
+/**
+* @brief    Erase the whole NVM area and start from scratch. It is done when the content of the NVM can not be trusted any more
+*
+* @param    none
+*
+* @return   true if the NVM area is erased, otherwise - false (the NVManager is not initialized any more)
+*/
+static bool _resetNvm(void)
+{
+    bool bOpResult = true;
+    uint32_t idx;
+    
+    /* erase the whole logical page by page and start from scratch */
+    for(idx=NVM_MANAGER_START_ADDR; idx<NVM_MANAGER_END_ADDR; idx += LOGICAL_PAGE_SIZE)
+    {
+        bOpResult &= _erasePage(idx);
+    }
+
+    if(true == bOpResult)
+    {
+        /* the first page gets the data, so it is found by the next nvm_init */
+        bOpResult = _writeBytes( NVM_MANAGER_START_ADDR, (uint8_t*)PAGE_MARK_AS_WRITTEN, PAGE_HEADER_HALF_SIZE);
+        NvmManagerDescriptor.writePointer = NVM_MANAGER_START_ADDR + PAGE_HEADER_SIZE;
+    }
+
+    if(false == bOpResult)
+    {
+        NvmManagerDescriptor.bIsInitialized = false;
+    }
+    
+    /* set the read point to not initialized */
+    _resetReadPointers();
+
+    return bOpResult;
+}
+
+/**
+* @brief    Performs calculation of checksum CRC32(helper function)
+*
+* @param    [in]buffer: buffer with data that will be checksummed
+*           [in]bufferSize: size of the data into the buffer
+*           [out]calculatedCrc: calculated CRC32
+* 
+* @return   none
+*/
+/*  */
+static void _nvmCrc32(uint8_t* buffer, uint32_t bufferSize, uint32_t* calculatedCrc)
+{
+    uint32_t calcCrc = 0;
+
+	calcCrc = CRC32_Calculate(buffer, bufferSize);
+    
+    *calculatedCrc = calcCrc;
+}
+
+/**
+* @brief    Read the latest instance of a logical block
+*
+* @param    [in]bIdx : index of the logical block to write the data
+*           [out]data : pointer to the source data buffer
+*           [out]size : pointer size of the data that was read
+* 
+* @return   true if data is read correctly. Otherwise - false
+*/
+static bool _readNvmBlock(const NvmBlocksId_t bIdx, uint8_t* data, uint16_t *size)
+{
+    uint8_t blockHeader[BLOCK_HEADER_SIZE];
+    FlsDrv_IoVec_t blockIo[NVM_BLOCK_IO_COUNT];
+    uint32_t existingCrc32 = 0;
+    uint32_t calculatedCrc32 = 0;
+    bool bResL = false;
+
+#ifdef NVM_USE_LAZY_MOUNT
+    /* the block is searched on its first read after nvm_init_lazy */
+    _resolveBlock(bIdx);
+#endif
+
+#ifdef NVM_USE_WEAR_BUDGET
+    if(NULL != NvmPendingData[bIdx])
+    {
+        /* the latest data is not programmed yet */
+        memcpy(data, NvmPendingData[bIdx], NvmBlocks[bIdx].size);
+        *size = (uint16_t)NvmBlocks[bIdx].size;
+
+        return true;
+    }
+#endif
+
+    if(READ_POINTER_NOT_SET == NvmBlocks[bIdx].readPointer)
+    {
+        return false;
+    }
+    
+    /* the data is read directly into the user buffer, only header and checksum are stored locally */
+    blockIo[0].buf = blockHeader;
+    blockIo[0].len = BLOCK_HEADER_SIZE;
+    blockIo[1].buf = data;
+    blockIo[1].len = NvmBlocks[bIdx].size;
+    blockIo[2].buf = (uint8_t*)&existingCrc32;
+    blockIo[2].len = NVM_CRC_LEN;
+
+    bResL = _readBytesv( NvmBlocks[bIdx].readPointer, blockIo, NVM_BLOCK_IO_COUNT );
+
+    if(bResL == true)
+    {
+        _nvmCrc32(data, NvmBlocks[bIdx].size, &calculatedCrc32);
+        
+        if (calculatedCrc32 == existingCrc32)
+        {
+            *size = NvmBlocks[bIdx].size;
+        }
+        else
+        {
+            bResL = false;
+        }
+    }
+
+    return bResL;
+}
+
+/**
+* @brief    Write a new instance of a logical block at the write pointer. If the data is shorter than the logical block
+*           (last chunk of a large object), the rest of the logical block is filled with zeros
+*
+* @param    [in]bIdx : index of the logical block to write the data
+*           [in]data : pointer to the source data buffer
+*           [in]len : size of the source data
+* 
+* @return   indicate if data is stored or an error has occurred
+*/
+static bool _writeNvmBlock(const NvmBlocksId_t bIdx, const uint8_t* data, uint16_t len)
+{
+    uint8_t blockHeader[BLOCK_HEADER_SIZE];
+    FlsDrv_IoVec_t blockIo[NVM_BLOCK_WRITE_IO_COUNT];
+    uint32_t recordSize = NvmRecordSizes[bIdx];
+    uint32_t calculatedCrc32 = 0;
+    uint32_t existingCrc32 = 0;
+    uint16_t padding = (uint16_t)(NvmBlocks[bIdx].size - len);
+    uint32_t traceStart;
+    bool bUnchanged = false;
+
+    /* the write pointer is known only after all records are searched */
+    _completeMount();
+
+#ifdef NVM_USE_EMERGENCY_FLUSH
+    if( (true == NvmManagerDescriptor.bEmergencyPending) && (false == NvmManagerDescriptor.bgarbageCollect) )
+    {
+        /* the application continues after an emergency flush without a reset. The flushed records are older than this write, 
+        *  so they are merged before it and the next initialization does not override the written data with them */
+        _mergeEmergencyRecords();
+    }
+#endif
+
+    NVM_STATS_ADD(writesRequested, (false == NvmManagerDescriptor.bgarbageCollect) ? 1 : 0);
+    
+    /* the checksum of the data to be written is calculated directly over the user buffer */
+    _nvmCrc32((uint8_t*)data, len, &calculatedCrc32);
+#ifdef NVM_USE_LARGE_OBJECTS
+    calculatedCrc32 = CRC32_Update(calculatedCrc32, (uint8_t*)NvmZeroPadding, padding);
+#endif
+
+    /* first check if there is a change of the parameter to be written. This is done to decrease the number fo writings into FLASH
+    *  perform this check only if no garbage collection is ongoing. Data with a different checksum is for sure changed, 
+    *  so the stored data is compared only if the checksums are equal
+    */
+    if( (false == NvmManagerDescriptor.bgarbageCollect) && (READ_POINTER_NOT_SET != NvmBlocks[bIdx].readPointer) )
+    {
+        traceStart = NVM_TRACE_BEGIN(NVM_TRACE_DUP_CHECK, bIdx);
+
+        bUnchanged = (true == _readBytes( NvmBlocks[bIdx].readPointer + BLOCK_HEADER_SIZE + NvmBlocks[bIdx].size, (uint8_t*)&existingCrc32, NVM_CRC_LEN)) &&
+                     (existingCrc32 == calculatedCrc32) &&
+                     (true == _isNvmBlockEqual(NvmBlocks[bIdx].readPointer + BLOCK_HEADER_SIZE, data, len))
+#ifdef NVM_USE_LARGE_OBJECTS
+                     && (true == _isNvmBlockEqual(NvmBlocks[bIdx].readPointer + BLOCK_HEADER_SIZE + len, NvmZeroPadding, padding))
+#endif
+                     ;
+
+        NVM_TRACE_END(NVM_TRACE_DUP_CHECK, traceStart, bIdx);
+    }
+
+    if(true == bUnchanged)
+    {
+        /* the data is already stored */
+        NVM_STATS_ADD(writesSkipped, 1);
+        return true;
+    }
+
+    if(false == _isLiveDataFitting(recordSize, (READ_POINTER_NOT_SET != NvmBlocks[bIdx].readPointer) ? recordSize : 0))
+    {
+        /* the write is rejected, because the next garbage collection would not be able to transfer all of the live data */
+        return false;
+    }
+
+    if(false == _ensurePageSpace(recordSize, bIdx))
+    {
+        /* the page switch failed. The live data stays in the current page, so it is not erased */
+        return false;
+    }
+
+    memcpy(blockHeader, (uint8_t*)(&NvmBlocks[bIdx].pattern), BLOCK_HEADER_HALF_SIZE);
+
+    /* Counter is reset on Garbage collection */
+    NvmBlocks[bIdx].occurrenceCntr++;
+    
+    /* Set the occurance counter  */
+    memcpy(blockHeader+BLOCK_HEADER_HALF_SIZE, (uint8_t*)(&NvmBlocks[bIdx].occurrenceCntr), BLOCK_HEADER_HALF_SIZE);
+
+    /* header, data, padding and checksum are programmed directly from their locations */
+    blockIo[0].buf = blockHeader;
+    blockIo[0].len = BLOCK_HEADER_SIZE;
+    blockIo[1].buf = (uint8_t*)data;
+    blockIo[1].len = len;
+#ifdef NVM_USE_LARGE_OBJECTS
+    blockIo[2].buf = (uint8_t*)NvmZeroPadding;
+#else
+    blockIo[2].buf = NULL;
+#endif
+    blockIo[2].len = padding;
+    blockIo[3].buf = (uint8_t*)&calculatedCrc32;
+    blockIo[3].len = NVM_CRC_LEN;
+
+    if(true == _writeBytesv( NvmManagerDescriptor.writePointer, blockIo, NVM_BLOCK_WRITE_IO_COUNT))
+    {
+        if(READ_POINTER_NOT_SET != NvmBlocks[bIdx].readPointer)
+        {
+            _clearRecordLive(bIdx, NvmBlocks[bIdx].readPointer, recordSize);
+        }
+        _setRecordLive(bIdx, NvmManagerDescriptor.writePointer, recordSize);
+        NvmBlocks[bIdx].readPointer = NvmManagerDescriptor.writePointer;
+
+        _advanceWritePointer(recordSize, true);
+        
+        return true;
+    }
+    else
+    {
+        /* the record may be programmed partially. Its space is skipped, so the previous instance of the block stays the latest one */
+        NvmManagerDescriptor.bErrorDetected = true;
+        _advanceWritePointer(recordSize, false);
+        
+        return false;
+    }
+}
+
+/**
+* @brief    Program the data of a logical block, which is written through the interface, and update the bookkeeping of the written blocks
+*
+* @param    [in]bIdx : index of the logical block
+*           [in]data : pointer to the source data buffer
+*           [in]len : size of the data. A shorter chunk of a large object is filled with zeros
+* 
+* @return   true if the data is stored, otherwise - false
+*/
+static bool _programBlock(NvmBlocksId_t bIdx, const uint8_t* data, uint16_t len)
+{
+    if(false == _writeNvmBlock(bIdx, data, len))
+    {
+        return false;
+    }
+
+#ifdef NVM_USE_EMERGENCY_FLUSH
+    /* the block does not need to be flushed any more */
+    _clearDirty(bIdx);
+#endif
+#ifdef NVM_USE_WEAR_BUDGET
+    /* the coalescing window of the block starts again */
+    NvmPendingData[bIdx] = NULL;
+    NvmLastWriteTime[bIdx] = _getOperatingTime();
+#endif
+
+    return true;
+}
+
+#if defined(NVM_USE_LARGE_OBJECTS) || defined(NVM_USE_KV_STORE)
+/**
+* @brief    Read a part of the data of a logical block or a key-value record. The whole data is checksummed chunk by chunk, 
+*           but only the requested part is copied into the destination buffer
+*
+* @param    [in]addr : address of the header of the logical block
+*           [in]size : size of the data of the logical block
+*           [in]offset : offset of the requested part into the data of the logical block
+*           [out]data : destination buffer
+*           [in]len : size of the requested part
+* 
+* @return   true if the checksum of the logical block is correct, otherwise - false
+*/
+static bool _readRecordPart(uint32_t addr, uint32_t size, uint16_t offset, uint8_t* data, uint16_t len)
+{
+    uint32_t existingCrc = 0;
+    uint32_t calcCrc = 0;
+    uint32_t pos = 0;
+    uint32_t currentSize;
+    uint32_t copyStart;
+    uint32_t copyEnd;
+
+    addr += BLOCK_HEADER_SIZE;
+
+    while(pos < size)
+    {
+        currentSize = ((size - pos) > NVM_CHUNK_SIZE) ? NVM_CHUNK_SIZE : (size - pos);
+
+        _readBytes( addr + pos, (uint8_t*)NvmChunkBuffer, currentSize);
+        calcCrc = CRC32_Update(calcCrc, (uint8_t*)NvmChunkBuffer, currentSize);
+
+        /* copy the part of the requested data, which is in this chunk */
+        copyStart = (pos > offset) ? pos : offset;
+        copyEnd = ((pos + currentSize) < ((uint32_t)offset + len)) ? (pos + currentSize) : ((uint32_t)offset + len);
+
+        if(copyStart < copyEnd)
+        {
+            memcpy(data + (copyStart - offset), (uint8_t*)NvmChunkBuffer + (copyStart - pos), copyEnd - copyStart);
+        }
+
+        pos += currentSize;
+    }
+
+    _readBytes( addr + size, (uint8_t*)&existingCrc, NVM_CRC_LEN);
+
+    return (existingCrc == calcCrc);
+}
+#endif
+
+#ifdef NVM_USE_EMERGENCY_FLUSH
+/**
+* @brief    Remove the dirty mark of a logical block
+*
+* @param    [in]bIdx : index of the logical block
+*
+* @return   none
+*/
+static void _clearDirty(NvmBlocksId_t bIdx)
+{
+    if(NULL != NvmDirtyData[bIdx])
+    {
+        NvmDirtyData[bIdx] = NULL;
+        NvmDirtyCount--;
+        NvmDirtySize -= NvmRecordSizes[bIdx];
+    }
+}
+
+/**
+* @brief    Merge the records of the last emergency flush into the NVM area and erase the emergency region for the next flush.
+*           Every merged record is marked before the erasing, so it is not merged again if the erasing is interrupted. A record, whose
+*           generation is not newer than the latest instance of the block, is older than a normal write and is only marked
+*
+* @param    none
+*
+* @return   none
+*/
+static void _mergeEmergencyRecords(void)
+{
+    uint8_t blockHeader[BLOCK_HEADER_SIZE];
+    uint16_t blockPatt = 0;
+    uint16_t occCntr = 0;
+    uint16_t merged = NVM_EMERGENCY_RECORD_MERGED;
+    uint32_t addr = NVM_EMERGENCY_START_ADDR;
+    uint32_t size;
+    uint32_t oldSize;
+    uint32_t sectorAddr;
+    uint32_t mergedBlocks[(eNvmBlockCount + 31)/32] = { 0 };
+    NvmBlocksId_t bIdx;
+    bool bConsumed;
+    bool result = true;
+
+    /* the records are merged only once, also if a write is done by the merging itself */
+    NvmManagerDescriptor.bEmergencyPending = false;
+
+    while((addr + BLOCK_HEADER_SIZE) <= NVM_EMERGENCY_END_ADDR)
+    {
+        _readBytes( addr, blockHeader, BLOCK_HEADER_SIZE );
+        memcpy((uint8_t*)&blockPatt, blockHeader, BLOCK_HEADER_HALF_SIZE);
+        memcpy((uint8_t*)&occCntr, blockHeader+BLOCK_HEADER_HALF_SIZE, BLOCK_HEADER_HALF_SIZE);
+
+        /* erased memory or a record, which was not written completely */
+        if(false == _findBlockByPattern(blockPatt, &bIdx))
+        {
+            break;
+        }
+
+        size = NvmRecordSizes[bIdx];
+        oldSize = (READ_POINTER_NOT_SET != NvmBlocks[bIdx].readPointer) ? size : 0;
+
+        if((addr + size) > NVM_EMERGENCY_END_ADDR)
+        {
+            break;
+        }
+
+        /* a record, which was interrupted by the power loss, is skipped */
+        if( (NVM_EMERGENCY_RECORD_MERGED != occCntr) && (true == _isNvmBlockCrcValid(addr, NvmBlocks[bIdx].size)) )
+        {
+            bConsumed = false;
+
+            if( (0 == (mergedBlocks[bIdx >> 5] & (1uL << (bIdx & 31u)))) && (0 != oldSize) &&
+                (NvmBlocks[bIdx].occurrenceCntr >= occCntr) )
+            {
+                /* the block is written normally after the flush, so its latest instance is newer than the record */
+                bConsumed = true;
+            }
+            else if(true == _isLiveDataFitting(size, oldSize))
+            {
+                /* the page overflow can reset the occurrence counter of the current block */
+                result = _ensurePageSpace(size, bIdx);
+
+                if(true == result)
+                {
+                    result = _relocateNvmBlock(bIdx, addr, NvmBlocks[bIdx].occurrenceCntr + 1);
+                }
+
+                if(false == result)
+                {
+                    break;
+                }
+
+                /* a later record of the block into the region is newer than the merged one */
+                mergedBlocks[bIdx >> 5] |= (1uL << (bIdx & 31u));
+                bConsumed = true;
+            }
+
+            /* the merging can start an erase in the background, so the mark is programmed while it is suspended */
+            if( (true == bConsumed) && (false == _writeBytes( addr + BLOCK_HEADER_HALF_SIZE, (uint8_t*)&merged, BLOCK_HEADER_HALF_SIZE )) )
+            {
+                /* the region is not erased with an unmarked record. Its generation keeps it from being merged twice */
+                result = false;
+                break;
+            }
+        }
+
+        addr += size;
+    }
+
+#ifdef NVM_USE_BACKGROUND_ERASE
+    /* the merging can release a page, but the flash driver erases only one sector at a time */
+    _completeBackgroundErase();
+#endif
+
+    if( (true == result) && (false == _isNvmBlockEmpty(NVM_EMERGENCY_START_ADDR, NVM_EMERGENCY_SIZE)) )
+    {
+        for(sectorAddr = NVM_EMERGENCY_START_ADDR; sectorAddr < NVM_EMERGENCY_END_ADDR; sectorAddr += FLASH_SECTOR_SIZE)
+        {
+            result &= FlsDrv_eraseBlock4K(sectorAddr);
+        }
+    }
+
+    /* if the region is not ready, no flush is possible until the next initialization */
+    NvmManagerDescriptor.emergencyWritePointer = (true == result) ? NVM_EMERGENCY_START_ADDR : NVM_EMERGENCY_END_ADDR;
+}
+#endif
+
+#ifdef NVM_USE_WEAR_BUDGET
+/**
+* @brief    Get the operating time of the NVM area, i.e. the stored operating time plus the time since the initialization
+*
+* @param    none
+*
+* @return   operating time in seconds
+*/
+static uint32_t _getOperatingTime(void)
+{
+    return NvmManagerDescriptor.operatingTime + (SysTime_getSeconds() - NvmManagerDescriptor.bootTime);
+}
+
+/**
+* @brief    Get the factor of the coalescing windows. It is the ratio between the erases so far and the erases allowed by the budget 
+*           for the operating time so far. The budget allows one erase more, so that the first garbage collection does not stretch the windows
+*
+* @param    none
+*
+* @return   factor between 1 and NVM_WEAR_MAX_STRETCH
+*/
+static uint32_t _getWearStretch(void)
+{
+    uint32_t budget = (_getOperatingTime() / NVM_WEAR_BUDGET_PERIOD_S) + 1u;
+    uint32_t stretch;
+
+    if(NvmManagerDescriptor.eraseCount <= budget)
+    {
+        return 1u;
+    }
+
+    stretch = (NvmManagerDescriptor.eraseCount / budget) + 1u;
+
+    return (stretch < NVM_WEAR_MAX_STRETCH) ? stretch : NVM_WEAR_MAX_STRETCH;
+}
+
+/**
+* @brief    Defer the write of a throttleable block, which was programmed within its coalescing window. Only the latest data is 
+*           programmed, when the window is over. The first write after the initialization is never deferred. The data is copied 
+*           into the shadow of the block, so the caller can reuse its buffer
+*
+* @param    [in]bIdx : index of the logical block
+*           [in]data : RAM location of the data
+*
+* @return   true if the write is deferred, otherwise - false (the block has to be programmed now)
+*/
+static bool _deferWrite(NvmBlocksId_t bIdx, const uint8_t* data)
+{
+    uint32_t window = (uint32_t)NvmWriteWindows[bIdx] * _getWearStretch();
+    uint32_t offset = 0;
+    NvmBlocksId_t idx;
+
+    if( (0 == NvmWriteWindows[bIdx]) || (NVM_WRITE_TIME_NONE == NvmLastWriteTime[bIdx]) || 
+        ((_getOperatingTime() - NvmLastWriteTime[bIdx]) >= window) )
+    {
+        return false;
+    }
+
+    /* the shadow of the block follows the ones of the throttleable blocks with a lower index */
+    for(idx = (NvmBlocksId_t)0; idx < bIdx; idx++)
+    {
+        if(0 != NvmWriteWindows[idx])
+        {
+            offset += NvmBlocks[idx].size;
+        }
+    }
+
+    if((offset + NvmBlocks[bIdx].size) > NVM_WEAR_SHADOW_SIZE)
+    {
+        /* no shadow is left for the block */
+        return false;
+    }
+
+    if(&NvmPendingShadow[offset] != data)
+    {
+        memcpy(&NvmPendingShadow[offset], data, NvmBlocks[bIdx].size);
+    }
+    NvmPendingData[bIdx] = &NvmPendingShadow[offset];
+
+    return true;
+}
+
+/**
+* @brief    Program the deferred writes
+*
+* @param    [in]bForce : true - all deferred writes are programmed, false - only the ones, whose coalescing window is over
+*
+* @return   true if no write is deferred any more, otherwise - false
+*/
+static bool _writePendingBlocks(bool bForce)
+{
+    uint32_t stretch = _getWearStretch();
+    uint32_t now = _getOperatingTime();
+    NvmBlocksId_t bIdx;
+    bool result = true;
+
+    for(bIdx = (NvmBlocksId_t)0; bIdx < eNvmBlockCount; bIdx++)
+    {
+        if(NULL != NvmPendingData[bIdx])
+        {
+            if( (true == bForce) || ((now - NvmLastWriteTime[bIdx]) >= ((uint32_t)NvmWriteWindows[bIdx] * stretch)) )
+            {
+                /* a failed write stays deferred */
+                result &= _programBlock(bIdx, NvmPendingData[bIdx], (uint16_t)NvmBlocks[bIdx].size);
+            }
+            else
+            {
+                result = false;
+            }
+        }
+    }
+
+    return result;
+}
+
+/**
+* @brief    Write the actual erase count and operating time into the wear info. The garbage collection calls it instead of relocating 
+*           the old instance, so the record is always of the same size and the live data does not grow
+*
+* @param    none
+*
+* @return   true if the wear info is written, otherwise - false
+*/
+static bool _writeWearInfo(void)
+{
+    NvmWearInfo_t wearInfo;
+
+    wearInfo.eraseCount = NvmManagerDescriptor.eraseCount;
+    wearInfo.operatingTime = _getOperatingTime();
+
+    return _writeNvmBlock(eNvmWearInfo, (const uint8_t*)&wearInfo, sizeof(wearInfo));
+}
+
+/**
+* @brief    Take over the wear info after all records are searched. The erases before it, i.e. by the reset of the NVM area, are added 
+*           to the stored ones. The wear info is written for the first time, if it is not found
+*
+* @param    none
+*
+* @return   none
+*/
+static void _loadWearInfo(void)
+{
+    NvmWearInfo_t wearInfo;
+    uint16_t size = 0;
+
+    if(true == _readNvmBlock(eNvmWearInfo, (uint8_t*)&wearInfo, &size))
+    {
+        NvmManagerDescriptor.eraseCount += wearInfo.eraseCount;
+        NvmManagerDescriptor.operatingTime = wearInfo.operatingTime;
+    }
+    else
+    {
+        (void)_writeWearInfo();
+    }
+}
+#endif
+
+#ifdef NVM_USE_KV_STORE
+/**
+* @brief    Calculate the hash of a key (FNV-1a). The type of the key is hashed too, so a string and an integer key never match
+*
+* @param    [in]keyType : NVM_KV_FLAG_ID_KEY for an integer key, otherwise 0
+*           [in]key : the key
+*           [in]keyLen : size of the key
+* 
+* @return   the hash of the key
+*/
+static uint32_t _kvHash(uint8_t keyType, const uint8_t* key, uint8_t keyLen)
+{
+    uint32_t hash = 0x811C9DC5;
+    uint8_t idx;
+
+    hash = (hash ^ keyType) * 0x01000193;
+
+    for(idx = 0; idx < keyLen; idx++)
+    {
+        hash = (hash ^ key[idx]) * 0x01000193;
+    }
+
+    return hash;
+}
+
+/**
+* @brief    Compare a key with the key of a key-value record in the flash
+*
+* @param    [in]addr : address of the header of the record
+*           [in]keyType : NVM_KV_FLAG_ID_KEY for an integer key, otherwise 0
+*           [in]key : the key
+*           [in]keyLen : size of the key
+* 
+* @return   true if the record belongs to the key, otherwise - false
+*/
+static bool _kvIsKeyEqual(uint32_t addr, uint8_t keyType, const uint8_t* key, uint8_t keyLen)
+{
+    NvmKvHeader_t kvHeader;
+
+    _readBytes( addr + BLOCK_HEADER_SIZE, (uint8_t*)&kvHeader, NVM_KV_HEADER_SIZE );
+
+    return ( (keyLen == kvHeader.keyLen) && (keyType == (kvHeader.flags & NVM_KV_FLAG_ID_KEY)) &&
+             (true == _isNvmBlockEqual(addr + BLOCK_HEADER_SIZE + NVM_KV_HEADER_SIZE, key, keyLen)) );
+}
+
+/**
+* @brief    Search after a key into the hash index. The keys are compared with the records only if the tags of their hashes match
+*
+* @param    [in]hash : hash of the key
+*           [in]keyType : NVM_KV_FLAG_ID_KEY for an integer key, otherwise 0
+*           [in]key : the key
+*           [in]keyLen : size of the key
+*           [out]freeSlot : the first entry, that can take the key if it is not found. NULL if the index is full
+* 
+* @return   the entry of the key or NULL if the key is not found
+*/
+static NvmKvIndexEntry_t* _kvFind(uint32_t hash, uint8_t keyType, const uint8_t* key, uint8_t keyLen, NvmKvIndexEntry_t** freeSlot)
+{
+    NvmKvIndexEntry_t* entry;
+    uint32_t slot = hash & (NVM_KV_INDEX_SIZE - 1u);
+    uint32_t probe;
+
+    *freeSlot = NULL;
+
+    for(probe = 0; probe < NVM_KV_INDEX_SIZE; probe++)
+    {
+        entry = &NvmKvIndex[slot];
+
+        if(NVM_KV_SLOT_FREE == entry->addr)
+        {
+            /* the key has never been placed after this entry */
+            if(NULL == *freeSlot)
+            {
+                *freeSlot = entry;
+            }
+            break;
+        }
+        else if(NVM_KV_SLOT_VACATED == entry->addr)
+        {
+            if(NULL == *freeSlot)
+            {
+                *freeSlot = entry;
+            }
+        }
+        else if( ((uint8_t)(hash >> 24) == entry->tag) && (true == _kvIsKeyEqual(entry->addr, keyType, key, keyLen)) )
+        {
+            return entry;
+        }
+
+        slot = (slot + 1u) & (NVM_KV_INDEX_SIZE - 1u);
+    }
+
+    return NULL;
+}
+
+/**
+* @brief    Add a key-value record, that is found while searching after power-on, into the hash index. 
+*           The record with the biggest occurence counter is the latest one for its key
+*
+* @param    [in]addr : address of the header of the record
+*           [in]occCtr : occurence counter of the record
+* 
+* @return   true if the record is indexed, otherwise - false (the index is full)
+*/
+static bool _kvIndexRecord(uint32_t addr, uint16_t occCtr)
+{
+    NvmKvHeader_t kvHeader;
+    uint8_t key[NVM_KV_MAX_KEY_SIZE];
+    NvmKvIndexEntry_t* entry;
+    NvmKvIndexEntry_t* freeSlot;
+    uint32_t hash;
+
+    _readBytes( addr + BLOCK_HEADER_SIZE, (uint8_t*)&kvHeader, NVM_KV_HEADER_SIZE );
+    _readBytes( addr + BLOCK_HEADER_SIZE + NVM_KV_HEADER_SIZE, key, kvHeader.keyLen );
+
+    hash = _kvHash(kvHeader.flags & NVM_KV_FLAG_ID_KEY, key, kvHeader.keyLen);
+    entry = _kvFind(hash, kvHeader.flags & NVM_KV_FLAG_ID_KEY, key, kvHeader.keyLen, &freeSlot);
+
+    if(NULL == entry)
+    {
+        if(NULL == freeSlot)
+        {
+            return false;
+        }
+
+        entry = freeSlot;
+        entry->tag = (uint8_t)(hash >> 24);
+        entry->occurrenceCntr = 0;
+    }
+
+    if(occCtr > entry->occurrenceCntr)
+    {
+        if(entry->addr < NVM_KV_SLOT_VACATED)
+        {
+            _clearRecordLive(eNvmBlockCount + (uint32_t)(entry - NvmKvIndex), entry->addr, _getKvRecordSize(entry));
+        }
+
+        entry->addr = addr;
+        entry->occurrenceCntr = occCtr;
+        entry->bDeleted = (0 != (kvHeader.flags & NVM_KV_FLAG_DELETED));
+
+        _setRecordLive(eNvmBlockCount + (uint32_t)(entry - NvmKvIndex), addr, _getKvRecordSize(entry));
+    }
+
+    return true;
+}
+
+/**
+* @brief    Get the size of the latest record of a key, that is counted as live data
+*
+* @param    [in]entry : entry of the key into the hash index
+*
+* @return   size of the record (header, key-value header, key, value and checksum) or 0 for a tombstone
+*/
+static uint32_t _getKvRecordSize(const NvmKvIndexEntry_t* entry)
+{
+    NvmKvHeader_t kvHeader;
+
+    if(true == entry->bDeleted)
+    {
+        /* a tombstone is dropped by the garbage collection */
+        return 0;
+    }
+
+    _readBytes( entry->addr + BLOCK_HEADER_SIZE, (uint8_t*)&kvHeader, NVM_KV_HEADER_SIZE );
+
+    return BLOCK_HEADER_SIZE + NVM_KV_HEADER_SIZE + kvHeader.keyLen + kvHeader.dataLen + NVM_CRC_LEN;
+}
+
+/**
+* @brief    Copy the latest record of a key from its current place to the write pointer
+*
+* @param    [in]entry : entry of the key into the hash index
+*
+* @return   true if the record is copied, otherwise - false
+*/
+static bool _relocateKvRecord(NvmKvIndexEntry_t* entry)
+{
+    uint32_t size = _getKvRecordSize(entry);
+
+    /* reset occurrence counter so that the latest data is always with higher occurrence number */
+    if(true == _relocateRecord(entry->addr, NVM_KV_PATTERN, 1, size))
+    {
+        entry->occurrenceCntr = 1;
+
+        _clearRecordLive(eNvmBlockCount + (uint32_t)(entry - NvmKvIndex), entry->addr, size);
+        _setRecordLive(eNvmBlockCount + (uint32_t)(entry - NvmKvIndex), NvmManagerDescriptor.writePointer, size);
+        entry->addr = NvmManagerDescriptor.writePointer;
+        _advanceWritePointer(size, true);
+
+        return true;
+    }
+
+    return false;
+}
+
+/**
+* @brief    Write a new record of a key at the write pointer. A deleted key gets a record without a value (tombstone), 
+*           which is dropped by the next garbage collection
+*
+* @param    [in]keyType : NVM_KV_FLAG_ID_KEY for an integer key, otherwise 0
+*           [in]key : the key
+*           [in]keyLen : size of the key
+*           [in]data : pointer to the source data buffer
+*           [in]len : size of the value
+*           [in]bDelete : true if the key has to be deleted
+* 
+* @return   true if the record is stored or is not needed, otherwise - false
+*/
+static bool _kvWrite(uint8_t keyType, const uint8_t* key, uint8_t keyLen, const uint8_t* data, uint16_t len, bool bDelete)
+{
+    uint8_t blockHeader[BLOCK_HEADER_SIZE];
+    NvmKvHeader_t kvHeader;
+    NvmKvHeader_t existingKvHeader;
+    FlsDrv_IoVec_t recordIo[NVM_KV_WRITE_IO_COUNT];
+    NvmKvIndexEntry_t* entry;
+    NvmKvIndexEntry_t* freeSlot;
+    uint16_t pattern = NVM_KV_PATTERN;
+    uint16_t occCntr;
+    uint32_t hash = _kvHash(keyType, key, keyLen);
+    uint32_t dataSize = NVM_KV_HEADER_SIZE + keyLen + len;
+    uint32_t recordSize = BLOCK_HEADER_SIZE + dataSize + NVM_CRC_LEN;
+    uint32_t recordIdx;
+    uint32_t oldSize = 0;
+    uint32_t calculatedCrc32 = 0;
+    uint32_t existingCrc32 = 0;
+    uint32_t traceStart;
+    bool bUnchanged = false;
+
+    if(NvmManagerDescriptor.bIsInitialized == false)
+    {
+        return false;
+    }
+
+    /* the index of the key-value store is complete only after all records are searched */
+    _completeMount();
+
+    NVM_STATS_ADD(writesRequested, 1);
+
+    entry = _kvFind(hash, keyType, key, keyLen, &freeSlot);
+
+    if( (NULL == entry) || (true == entry->bDeleted) )
+    {
+        if(true == bDelete)
+        {
+            /* the key does not exist */
+            NVM_STATS_ADD(writesSkipped, 1);
+            return true;
+        }
+
+        if( (NULL == entry) && (NULL == freeSlot) )
+        {
+            /* the hash index is full */
+            return false;
+        }
+    }
+
+    kvHeader.keyLen = keyLen;
+    kvHeader.flags = (uint8_t)(keyType | ((true == bDelete) ? NVM_KV_FLAG_DELETED : 0));
+    kvHeader.dataLen = len;
+
+    /* the checksum covers the key-value header, the key and the value */
+    calculatedCrc32 = CRC32_Update(calculatedCrc32, (uint8_t*)&kvHeader, NVM_KV_HEADER_SIZE);
+    calculatedCrc32 = CRC32_Update(calculatedCrc32, (uint8_t*)key, keyLen);
+    calculatedCrc32 = CRC32_Update(calculatedCrc32, (uint8_t*)data, len);
+
+    /* an unchanged value is not programmed again. The stored value is compared only if the headers and the checksums are equal */
+    if(NULL != entry)
+    {
+        traceStart = NVM_TRACE_BEGIN(NVM_TRACE_DUP_CHECK, hash);
+
+        bUnchanged = (true == _readBytes( entry->addr + BLOCK_HEADER_SIZE, (uint8_t*)&existingKvHeader, NVM_KV_HEADER_SIZE)) &&
+                     (0 == memcmp(&existingKvHeader, &kvHeader, NVM_KV_HEADER_SIZE)) &&
+                     (true == _readBytes( entry->addr + BLOCK_HEADER_SIZE + dataSize, (uint8_t*)&existingCrc32, NVM_CRC_LEN)) &&
+                     (existingCrc32 == calculatedCrc32) &&
+                     (true == _isNvmBlockEqual(entry->addr + BLOCK_HEADER_SIZE + NVM_KV_HEADER_SIZE + keyLen, data, len));
+
+        NVM_TRACE_END(NVM_TRACE_DUP_CHECK, traceStart, hash);
+    }
+
+    if(true == bUnchanged)
+    {
+        /* the data is already stored */
+        NVM_STATS_ADD(writesSkipped, 1);
+        NVM_STATS_ADD(bytesRequested, len);
+        return true;
+    }
+
+    /* the entry of a new key is taken only when its record is written */
+    recordIdx = eNvmBlockCount + (uint32_t)(((NULL != entry) ? entry : freeSlot) - NvmKvIndex);
+
+    if( (NULL != entry) && (entry->addr < NVM_KV_SLOT_VACATED) )
+    {
+        oldSize = _getKvRecordSize(entry);
+    }
+
+    /* a tombstone is never bigger than the live record it replaces, but it occupies the page until the next garbage collection */
+    if(false == _isLiveDataFitting(recordSize, oldSize))
+    {
+        /* the write is rejected, because the next garbage collection would not be able to transfer all of the live data */
+        return false;
+    }
+
+    if(false == _ensurePageSpace(recordSize, recordIdx))
+    {
+        /* the page switch failed. The live data stays in the current page, so it is not erased */
+        return false;
+    }
+
+    if( (NULL == entry) || (NVM_KV_SLOT_VACATED == entry->addr) )
+    {
+        occCntr = 1;
+    }
+    else
+    {
+        occCntr = entry->occurrenceCntr + 1;
+    }
+
+    memcpy(blockHeader, (uint8_t*)&pattern, BLOCK_HEADER_HALF_SIZE);
+    memcpy(blockHeader+BLOCK_HEADER_HALF_SIZE, (uint8_t*)&occCntr, BLOCK_HEADER_HALF_SIZE);
+
+    recordIo[0].buf = blockHeader;
+    recordIo[0].len = BLOCK_HEADER_SIZE;
+    recordIo[1].buf = (uint8_t*)&kvHeader;
+    recordIo[1].len = NVM_KV_HEADER_SIZE;
+    recordIo[2].buf = (uint8_t*)key;
+    recordIo[2].len = keyLen;
+    recordIo[3].buf = (uint8_t*)data;
+    recordIo[3].len = len;
+    recordIo[4].buf = (uint8_t*)&calculatedCrc32;
+    recordIo[4].len = NVM_CRC_LEN;
+
+    if(true == _writeBytesv( NvmManagerDescriptor.writePointer, recordIo, NVM_KV_WRITE_IO_COUNT))
+    {
+        if(NULL == entry)
+        {
+            entry = freeSlot;
+            entry->tag = (uint8_t)(hash >> 24);
+        }
+        else if(entry->addr < NVM_KV_SLOT_VACATED)
+        {
+            _clearRecordLive(recordIdx, entry->addr, oldSize);
+        }
+
+        entry->addr = NvmManagerDescriptor.writePointer;
+        entry->occurrenceCntr = occCntr;
+        entry->bDeleted = bDelete;
+
+        _setRecordLive(recordIdx, entry->addr, (true == bDelete) ? 0 : recordSize);
+
+        _advanceWritePointer(recordSize, true);
+        NVM_STATS_ADD(bytesRequested, len);
+
+        return true;
+    }
+    else
+    {
+        /* the record may be programmed partially. Its space is skipped, so the previous value of the key stays the latest one */
+        NvmManagerDescriptor.bErrorDetected = true;
+        _advanceWritePointer(recordSize, false);
+
+        return false;
+    }
+}
+
+/**
+* @brief    Read the value of a key
+*
+* @param    [in]keyType : NVM_KV_FLAG_ID_KEY for an integer key, otherwise 0
+*           [in]key : the key
+*           [in]keyLen : size of the key
+*           [out]data : pointer to the destination buffer
+*           [in]size : size of the destination buffer
+*           [out]len : size of the value
+* 
+* @return   true if the key exists and its value is read correctly. Otherwise - false
+*/
+static bool _kvRead(uint8_t keyType, const uint8_t* key, uint8_t keyLen, uint8_t* data, uint16_t size, uint16_t* len)
+{
+    NvmKvHeader_t kvHeader;
+    NvmKvIndexEntry_t* entry;
+    NvmKvIndexEntry_t* freeSlot;
+
+    if(NvmManagerDescriptor.bIsInitialized == false)
+    {
+        return false;
+    }
+
+    /* the index of the key-value store is complete only after all records are searched */
+    _completeMount();
+
+    entry = _kvFind(_kvHash(keyType, key, keyLen), keyType, key, keyLen, &freeSlot);
+
+    if( (NULL == entry) || (true == entry->bDeleted) )
+    {
+        return false;
+    }
+
+    _readBytes( entry->addr + BLOCK_HEADER_SIZE, (uint8_t*)&kvHeader, NVM_KV_HEADER_SIZE );
+
+    if( (kvHeader.dataLen > size) || 
+        (false == _readRecordPart(entry->addr, NVM_KV_HEADER_SIZE + keyLen + kvHeader.dataLen, NVM_KV_HEADER_SIZE + keyLen, data, kvHeader.dataLen)) )
+    {
+        return false;
+    }
+
+    *len = kvHeader.dataLen;
+
+    return true;
+}
+#endif
+
+/**
+* @brief    Locate the page with data after power-on and prepare the search of its records. The read pointers are not known yet
+*
+* @param    none
+*
+* @return   true if the records can be searched, otherwise - false (the NVManager is not initialized)
+*/
+static bool _mountBegin(void)
+{
+    uint8_t  pageHeader[PAGE_HEADER_SIZE] = { 0 };
+    uint32_t idx;
+    uint32_t pageAddr = 0;
+    bool bWritePointerFound = false;
+    bool bOldestFound = false;
+#ifdef NVM_USE_STATS
+    uint32_t startTime = SysTime_getMicroseconds();
+
+    memset(&NvmStats, 0, sizeof(NvmStats));
+#endif
+
+#ifdef NVM_USE_BACKGROUND_ERASE
+    /* a sector erase, which is still running, has to be finished before the flash is searched */
+    if(true == NvmManagerDescriptor.bEraseRunning)
+    {
+        (void)FlsDrv_eraseResume();
+
+        while(FLS_ERASE_IDLE != FlsDrv_eraseStatus())
+        {
+            /* polling of the flash driver */
+        }
+    }
+
+    NvmManagerDescriptor.bEraseRunning = false;
+    NvmManagerDescriptor.erasePageAddr = NVM_ERASE_NONE;
+#endif
+
+    NvmManagerDescriptor.writePointer = 0;
+    NvmManagerDescriptor.bIsInitialized = false;
+    NvmManagerDescriptor.bErrorDetected = false;
+    NvmManagerDescriptor.bMountComplete = false;
+
+    /* set the read point to not initialized */
+    _resetReadPointers();
+
+#ifdef NVM_USE_LAZY_MOUNT
+    memset(NvmBlockResolved, 0, sizeof(NvmBlockResolved));
+#endif
+#ifdef NVM_USE_EMERGENCY_FLUSH
+    memset((void*)NvmDirtyData, 0, sizeof(NvmDirtyData));
+    NvmDirtyCount = 0;
+    NvmDirtySize = 0;
+    NvmManagerDescriptor.emergencyWritePointer = NVM_EMERGENCY_END_ADDR;
+    NvmManagerDescriptor.bEmergencyPending = false;
+#endif
+#ifdef NVM_USE_WEAR_BUDGET
+    /* the stored wear info is added, when it is found */
+    memset((void*)NvmPendingData, 0, sizeof(NvmPendingData));
+    memset(NvmLastWriteTime, 0xFF, sizeof(NvmLastWriteTime));
+    NvmManagerDescriptor.eraseCount = 0;
+    NvmManagerDescriptor.operatingTime = 0;
+    NvmManagerDescriptor.bootTime = SysTime_getSeconds();
+#endif
+
+	/* go through all pages in te flash */
+    for(idx=NVM_MANAGER_START_ADDR; idx<NVM_MANAGER_END_ADDR; idx+=LOGICAL_PAGE_SIZE)
+    {
+        _readBytes( idx, pageHeader, PAGE_HEADER_SIZE );
+
+        /* a mark, whose programming is cut, has only some of its bits cleared. The oldest and the read marks count as soon as 
+        *  any bit is cleared - both states of the page before and after the mark are consistent, and the mark is programmed 
+        *  again over the torn bits */
+        if( (memcmp(pageHeader, (uint8_t*)PAGE_MARK_AS_WRITTEN, PAGE_HEADER_HALF_SIZE) != 0) || 
+            (0xFF != pageHeader[PAGE_HEADER_SIZE-PAGE_HEADER_ONE_BYTE]) )
+        {
+            /* the page is erased, read or its header is not written completely */
+        }
+        else if(0xFF != pageHeader[PAGE_HEADER_HALF_SIZE])
+        {
+            /* the garbage collection of this page has been cut, so it contains the complete data unlike the next page */
+            pageAddr = idx;
+            bOldestFound = true;
+            bWritePointerFound = true;
+        }
+        else if(false == bOldestFound)
+        {
+            /* page contains unprocessed data */
+            pageAddr = idx;
+            bWritePointerFound = true;
+        }
+    }
+
+    /* within the page that is currently written search for the first unoccupied NvM block 
+	*  check if write pointer was found */
+    if(false == bWritePointerFound)
+    {
+        /* there is no page with data - erase the whole flash page by page and start from scratch */
+        if(false == _resetNvm())
+        {
+            NvmManagerDescriptor.bErrorDetected = true;
+            return false;
+        }
+        
+#ifdef NVM_USE_DEFAULTS
+        FlsDrv_writeBytes(DEFAULTS_START_ADDRESS , nvmDefaults, DEFAULTS_SIZE);
+        NvmManagerDescriptor.writePointer += DEFAULTS_SIZE;
+#endif
+        /* there are no records to be searched */
+        NvmManagerDescriptor.mountPointer = NvmManagerDescriptor.writePointer;
+        NvmManagerDescriptor.mountEndAddr = NvmManagerDescriptor.writePointer;
+        NvmManagerDescriptor.mountPageEndAddr = NVM_MANAGER_START_ADDR + LOGICAL_PAGE_SIZE;
+    }
+    else
+    {
+        /* add offset so that the search starts at the first DR */
+        NvmManagerDescriptor.mountPointer = pageAddr + PAGE_HEADER_SIZE;
+        NvmManagerDescriptor.mountPageEndAddr = pageAddr + LOGICAL_PAGE_SIZE;
+
+        /* all bytes after this address are erased (0xFF), so the last DR on the page ends at or after it */
+        NvmManagerDescriptor.mountEndAddr = _findErasedBoundary(NvmManagerDescriptor.mountPointer, NvmManagerDescriptor.mountPageEndAddr);
+    }
+
+    NvmManagerDescriptor.bIsInitialized = true;
+
+#ifdef NVM_USE_STATS
+    NvmStats.mountTimeUs = SysTime_getMicroseconds() - startTime;
+#endif
+
+    return true;
+}
+
+/**
+* @brief    Take a valid record, which is found while searching after power-on, into the read pointers or the index of the key-value store
+*
+* @param    [in]addr : address of the header of the record
+*           [in]bIdx : index of the block or NVM_KV_RECORD
+*           [in]occCntr : occurrence counter of the record
+*           [in]dataSize : size of the data between the header and the checksum of the record
+*
+* @return   none
+*/
+static void _mountRecord(uint32_t addr, NvmBlocksId_t bIdx, uint16_t occCntr, uint32_t dataSize)
+{
+#ifdef NVM_USE_KV_STORE
+    if(NVM_KV_RECORD == bIdx)
+    {
+        if(false == _kvIndexRecord(addr, occCntr))
+        {
+            /* there are more keys than entries into the hash index. The key is skipped */
+            NvmManagerDescriptor.bErrorDetected = true;
+        }
+    }
+    else
+#endif
+    /* restore the occurance counter and the read pointer from the readed NVM block info 
+    *  biggest occurence counter for a block means the latest information stored in NVM for this block
     */
-    if(true == _isNvmBlockEmpty(NvmManagerDescriptor.writePointer, FLASH_SECTOR_SIZE - (NvmManagerDescriptor.writePointer&GET_OFFSET_IN_PAGE_MASK)))
+    if(occCntr > NvmBlocks[bIdx].occurrenceCntr)
+    {
+        if(READ_POINTER_NOT_SET != NvmBlocks[bIdx].readPointer)
+        {
+            _clearRecordLive(bIdx, NvmBlocks[bIdx].readPointer, dataSize+BLOCK_HEADER_SIZE+NVM_CRC_LEN);
+        }
+        _setRecordLive(bIdx, addr, dataSize+BLOCK_HEADER_SIZE+NVM_CRC_LEN);
+        NvmBlocks[bIdx].readPointer = addr;
+        NvmBlocks[bIdx].occurrenceCntr = occCntr;
+    }
+}
+
+/**
+* @brief    Search the records of the page with data from an address up to the erased end of the page and take the valid ones
+*
+* @param    [in]addr : address of the first record to be searched
+*           [in]maxRecords : maximal number of records to be searched
+*
+* @return   the address after the last searched record
+*/
+static uint32_t _searchRecords(uint32_t addr, uint32_t maxRecords)
+{
+    uint32_t dataSize;
+    uint32_t count;
+    uint16_t currOccCntr;
+    NvmBlocksId_t bIdx;
+
+    for(count = 0; (count < maxRecords) && (addr < NvmManagerDescriptor.mountEndAddr); count++)
+    {
+        if(false == _isRecordValid(addr, NvmManagerDescriptor.mountPageEndAddr, &bIdx, &currOccCntr, &dataSize))
+        {
+            /* a torn or damaged record is skipped, so the previous valid instance of the block stays the latest one.
+            *  It is not live data, so it is dropped by the next garbage collection */
+            NvmManagerDescriptor.bErrorDetected = true;
+            addr = _findNextValidRecord(addr + 1, NvmManagerDescriptor.mountEndAddr, NvmManagerDescriptor.mountPageEndAddr);
+            continue;
+        }
+
+        _mountRecord(addr, bIdx, currOccCntr, dataSize);
+
+        /* switch to the adjacent NVM block on the same page and try to read out the info */
+        addr += (dataSize+BLOCK_HEADER_SIZE+NVM_CRC_LEN);
+    }
+
+    return addr;
+}
+
+/**
+* @brief    Search the next records of the page with data. When all of them are found, the write pointer is set and 
+*           the records of the last emergency flush are merged
+*
+* @param    [in]maxRecords : maximal number of records to be searched
+*
+* @return   true if all records are found, otherwise - false
+*/
+static bool _mountRecords(uint32_t maxRecords)
+{
+    uint32_t currBlockAddr = NvmManagerDescriptor.mountPointer;
+    uint32_t pageEndAddr = NvmManagerDescriptor.mountPageEndAddr;
+#ifdef NVM_USE_STATS
+    uint32_t startTime;
+#endif
+
+    if( (NvmManagerDescriptor.bIsInitialized == false) || (true == NvmManagerDescriptor.bMountComplete) )
+    {
+        return true;
+    }
+
+#ifdef NVM_USE_STATS
+    startTime = SysTime_getMicroseconds();
+#endif
+
+    currBlockAddr = _searchRecords(currBlockAddr, maxRecords);
+    NvmManagerDescriptor.mountPointer = currBlockAddr;
+
+#ifdef NVM_USE_STATS
+    /* the search step by step is measured without the time between the steps */
+    NvmStats.mountTimeUs += SysTime_getMicroseconds() - startTime;
+#endif
+
+    if(currBlockAddr < NvmManagerDescriptor.mountEndAddr)
+    {
+        return false;
+    }
+
+    if(currBlockAddr >= pageEndAddr)
+    {
+        /* page overflow will be performed on the next write operation */
+        NvmManagerDescriptor.writePointer = pageEndAddr - BLOCK_HEADER_HALF_SIZE;
+    }
+    else
+    {
+        /* first unoccupied block space found - this is the first possible writing address */
+        NvmManagerDescriptor.writePointer = currBlockAddr;
+    }
+
+    NvmManagerDescriptor.bMountComplete = true;
+
+#ifdef NVM_USE_WEAR_BUDGET
+    _loadWearInfo();
+#endif
+#ifdef NVM_USE_EMERGENCY_FLUSH
+    /* the data of the last emergency flush is newer than the data in the NVM area */
+    _mergeEmergencyRecords();
+#endif
+
+    return true;
+}
+
+/**
+* @brief    Search all records, which are not searched yet. The write pointer and the index of the key-value store are valid only after it
+*
+* @param    none
+*
+* @return   none
+*/
+static void _completeMount(void)
+{
+    (void)_mountRecords(0xFFFFFFFF);
+}
+
+#ifdef NVM_USE_LAZY_MOUNT
+/**
+* @brief    Find the latest instance of one logical block, before all records are searched. Only the headers of the records, 
+*           which are not searched yet, are read and only the instances of this block are checksummed
+*
+* @param    [in]bIdx : index of the logical block
+*
+* @return   none
+*/
+static void _resolveBlock(NvmBlocksId_t bIdx)
+{
+    uint32_t addr;
+    uint32_t dataSize;
+    uint16_t occCntr;
+    NvmBlocksId_t recordIdx;
+
+    if( (true == NvmManagerDescriptor.bMountComplete) || (0 != (NvmBlockResolved[bIdx >> 5] & (1uL << (bIdx & 31u)))) )
+    {
+        return;
+    }
+
+    for(addr = NvmManagerDescriptor.mountPointer; addr < NvmManagerDescriptor.mountEndAddr; addr += (dataSize+BLOCK_HEADER_SIZE+NVM_CRC_LEN))
+    {
+        if( (false == _getBlockInfo(addr, &recordIdx, &occCntr, &dataSize)) || 
+            ((addr + dataSize + BLOCK_HEADER_SIZE + NVM_CRC_LEN) > NvmManagerDescriptor.mountPageEndAddr) )
+        {
+            /* the records after a damaged one are found only by the complete search */
+            _completeMount();
+            return;
+        }
+
+        if( (bIdx == recordIdx) && (occCntr > NvmBlocks[bIdx].occurrenceCntr) && (true == _isNvmBlockCrcValid(addr, dataSize)) )
+        {
+            _mountRecord(addr, bIdx, occCntr, dataSize);
+        }
+    }
+
+    NvmBlockResolved[bIdx >> 5] |= (1uL << (bIdx & 31u));
+}
+#endif
+
+/**********************************
+* Interface functions definition
+***********************************/
+
+/**
+* @brief    Initialize NVManager once after power-on. It searches the current read and write pointers and sets them into a structure in RAM
+* 
+* @param     none
+*
+* @return    none
+*/
+void nvm_init(void)
+{
+    uint32_t traceStart = NVM_TRACE_BEGIN(NVM_TRACE_MOUNT, 0);
+
+    if(true == _mountBegin())
+    {
+        _completeMount();
+    }
+
+    NVM_TRACE_END(NVM_TRACE_MOUNT, traceStart, 0);
+    NVM_RECORD(NVM_REC_INIT, eNvmBlock1, NULL, 0, NvmManagerDescriptor.bIsInitialized);
+}
+
+#ifdef NVM_USE_LAZY_MOUNT
+/**
+* @brief    Initialize NVManager once after power-on without searching the records. It returns after the page with data is located.
+*           A logical block is searched on its first read, all other operations search the rest of the records first
+* 
+* @param     none
+*
+* @return    none
+*/
+void nvm_init_lazy(void)
+{
+    uint32_t traceStart = NVM_TRACE_BEGIN(NVM_TRACE_MOUNT, 0);
+
+    (void)_mountBegin();
+
+    NVM_TRACE_END(NVM_TRACE_MOUNT, traceStart, 0);
+    NVM_RECORD(NVM_REC_INIT_LAZY, eNvmBlock1, NULL, 0, NvmManagerDescriptor.bIsInitialized);
+}
+
+/**
+* @brief    Search the next NVM_MOUNT_STEP_RECORDS records after nvm_init_lazy. It shall be called cyclically, i.e. from the idle task
+* 
+* @param     none
+*
+* @return    true if all records are searched, otherwise - false
+*/
+bool nvm_mount_step(void)
+{
+    uint32_t traceStart = NVM_TRACE_BEGIN(NVM_TRACE_MOUNT, 0);
+    bool result = _mountRecords(NVM_MOUNT_STEP_RECORDS);
+
+    NVM_TRACE_END(NVM_TRACE_MOUNT, traceStart, 0);
+
+    return result;
+}
+#endif
+
+/**
+* @brief    Update data element in NVManager. The write of a throttleable block within its coalescing window is deferred: 
+*           the data is copied and programmed by nvm_write_step
+*
+* @param    [in]bIdx : index of the logical block to write the data
+*           [in]data : pointer to the source data buffer
+*           [in]size : size of the data to be written
+* 
+* @return   indicate if data is stored or an error has occurred
+*/
+bool nvm_write(const NvmBlocksId_t bIdx, const uint8_t* data, uint16_t size)
+{
+    uint32_t traceStart;
+    bool result;
+
+    if( (NvmManagerDescriptor.bIsInitialized == false) || (bIdx >= eNvmBlockCount) )
+    {
+        return false;
+    }
+
+#ifdef NVM_USE_WEAR_BUDGET
+    if(eNvmWearInfo == bIdx)
+    {
+        /* the wear info is written only by the NVManager */
+        return false;
+    }
+#endif
+
+    traceStart = NVM_TRACE_BEGIN(NVM_TRACE_WRITE, bIdx);
+
+#ifdef NVM_USE_WEAR_BUDGET
+    if(true == _deferWrite(bIdx, data))
+    {
+        result = true;
+    }
+    else
+#endif
+    {
+        result = _programBlock(bIdx, data, (uint16_t)NvmBlocks[bIdx].size);
+    }
+
+    NVM_TRACE_END(NVM_TRACE_WRITE, traceStart, bIdx);
+    NVM_RECORD(NVM_REC_WRITE, bIdx, data, (uint16_t)NvmBlocks[bIdx].size, result);
+    NVM_STATS_ADD(bytesRequested, (true == result) ? NvmBlocks[bIdx].size : 0);
+
+    return result;
+}
+
+/**
+* @brief    Read data element from NVManager
+*
+* @param    [in]bIdx : index of the logical block to write the data
+*           [out]data : pointer to the source data buffer
+*           [out]size : pointer size of the data that was read
+* 
+* @return   true if data is read correctly. Otherwise - false
+*/
+bool nvm_read(const NvmBlocksId_t bIdx, uint8_t* data, uint16_t *size)
+{
+    bool result;
+
+    if( (NvmManagerDescriptor.bIsInitialized == false) || (bIdx >= eNvmBlockCount) )
+    {
+        return false;
+    }
+
+    result = _readNvmBlock(bIdx, data, size);
+    NVM_RECORD(NVM_REC_READ, bIdx, (true == result) ? data : NULL, (uint16_t)NvmBlocks[bIdx].size, result);
+
+    return result;
+}
+
+#ifdef NVM_USE_EMERGENCY_FLUSH
+/**
+* @brief    Mark a logical block as changed but not written yet. The block is written from the given RAM location
+*           by nvm_emergency_flush, unless it is written by nvm_write before that
+*
+* @param    [in]bIdx : index of the logical block
+*           [in]data : RAM location of the latest data of the block. It has to stay valid until the block is written
+*
+* @return   true if the block is marked, otherwise - false (NVM_EMERGENCY_MAX_RECORDS or NVM_EMERGENCY_SIZE would be exceeded)
+*/
+bool nvm_set_dirty(const NvmBlocksId_t bIdx, const uint8_t* data)
+{
+    uint32_t size;
+
+    if( (NvmManagerDescriptor.bIsInitialized == false) || (bIdx >= eNvmBlockCount) || (NULL == data) )
+    {
+        return false;
+    }
+
+    size = NvmRecordSizes[bIdx];
+
+#ifdef NVM_USE_LAZY_MOUNT
+    /* the flush takes the generation of the record from the latest instance of the block */
+    _resolveBlock(bIdx);
+#endif
+
+    if(NULL == NvmDirtyData[bIdx])
+    {
+        /* all dirty blocks have to fit into the emergency region, so that the flush time is bounded */
+        if( (NvmDirtyCount >= NVM_EMERGENCY_MAX_RECORDS) || ((NvmDirtySize + size) > NVM_EMERGENCY_SIZE) )
+        {
+            return false;
+        }
+
+        NvmDirtyCount++;
+        NvmDirtySize += size;
+    }
+
+    NvmDirtyData[bIdx] = data;
+
+    return true;
+}
+
+/**
+* @brief    Write all dirty blocks into the emergency region, i.e. on brown-out detection. There is no garbage collection,
+*           erasing or comparison of data, so it never takes longer than NVM_EMERGENCY_FLUSH_TIME_NS.
+*           The blocks are merged into the NVM area by the next nvm_init
+*
+* @param    none
+*
+* @return   true if all dirty blocks are written, otherwise - false
+*/
+bool nvm_emergency_flush(void)
+{
+    uint8_t blockHeader[BLOCK_HEADER_SIZE];
+    FlsDrv_IoVec_t blockIo[NVM_BLOCK_IO_COUNT];
+    uint16_t occCntr;
+    uint32_t calculatedCrc32 = 0;
+    uint32_t size;
+    NvmBlocksId_t bIdx;
+    bool result = true;
+    bool bSuspended;
+
+    if(NvmManagerDescriptor.bIsInitialized == false)
+    {
+        return false;
+    }
+
+    /* the records are programmed while the erase in the background is suspended */
+    bSuspended = _suspendErase();
+
+    for(bIdx = (NvmBlocksId_t)0; (bIdx < eNvmBlockCount) && (0 < NvmDirtyCount); bIdx++)
+    {
+        if(NULL != NvmDirtyData[bIdx])
+        {
+            size = NvmRecordSizes[bIdx];
+
+            /* the region is not erased since the last flush */
+            if((NvmManagerDescriptor.emergencyWritePointer + size) > NVM_EMERGENCY_END_ADDR)
+            {
+                result = false;
+                break;
+            }
+
+            _nvmCrc32((uint8_t*)NvmDirtyData[bIdx], NvmBlocks[bIdx].size, &calculatedCrc32);
+
+            /* the generation of the record is the occurrence counter of its merge, so a later normal write makes it older */
+            occCntr = (uint16_t)(NvmBlocks[bIdx].occurrenceCntr + 1);
+
+            memcpy(blockHeader, (uint8_t*)(&NvmBlocks[bIdx].pattern), BLOCK_HEADER_HALF_SIZE);
+            memcpy(blockHeader+BLOCK_HEADER_HALF_SIZE, (uint8_t*)&occCntr, BLOCK_HEADER_HALF_SIZE);
+
+            /* every record is programmed with one operation */
+            blockIo[0].buf = blockHeader;
+            blockIo[0].len = BLOCK_HEADER_SIZE;
+            blockIo[1].buf = (uint8_t*)NvmDirtyData[bIdx];
+            blockIo[1].len = NvmBlocks[bIdx].size;
+            blockIo[2].buf = (uint8_t*)&calculatedCrc32;
+            blockIo[2].len = NVM_CRC_LEN;
+
+            result &= FlsDrv_writev( NvmManagerDescriptor.emergencyWritePointer, blockIo, NVM_BLOCK_IO_COUNT );
+
+            NvmManagerDescriptor.emergencyWritePointer += size;
+            NvmManagerDescriptor.bEmergencyPending = true;
+            _clearDirty(bIdx);
+        }
+    }
+
+    _resumeErase(bSuspended);
+
+    return result;
+}
+#endif
+
+#ifdef NVM_USE_BACKGROUND_ERASE
+/**
+* @brief    Continue the erasing of the released logical page in the background. It shall be called cyclically, i.e. from the idle task.
+*           The page is erased sector by sector and the running erase is suspended whenever the NVManager accesses the flash
+*
+* @param    none
+* 
+* @return   true if no erase is pending, otherwise - false
+*/
+bool nvm_erase_step(void)
+{
+    if(NvmManagerDescriptor.bIsInitialized == false)
+    {
+        return true;
+    }
+
+    return _stepBackgroundErase();
+}
+#endif
+
+#ifdef NVM_USE_WEAR_BUDGET
+/**
+* @brief    Program the deferred writes of the throttleable blocks, whose coalescing window is over. It shall be called cyclically, 
+*           i.e. from the idle task
+*
+* @param    none
+* 
+* @return   true if no write is deferred any more, otherwise - false
+*/
+bool nvm_write_step(void)
+{
+    if(NvmManagerDescriptor.bIsInitialized == false)
+    {
+        return false;
+    }
+
+    return _writePendingBlocks(false);
+}
+
+/**
+* @brief    Program all deferred writes and the wear info immediately, i.e. before a controlled shutdown. The operating time 
+*           since the last garbage collection is not lost then
+*
+* @param    none
+* 
+* @return   true if all data is programmed, otherwise - false
+*/
+bool nvm_write_flush(void)
+{
+    bool result;
+
+    if(NvmManagerDescriptor.bIsInitialized == false)
+    {
+        return false;
+    }
+
+    result = _writePendingBlocks(true);
+    result &= _writeWearInfo();
+
+    return result;
+}
+
+/**
+* @brief    Project the remaining life of the NVM area from the erase rate over the operating time so far
+*
+* @param    [out]seconds : operating time until the rated endurance is reached or NVM_REMAINING_LIFE_MAX
+* 
+* @return   true if the NVManager is initialized, otherwise - false
+*/
+bool nvm_get_remaining_life(uint32_t* seconds)
+{
+    uint32_t secondsPerErase;
+    uint32_t remainingErases;
+
+    if( (NvmManagerDescriptor.bIsInitialized == false) || (NULL == seconds) )
+    {
+        return false;
+    }
+
+    /* the stored erase count is known after all records are searched */
+    _completeMount();
+
+    if(NvmManagerDescriptor.eraseCount >= NVM_RATED_PAGE_ERASES)
+    {
+        *seconds = 0;
+        return true;
+    }
+
+    if(0 == NvmManagerDescriptor.eraseCount)
+    {
+        *seconds = NVM_REMAINING_LIFE_MAX;
+        return true;
+    }
+
+    secondsPerErase = _getOperatingTime() / NvmManagerDescriptor.eraseCount;
+    remainingErases = NVM_RATED_PAGE_ERASES - NvmManagerDescriptor.eraseCount;
+
+    *seconds = (secondsPerErase > (NVM_REMAINING_LIFE_MAX / remainingErases)) ? NVM_REMAINING_LIFE_MAX : (secondsPerErase * remainingErases);
+
+    return true;
+}
+#endif
+
+#ifdef NVM_USE_READ_VIEW
+/**
+* @brief    Get direct access to the data element into the memory-mapped FLASH without copying it
+*
+* @param    [in]bIdx : index of the logical block to be read
+*           [out]ptr : pointer to the data of the logical block into the FLASH
+*           [out]len : size of the data of the logical block
+* 
+* @return   true if the flash is memory-mapped and the data is read correctly. Otherwise - false
+*/
+bool nvm_read_view(const NvmBlocksId_t bIdx, const uint8_t** ptr, uint16_t* len)
+{
+    const uint8_t* pBlock;
+    uint32_t existingCrc32 = 0;
+    uint32_t calculatedCrc32 = 0;
+
+    if( (NvmManagerDescriptor.bIsInitialized == false) || (bIdx >= eNvmBlockCount) )
+    {
+        return false;
+    }
+
+#ifdef NVM_USE_LAZY_MOUNT
+    /* the block is searched on its first read after nvm_init_lazy */
+    _resolveBlock(bIdx);
+#endif
+
+#ifdef NVM_USE_WEAR_BUDGET
+    /* the view has to show the latest data, so a deferred write is programmed now */
+    if( (NULL != NvmPendingData[bIdx]) && (false == _programBlock(bIdx, NvmPendingData[bIdx], (uint16_t)NvmBlocks[bIdx].size)) )
+    {
+        return false;
+    }
+#endif
+
+    if(READ_POINTER_NOT_SET == NvmBlocks[bIdx].readPointer)
+    {
+        return false;
+    }
+
+    pBlock = FlsDrv_getMappedAddress(NvmBlocks[bIdx].readPointer);
+
+    if(NULL == pBlock)
+    {
+        /* the flash is not accessible into the address space */
+        return false;
+    }
+
+    memcpy(&existingCrc32, pBlock + BLOCK_HEADER_SIZE + NvmBlocks[bIdx].size, NVM_CRC_LEN);
+    _nvmCrc32((uint8_t*)(pBlock + BLOCK_HEADER_SIZE), NvmBlocks[bIdx].size, &calculatedCrc32);
+
+    if(calculatedCrc32 != existingCrc32)
+    {
+        return false;
+    }
+
+    *ptr = pBlock + BLOCK_HEADER_SIZE;
+    *len = (uint16_t)NvmBlocks[bIdx].size;
+
+    return true;
+}
+#endif
+
+#ifdef NVM_USE_LARGE_OBJECTS
+/**
+* @brief    Get the actual size of a large object
+*
+* @param    [in]loIdx : index of the large object
+*           [out]size : actual size of the large object
+* 
+* @return   true if the large object is written, otherwise - false
+*/
+bool nvm_lo_get_size(const NvmLargeObjectsId_t loIdx, uint16_t* size)
+{
+    uint32_t loSize = 0;
+    uint16_t readSize = 0;
+
+    if( (loIdx >= eNvmLoCount) || (false == nvm_read(NvmLargeObjects[loIdx].indexBlock, (uint8_t*)&loSize, &readSize)) )
     {
-        for(idx=PAGE_HEADER_SIZE; idx<FLASH_SECTOR_SIZE; )
-        {
-            if(false == _getBlockInfo(currBlockAddr, &bIdx, &currOccCntr))
-            {
-                /* it seems that no NVM blocks are stored on this NVM page */
-                idx = FLASH_SECTOR_SIZE;
-                continue;
-            }
-            
-            /* restore the occurance counter and the read pointer from the readed NVM block info 
-            *  biggest occurence counter for a block means the latest information stored in NVM for this block
-            */
-            if(currOccCntr > NvmBlocks[bIdx].occurrenceCntr)
-            {
-                NvmBlocks[bIdx].readPointer = currBlockAddr;
-                NvmBlocks[bIdx].occurrenceCntr = currOccCntr;
-            }
+        return false;
+    }
 
-            /* switch to the adjacent NVM block on the same page and try to read out the info */
-            currBlockAddr += (NvmBlocks[bIdx].size+BLOCK_HEADER_SIZE+NVM_CRC_LEN);
-            idx += (NvmBlocks[bIdx].size+BLOCK_HEADER_SIZE+NVM_CRC_LEN);
-        }
+    if(loSize > NvmLargeObjects[loIdx].maxSize)
+    {
+        /* the index does not belong to this configuration */
+        return false;
     }
-    else
+
+    *size = (uint16_t)loSize;
+
+    return true;
+}
+
+/**
+* @brief    Set the actual size of a large object, i.e. truncate it. The chunks are not changed
+*
+* @param    [in]loIdx : index of the large object
+*           [in]size : new size of the large object
+* 
+* @return   true if the size is stored, otherwise - false
+*/
+bool nvm_lo_set_size(const NvmLargeObjectsId_t loIdx, uint16_t size)
+{
+    uint32_t loSize = size;
+
+    if( (loIdx >= eNvmLoCount) || (size > NvmLargeObjects[loIdx].maxSize) )
     {
-        NvmManagerDescriptor.bErrorDetected = true;
+        return false;
     }
-    
-    if(true == NvmManagerDescriptor.bErrorDetected)
+
+    return nvm_write(NvmLargeObjects[loIdx].indexBlock, (uint8_t*)&loSize, NVM_LO_INDEX_SIZE);
+}
+
+/**
+* @brief    Write a part of a large object. Only the chunks, which are covered by the part, are written and 
+*           only the changed chunks are programmed. A chunk, which is covered only partially at the end of the part, is filled with zeros,
+*           so such a part is rejected if it ends before the actual size of the object. The object grows if the part ends after its actual size
+*
+* @param    [in]loIdx : index of the large object
+*           [in]offset : offset of the part into the object. It shall be aligned to NVM_LO_CHUNK_SIZE
+*           [in]data : pointer to the source data buffer
+*           [in]len : size of the part
+* 
+* @return   true if the part is stored, otherwise - false
+*/
+bool nvm_lo_write(const NvmLargeObjectsId_t loIdx, uint16_t offset, const uint8_t* data, uint16_t len)
+{
+    NvmBlocksId_t chunkIdx;
+    uint16_t remainingSize = len;
+    uint16_t currentSize;
+    uint16_t loSize = 0;
+    uint32_t traceStart;
+    bool bSizeKnown;
+    bool result = true;
+
+    if( (NvmManagerDescriptor.bIsInitialized == false) || (loIdx >= eNvmLoCount) || 
+        (0 != (offset%NVM_LO_CHUNK_SIZE)) || (((uint32_t)offset + len) > NvmLargeObjects[loIdx].maxSize) )
+    {
+        return false;
+    }
+
+    /* the zeros after a part, which ends inside a chunk, would override the data of the object after the part */
+    bSizeKnown = nvm_lo_get_size(loIdx, &loSize);
+    if( (0 != ((offset + len)%NVM_LO_CHUNK_SIZE)) && (true == bSizeKnown) && ((offset + len) < loSize) )
+    {
+        return false;
+    }
+
+    chunkIdx = (NvmBlocksId_t)(NvmLargeObjects[loIdx].firstChunk + (offset/NVM_LO_CHUNK_SIZE));
+
+    /* stream the data chunk by chunk. Each chunk is an independent logical block */
+    while((true == result) && (remainingSize > 0))
+    {
+        currentSize = (remainingSize > NVM_LO_CHUNK_SIZE) ? (uint16_t)NVM_LO_CHUNK_SIZE : remainingSize;
+
+        /* every chunk is written, traced and recorded like a block written by nvm_write */
+        traceStart = NVM_TRACE_BEGIN(NVM_TRACE_WRITE, chunkIdx);
+        result = _programBlock(chunkIdx, data, currentSize);
+        NVM_TRACE_END(NVM_TRACE_WRITE, traceStart, chunkIdx);
+        NVM_RECORD(NVM_REC_WRITE, chunkIdx, data, currentSize, result);
+        NVM_STATS_ADD(bytesRequested, (true == result) ? currentSize : 0);
+
+        data += currentSize;
+        remainingSize -= currentSize;
+        chunkIdx++;
+    }
+
+    /* the index is written after the chunks, so a bigger object gets visible only when all of its data is stored */
+    if( (true == result) && ((false == bSizeKnown) || (loSize < (offset + len))) )
+    {
+        result = nvm_lo_set_size(loIdx, (uint16_t)(offset + len));
+    }
+
+    return result;
+}
+
+/**
+* @brief    Read a part of a large object. Whole chunks are read directly into the destination buffer
+*
+* @param    [in]loIdx : index of the large object
+*           [in]offset : offset of the part into the object
+*           [out]data : pointer to the destination buffer
+*           [in]len : size of the destination buffer
+*           [out]readLen : size of the read data. It is smaller than len if the object ends before the end of the part
+* 
+* @return   true if data is read correctly. Otherwise - false
+*/
+bool nvm_lo_read(const NvmLargeObjectsId_t loIdx, uint16_t offset, uint8_t* data, uint16_t len, uint16_t* readLen)
+{
+    NvmBlocksId_t chunkIdx;
+    uint16_t loSize = 0;
+    uint16_t pos;
+    uint16_t offsetInChunk;
+    uint16_t currentSize;
+    uint16_t readSize;
+    bool result = true;
+
+    if( (NvmManagerDescriptor.bIsInitialized == false) || (false == nvm_lo_get_size(loIdx, &loSize)) || (offset > loSize) )
+    {
+        return false;
+    }
+
+    /* the chunks are read also partially, without searching the blocks one by one */
+    _completeMount();
+
+    if(len > (loSize - offset))
+    {
+        len = (uint16_t)(loSize - offset);
+    }
+
+    for(pos = offset; (true == result) && (pos < (offset + len)); pos += currentSize)
     {
-        bOpResult = false;
-        /* erase the whole FLASH page by page and start from scratch */
-        for(idx=NVM_MANAGER_START_ADDR; idx<NVM_MANAGER_END_ADDR; idx += FLASH_SECTOR_SIZE)
+        chunkIdx = (NvmBlocksId_t)(NvmLargeObjects[loIdx].firstChunk + (pos/NVM_LO_CHUNK_SIZE));
+        offsetInChunk = pos%NVM_LO_CHUNK_SIZE;
+        currentSize = (uint16_t)(NVM_LO_CHUNK_SIZE - offsetInChunk);
+
+        if(currentSize > (offset + len - pos))
         {
-            bOpResult |= FlsDrv_eraseBlock4K(idx);
+            currentSize = (uint16_t)(offset + len - pos);
         }
 
-        if(true == bOpResult)
+        if(currentSize == NVM_LO_CHUNK_SIZE)
         {
-            NvmManagerDescriptor.writePointer = NVM_MANAGER_START_ADDR;
+            result = nvm_read(chunkIdx, data + (pos - offset), &readSize);
         }
         else
         {
-            NvmManagerDescriptor.bIsInitialized = false;
-            return;
+            result = (READ_POINTER_NOT_SET != NvmBlocks[chunkIdx].readPointer) &&
+                     (true == _readRecordPart(NvmBlocks[chunkIdx].readPointer, NvmBlocks[chunkIdx].size, offsetInChunk, data + (pos - offset), currentSize));
         }
     }
 
-    NvmManagerDescriptor.bIsInitialized = true;
+    if(true == result)
+    {
+        *readLen = len;
+    }
+
+    return result;
 }
+#endif
 
+#ifdef NVM_USE_KV_STORE
 /**
-* @brief    Update data element in NVManager
+* @brief    Store a value with a string key into the key-value store. An unchanged value is not programmed again
 *
-* @param    [in]bIdx : index of the logical block to write the data
+* @param    [in]key : zero-terminated key with up to NVM_KV_MAX_KEY_SIZE characters
 *           [in]data : pointer to the source data buffer
-*           [in]size : size of the data to be written
+*           [in]len : size of the value, up to NVM_KV_MAX_DATA_SIZE
 * 
-* @return   indicate if data is stored or an error has occurred
+* @return   true if the value is stored, otherwise - false
 */
-bool nvm_write(const NvmBlocksId_t bIdx, const uint8_t* data, uint16_t size)
+bool nvm_kv_put(const char* key, const uint8_t* data, uint16_t len)
 {
-    uint32_t currPage;
-    uint32_t nextPageAddr;
-    uint32_t calculatedCrc32 = 0;
-    bool writeResult = true;
-    
-    if( (NvmManagerDescriptor.bIsInitialized == false) || (bIdx >= eNvmBlockCount) )
+    uint32_t keyLen = (NULL != key) ? (uint32_t)strlen(key) : 0;
+
+    if( (0 == keyLen) || (keyLen > NVM_KV_MAX_KEY_SIZE) || (len > NVM_KV_MAX_DATA_SIZE) )
     {
         return false;
     }
-    
-    /* first check if there is a change of the parameter to be written. This is done to decrease the number fo writings into FLASH */
-    if( (READ_POINTER_NOT_SET != NvmBlocks[bIdx].readPointer) &&
-        (true == FlsDrv_readBytes( NvmBlocks[bIdx].readPointer, (uint8_t*)NvmRamBuffer, NvmBlocks[bIdx].size + BLOCK_HEADER_SIZE)) )
+
+    return _kvWrite(0, (const uint8_t*)key, (uint8_t)keyLen, data, len, false);
+}
+
+/**
+* @brief    Read the value of a string key from the key-value store
+*
+* @param    [in]key : zero-terminated key
+*           [out]data : pointer to the destination buffer
+*           [in]size : size of the destination buffer
+*           [out]len : size of the value
+* 
+* @return   true if the key exists and its value is read correctly. Otherwise - false
+*/
+bool nvm_kv_get(const char* key, uint8_t* data, uint16_t size, uint16_t* len)
+{
+    uint32_t keyLen = (NULL != key) ? (uint32_t)strlen(key) : 0;
+
+    if( (0 == keyLen) || (keyLen > NVM_KV_MAX_KEY_SIZE) )
     {
-        /* perform this chech only if no garbage collection is ongoing */
-        if((false == NvmManagerDescriptor.bgarbageCollect)&&(0 == memcmp(data, NvmRamBuffer+BLOCK_HEADER_SIZE, NvmBlocks[bIdx].size)))
-        {
-            /* the data is already stored */
-            return true;
-        }
+        return false;
     }
 
-    if( (NvmManagerDescriptor.writePointer%GET_OFFSET_IN_PAGE_MASK + NvmBlocks[bIdx].size + BLOCK_HEADER_SIZE + NVM_CRC_LEN) > FLASH_SECTOR_SIZE )
+    return _kvRead(0, (const uint8_t*)key, (uint8_t)keyLen, data, size, len);
+}
+
+/**
+* @brief    Delete a string key from the key-value store
+*
+* @param    [in]key : zero-terminated key
+* 
+* @return   true if the key does not exist any more, otherwise - false
+*/
+bool nvm_kv_delete(const char* key)
+{
+    uint32_t keyLen = (NULL != key) ? (uint32_t)strlen(key) : 0;
+
+    if( (0 == keyLen) || (keyLen > NVM_KV_MAX_KEY_SIZE) )
     {
-        /* page overflow */
-        currPage = NvmManagerDescriptor.writePointer&GET_FLASH_PAGE_MASK;
+        return false;
+    }
 
-        if(NvmManagerDescriptor.writePointer + FLASH_SECTOR_SIZE > NVM_MANAGER_END_ADDR)
-        {
-            nextPageAddr = NVM_MANAGER_START_ADDR;
-        }
-        else
-        {
-            nextPageAddr = (NvmManagerDescriptor.writePointer&GET_FLASH_PAGE_MASK) + FLASH_SECTOR_SIZE;
-        }
+    return _kvWrite(0, (const uint8_t*)key, (uint8_t)keyLen, NULL, 0, true);
+}
 
-        NvmManagerDescriptor.writePointer = nextPageAddr + PAGE_HEADER_SIZE;
+/**
+* @brief    Store a value with an integer key into the key-value store. An unchanged value is not programmed again
+*
+* @param    [in]id : the key
+*           [in]data : pointer to the source data buffer
+*           [in]len : size of the value, up to NVM_KV_MAX_DATA_SIZE
+* 
+* @return   true if the value is stored, otherwise - false
+*/
+bool nvm_kv_put_id(uint32_t id, const uint8_t* data, uint16_t len)
+{
+    if(len > NVM_KV_MAX_DATA_SIZE)
+    {
+        return false;
+    }
 
-        /* erase next page */
-        FlsDrv_eraseBlock4K(nextPageAddr);
+    return _kvWrite(NVM_KV_FLAG_ID_KEY, (const uint8_t*)&id, sizeof(id), data, len, false);
+}
 
-        /* mark next page as written */
-        writeResult &= _writeBytes( nextPageAddr, (uint8_t*)PAGE_MARK_AS_WRITTEN, PAGE_HEADER_HALF_SIZE);
+/**
+* @brief    Read the value of an integer key from the key-value store
+*
+* @param    [in]id : the key
+*           [out]data : pointer to the destination buffer
+*           [in]size : size of the destination buffer
+*           [out]len : size of the value
+* 
+* @return   true if the key exists and its value is read correctly. Otherwise - false
+*/
+bool nvm_kv_get_id(uint32_t id, uint8_t* data, uint16_t size, uint16_t* len)
+{
+    return _kvRead(NVM_KV_FLAG_ID_KEY, (const uint8_t*)&id, sizeof(id), data, size, len);
+}
 
-        /* ensure that all NvM blocks are updated in the next page */
-        _garbageCollection(currPage, bIdx);
-        
-        /* set the current occurance counter to 0 */
-        NvmBlocks[bIdx].occurrenceCntr = 0;
+/**
+* @brief    Delete an integer key from the key-value store
+*
+* @param    [in]id : the key
+* 
+* @return   true if the key does not exist any more, otherwise - false
+*/
+bool nvm_kv_delete_id(uint32_t id)
+{
+    return _kvWrite(NVM_KV_FLAG_ID_KEY, (const uint8_t*)&id, sizeof(id), NULL, 0, true);
+}
+#endif
 
-        /* mark this page as ready to be erased */
-        writeResult &= _writeBytes( currPage+PAGE_HEADER_HALF_SIZE, (uint8_t*)PAGE_MARK_AS_READ, PAGE_HEADER_HALF_SIZE);
+/**
+* @brief    Get the utilization of a logical page, i.e. the size of the latest instances of the logical blocks and key-value records into it
+*
+* @param    [in]pageIdx : index of the logical page, up to NVM_PAGE_COUNT - 1
+*           [out]validBytes : size of the live data into the page (headers, data and checksums)
+* 
+* @return   true if the page exists, otherwise - false
+*/
+bool nvm_get_page_utilization(uint32_t pageIdx, uint32_t* validBytes)
+{
+    if( (NvmManagerDescriptor.bIsInitialized == false) || (pageIdx >= NVM_PAGE_COUNT) )
+    {
+        return false;
     }
 
-    memset(NvmRamBuffer, 0, NVM_BLOCK_MAX_SIZE);
+    _completeMount();
 
-    memcpy(NvmRamBuffer, (uint8_t*)(&NvmBlocks[bIdx].pattern), BLOCK_HEADER_HALF_SIZE);
+    *validBytes = NvmPageInfo[pageIdx].validBytes;
 
-    /* Counter is reset on Garbage collection */
-    NvmBlocks[bIdx].occurrenceCntr++;
-    
-    /* Set the occurance counter  */
-    memcpy(NvmRamBuffer+BLOCK_HEADER_HALF_SIZE, (uint8_t*)(&NvmBlocks[bIdx].occurrenceCntr), BLOCK_HEADER_HALF_SIZE);
+    return true;
+}
 
-    /* copy the block data */
-    memcpy(NvmRamBuffer+BLOCK_HEADER_SIZE, data, NvmBlocks[bIdx].size);
-    
-    /* add checksum of the data to be written */
-    _nvmCrc32(NvmRamBuffer+BLOCK_HEADER_SIZE, NvmBlocks[bIdx].size, &calculatedCrc32);
-    
-    memcpy((uint8_t*)(NvmRamBuffer+BLOCK_HEADER_SIZE+NvmBlocks[bIdx].size), &calculatedCrc32, NVM_CRC_LEN);
-    
-    /* In case of error delete the whole NVM area and force the default settings 
-    * Normally false should never happen if NVM is initialized correctly. OTherwise the NVM content can not be trust any more
-    */
-    if((true == writeResult)&&(true == _writeBytes( NvmManagerDescriptor.writePointer, (uint8_t*)NvmRamBuffer, NvmBlocks[bIdx].size + BLOCK_HEADER_SIZE + NVM_CRC_LEN)))
-    {
-        NvmBlocks[bIdx].readPointer = NvmManagerDescriptor.writePointer;
+#ifdef NVM_USE_TRACE
+/**
+* @brief    Register the callback and the clock of the trace points and clear the latency histograms
+*
+* @param    [in]callback : called at the begin and at the end of every traced operation or NULL
+*           [in]clock : source of the timestamps or NULL. The histograms are collected only with a clock
+* 
+* @return   none
+*/
+void nvm_trace_register(NvmTraceCallback_t callback, NvmTraceClock_t clock)
+{
+    NvmTraceCallback = callback;
+    NvmTraceClock = clock;
 
-        NvmManagerDescriptor.writePointer += (NvmBlocks[bIdx].size + BLOCK_HEADER_SIZE + NVM_CRC_LEN);
+    memset(NvmTraceHistogram, 0, sizeof(NvmTraceHistogram));
+}
 
-        if( 0 == (NvmManagerDescriptor.writePointer%FLASH_SECTOR_SIZE) )
-        {
-            /* page overflow will be performed on the next write operation */
-            NvmManagerDescriptor.writePointer -= BLOCK_HEADER_HALF_SIZE;
-        }
-        
-        return true;
-    }
-    else
+/**
+* @brief    Get the latency histogram of a traced operation. Bucket n counts the latencies from 2^n to 2^(n+1)-1 clock ticks, 
+*           bucket 0 counts also the latency 0 and the last bucket counts all longer latencies
+*
+* @param    [in]op : the operation
+*           [out]histogram : NVM_TRACE_HIST_BUCKETS counters
+* 
+* @return   true if the operation exists, otherwise - false
+*/
+bool nvm_trace_get_histogram(NvmTraceOp_t op, uint32_t* histogram)
+{
+    if( (op >= NVM_TRACE_OP_COUNT) || (NULL == histogram) )
     {
-        /* NVM writing was not successful - perform reinitialization of the NVM */
-        bool bOpResult = false;
-        uint32_t idx = 0;
-        
-        /* erase the whole logical page by page and start from scratch */
-        for(idx=NVM_MANAGER_START_ADDR; idx<NVM_MANAGER_END_ADDR; idx += FLASH_SECTOR_SIZE)
-        {
-            bOpResult |= FlsDrv_eraseBlock4K(idx);
-        }
-
-        if(true == bOpResult)
-        {
-            NvmManagerDescriptor.writePointer = NVM_MANAGER_START_ADDR;
-        }
-        else
-        {
-            NvmManagerDescriptor.bIsInitialized = false;
-        }
-        
-        /* set the read point to not initialized */
-        for(idx = (NvmBlocksId_t)0; idx < eNvmBlockCount; idx++)
-        {
-            NvmBlocks[idx].readPointer = READ_POINTER_NOT_SET;
-        }
-        
         return false;
     }
+
+    memcpy(histogram, NvmTraceHistogram[op], sizeof(NvmTraceHistogram[op]));
+
+    return true;
 }
+#endif
 
+#ifdef NVM_USE_RECORDER
 /**
-* @brief    Read data element from NVManager
+* @brief    Register the sink of the recorder. The first record after the registration has the time difference 0
 *
-* @param    [in]bIdx : index of the logical block to write the data
-*           [out]data : pointer to the source data buffer
-*           [out]size : pointer size of the data that was read
+* @param    [in]sink : called with every record or NULL to stop the recording
 * 
-* @return   true if data is read correctly. Otherwise - false
+* @return   none
 */
-bool nvm_read(const NvmBlocksId_t bIdx, uint8_t* data, uint16_t *size)
+void nvm_record_register(NvmRecordSink_t sink)
 {
-    uint32_t existingCrc32 = 0;
-    uint32_t calculatedCrc32 = 0;
-    bool bResL = false;
+    NvmRecordSink = sink;
+    NvmRecordStarted = false;
+}
+#endif
+
+#ifdef NVM_USE_STATS
+/**
+* @brief    Get the runtime counters since the last initialization, the current usage of the page and the write amplification
+*
+* @param    [out]stats : the counters
+* 
+* @return   true if the NVManager is initialized, otherwise - false
+*/
+bool nvm_get_stats(NvmStats_t* stats)
+{
+    uint32_t pageIdx;
+    uint32_t usedBytes;
 
-    if( (NvmManagerDescriptor.bIsInitialized == false) || (bIdx >= eNvmBlockCount) || (READ_POINTER_NOT_SET == NvmBlocks[bIdx].readPointer) )
+    if( (NvmManagerDescriptor.bIsInitialized == false) || (NULL == stats) )
     {
         return false;
     }
-    
-    bResL = FlsDrv_readBytes( NvmBlocks[bIdx].readPointer, 
-                             (uint8_t*)NvmRamBuffer, 
-                             NvmBlocks[bIdx].size + BLOCK_HEADER_SIZE + NVM_CRC_LEN );
 
-    if(bResL == true)
+    /* the write pointer and the live records are known only after all records are searched */
+    _completeMount();
+
+    *stats = NvmStats;
+
+    stats->liveBytes = 0;
+    for(pageIdx = 0; pageIdx < NVM_PAGE_COUNT; pageIdx++)
     {
-        memcpy( &existingCrc32, 
-                (uint8_t*)(NvmRamBuffer + NvmBlocks[bIdx].size + BLOCK_HEADER_SIZE), 
-                NVM_CRC_LEN );
-        _nvmCrc32(NvmRamBuffer+BLOCK_HEADER_SIZE, NvmBlocks[bIdx].size, &calculatedCrc32);
-        
-        if (calculatedCrc32 == existingCrc32)
-        {
-            *size = NvmBlocks[bIdx].size;
-            memcpy(data, (uint8_t*)(NvmRamBuffer+BLOCK_HEADER_SIZE), NvmBlocks[bIdx].size);
-            bResL = true;
-        }
+        stats->liveBytes += NvmPageInfo[pageIdx].validBytes;
     }
 
-    return bResL;
+    /* the page header and the records before the write pointer are used, the rest of the page is free */
+    usedBytes = GET_OFFSET_IN_PAGE(NvmManagerDescriptor.writePointer);
+    stats->freeBytes = LOGICAL_PAGE_SIZE - usedBytes;
+    stats->dirtyBytes = usedBytes - PAGE_HEADER_SIZE - NvmPageInfo[GET_PAGE_IDX(NvmManagerDescriptor.writePointer)].validBytes;
+
+    if(0 == NvmStats.bytesRequested)
+    {
+        stats->writeAmplification = 0;
+    }
+    else if(NvmStats.bytesRequested > (0xFFFFFFFFuL / 100u))
+    {
+        stats->writeAmplification = NvmStats.bytesProgrammed / (NvmStats.bytesRequested / 100u);
+    }
+    else
+    {
+        stats->writeAmplification = ((NvmStats.bytesProgrammed / NvmStats.bytesRequested) * 100u) + 
+                                    (((NvmStats.bytesProgrammed % NvmStats.bytesRequested) * 100u) / NvmStats.bytesRequested);
+    }
+
+    return true;
+}
+#endif
+
+/**
+* @brief    Get the generation of the NVManager. It is changed every time a page is erased, i.e. NVM blocks are relocated 
+*           by the garbage collection. Views from nvm_read_view remain valid only while the generation is the same
+*
+* @param    none
+* 
+* @return   the current generation
+*/
+uint32_t nvm_get_generation(void)
+{
+    return NvmManagerDescriptor.generation;
 }
 
 /**
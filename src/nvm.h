@@ -23,14 +23,63 @@
 ***********************************/
 #include "nvm_cfg.h"
 
-#define 	FLASH_PAGE_MASK1				0xFFFFF000
-#define 	FLASH_PAGE_MASK2				0xFFF
-
-#define LOGICAL_PAGE_SIZE		    4096u
-#define GET_FLASH_PAGE_MASK			FLASH_PAGE_MASK1
-#define GET_OFFSET_IN_PAGE_MASK 	FLASH_PAGE_MASK2
+/* start address of the logical page, which contains the address and the offset of the address into this page */
+#define GET_PAGE_ADDR(addr)         (NVM_MANAGER_START_ADDR + ((((addr) - NVM_MANAGER_START_ADDR)/LOGICAL_PAGE_SIZE)*LOGICAL_PAGE_SIZE))
+#define GET_OFFSET_IN_PAGE(addr)    (((addr) - NVM_MANAGER_START_ADDR)%LOGICAL_PAGE_SIZE)
+#define GET_PAGE_IDX(addr)          (((addr) - NVM_MANAGER_START_ADDR)/LOGICAL_PAGE_SIZE)
+#define NVM_PAGE_COUNT              ((NVM_MANAGER_END_ADDR - NVM_MANAGER_START_ADDR)/LOGICAL_PAGE_SIZE)
+#define GET_SECTOR_IDX(addr)        (((addr) - NVM_MANAGER_START_ADDR)/FLASH_SECTOR_SIZE)
+#define NVM_SECTOR_COUNT            ((NVM_MANAGER_END_ADDR - NVM_MANAGER_START_ADDR)/FLASH_SECTOR_SIZE)
 
 #define READ_POINTER_NOT_SET        0xFFFFFFFF
+#define NVM_CRC_ERASED              0xFFFFFFFF // checksum of a record, whose programming is cut after the header
+
+#ifdef NVM_USE_KV_STORE
+/* flags into the header of a key-value record */
+#define NVM_KV_FLAG_DELETED         0x01 // the key is deleted (tombstone record without a value)
+#define NVM_KV_FLAG_ID_KEY          0x02 // the key is an integer and not a string
+
+/* block index, which is reported for a record of the key-value store while searching after power-on */
+#define NVM_KV_RECORD               eNvmBlockCount
+
+/* states of an entry of the hash index, which do not point to a record */
+#define NVM_KV_SLOT_FREE            READ_POINTER_NOT_SET // never used, ends the search after a key
+#define NVM_KV_SLOT_VACATED         0xFFFFFFFE           // released by the garbage collection, the search continues after it
+
+/* the live records of a page are the logical blocks followed by the entries of the hash index of the key-value store */
+#define NVM_RECORD_COUNT            (eNvmBlockCount + NVM_KV_INDEX_SIZE)
+#else
+#define NVM_RECORD_COUNT            eNvmBlockCount
+#endif
+#define NVM_LIVE_MAP_WORDS          ((NVM_RECORD_COUNT + 31)/32)
+
+#ifdef NVM_USE_EMERGENCY_FLUSH
+#define NVM_EMERGENCY_END_ADDR      (NVM_EMERGENCY_START_ADDR + NVM_EMERGENCY_SIZE)
+/* occurrence counter of a consumed record into the emergency region. A new record carries its generation instead - the occurrence counter,
+ * which the block gets by the merge. It is programmed to 0, when the record is merged or older than the latest instance */
+#define NVM_EMERGENCY_RECORD_MERGED 0x0000
+#endif
+
+#ifdef NVM_USE_BACKGROUND_ERASE
+#define NVM_ERASE_NONE              0xFFFFFFFF // no logical page is released for erasing in the background
+#endif
+
+#ifdef NVM_USE_WEAR_BUDGET
+/* the NVM area may erase one logical page per this period, so that its sectors reach the rated endurance at the end of the target lifetime */
+#define NVM_WEAR_BUDGET_PERIOD_S    (NVM_TARGET_LIFETIME_S/(NVM_RATED_ERASE_CYCLES*NVM_PAGE_COUNT))
+#define NVM_RATED_PAGE_ERASES       (NVM_RATED_ERASE_CYCLES*NVM_PAGE_COUNT)
+#define NVM_REMAINING_LIFE_MAX      0xFFFFFFFF // no page is erased yet or the projection does not fit into 32 bits
+#define NVM_WRITE_TIME_NONE         0xFFFFFFFF // the block is not programmed since the initialization
+#endif
+
+/* A trace file of the recorder starts with a header (magic, version and record size, little-endian) followed by the records. A record is 
+ * [op u8][block index u8][block size u16][time since the previous record in us u32][CRC32 of the data u32], little-endian. 
+ * The format does not depend on the configuration, so a trace can be replayed by a build without the recorder */
+#define NVM_REC_MAGIC               "NVMT"
+#define NVM_REC_VERSION             1
+#define NVM_REC_HEADER_SIZE         8
+#define NVM_REC_SIZE                12
+#define NVM_REC_FAILED              0x80 // the call has returned false
 
 /**********************************
 * Type definitions
@@ -55,13 +104,134 @@ typedef struct
 	bool bIsInitialized;
 	bool bErrorDetected;
     bool bgarbageCollect;
+    uint32_t generation;
+#ifdef NVM_USE_EMERGENCY_FLUSH
+    uint32_t emergencyWritePointer;
+    bool bEmergencyPending; /* the emergency region contains records, which are flushed after the initialization */
+#endif
+    uint32_t mountPointer; /* next record to be searched after power-on */
+    uint32_t mountEndAddr; /* the page with data is erased after this address */
+    uint32_t mountPageEndAddr; /* end address of the page with data */
+    bool bMountComplete; /* all records are searched, so the write pointer is valid */
+#ifdef NVM_USE_BACKGROUND_ERASE
+    uint32_t erasePageAddr; /* logical page, which is erased in the background or NVM_ERASE_NONE */
+    uint32_t eraseAddr; /* next sector of the page to be erased. The page is erased when it reaches the end of the page */
+    bool bEraseRunning; /* an erase of the sector is started into the flash driver */
+#endif
+#ifdef NVM_USE_WEAR_BUDGET
+    uint32_t eraseCount; /* erases of logical pages since the NVM area is used */
+    uint32_t operatingTime; /* operating time in seconds, which is stored into the wear info */
+    uint32_t bootTime; /* SysTime_getSeconds at the initialization */
+#endif
 } NvmManagerDescriptor_t;
 
+#ifdef NVM_USE_WEAR_BUDGET
+/* Data of the logical block eNvmWearInfo. It is written with the actual values on every garbage collection */
+typedef struct
+{
+    uint32_t eraseCount; /* erases of logical pages */
+    uint32_t operatingTime; /* operating time in seconds */
+} NvmWearInfo_t;
+#endif
+
+/* Bookkeeping of one logical page. It is updated on every write and relocation, so the garbage collection visits only the live records */
+typedef struct
+{
+    uint32_t validBytes; /* size of the live records (header, data and checksum) into the page */
+    uint32_t liveRecords[NVM_LIVE_MAP_WORDS]; /* one bit per record (NVM_RECORD_COUNT), that has its latest instance into the page */
+} NvmPageInfo_t;
+
+#ifdef NVM_USE_STATS
+/* Runtime counters of the NVManager since the last initialization */
+typedef struct
+{
+    uint32_t writesRequested; /* write requests of logical blocks and key-value records, which reach the flash (after the coalescing) */
+    uint32_t writesSkipped; /* write requests with unchanged data, which are not programmed */
+    uint32_t recordsProgrammed; /* records programmed without an error on request and by the garbage collection */
+    uint32_t bytesRequested; /* data bytes of the successful write requests (nvm_write, the parts of nvm_lo_write and the values of the key-value store), unchanged data included */
+    uint32_t bytesProgrammed; /* all bytes programmed without an error into the NVM area, including the relocated records and the page headers */
+    uint32_t sectorErases[NVM_SECTOR_COUNT]; /* erases of every flash sector of the NVM area */
+    uint32_t gcRuns; /* garbage collections */
+    uint32_t gcRecordsRelocated; /* records relocated by the garbage collection */
+    uint32_t gcBytesRelocated; /* size of the records relocated by the garbage collection */
+    uint32_t mountTimeUs; /* time of the search after power-on in microseconds */
+    uint32_t liveBytes; /* size of the latest instances of all records */
+    uint32_t freeBytes; /* space after the write pointer, which is written without garbage collection */
+    uint32_t dirtyBytes; /* space of the old instances of the records into the current page */
+    uint32_t writeAmplification; /* bytesProgrammed per bytesRequested in percent, the write_amplification of workload_bench */
+} NvmStats_t;
+#endif
+
+#ifdef NVM_USE_TRACE
+/* Operations and phases, which are traced */
+typedef enum
+{
+    NVM_TRACE_READ,      /* read from the flash */
+    NVM_TRACE_PROGRAM,   /* program of the flash */
+    NVM_TRACE_ERASE,     /* erase of a flash sector, which is waited for */
+    NVM_TRACE_WRITE,     /* nvm_write */
+    NVM_TRACE_GC,        /* garbage collection */
+    NVM_TRACE_MOUNT,     /* nvm_init, nvm_init_lazy and nvm_mount_step */
+    NVM_TRACE_DUP_CHECK, /* comparison of the data to be written with the stored one */
+    NVM_TRACE_OP_COUNT
+} NvmTraceOp_t;
+
+/* Events of a trace point */
+typedef enum
+{
+    NVM_TRACE_EVENT_BEGIN,
+    NVM_TRACE_EVENT_END
+} NvmTraceEvent_t;
+
+/* Callback of a trace point. arg is the flash address of a flash operation, the block index of a write, the page address 
+ * of a garbage collection and 0 for a mount */
+typedef void (*NvmTraceCallback_t)(NvmTraceOp_t op, NvmTraceEvent_t event, uint32_t timestamp, uint32_t arg);
+
+/* Clock of the trace points. The unit of the timestamps and the latencies is defined by it */
+typedef uint32_t (*NvmTraceClock_t)(void);
+#endif
+
+/* Recorded calls. NVM_REC_FAILED is set into the operation byte of a call, which has returned false */
+typedef enum
+{
+    NVM_REC_INIT,
+    NVM_REC_INIT_LAZY,
+    NVM_REC_WRITE,
+    NVM_REC_READ
+} NvmRecordOp_t;
+
+#ifdef NVM_USE_RECORDER
+/* Sink of the recorded calls, i.e. a file or a log of the device. Every call passes one record of NVM_REC_SIZE bytes */
+typedef void (*NvmRecordSink_t)(const uint8_t* record, uint32_t len);
+#endif
+
+#ifdef NVM_USE_KV_STORE
+/* Header of a key-value record, that follows the block header. The key, the value and the checksum follow it */
+typedef struct
+{
+    uint8_t keyLen; /* size of the key */
+    uint8_t flags; /* NVM_KV_FLAG_x */
+    uint16_t dataLen; /* size of the value */
+} NvmKvHeader_t;
+
+/* An entry of the hash index of the key-value store */
+typedef struct
+{
+    uint32_t addr; /* address of the latest record of the key or NVM_KV_SLOT_FREE/NVM_KV_SLOT_VACATED */
+    uint16_t occurrenceCntr; /* occurence counter of the latest record */
+    uint8_t tag; /* upper byte of the hash of the key. The key is compared with the record only if the tag matches */
+    bool bDeleted; /* the latest record is a tombstone */
+} NvmKvIndexEntry_t;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**********************************
 * Data declarations
 ***********************************/
 extern NvmManagerDescriptor_t NvmManagerDescriptor;
-extern uint8_t NvmRamBuffer[NVM_BLOCK_MAX_SIZE];
 
 /**********************************
 * Interface
@@ -76,8 +246,30 @@ extern uint8_t NvmRamBuffer[NVM_BLOCK_MAX_SIZE];
 */
 void nvm_init(void);
 
+#ifdef NVM_USE_LAZY_MOUNT
+/**
+* @brief    Initialize NVManager once after power-on without searching the records. It returns after the page with data is located.
+*           A logical block is searched on its first read, all other operations search the rest of the records first
+* 
+* @param     none
+*
+* @return    none
+*/
+void nvm_init_lazy(void);
+
 /**
-* @brief    Update data element in NVManager
+* @brief    Search the next NVM_MOUNT_STEP_RECORDS records after nvm_init_lazy. It shall be called cyclically, i.e. from the idle task
+* 
+* @param     none
+*
+* @return    true if all records are searched, otherwise - false
+*/
+bool nvm_mount_step(void);
+#endif
+
+/**
+* @brief    Update data element in NVManager. The write of a throttleable block within its coalescing window is deferred: 
+*           the data is copied and programmed by nvm_write_step
 *
 * @param    [in]bIdx : index of the logical block to write the data
 *           [in]data : pointer to the source data buffer
@@ -98,6 +290,266 @@ bool nvm_write(const NvmBlocksId_t bIdx, const uint8_t* data, uint16_t size);
 */
 bool nvm_read(const NvmBlocksId_t bIdx, uint8_t* data, uint16_t *size);
 
+#ifdef NVM_USE_EMERGENCY_FLUSH
+/**
+* @brief    Mark a logical block as changed, but not written yet. The block is written from the given RAM location 
+*           by nvm_emergency_flush, unless it is written by nvm_write before that
+*
+* @param    [in]bIdx : index of the logical block
+*           [in]data : RAM location of the latest data of the block. It has to stay valid until the block is written
+* 
+* @return   true if the block is marked, otherwise - false (NVM_EMERGENCY_MAX_RECORDS or NVM_EMERGENCY_SIZE would be exceeded)
+*/
+bool nvm_set_dirty(const NvmBlocksId_t bIdx, const uint8_t* data);
+
+/**
+* @brief    Write all dirty blocks into the emergency region, i.e. on brown-out. There is no garbage collection, erasing or comparison 
+*           of the data, so the execution time is never longer than NVM_EMERGENCY_FLUSH_TIME_NS. The blocks are merged back 
+*           into the NVM area by the next nvm_init. It shall not interrupt another operation of the NVManager
+*
+* @param    none
+* 
+* @return   true if all dirty blocks are written, otherwise - false
+*/
+bool nvm_emergency_flush(void);
+#endif
+
+#ifdef NVM_USE_BACKGROUND_ERASE
+/**
+* @brief    Continue the erasing of the released logical page in the background. It shall be called cyclically, i.e. from the idle task.
+*           The page is erased sector by sector and the running erase is suspended whenever the NVManager accesses the flash
+*
+* @param    none
+* 
+* @return   true if no erase is pending, otherwise - false
+*/
+bool nvm_erase_step(void);
+#endif
+
+#ifdef NVM_USE_WEAR_BUDGET
+/**
+* @brief    Program the deferred writes of the throttleable blocks, whose coalescing window is over. It shall be called cyclically, 
+*           i.e. from the idle task
+*
+* @param    none
+* 
+* @return   true if no write is deferred any more, otherwise - false
+*/
+bool nvm_write_step(void);
+
+/**
+* @brief    Program all deferred writes and the wear info immediately, i.e. before a controlled shutdown
+*
+* @param    none
+* 
+* @return   true if all data is programmed, otherwise - false
+*/
+bool nvm_write_flush(void);
+
+/**
+* @brief    Project the remaining life of the NVM area from the erase rate over the operating time so far
+*
+* @param    [out]seconds : operating time until the rated endurance is reached or NVM_REMAINING_LIFE_MAX
+* 
+* @return   true if the NVManager is initialized, otherwise - false
+*/
+bool nvm_get_remaining_life(uint32_t* seconds);
+#endif
+
+#ifdef NVM_USE_READ_VIEW
+/**
+* @brief    Get direct access to the data element into the memory-mapped FLASH without copying it.
+*           The CRC of the data is verified before the pointer is returned
+*
+* @param    [in]bIdx : index of the logical block to be read
+*           [out]ptr : pointer to the data of the logical block into the FLASH
+*           [out]len : size of the data of the logical block
+* 
+* @return   true if the flash is memory-mapped and the data is read correctly. Otherwise - false
+*/
+bool nvm_read_view(const NvmBlocksId_t bIdx, const uint8_t** ptr, uint16_t* len);
+#endif
+
+#ifdef NVM_USE_LARGE_OBJECTS
+/**
+* @brief    Write a part of a large object. Only the chunks covered by the part are written and only the changed ones are programmed.
+*           A chunk, which is covered only partially at the end of the part, is filled with zeros, so such a part has to end at or after
+*           the actual size of the object. The object grows if the part ends after its actual size
+*
+* @param    [in]loIdx : index of the large object
+*           [in]offset : offset of the part into the object. It shall be aligned to NVM_LO_CHUNK_SIZE
+*           [in]data : pointer to the source data buffer
+*           [in]len : size of the part
+* 
+* @return   true if the part is stored, otherwise - false
+*/
+bool nvm_lo_write(const NvmLargeObjectsId_t loIdx, uint16_t offset, const uint8_t* data, uint16_t len);
+
+/**
+* @brief    Read a part of a large object
+*
+* @param    [in]loIdx : index of the large object
+*           [in]offset : offset of the part into the object
+*           [out]data : pointer to the destination buffer
+*           [in]len : size of the destination buffer
+*           [out]readLen : size of the read data. It is smaller than len if the object ends before the end of the part
+* 
+* @return   true if data is read correctly. Otherwise - false
+*/
+bool nvm_lo_read(const NvmLargeObjectsId_t loIdx, uint16_t offset, uint8_t* data, uint16_t len, uint16_t* readLen);
+
+/**
+* @brief    Get the actual size of a large object
+*
+* @param    [in]loIdx : index of the large object
+*           [out]size : actual size of the large object
+* 
+* @return   true if the large object is written, otherwise - false
+*/
+bool nvm_lo_get_size(const NvmLargeObjectsId_t loIdx, uint16_t* size);
+
+/**
+* @brief    Set the actual size of a large object, i.e. truncate it before writing a shorter content
+*
+* @param    [in]loIdx : index of the large object
+*           [in]size : new size of the large object
+* 
+* @return   true if the size is stored, otherwise - false
+*/
+bool nvm_lo_set_size(const NvmLargeObjectsId_t loIdx, uint16_t size);
+#endif
+
+#ifdef NVM_USE_KV_STORE
+/**
+* @brief    Store a value with a string key into the key-value store. An unchanged value is not programmed again
+*
+* @param    [in]key : zero-terminated key with up to NVM_KV_MAX_KEY_SIZE characters
+*           [in]data : pointer to the source data buffer
+*           [in]len : size of the value, up to NVM_KV_MAX_DATA_SIZE
+* 
+* @return   true if the value is stored, otherwise - false
+*/
+bool nvm_kv_put(const char* key, const uint8_t* data, uint16_t len);
+
+/**
+* @brief    Read the value of a string key from the key-value store
+*
+* @param    [in]key : zero-terminated key
+*           [out]data : pointer to the destination buffer
+*           [in]size : size of the destination buffer
+*           [out]len : size of the value
+* 
+* @return   true if the key exists and its value is read correctly. Otherwise - false
+*/
+bool nvm_kv_get(const char* key, uint8_t* data, uint16_t size, uint16_t* len);
+
+/**
+* @brief    Delete a string key from the key-value store
+*
+* @param    [in]key : zero-terminated key
+* 
+* @return   true if the key does not exist any more, otherwise - false
+*/
+bool nvm_kv_delete(const char* key);
+
+/**
+* @brief    Store a value with an integer key into the key-value store. An unchanged value is not programmed again
+*
+* @param    [in]id : the key
+*           [in]data : pointer to the source data buffer
+*           [in]len : size of the value, up to NVM_KV_MAX_DATA_SIZE
+* 
+* @return   true if the value is stored, otherwise - false
+*/
+bool nvm_kv_put_id(uint32_t id, const uint8_t* data, uint16_t len);
+
+/**
+* @brief    Read the value of an integer key from the key-value store
+*
+* @param    [in]id : the key
+*           [out]data : pointer to the destination buffer
+*           [in]size : size of the destination buffer
+*           [out]len : size of the value
+* 
+* @return   true if the key exists and its value is read correctly. Otherwise - false
+*/
+bool nvm_kv_get_id(uint32_t id, uint8_t* data, uint16_t size, uint16_t* len);
+
+/**
+* @brief    Delete an integer key from the key-value store
+*
+* @param    [in]id : the key
+* 
+* @return   true if the key does not exist any more, otherwise - false
+*/
+bool nvm_kv_delete_id(uint32_t id);
+#endif
+
+/**
+* @brief    Get the utilization of a logical page, i.e. the size of the latest instances of the logical blocks and key-value records into it
+*
+* @param    [in]pageIdx : index of the logical page, up to NVM_PAGE_COUNT - 1
+*           [out]validBytes : size of the live data into the page (headers, data and checksums)
+* 
+* @return   true if the page exists, otherwise - false
+*/
+bool nvm_get_page_utilization(uint32_t pageIdx, uint32_t* validBytes);
+
+#ifdef NVM_USE_TRACE
+/**
+* @brief    Register the callback and the clock of the trace points and clear the latency histograms
+*
+* @param    [in]callback : called at the begin and at the end of every traced operation or NULL
+*           [in]clock : source of the timestamps or NULL. The histograms are collected only with a clock
+* 
+* @return   none
+*/
+void nvm_trace_register(NvmTraceCallback_t callback, NvmTraceClock_t clock);
+
+/**
+* @brief    Get the latency histogram of a traced operation. Bucket n counts the latencies from 2^n to 2^(n+1)-1 clock ticks, 
+*           bucket 0 counts also the latency 0 and the last bucket counts all longer latencies
+*
+* @param    [in]op : the operation
+*           [out]histogram : NVM_TRACE_HIST_BUCKETS counters
+* 
+* @return   true if the operation exists, otherwise - false
+*/
+bool nvm_trace_get_histogram(NvmTraceOp_t op, uint32_t* histogram);
+#endif
+
+#ifdef NVM_USE_RECORDER
+/**
+* @brief    Register the sink of the recorder. The first record after the registration has the time difference 0
+*
+* @param    [in]sink : called with every record or NULL to stop the recording
+* 
+* @return   none
+*/
+void nvm_record_register(NvmRecordSink_t sink);
+#endif
+
+#ifdef NVM_USE_STATS
+/**
+* @brief    Get the runtime counters since the last initialization, the current usage of the page and the write amplification
+*
+* @param    [out]stats : the counters
+* 
+* @return   true if the NVManager is initialized, otherwise - false
+*/
+bool nvm_get_stats(NvmStats_t* stats);
+#endif
+
+/**
+* @brief    Get the generation of the NVManager. It is changed every time a page is erased (garbage collection or reset of the NVM).
+*           A pointer returned by nvm_read_view remains valid only while the generation is the same as right after the call
+*
+* @param    none
+* 
+* @return   the current generation
+*/
+uint32_t nvm_get_generation(void);
+
 /**
 * @brief    Get error status of the NVManager
 *
@@ -106,6 +558,9 @@ bool nvm_read(const NvmBlocksId_t bIdx, uint8_t* data, uint16_t *size);
 * @return   true if there is an error detected. Otherwise - false
 */
 bool nvm_get_error(void);
-   
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* __NVM_H_ */
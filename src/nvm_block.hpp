@@ -0,0 +1,108 @@
+/*
+ * nvm_block.hpp
+ *
+ *  Author: Martin Patarinski
+ *  Copyright: Open source. Further copyright shall be approved by the author
+ *  Description:
+ *   Typed C++17 interface of the NVManager. A logical block is bound to a trivially copyable type at compile time,
+ *   so its payload is read and written in place without a copy into a byte buffer and a size, which differs from
+ *   the configuration, is a compile error. The layout of the records is available as a constexpr table, which is
+ *   expanded from NVM_BLOCK_LIST
+ */
+
+#ifndef __NVM_BLOCK_HPP_
+#define __NVM_BLOCK_HPP_
+
+/**********************************
+* Inclusions
+***********************************/
+#include <cstddef>
+#include <type_traits>
+
+#include "nvm.h"
+
+namespace nvm
+{
+
+/* Layout of the records of a logical block into the flash */
+struct BlockInfo
+{
+    uint16_t pattern; /* ID pattern of the records */
+    uint32_t size; /* size of the data */
+    uint32_t dataOffset; /* offset of the data from the beginning of the record */
+    uint32_t crcOffset; /* offset of the checksum from the beginning of the record */
+    uint32_t recordSize; /* header, data and checksum */
+};
+
+#define NVM_BLOCK_INFO(name, pattern, size)   { (pattern), (size), BLOCK_HEADER_SIZE, BLOCK_HEADER_SIZE + (size), BLOCK_HEADER_SIZE + (size) + NVM_CRC_LEN },
+
+/* The layout of all logical blocks in the order of NvmBlocksId_t */
+inline constexpr BlockInfo BlockTable[] = { NVM_BLOCK_LIST(NVM_BLOCK_INFO) };
+
+#undef NVM_BLOCK_INFO
+
+static_assert(sizeof(BlockTable) / sizeof(BlockTable[0]) == eNvmBlockCount, "NVM_BLOCK_LIST has to contain one entry per logical block");
+
+/**
+* @brief    A logical block with the payload type T. The size of T has to be the size of the block, because the NVManager
+*           reads and writes always the whole block
+*
+* @param    Id : index of the logical block
+*           T : trivially copyable type of the payload, i.e. a packed structure
+*/
+template <NvmBlocksId_t Id, typename T>
+class NvmBlock
+{
+    static_assert(Id < NVM_USER_BLOCK_COUNT, "the block is written only by the NVManager");
+    static_assert(std::is_trivially_copyable_v<T>, "the payload is copied bytewise from and to the flash");
+    static_assert(sizeof(T) == BlockTable[Id].size, "the size of the payload differs from the size of the block");
+
+public:
+    static constexpr NvmBlocksId_t id = Id;
+    static constexpr BlockInfo info = BlockTable[Id];
+
+    /**
+    * @brief    Read the latest instance of the block into the payload
+    *
+    * @param    [out]value : payload
+    *
+    * @return   true if the data is read correctly. Otherwise - false
+    */
+    static bool read(T& value) noexcept
+    {
+        uint16_t size = 0;
+
+        return nvm_read(Id, reinterpret_cast<uint8_t*>(&value), &size);
+    }
+
+    /**
+    * @brief    Write the payload as a new instance of the block. With NVM_USE_WEAR_BUDGET the write of a throttleable block
+    *           can be deferred, then a copy of the payload is programmed later
+    *
+    * @param    [in]value : payload
+    *
+    * @return   true if the data is written or deferred. Otherwise - false
+    */
+    static bool write(const T& value) noexcept
+    {
+        return nvm_write(Id, reinterpret_cast<const uint8_t*>(&value), static_cast<uint16_t>(sizeof(T)));
+    }
+
+#ifdef NVM_USE_EMERGENCY_FLUSH
+    /**
+    * @brief    Mark the payload as changed, so it is saved by nvm_emergency_flush. The payload has to stay valid until it is written
+    *
+    * @param    [in]value : payload
+    *
+    * @return   true if the block is marked. Otherwise - false
+    */
+    static bool setDirty(const T& value) noexcept
+    {
+        return nvm_set_dirty(Id, reinterpret_cast<const uint8_t*>(&value));
+    }
+#endif
+};
+
+} /* namespace nvm */
+
+#endif /* __NVM_BLOCK_HPP_ */
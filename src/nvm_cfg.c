@@ -19,27 +19,103 @@
 
 /* A descriptor of all used logical blocks 
  * Every logical block has an ID pattern (2 bytes), size (4 bytes) and info of the pointer where the last copy of the block is located (address and occurence counter)
- * When this descriptor is edited, don't forget to edit also the enumeration NvmBlocksId_t!!!
+ * The names, the patterns and the sizes are configured only by NVM_BLOCK_LIST
  */
+#define NVM_BLOCK_DESCRIPTOR(name, pattern, size)   { (pattern), (size), 0x00000000, 0x0000 },
 BlockDescriptor_t NvmBlocks[eNvmBlockCount] =
 {
-    { 0xCC01, NVM_BLOCK_1_SIZE, 0x00000000, 0x0000 },
-    { 0xCC02, NVM_BLOCK_2_SIZE, 0x00000000, 0x0000 },
-    { 0xCC03, NVM_BLOCK_3_SIZE, 0x00000000, 0x0000 },
-    { 0xAA04, NVM_BLOCK_4_SIZE, 0x00000000, 0x0000 },
-    { 0xAA05, NVM_BLOCK_5_SIZE, 0x00000000, 0x0000 },
-    { 0xAA06, NVM_BLOCK_6_SIZE, 0x00000000, 0x0000 },
-    { 0xAA07, NVM_BLOCK_7_SIZE, 0x00000000, 0x0000 },
-    { 0xAA08, NVM_BLOCK_8_SIZE, 0x00000000, 0x0000 },
-    { 0xAA09, NVM_BLOCK_9_SIZE, 0x00000000, 0x0000 },
-    { 0xAA10, NVM_BLOCK_10_SIZE, 0x00000000, 0x0000 },
-    { 0xAA11, NVM_BLOCK_11_SIZE, 0x00000000, 0x0000 },
-    { 0xAA12, NVM_BLOCK_12_SIZE, 0x00000000, 0x0000 },
-	{ 0xAA13, NVM_BLOCK_13_SIZE, 0x00000000, 0x0000 },
-	{ 0xAA14, NVM_BLOCK_14_SIZE, 0x00000000, 0x0000 },
-	{ 0xAA15, NVM_BLOCK_15_SIZE, 0x00000000, 0x0000 }
+    NVM_BLOCK_LIST(NVM_BLOCK_DESCRIPTOR)
 };
 
+/* Size of the records of every logical block (header, data and checksum) */
+#define NVM_RECORD_SIZE(name, pattern, size)        (BLOCK_HEADER_SIZE + (size) + NVM_CRC_LEN),
+const uint32_t NvmRecordSizes[eNvmBlockCount] =
+{
+    NVM_BLOCK_LIST(NVM_RECORD_SIZE)
+};
+
+/* Hash index of the block patterns. The entries are free of collisions, which is checked below */
+#define NVM_PATTERN_ENTRY(name, pattern, size)      [GET_PATTERN_SLOT(pattern)] = (uint16_t)(name + 1),
+const uint16_t NvmPatternIndex[NVM_PATTERN_INDEX_SIZE] =
+{
+    NVM_BLOCK_LIST(NVM_PATTERN_ENTRY)
+};
+
+/**********************************************************  
+                CONFIGURATION CHECKS
+ *********************************************************/
+/* The checks fail the build with a negative array size or with a duplicate case value */
+#define NVM_CFG_CHECK(name, cond)                   typedef char name[(cond) ? 1 : -1]
+
+/* the hash index has a power of two entries and an entry for every logical block */
+NVM_CFG_CHECK(NvmPatternIndexSizeCheck_t, (0 == (NVM_PATTERN_INDEX_SIZE & (NVM_PATTERN_INDEX_SIZE - 1))) && (eNvmBlockCount <= NVM_PATTERN_INDEX_SIZE));
+
+/* the biggest logical block fits into the data buffers of the user */
+NVM_CFG_CHECK(NvmBlockMaxSizeCheck_t, (NVM_BLOCK_MAX_SIZE - NVM_CRC_LEN) <= MAX_DR_SIZE);
+
+/* the latest instances of all logical blocks fit into one logical page, so the garbage collection can copy them */
+#define NVM_RECORD_SIZE_SUM(name, pattern, size)    + (BLOCK_HEADER_SIZE + (size) + NVM_CRC_LEN)
+NVM_CFG_CHECK(NvmPageFitCheck_t, (0 NVM_BLOCK_LIST(NVM_RECORD_SIZE_SUM)) <= (LOGICAL_PAGE_SIZE - PAGE_HEADER_SIZE));
+
+#ifdef NVM_USE_LARGE_OBJECTS
+/* the large object has exactly NVM_LO_1_CHUNKS chunk blocks */
+NVM_CFG_CHECK(NvmLoChunksCheck_t, (eNvmLo1ChunkLast - eNvmLo1Chunk1 + 1) == NVM_LO_1_CHUNKS);
+#endif
+
+/**
+* @brief    Never called. Its case labels are the patterns and the entries of the hash index of all logical blocks,
+*           so the compiler rejects a duplicate pattern, a pattern of the key-value store or of the erased flash and a collision 
+*           into the hash index. A collision is resolved by another NVM_PATTERN_HASH_SEED (tools/pattern_seed)
+*
+* @param    [in]pattern : any pattern
+*
+* @return   none
+*/
+#define NVM_PATTERN_CASE(name, pattern, size)       case (pattern):
+#define NVM_SLOT_CASE(name, pattern, size)          case GET_PATTERN_SLOT(pattern):
+static inline void _checkPatterns(uint16_t pattern)
+{
+    switch(pattern)
+    {
+        NVM_BLOCK_LIST(NVM_PATTERN_CASE)
+#ifdef NVM_USE_KV_STORE
+        case NVM_KV_PATTERN:
+#endif
+        case 0xFFFF:
+        default:
+            break;
+    }
+
+    switch(GET_PATTERN_SLOT(pattern))
+    {
+        NVM_BLOCK_LIST(NVM_SLOT_CASE)
+        default:
+            break;
+    }
+}
+
+#ifdef NVM_USE_LARGE_OBJECTS
+/* A descriptor of all large objects 
+ * Every large object has an index block, a sequence of NVM_LO_n_CHUNKS chunk blocks and a maximal size
+ */
+const LargeObjectDescriptor_t NvmLargeObjects[eNvmLoCount] =
+{
+    { eNvmLo1Index, eNvmLo1Chunk1, NVM_LO_1_SIZE }
+};
+#endif
+
+#ifdef NVM_USE_WEAR_BUDGET
+/* Coalescing windows of the logical blocks in seconds. A throttleable block is programmed at most once per window, the writes 
+ * in between are deferred and only the latest data is programmed. The windows are stretched, when the NVM area wears faster than its budget.
+ * A critical block (0) bypasses the throttle
+ */
+const uint16_t NvmWriteWindows[eNvmBlockCount] =
+{
+    [eNvmBlock8]  = 60,  //Keypad dose
+    [eNvmBlock10] = 300, //Services
+};
+#endif
+
 #ifdef NVM_USE_DEFAULTS
 uint8_t nvmDefaults[DEFAULTS_SIZE] = 
 {
@@ -52,9 +52,11 @@
 #define MAX_DR_SIZE 		        0x200
 
 #define NVM_MANAGER_START_ADDR      0x00002000
-#define NVM_MANAGER_END_ADDR        0x00004000
+#define NVM_MANAGER_END_ADDR        0x00006000
 
 #define FLASH_SECTOR_SIZE           0x1000
+/* The logical page is the unit of the garbage collection. It shall be a multiple of FLASH_SECTOR_SIZE and all live NVM blocks have to fit into one logical page */
+#define LOGICAL_PAGE_SIZE           (2*FLASH_SECTOR_SIZE)
 
 /* Change block patterns, when you change block sizes! */
 #define NVM_BLOCK_1_SIZE            0x13C  //Log
@@ -73,36 +75,173 @@
 #define NVM_BLOCK_14_SIZE           0x04   //Write cycle counter
 #define NVM_BLOCK_15_SIZE           0x40
 
-#define NVM_BLOCK_MAX_SIZE          (NVM_CRC_LEN+NVM_BLOCK_1_SIZE) // max size should be bigger or equal to the size of the biggest NvM block
-
 #define NVM_CRC_LEN                 0x04
 
-#define ram_buffer                  FlsDrv_sector_buffer
-#define RAM_BUFF_SIZE               (MAX_DR_SIZE + PAGE_HEADER_SIZE + DR_HEADER_SIZE)
+#define NVM_BLOCK_IO_COUNT          3 // a logical block is read as header, data and checksum
+#define NVM_BLOCK_WRITE_IO_COUNT    4 // a logical block is written as header, data, padding and checksum
+
+/* Large objects are stored as a sequence of chunk blocks and an index block with the actual size of the object */
+#define NVM_USE_LARGE_OBJECTS
+#define NVM_LO_CHUNK_SIZE           0x100
+#define NVM_LO_INDEX_SIZE           0x04
+#define NVM_LO_1_SIZE               0x1000 //TLS certificate
+#define NVM_LO_1_CHUNKS             ((NVM_LO_1_SIZE + NVM_LO_CHUNK_SIZE - 1)/NVM_LO_CHUNK_SIZE)
+
+/* Runtime key-value store. The values are stored as records with a common pattern and found through a hash index into the RAM, 
+ * which is rebuilt by nvm_init. The live records share the logical page with the logical blocks */
+#define NVM_USE_KV_STORE
+#define NVM_KV_PATTERN              0xEE00 // pattern of the key-value records. It shall not be used by any logical block
+#define NVM_KV_HEADER_SIZE          4      // length of the key, flags and length of the value
+#define NVM_KV_MAX_KEY_SIZE         0x20
+#define NVM_KV_MAX_DATA_SIZE        0x100
+#define NVM_KV_INDEX_SIZE           64     // entries of the hash index. Power of two and bigger than the number of used keys
+#define NVM_KV_WRITE_IO_COUNT       5      // a key-value record is written as header, key-value header, key, value and checksum
+
+/* Last-gasp flush of the dirty blocks on power failure. The records are programmed one after another into a reserved region, 
+ * that is always erased and is outside of the NVM area. They are merged back into the NVM area by nvm_init */
+#define NVM_USE_EMERGENCY_FLUSH
+#define NVM_EMERGENCY_START_ADDR    0x00006000
+#define NVM_EMERGENCY_SIZE          FLASH_SECTOR_SIZE
+#define NVM_EMERGENCY_MAX_RECORDS   8      // maximal number of dirty blocks at a time
+/* timings from the datasheets of the flash and the CRC module, used for the worst-case time of the emergency flush */
+#define FLS_PROGRAM_SETUP_TIME_NS   20000uL
+#define FLS_PROGRAM_TIME_NS_PER_BYTE 2500uL
+#define NVM_CRC_TIME_NS_PER_BYTE    20uL
+/* worst-case time of nvm_emergency_flush: every record is programmed with one operation and all of them fit into the region */
+#define NVM_EMERGENCY_FLUSH_TIME_NS ((NVM_EMERGENCY_MAX_RECORDS*FLS_PROGRAM_SETUP_TIME_NS) + \
+                                     (NVM_EMERGENCY_SIZE*(FLS_PROGRAM_TIME_NS_PER_BYTE + NVM_CRC_TIME_NS_PER_BYTE)))
+
+/* nvm_init_lazy returns after the page with data is located and the records are searched on demand or by nvm_mount_step */
+#define NVM_USE_LAZY_MOUNT
+#define NVM_MOUNT_STEP_RECORDS      16     // records searched by one call of nvm_mount_step
+
+/* Endurance budget of the NVM area. The erases of the logical pages and the operating time (SysTime_getSeconds) are kept into an internal 
+ * logical block. The writes of the throttleable blocks are coalesced (NvmWriteWindows) and the windows are stretched, when the erases 
+ * run ahead of the budget */
+#define NVM_USE_WEAR_BUDGET
+#define NVM_TARGET_LIFETIME_S       315360000uL // 10 years
+#define NVM_RATED_ERASE_CYCLES      100000uL    // erase endurance of a flash sector from the datasheet
+#define NVM_WEAR_MAX_STRETCH        16u         // maximal factor of the coalescing windows
+#define NVM_WEAR_INFO_SIZE          0x08        // erase count and operating time
+/* RAM copies of the deferred writes. The throttleable blocks (NvmWriteWindows) are placed one after another in the order of their index, 
+ * a block, which does not fit any more, is programmed without deferring */
+#define NVM_WEAR_SHADOW_SIZE        (NVM_BLOCK_8_SIZE + NVM_BLOCK_10_SIZE)
+
+/* Runtime counters of the requests, programming, erasing and garbage collection, which are read by nvm_get_stats. 
+ * The mount time is measured with SysTime_getMicroseconds */
+#define NVM_USE_STATS
+
+/* Trace points around the flash operations and the phases of the NVManager. A callback and a clock are registered by nvm_trace_register 
+ * and the latencies are collected into log2 histograms with NVM_TRACE_HIST_BUCKETS buckets per operation */
+#define NVM_USE_TRACE
+#define NVM_TRACE_HIST_BUCKETS      16
+/* Enable on Linux to get the USDT probes nvm:op__begin and nvm:op__end for perf and bpftrace. It requires sys/sdt.h of systemtap */
+//#define NVM_USE_TRACE_USDT
+
+/* Recorder of the calls of nvm_init, nvm_init_lazy, nvm_write and nvm_read. Every call is passed as a compact binary record to the sink 
+ * registered by nvm_record_register, so that the trace can be replayed offline. The timestamps are taken with SysTime_getMicroseconds */
+#define NVM_USE_RECORDER
+
+/* Entries of the hash index of the block patterns, that is used while searching after power-on. Power of two and at least twice the number of logical blocks.
+ * The index is a constant table without collisions (perfect hash), so a pattern is found with one lookup. If the build fails with a duplicate 
+ * case value into nvm_cfg.c, two patterns have the same entry - run tools/pattern_seed and take the seed, which it prints */
+#define NVM_PATTERN_INDEX_SIZE      64
+#define NVM_PATTERN_HASH_SEED       0x9E378261u
+/* entry of a pattern into the hash index of the block patterns (multiplicative hashing) */
+#define GET_PATTERN_SLOT(patt)      ((((uint32_t)(patt)*NVM_PATTERN_HASH_SEED) >> 16) & (NVM_PATTERN_INDEX_SIZE - 1u))
+
+/* Size of the only RAM buffer of the NVManager. All checks, compares and copies of flash data are done chunk by chunk through it, 
+ * so the RAM usage does not depend on the block sizes. Shall be a multiple of 4 */
+#define NVM_CHUNK_SIZE              0x40
+/* Enable if the flash driver supports a HW blank-check command (FlsDrv_blankCheck) */
+//#define NVM_USE_FLS_BLANK_CHECK
+/* Enable if the flash is accessible into the address space (XIP/memory-mapped) and the flash driver provides FlsDrv_getMappedAddress */
+#define NVM_USE_READ_VIEW
+/* Enable if the flash driver supports asynchronous erase with suspend and resume (FlsDrv_eraseStart, FlsDrv_eraseStatus, FlsDrv_eraseSuspend, FlsDrv_eraseResume).
+ * A released logical page is erased sector by sector through nvm_erase_step and the running erase is suspended for every read or write.
+ * The read views require a memory-mapped flash, which is readable during an erase */
+#define NVM_USE_BACKGROUND_ERASE
+
+/* The schema of the logical blocks as X(name, pattern, size). NvmBlocksId_t, NvmBlocks, NvmRecordSizes, the hash index of the 
+ * patterns, NVM_BLOCK_MAX_SIZE and the constexpr table of the C++ interface (nvm_block.hpp) are expanded from these lists and 
+ * nvm_cfg.c checks them at compile time. Change block patterns, when you change block sizes! */
+#define NVM_USER_BLOCK_LIST(X) \
+    X(eNvmBlock1,  0xCC01, NVM_BLOCK_1_SIZE)  /* Log */ \
+    X(eNvmBlock2,  0xCC02, NVM_BLOCK_2_SIZE)  /* power on data */ \
+    X(eNvmBlock3,  0xCC03, NVM_BLOCK_3_SIZE)  /* Keypad counter GR1 */ \
+    X(eNvmBlock4,  0xAA04, NVM_BLOCK_4_SIZE)  /* Keypad counter GR2 */ \
+    X(eNvmBlock5,  0xAA05, NVM_BLOCK_5_SIZE)  /* Keypad counter GR3 */ \
+    X(eNvmBlock6,  0xAA06, NVM_BLOCK_6_SIZE)  /* Keypad counter Tea */ \
+    X(eNvmBlock7,  0xAA07, NVM_BLOCK_7_SIZE)  /* Temperature */ \
+    X(eNvmBlock8,  0xAA08, NVM_BLOCK_8_SIZE)  /* Keypad dose GR1 GR3 GR3 */ \
+    X(eNvmBlock9,  0xAA09, NVM_BLOCK_9_SIZE)  /* Keypad dose tea */ \
+    X(eNvmBlock10, 0xAA10, NVM_BLOCK_10_SIZE) /* Services */ \
+    X(eNvmBlock11, 0xAA11, NVM_BLOCK_11_SIZE) /* Alarms */ \
+    X(eNvmBlock12, 0xAA12, NVM_BLOCK_12_SIZE) /* FLag - first time connect to mqtt */ \
+    X(eNvmBlock13, 0xAA13, NVM_BLOCK_13_SIZE) /* NTP server - string */ \
+    X(eNvmBlock14, 0xAA14, NVM_BLOCK_14_SIZE) /* NTP server port - string */ \
+    X(eNvmBlock15, 0xAA15, NVM_BLOCK_15_SIZE) /* Latest AWS job id which is used for FOTA update - string */
+
+#ifdef NVM_USE_LARGE_OBJECTS
+/* the index block (size of the object) and the NVM_LO_1_CHUNKS chunk blocks of the TLS certificate */
+#define NVM_LO_BLOCK_LIST(X) \
+    X(eNvmLo1Index,   0xBB00, NVM_LO_INDEX_SIZE) \
+    X(eNvmLo1Chunk1,  0xBB01, NVM_LO_CHUNK_SIZE) X(eNvmLo1Chunk2,  0xBB02, NVM_LO_CHUNK_SIZE) \
+    X(eNvmLo1Chunk3,  0xBB03, NVM_LO_CHUNK_SIZE) X(eNvmLo1Chunk4,  0xBB04, NVM_LO_CHUNK_SIZE) \
+    X(eNvmLo1Chunk5,  0xBB05, NVM_LO_CHUNK_SIZE) X(eNvmLo1Chunk6,  0xBB06, NVM_LO_CHUNK_SIZE) \
+    X(eNvmLo1Chunk7,  0xBB07, NVM_LO_CHUNK_SIZE) X(eNvmLo1Chunk8,  0xBB08, NVM_LO_CHUNK_SIZE) \
+    X(eNvmLo1Chunk9,  0xBB09, NVM_LO_CHUNK_SIZE) X(eNvmLo1Chunk10, 0xBB0A, NVM_LO_CHUNK_SIZE) \
+    X(eNvmLo1Chunk11, 0xBB0B, NVM_LO_CHUNK_SIZE) X(eNvmLo1Chunk12, 0xBB0C, NVM_LO_CHUNK_SIZE) \
+    X(eNvmLo1Chunk13, 0xBB0D, NVM_LO_CHUNK_SIZE) X(eNvmLo1Chunk14, 0xBB0E, NVM_LO_CHUNK_SIZE) \
+    X(eNvmLo1Chunk15, 0xBB0F, NVM_LO_CHUNK_SIZE) X(eNvmLo1Chunk16, 0xBB10, NVM_LO_CHUNK_SIZE)
+#define eNvmLo1ChunkLast            eNvmLo1Chunk16 // it is checked against NVM_LO_1_CHUNKS
+#else
+#define NVM_LO_BLOCK_LIST(X)
+#endif
+
+#ifdef NVM_USE_WEAR_BUDGET
+/* erase count and operating time of the NVM area - written only by the NVManager */
+#define NVM_WEAR_BLOCK_LIST(X) \
+    X(eNvmWearInfo, 0xDD00, NVM_WEAR_INFO_SIZE)
+#else
+#define NVM_WEAR_BLOCK_LIST(X)
+#endif
+
+#define NVM_BLOCK_LIST(X)           NVM_USER_BLOCK_LIST(X) NVM_LO_BLOCK_LIST(X) NVM_WEAR_BLOCK_LIST(X)
 
 /**********************************************************  
                     INTERFACE TYPES
  *********************************************************/
+#define NVM_BLOCK_ID(name, pattern, size)       name,
 typedef enum sNvmBlocksId
 {
-	eNvmBlock1,  
-	eNvmBlock2,     //power on data
-	eNvmBlock3,     //Keypad counter GR1
-    eNvmBlock4,     //Keypad counter GR2
-    eNvmBlock5,     //Keypad counter GR3
-    eNvmBlock6,     //Keypad counter Tea
-    eNvmBlock7,     //Temperature
-    eNvmBlock8,     //Keypad dose GR1 GR3 GR3
-    eNvmBlock9,     //Keypad dose tea
-    eNvmBlock10,    //Services
-    eNvmBlock11,    //Alarms
-    eNvmBlock12,    //FLag - first time connect to mqtt
-	eNvmBlock13,    //NTP server - string
-	eNvmBlock14,    //NTP server port - string
-	eNvmBlock15,	//Latest AWS job id which is used for FOTA update - string
+    NVM_BLOCK_LIST(NVM_BLOCK_ID)
 	eNvmBlockCount
 } NvmBlocksId_t;
 
+/* A union of the data of all logical blocks, so its size is the size of the biggest one */
+#define NVM_BLOCK_DATA(name, pattern, size)     uint8_t name[size];
+typedef union
+{
+    NVM_BLOCK_LIST(NVM_BLOCK_DATA)
+} NvmBlockData_t;
+
+#define NVM_BLOCK_MAX_SIZE          (NVM_CRC_LEN+sizeof(NvmBlockData_t)) // the biggest NvM block and its checksum
+
+#ifdef NVM_USE_WEAR_BUDGET
+#define NVM_USER_BLOCK_COUNT        eNvmWearInfo // the blocks after it are written only by the NVManager
+#else
+#define NVM_USER_BLOCK_COUNT        eNvmBlockCount
+#endif
+
+#ifdef NVM_USE_LARGE_OBJECTS
+typedef enum sNvmLargeObjectsId
+{
+	eNvmLo1,        //TLS certificate
+	eNvmLoCount
+} NvmLargeObjectsId_t;
+#endif
+
 /* A type for the descriptor of all used logical blocks */
 typedef struct
 {
@@ -112,19 +251,53 @@ typedef struct
     uint16_t occurrenceCntr; /* occurence counter of the instance */
 } BlockDescriptor_t;
 
+#ifdef NVM_USE_LARGE_OBJECTS
+/* A type for the descriptor of the large objects */
+typedef struct
+{
+    const NvmBlocksId_t indexBlock; /* logical block with the actual size of the object */
+    const NvmBlocksId_t firstChunk; /* first logical block with data of the object. The rest of the chunks follow it */
+    const uint16_t maxSize; /* maximal size of the object */
+} LargeObjectDescriptor_t;
+#endif
+
 /**********************************************************  
                     GLOBAL VARIABLES
  *********************************************************/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* A descriptor of all used logical blocks 
  * Every logical block has an ID pattern (2 bytes), size (4 bytes) and info of the pointer where the last copy of the block is located (address and number of occurencies)
- * When this descriptor is edited, don't forget to edit also the enumeration NvmBlocksId_t!!!
+ * It is expanded from NVM_BLOCK_LIST in the order of NvmBlocksId_t
  */
 extern BlockDescriptor_t NvmBlocks[eNvmBlockCount];
 
+/* Size of the records of every logical block (header, data and checksum) */
+extern const uint32_t NvmRecordSizes[eNvmBlockCount];
+
+/* Hash index of the block patterns. The entry GET_PATTERN_SLOT of a pattern contains the index of its logical block + 1, 0 means an unused entry */
+extern const uint16_t NvmPatternIndex[NVM_PATTERN_INDEX_SIZE];
+
+#ifdef NVM_USE_LARGE_OBJECTS
+/* A descriptor of all large objects. The index and chunk blocks have to be configured also in NvmBlocks */
+extern const LargeObjectDescriptor_t NvmLargeObjects[eNvmLoCount];
+#endif
+
+#ifdef NVM_USE_WEAR_BUDGET
+/* Coalescing windows of the logical blocks in seconds. 0 means a critical block, which is always programmed immediately */
+extern const uint16_t NvmWriteWindows[eNvmBlockCount];
+#endif
+
 #ifdef NVM_USE_DEFAULTS
   #define DEFAULTS_SIZE               (NVM_BLOCK_1_SIZE+BLOCK_HEADER_SIZE)
   #define DEFAULTS_START_ADDRESS      (NVM_MANAGER_START_ADDR+PAGE_HEADER_SIZE)
   extern uint8_t nvmDefaults[DEFAULTS_SIZE];
 #endif
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* __NVM_CFG_H_ */
@@ -10,30 +10,90 @@
  *  The Flash driver APIs would have to be replaced, wrapped or adapted, if the NVManager is integrated into an embedded project.
  */
 
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L /* mmap, ftruncate */
+#endif
+
 #include "stubs.h"
+#include <time.h>
+
+#ifdef FLS_SIMU_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* This is a buffer into the RAM of the PC in order to simulate a FLASH of an embedded device. Only for Unit test purpose */
+static uint8_t FlsSimuRam[TOTAL_FLASH_SIZE];
+
+/* The content of the simulated flash - the RAM buffer or the image file opened by FlsSimu_open */
+uint8_t* FlashSimu = FlsSimuRam;
 
-/* This is a large buffer into the RAM of the PC in order to simulate a FLASH of an embedded device. Only for Unit test purpose */
-uint8_t FlashSimu[0x800][BUFF_FLASH_PAGE_SIZE]; /* 8MB */
+/* The opened image file. Without a memory mapping it is loaded into the RAM buffer and saved by FlsSimu_close */
+static const char* FlsSimuImagePath = NULL;
 
-/* This is a significantly big buffer, that would be located in the RAM of the embedded device. It is required by the NVManager in order to operate
-   It has to be configured according to the specification of the used FLASH memoy and the used Flash driver. 
-   The macro BUFF_FLASH_PAGE_SIZE shall be set with the minimum erasable sector in the FLASH memory */
-uint8_t sector_buffer[BUFF_FLASH_PAGE_SIZE] = { 0 };
+/* Latency model and counters of the simulated flash. The modelled time is also added to SysTime_getMicroseconds, 
+   so the durations measured by the NVManager reflect the flash and not the RAM of the PC */
+static FlsSimu_Timing_t FlsSimuTiming = { FLS_SIMU_READ_SETUP_NS, FLS_SIMU_READ_NS_PER_BYTE, FLS_SIMU_PROGRAM_SETUP_NS, 
+                                          FLS_SIMU_PROGRAM_NS_PER_BYTE, FLS_SIMU_ERASE_SECTOR_NS };
+static FlsSimu_Stats_t FlsSimuStats;
+static uint32_t FlsSimuBusyNs = 0;
+static uint32_t FlsSimuClockUs = 0;
 
 /* A table for CRC calculation. Only for Unit test. Assuming there would be a library or HW module for CRC calculation on the Embedded project */
 uint32_t Crc32_table[256];
 
+/* State of the asynchronous erase. The sector is erased after FLS_SIMU_ERASE_POLLS polls of the status, so that the scheduling 
+   of the NVManager can be tested */
+static FlsDrv_EraseState_t FlsSimuEraseState = FLS_ERASE_IDLE;
+static uint32_t FlsSimuEraseAddr = 0;
+static uint32_t FlsSimuErasePolls = 0;
+
+/* Power cut of the simulated device. The power is cut after FlsSimuPowerBudget more programmed bytes or at a byte of a 
+   flash operation scheduled by FlsSimu_setPowerCutAt, then the flash is neither programmed nor erased until the power is on again */
+static uint32_t FlsSimuPowerBudget = FLS_SIMU_POWER_ON;
+static bool FlsSimuPowerOff = false;
+static FlsSimu_PowerCut_t FlsSimuCutAt;
+static bool FlsSimuCutAtArmed = false;
+static uint8_t FlsSimuTornBits = 0;
+
+/* Simulated system time in seconds. It is advanced by the unit test instead of a timer of the embedded device */
+uint32_t SysTimeSimu = 0;
+
 static void generate_table(uint32_t table[256]);
 static uint32_t update(uint32_t table[256], uint32_t initial, const void* buf, size_t len);
+static bool isAccessible(uint32_t addr, uint32_t len);
+static bool isInRange(uint32_t addr, uint32_t len);
+static bool isProgramAllowed(uint32_t addr, uint32_t len);
+static uint32_t ioVecLength(const FlsDrv_IoVec_t* iov, uint32_t iovCnt);
+static uint32_t consumePower(uint32_t len, uint8_t kind);
+static void cutPower(void);
+static void programData(uint32_t addr, const uint8_t* src, uint32_t len);
+static void tearProgram(uint32_t addr, uint8_t value);
+static void accountRead(uint32_t len);
+static void accountProgram(uint32_t addr, uint32_t len);
+static void addBusyTime(uint32_t ns);
+static bool eraseSector(uint32_t addr);
 
 /**********************************************************  
                     INTERFACE FUNCTIONS
  *********************************************************/
-/* A dummy implementation of the initialization of the underalying flash driver */
+/* A dummy implementation of the initialization of the underalying flash driver. The flash is erased, unless an image 
+   is opened by FlsSimu_open */
 void FlsDrv_Init()
 {
-	/* set the FLASH as erased */
-	memset(FlashSimu, 0xFF, 0x800*BUFF_FLASH_PAGE_SIZE);
+	if(NULL == FlsSimuImagePath)
+	{
+		/* set the FLASH as erased */
+		memset(FlashSimu, 0xFF, TOTAL_FLASH_SIZE);
+	}
+	FlsSimuEraseState = FLS_ERASE_IDLE;
+	FlsSimuPowerBudget = FLS_SIMU_POWER_ON;
+	FlsSimuPowerOff = false;
+	FlsSimuCutAtArmed = false;
+	FlsSimuTornBits = 0;
+	memset(&FlsSimuStats, 0, sizeof(FlsSimuStats));
 
 	/* initialize the CRC table so that it is ready for calculation */
  	generate_table(Crc32_table);
@@ -42,43 +102,377 @@ void FlsDrv_Init()
 /* A dummy implementation of the reading function of the flash driver */
 bool FlsDrv_readBytes( uint32_t addr, uint8_t* dest, uint32_t len)
 {
-	uint32_t page = (addr & FLASH_PAGE_MASK1) / BUFF_FLASH_PAGE_SIZE;
-	uint32_t offset = addr & FLASH_PAGE_MASK2;
+	if( (false == isInRange(addr, len)) || (false == isAccessible(addr, len)) )
+	{
+		return false;
+	}
 
-	memcpy(dest, &FlashSimu[page][offset], len);
+	memcpy(dest, &FlashSimu[addr], len);
+	accountRead(len);
 
 	return true;
 }
 
-/* A dummy implementation of the erasing function of the flash driver, that erases one physical block */
+/* A dummy implementation of the erasing function of the flash driver, that erases one physical block. The address has to be 
+   aligned to the block */
 bool FlsDrv_eraseBlock4K(uint32_t addr)
 {
-	uint32_t page = (addr & FLASH_PAGE_MASK1) / BUFF_FLASH_PAGE_SIZE;
+	/* the blocking erase is not possible while an asynchronous one is not finished */
+	if( (true == FlsSimuPowerOff) || (FLS_ERASE_IDLE != FlsSimuEraseState) || (0 != (addr & FLASH_PAGE_MASK2)) || (false == isInRange(addr, BUFF_FLASH_PAGE_SIZE)) )
+	{
+		return false;
+	}
 
-	memset(&FlashSimu[page][0], 0xFF, BUFF_FLASH_PAGE_SIZE);
+	addBusyTime(FlsSimuTiming.eraseSectorNs);
 
-	return true;
+	return eraseSector(addr);
 }
 
-/* A dummy implementation of the writing function of the flash driver */
+/* A dummy implementation of the writing function of the flash driver. Like a NOR flash, the programming can only clear bits, 
+   so the result is the AND of the old and the new data */
 bool FlsDrv_writeBytes( uint32_t addr, uint8_t* src, uint32_t len)
 {
-	uint32_t page = (addr & FLASH_PAGE_MASK1) / BUFF_FLASH_PAGE_SIZE;
-	uint32_t offset = addr & FLASH_PAGE_MASK2;
+	uint32_t programLen;
+
+	if(false == isProgramAllowed(addr, len))
+	{
+		return false;
+	}
+
+	/* a power cut stops the write after the last byte of the budget, the next byte may be partially programmed */
+	programLen = consumePower(len, FLS_SIMU_CUT_PROGRAM);
+	programData(addr, src, programLen);
+	if(programLen < len)
+	{
+		tearProgram(addr + programLen, src[programLen]);
+	}
+	accountProgram(addr, programLen);
+
+	return (programLen == len);
+}
+
+/* A dummy implementation of the scatter reading function of the flash driver. The consecutive flash data is distributed into several buffers 
+   with one read operation */
+bool FlsDrv_readv( uint32_t addr, const FlsDrv_IoVec_t* iov, uint32_t iovCnt)
+{
+	uint32_t len = ioVecLength(iov, iovCnt);
+	uint32_t idx;
 
-	memcpy(&FlashSimu[page][offset], src, len);
+	if( (false == isInRange(addr, len)) || (false == isAccessible(addr, len)) )
+	{
+		return false;
+	}
+
+	for(idx = 0; idx < iovCnt; idx++)
+	{
+		/* empty buffers are skipped */
+		if(iov[idx].len > 0)
+		{
+			memcpy(iov[idx].buf, &FlashSimu[addr], iov[idx].len);
+			addr += iov[idx].len;
+		}
+	}
+	accountRead(len);
 
 	return true;
 }
 
+/* A dummy implementation of the gather writing function of the flash driver. Several buffers are written as consecutive flash data 
+   with the program operations of one write */
+bool FlsDrv_writev( uint32_t addr, const FlsDrv_IoVec_t* iov, uint32_t iovCnt)
+{
+	uint32_t len = ioVecLength(iov, iovCnt);
+	uint32_t programLen;
+	uint32_t bufLen;
+	uint32_t startAddr = addr;
+	uint32_t idx;
+
+	if(false == isProgramAllowed(addr, len))
+	{
+		return false;
+	}
+
+	/* a power cut stops the write after the last byte of the budget, the next byte may be partially programmed */
+	programLen = consumePower(len, FLS_SIMU_CUT_PROGRAM);
+
+	for(idx = 0; (idx < iovCnt) && (addr <= (startAddr + programLen)); idx++)
+	{
+		bufLen = ((startAddr + programLen - addr) < iov[idx].len) ? (startAddr + programLen - addr) : iov[idx].len;
+
+		/* empty buffers are skipped */
+		if(bufLen > 0)
+		{
+			programData(addr, iov[idx].buf, bufLen);
+			addr += bufLen;
+		}
+
+		if( (addr == (startAddr + programLen)) && (bufLen < iov[idx].len) )
+		{
+			tearProgram(addr, iov[idx].buf[bufLen]);
+			break;
+		}
+	}
+	accountProgram(startAddr, programLen);
+
+	return (programLen == len);
+}
+
 /* A dummy implementation of the erasing function of the flash driver, that erases the whole data FLASH (memory area that is used by the NVManager) */
 bool FlsDrv_chipErase(void)
 {
-	memset(FlashSimu, 0xFF, sizeof(FlashSimu));
+	uint32_t addr;
+
+	if( (true == FlsSimuPowerOff) || (FLS_ERASE_IDLE != FlsSimuEraseState) )
+	{
+		return false;
+	}
+
+	for(addr = 0; addr < TOTAL_FLASH_SIZE; addr += BUFF_FLASH_PAGE_SIZE)
+	{
+		addBusyTime(FlsSimuTiming.eraseSectorNs);
+		if(false == eraseSector(addr))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* A dummy implementation of the blank-check command of the flash driver. Returns true if all bytes in the range are erased */
+bool FlsDrv_blankCheck(uint32_t addr, uint32_t len)
+{
+	const uint8_t* pByte = &FlashSimu[addr];
+	uint32_t idx;
+
+	if( (false == isInRange(addr, len)) || (false == isAccessible(addr, len)) )
+	{
+		return false;
+	}
+
+	accountRead(len);
+
+	for(idx = 0; idx < len; idx++)
+	{
+		if(0xFF != pByte[idx])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* A dummy implementation of the memory mapping of the flash. Returns the address of the flash location into the address space or NULL if it is not mapped */
+const uint8_t* FlsDrv_getMappedAddress(uint32_t addr)
+{
+	if(addr >= TOTAL_FLASH_SIZE)
+	{
+		return NULL;
+	}
+
+	return &FlashSimu[addr];
+}
+
+/* A dummy implementation of the asynchronous erasing function of the flash driver. Starts the erasing of one physical block and returns immediately */
+bool FlsDrv_eraseStart(uint32_t addr)
+{
+	if( (true == FlsSimuPowerOff) || (FLS_ERASE_IDLE != FlsSimuEraseState) || (0 != (addr & FLASH_PAGE_MASK2)) || (false == isInRange(addr, BUFF_FLASH_PAGE_SIZE)) )
+	{
+		return false;
+	}
+
+	FlsSimuEraseState = FLS_ERASE_BUSY;
+	FlsSimuEraseAddr = addr;
+	FlsSimuErasePolls = FLS_SIMU_ERASE_POLLS;
+
+	return true;
+}
+
+/* A dummy implementation of the status polling of the asynchronous erase. The erase makes progress only while it is not suspended */
+FlsDrv_EraseState_t FlsDrv_eraseStatus(void)
+{
+	if(FLS_ERASE_BUSY == FlsSimuEraseState)
+	{
+		FlsSimuErasePolls--;
+
+		/* the power cut of a scheduled operation happens at the last poll */
+		if(0 == FlsSimuErasePolls)
+		{
+			FlsSimuEraseState = FLS_ERASE_IDLE;
+			(void)eraseSector(FlsSimuEraseAddr);
+		}
+	}
+
+	return FlsSimuEraseState;
+}
+
+/* A dummy implementation of the erase suspend command. Returns false if there is no running erase */
+bool FlsDrv_eraseSuspend(void)
+{
+	if(FLS_ERASE_BUSY != FlsSimuEraseState)
+	{
+		return false;
+	}
+
+	FlsSimuEraseState = FLS_ERASE_SUSPENDED;
+
+	return true;
+}
+
+/* A dummy implementation of the erase resume command. Returns false if there is no suspended erase */
+bool FlsDrv_eraseResume(void)
+{
+	if(FLS_ERASE_SUSPENDED != FlsSimuEraseState)
+	{
+		return false;
+	}
+
+	FlsSimuEraseState = FLS_ERASE_BUSY;
+
+	return true;
+}
+
+/* Open an image file as the content of the simulated flash, so the content is kept between the runs. A missing or shorter file 
+   is extended with erased flash. With FLS_SIMU_USE_MMAP the file is mapped into the memory, otherwise it is loaded into the RAM 
+   and saved by FlsSimu_close. The path has to stay valid until FlsSimu_close. Call it before FlsDrv_Init */
+bool FlsSimu_open(const char* path)
+{
+	uint32_t size = 0;
+#ifdef FLS_SIMU_USE_MMAP
+	struct stat fileStat;
+	void* image;
+	int fd;
+#else
+	FILE* fp;
+#endif
+
+	if( (NULL == path) || (false == FlsSimu_close()) )
+	{
+		return false;
+	}
+
+#ifdef FLS_SIMU_USE_MMAP
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if(fd < 0)
+	{
+		return false;
+	}
+
+	if( (0 != fstat(fd, &fileStat)) || ((fileStat.st_size < TOTAL_FLASH_SIZE) && (0 != ftruncate(fd, TOTAL_FLASH_SIZE))) )
+	{
+		close(fd);
+		return false;
+	}
+	size = (fileStat.st_size < TOTAL_FLASH_SIZE) ? (uint32_t)fileStat.st_size : TOTAL_FLASH_SIZE;
+
+	/* the mapping stays valid after the file is closed */
+	image = mmap(NULL, TOTAL_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(MAP_FAILED == image)
+	{
+		return false;
+	}
+
+	FlashSimu = (uint8_t*)image;
+#else
+	fp = fopen(path, "rb");
+	if(NULL != fp)
+	{
+		size = (uint32_t)fread(FlsSimuRam, 1, TOTAL_FLASH_SIZE, fp);
+		fclose(fp);
+	}
+#endif
+
+	memset(&FlashSimu[size], 0xFF, TOTAL_FLASH_SIZE - size);
+	FlsSimuImagePath = path;
 
 	return true;
 }
 
+/* Close the image file of the simulated flash. The simulation continues with the same content into the RAM */
+bool FlsSimu_close(void)
+{
+	bool result = true;
+#ifndef FLS_SIMU_USE_MMAP
+	FILE* fp;
+#endif
+
+	if(NULL == FlsSimuImagePath)
+	{
+		return true;
+	}
+
+#ifdef FLS_SIMU_USE_MMAP
+	memcpy(FlsSimuRam, FlashSimu, TOTAL_FLASH_SIZE);
+	result &= (0 == msync(FlashSimu, TOTAL_FLASH_SIZE, MS_SYNC));
+	result &= (0 == munmap(FlashSimu, TOTAL_FLASH_SIZE));
+	FlashSimu = FlsSimuRam;
+#else
+	fp = fopen(FlsSimuImagePath, "wb");
+	result = (NULL != fp) && (TOTAL_FLASH_SIZE == fwrite(FlsSimuRam, 1, TOTAL_FLASH_SIZE, fp));
+	if(NULL != fp)
+	{
+		result &= (0 == fclose(fp));
+	}
+#endif
+
+	FlsSimuImagePath = NULL;
+
+	return result;
+}
+
+/* Set the latency model of the simulated flash. NULL restores the default timings, a model with zeros disables it */
+void FlsSimu_setTiming(const FlsSimu_Timing_t* timing)
+{
+	const FlsSimu_Timing_t defaultTiming = { FLS_SIMU_READ_SETUP_NS, FLS_SIMU_READ_NS_PER_BYTE, FLS_SIMU_PROGRAM_SETUP_NS, 
+	                                         FLS_SIMU_PROGRAM_NS_PER_BYTE, FLS_SIMU_ERASE_SECTOR_NS };
+
+	FlsSimuTiming = (NULL != timing) ? *timing : defaultTiming;
+}
+
+/* Get the counters of the simulated flash since FlsDrv_Init */
+void FlsSimu_getStats(FlsSimu_Stats_t* stats)
+{
+	if(NULL != stats)
+	{
+		*stats = FlsSimuStats;
+	}
+}
+
+/* Schedule a power cut after the given number of programmed bytes, so the write with the last byte is torn. FLS_SIMU_POWER_ON 
+   switches the power on again after a cut - the content of the flash is kept and an erase, which was running, is aborted */
+void FlsSimu_setPowerCut(uint32_t programBytes)
+{
+	if(FLS_SIMU_POWER_ON == programBytes)
+	{
+		FlsSimuEraseState = FLS_ERASE_IDLE;
+	}
+
+	FlsSimuPowerBudget = programBytes;
+	FlsSimuPowerOff = false;
+	FlsSimuCutAtArmed = false;
+	FlsSimuTornBits = 0;
+}
+
+/* Schedule a power cut at a byte of a later program or erase operation. The operations of the given kinds are counted from the 
+   next one: every write, blocking erase, sector of a chip erase and completed asynchronous erase is one operation. The bytes before the offset 
+   are programmed or erased, the torn bits of the byte at the offset are already changed and the rest keeps the old content. 
+   No power cut happens if the operation is shorter than the offset. NULL cancels the scheduled cut */
+void FlsSimu_setPowerCutAt(const FlsSimu_PowerCut_t* cut)
+{
+	FlsSimuPowerBudget = FLS_SIMU_POWER_ON;
+	FlsSimuPowerOff = false;
+	FlsSimuCutAtArmed = (NULL != cut);
+	FlsSimuTornBits = 0;
+
+	if(NULL != cut)
+	{
+		FlsSimuCutAt = *cut;
+		FlsSimuTornBits = cut->tornBits;
+	}
+}
+
 /* A dummy implementation of the CRC32 calculation function */
 uint32_t CRC32_Calculate(uint8_t* buffer, uint32_t bufferSize)
 {
@@ -89,9 +483,207 @@ uint32_t CRC32_Calculate(uint8_t* buffer, uint32_t bufferSize)
 	return crc;
 }
 
+/* A dummy implementation of the CRC32 calculation function, that continues the calculation of a previous CRC. 
+   Start with crc = 0 for the first buffer */
+uint32_t CRC32_Update(uint32_t crc, uint8_t* buffer, uint32_t bufferSize)
+{
+	return update(Crc32_table, crc, buffer, bufferSize);
+}
+
+/* A dummy implementation of the monotonic system time since power-on */
+uint32_t SysTime_getSeconds(void)
+{
+	return SysTimeSimu;
+}
+
+/* A dummy implementation of the free-running microsecond timer. The processor time of the PC and the modelled time of the flash 
+   operations are used, so the measured durations correspond to the flash of the embedded device */
+uint32_t SysTime_getMicroseconds(void)
+{
+	return (uint32_t)(((double)clock() * 1000000.0) / CLOCKS_PER_SEC) + FlsSimuClockUs;
+}
+
 /**********************************************************  
                     LOCAL FUNCTIONS
  *********************************************************/
+/* A helper function to check whether a range of the flash can be accessed. Nothing is accessible during a running erase 
+   and the sector of a suspended erase has undefined content */
+static bool isAccessible(uint32_t addr, uint32_t len)
+{
+	if(FLS_ERASE_BUSY == FlsSimuEraseState)
+	{
+		return false;
+	}
+
+	if( (FLS_ERASE_SUSPENDED == FlsSimuEraseState) && (addr < (FlsSimuEraseAddr + BUFF_FLASH_PAGE_SIZE)) && ((addr + len) > FlsSimuEraseAddr) )
+	{
+		return false;
+	}
+
+	return true;
+}
+
+/* A helper function to check whether a range is within the simulated flash */
+static bool isInRange(uint32_t addr, uint32_t len)
+{
+	return (addr <= TOTAL_FLASH_SIZE) && (len <= (TOTAL_FLASH_SIZE - addr));
+}
+
+/* A helper function to check whether a range of the flash can be programmed with the program granularity */
+static bool isProgramAllowed(uint32_t addr, uint32_t len)
+{
+	return (true == isInRange(addr, len)) && (0 == (addr % FLS_SIMU_PROGRAM_UNIT)) && (0 == (len % FLS_SIMU_PROGRAM_UNIT)) && 
+	       (true == isAccessible(addr, len));
+}
+
+/* A helper function to get the total length of the buffers of a scatter/gather operation */
+static uint32_t ioVecLength(const FlsDrv_IoVec_t* iov, uint32_t iovCnt)
+{
+	uint32_t len = 0;
+	uint32_t idx;
+
+	for(idx = 0; idx < iovCnt; idx++)
+	{
+		len += iov[idx].len;
+	}
+
+	return len;
+}
+
+/* A helper function to take the bytes of a write or an erase from the budget of a scheduled power cut. Returns the bytes, which 
+   are programmed or erased before the power is cut */
+static uint32_t consumePower(uint32_t len, uint8_t kind)
+{
+	if(true == FlsSimuPowerOff)
+	{
+		return 0;
+	}
+
+	if( (true == FlsSimuCutAtArmed) && (0 != (kind & FlsSimuCutAt.kinds)) )
+	{
+		if(0 < FlsSimuCutAt.operation)
+		{
+			FlsSimuCutAt.operation--;
+		}
+		else
+		{
+			FlsSimuCutAtArmed = false;
+			if(FlsSimuCutAt.offset < len)
+			{
+				cutPower();
+				return FlsSimuCutAt.offset;
+			}
+		}
+	}
+
+	if(FLS_SIMU_POWER_ON == FlsSimuPowerBudget)
+	{
+		return len;
+	}
+
+	if(len < FlsSimuPowerBudget)
+	{
+		FlsSimuPowerBudget -= len;
+		return len;
+	}
+
+	len = FlsSimuPowerBudget;
+	cutPower();
+
+	return len;
+}
+
+/* A helper function to cut the power. An erase, which is running or suspended, is aborted and the sector keeps its content */
+static void cutPower(void)
+{
+	FlsSimuPowerBudget = 0;
+	FlsSimuPowerOff = true;
+	FlsSimuEraseState = FLS_ERASE_IDLE;
+	FlsSimuStats.powerCuts++;
+}
+
+/* A helper function to program data like a NOR flash - the bits can only be cleared. A request to set a cleared bit is counted */
+static void programData(uint32_t addr, const uint8_t* src, uint32_t len)
+{
+	uint32_t idx;
+
+	for(idx = 0; idx < len; idx++)
+	{
+		if(0 != (src[idx] & (uint8_t)~FlashSimu[addr + idx]))
+		{
+			FlsSimuStats.programViolations++;
+		}
+
+		FlashSimu[addr + idx] &= src[idx];
+	}
+}
+
+/* A helper function to program the byte, which is interrupted by a power cut. Only the torn bits of the new value are cleared. 
+   The byte is torn once, the writes after the cut do not change the flash */
+static void tearProgram(uint32_t addr, uint8_t value)
+{
+	FlashSimu[addr] &= (uint8_t)(value | (uint8_t)~FlsSimuTornBits);
+	FlsSimuTornBits = 0;
+}
+
+/* A helper function to count a read operation and its modelled duration */
+static void accountRead(uint32_t len)
+{
+	FlsSimuStats.reads++;
+	FlsSimuStats.readBytes += len;
+	addBusyTime(FlsSimuTiming.readSetupNs + (len * FlsSimuTiming.readNsPerByte));
+}
+
+/* A helper function to count the program operations of a write and their modelled duration. A program operation does not cross 
+   a program page, so every touched program page costs the setup time */
+static void accountProgram(uint32_t addr, uint32_t len)
+{
+	uint32_t pages;
+
+	if(0 == len)
+	{
+		return;
+	}
+
+	pages = ((addr + len - 1) / FLS_SIMU_PROGRAM_PAGE_SIZE) - (addr / FLS_SIMU_PROGRAM_PAGE_SIZE) + 1;
+
+	FlsSimuStats.programs += pages;
+	FlsSimuStats.programBytes += len;
+	addBusyTime((pages * FlsSimuTiming.programSetupNs) + (len * FlsSimuTiming.programNsPerByte));
+}
+
+/* A helper function to account the modelled duration of a flash operation */
+static void addBusyTime(uint32_t ns)
+{
+	FlsSimuBusyNs += ns % 1000;
+	FlsSimuStats.busyTimeUs += (ns / 1000) + (FlsSimuBusyNs / 1000);
+	FlsSimuClockUs += (ns / 1000) + (FlsSimuBusyNs / 1000);
+	FlsSimuBusyNs %= 1000;
+}
+
+/* A helper function to erase one sector of the simulated flash and count its wear. A power cut leaves the sector partially erased - 
+   the bytes before the cut are erased and only the torn bits are set in the byte at the cut. Returns false after a power cut */
+static bool eraseSector(uint32_t addr)
+{
+	uint32_t eraseLen;
+
+	if(true == FlsSimuPowerOff)
+	{
+		return false;
+	}
+
+	eraseLen = (true == FlsSimuCutAtArmed) ? consumePower(BUFF_FLASH_PAGE_SIZE, FLS_SIMU_CUT_ERASE) : BUFF_FLASH_PAGE_SIZE;
+	memset(&FlashSimu[addr], 0xFF, eraseLen);
+	if(eraseLen < BUFF_FLASH_PAGE_SIZE)
+	{
+		FlashSimu[addr + eraseLen] |= FlsSimuTornBits;
+		FlsSimuTornBits = 0;
+	}
+	FlsSimuStats.sectorErases[addr / BUFF_FLASH_PAGE_SIZE]++;
+
+	return (eraseLen == BUFF_FLASH_PAGE_SIZE);
+}
+
 /* A helper function to generate a table for CRC32 calculation. 
    Only for Unit test. Assuming there would be a library or HW module for CRC calculation on the Embedded project */
 static void generate_table(uint32_t table[256])
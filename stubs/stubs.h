@@ -28,27 +28,105 @@
 
 #define BUFF_FLASH_PAGE_SIZE 0x1000
 
+#ifndef __cplusplus
 #define true 1
 #define false 0
+#endif
 
 #define TOTAL_FLASH_SIZE 0x40000
 
 #define FLASH_PAGE_MASK1 0xFFFFF000
 #define FLASH_PAGE_MASK2 0x00000FFF
 
+#define FLS_SIMU_ERASE_POLLS 4 // status polls until an asynchronous erase of one sector is finished
+
+#define FLS_SIMU_SECTOR_COUNT (TOTAL_FLASH_SIZE / BUFF_FLASH_PAGE_SIZE) // erase sectors of the simulated flash
+#define FLS_SIMU_PROGRAM_PAGE_SIZE 0x100 // a program operation does not cross a program page, longer writes are split
+#define FLS_SIMU_PROGRAM_UNIT 1 // alignment of the address and the length of a write (1 for a byte-programmable NOR flash)
+
+/* Default latency model of a serial NOR flash. The program timings match FLS_PROGRAM_SETUP_TIME_NS and 
+   FLS_PROGRAM_TIME_NS_PER_BYTE of the NVManager configuration */
+#define FLS_SIMU_READ_SETUP_NS 500
+#define FLS_SIMU_READ_NS_PER_BYTE 100
+#define FLS_SIMU_PROGRAM_SETUP_NS 20000
+#define FLS_SIMU_PROGRAM_NS_PER_BYTE 2500
+#define FLS_SIMU_ERASE_SECTOR_NS 45000000
+
+#define FLS_SIMU_POWER_ON 0xFFFFFFFF // no power cut is scheduled
+#define FLS_SIMU_CUT_PROGRAM 0x01 // writes are counted by FlsSimu_setPowerCutAt
+#define FLS_SIMU_CUT_ERASE 0x02 // erases are counted by FlsSimu_setPowerCutAt
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FLS_SIMU_USE_MMAP // the flash image is mapped into the memory, so every write reaches the file immediately
+#endif
+
 /**********************************************************  
                     INTERFACE TYPES
  *********************************************************/
 typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
+#ifndef __cplusplus
 typedef unsigned char bool;
+#endif
+
+/* A descriptor of one buffer of a scatter/gather flash operation. Buffers with zero length are skipped */
+typedef struct
+{
+	uint8_t* buf;
+	uint32_t len;
+} FlsDrv_IoVec_t;
+
+/* State of the asynchronous erase of the flash driver */
+typedef enum
+{
+	FLS_ERASE_IDLE,      /* no erase is running, the flash is accessible */
+	FLS_ERASE_BUSY,      /* an erase is running, the flash is not accessible */
+	FLS_ERASE_SUSPENDED  /* an erase is suspended, the flash is accessible except for the sector being erased */
+} FlsDrv_EraseState_t;
+
+/* Latency model of the simulated flash. A program costs the setup time for every program page it touches */
+typedef struct
+{
+	uint32_t readSetupNs;
+	uint32_t readNsPerByte;
+	uint32_t programSetupNs;
+	uint32_t programNsPerByte;
+	uint32_t eraseSectorNs;
+} FlsSimu_Timing_t;
+
+/* Counters of the simulated flash since FlsDrv_Init */
+typedef struct
+{
+	uint32_t reads;                                  /* read and blank-check operations */
+	uint32_t readBytes;
+	uint32_t programs;                               /* program operations, one per touched program page */
+	uint32_t programBytes;
+	uint32_t programViolations;                      /* bytes, where a bit was requested to change from 0 to 1 */
+	uint32_t sectorErases[FLS_SIMU_SECTOR_COUNT];    /* blocking and asynchronous erases of every sector */
+	uint32_t busyTimeUs;                             /* modelled duration of the reads, programs and blocking erases */
+	uint32_t powerCuts;                              /* scheduled power cuts, which have happened */
+} FlsSimu_Stats_t;
+
+/* A power cut at a byte of a flash operation, see FlsSimu_setPowerCutAt */
+typedef struct
+{
+	uint8_t kinds;                                   /* kinds of the counted operations (FLS_SIMU_CUT_x) */
+	uint32_t operation;                              /* operations to skip before the interrupted one */
+	uint32_t offset;                                 /* byte of the operation, at which the power is cut */
+	uint8_t tornBits;                                /* bits of the byte at the offset, which are changed before the cut */
+} FlsSimu_PowerCut_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /**********************************************************  
                     GLOBAL VARIABLES
  *********************************************************/
-extern uint8_t FlashSimu[0x800][BUFF_FLASH_PAGE_SIZE];
-extern uint8_t sector_buffer[BUFF_FLASH_PAGE_SIZE];
+extern uint8_t* FlashSimu;
+
+extern uint32_t SysTimeSimu;
 
 /**********************************************************  
                     INTERFACE FUNCTIONS
@@ -63,6 +141,44 @@ extern bool FlsDrv_writeBytes( uint32_t addr, uint8_t* src, uint32_t len);
 
 extern bool FlsDrv_chipErase(void);
 
+extern bool FlsDrv_readv( uint32_t addr, const FlsDrv_IoVec_t* iov, uint32_t iovCnt);
+
+extern bool FlsDrv_writev( uint32_t addr, const FlsDrv_IoVec_t* iov, uint32_t iovCnt);
+
+extern bool FlsDrv_blankCheck(uint32_t addr, uint32_t len);
+
+extern const uint8_t* FlsDrv_getMappedAddress(uint32_t addr);
+
+extern bool FlsDrv_eraseStart(uint32_t addr);
+
+extern FlsDrv_EraseState_t FlsDrv_eraseStatus(void);
+
+extern bool FlsDrv_eraseSuspend(void);
+
+extern bool FlsDrv_eraseResume(void);
+
+extern bool FlsSimu_open(const char* path);
+
+extern bool FlsSimu_close(void);
+
+extern void FlsSimu_setTiming(const FlsSimu_Timing_t* timing);
+
+extern void FlsSimu_getStats(FlsSimu_Stats_t* stats);
+
+extern void FlsSimu_setPowerCut(uint32_t programBytes);
+
+extern void FlsSimu_setPowerCutAt(const FlsSimu_PowerCut_t* cut);
+
 extern uint32_t CRC32_Calculate(uint8_t* buffer, uint32_t bufferSize);
 
+extern uint32_t CRC32_Update(uint32_t crc, uint8_t* buffer, uint32_t bufferSize);
+
+extern uint32_t SysTime_getSeconds(void);
+
+extern uint32_t SysTime_getMicroseconds(void);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* STUBS_H_ */
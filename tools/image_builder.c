@@ -0,0 +1,703 @@
+/*
+ ============================================================================
+ Name        : image_builder.c
+ Author      : Martin Patarinski
+ Version     :
+ Copyright   : Open source. Further copyright shall be approved by the author
+ Description : Host-side builder of a factory image of the NVM area. The
+               values of the logical blocks, the large objects and the keys
+               of the key-value store are read from an INI file and are
+               written by the NVManager into the flash simulator, so the
+               image has exactly the format of the device: page headers,
+               records, checksums and the wear info. The image is verified
+               by initializing the NVManager from it and reading all values
+               back. A summary is printed as JSON
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "stubs/stubs.h"
+#include "src/nvm.h"
+
+#define IMG_MAX_LINE               1024
+#define IMG_MAX_DATA_SIZE          0xFFFF // the size of the data of a write is 16-bit
+#define IMG_MAX_ITEMS              256
+#define IMG_KV_PREFIX              "kv:"
+#define IMG_KV_ID_PREFIX           "kvid:"
+
+/* Layouts of the image */
+typedef enum
+{
+	IMG_LAYOUT_AREA,   /* the NVM area (and the emergency region) from its start address */
+	IMG_LAYOUT_FLASH   /* the whole simulated flash, i.e. for FlsSimu_open */
+} ImgLayout_t;
+
+/* Kinds of the values of the INI file */
+typedef enum
+{
+	IMG_ITEM_BLOCK,    /* [eNvmBlockN] */
+#ifdef NVM_USE_LARGE_OBJECTS
+	IMG_ITEM_LO,       /* [eNvmLoN] */
+#endif
+#ifdef NVM_USE_KV_STORE
+	IMG_ITEM_KV,       /* [kv:KEY] */
+	IMG_ITEM_KV_ID,    /* [kvid:ID] */
+#endif
+	IMG_ITEM_NONE
+} ImgItemKind_t;
+
+/* A type for the parameters of the builder */
+typedef struct
+{
+	const char* input;         /* INI file with the values */
+	const char* image;         /* binary image to be written */
+	ImgLayout_t layout;
+	bool bTrim;                /* the erased sectors at the end of the image are left out */
+	const char* output;        /* JSON file or NULL for stdout */
+} ImgParams_t;
+
+/* A value of the INI file, which is written into the image */
+typedef struct
+{
+	ImgItemKind_t kind;
+	uint32_t index;            /* block, large object or integer key */
+	char key[NVM_KV_MAX_KEY_SIZE + 1];
+	uint32_t offset;           /* offset of the value into the data buffer */
+	uint32_t size;
+	uint32_t line;             /* line of the section, for the messages */
+} ImgItem_t;
+
+/* A name of a logical block or a large object */
+typedef struct
+{
+	const char* name;
+	uint32_t index;
+} ImgName_t;
+
+static const ImgName_t BlockNames[] = {
+	{ "eNvmBlock1", eNvmBlock1 }, { "eNvmBlock2", eNvmBlock2 }, { "eNvmBlock3", eNvmBlock3 }, { "eNvmBlock4", eNvmBlock4 },
+	{ "eNvmBlock5", eNvmBlock5 }, { "eNvmBlock6", eNvmBlock6 }, { "eNvmBlock7", eNvmBlock7 }, { "eNvmBlock8", eNvmBlock8 },
+	{ "eNvmBlock9", eNvmBlock9 }, { "eNvmBlock10", eNvmBlock10 }, { "eNvmBlock11", eNvmBlock11 }, { "eNvmBlock12", eNvmBlock12 },
+	{ "eNvmBlock13", eNvmBlock13 }, { "eNvmBlock14", eNvmBlock14 }, { "eNvmBlock15", eNvmBlock15 }
+};
+#ifdef NVM_USE_LARGE_OBJECTS
+static const ImgName_t LoNames[] = {
+	{ "eNvmLo1", eNvmLo1 }
+};
+#endif
+
+static ImgParams_t Params = { NULL, NULL, IMG_LAYOUT_AREA, false, NULL };
+
+/* The values of all items one after another */
+static uint8_t ItemData[IMG_MAX_ITEMS * MAX_DR_SIZE];
+static uint32_t ItemDataSize = 0;
+static ImgItem_t Items[IMG_MAX_ITEMS];
+static uint32_t ItemCount = 0;
+
+static bool parseArgs(int argc, char* argv[]);
+static char* trim(char* text);
+static bool findName(const ImgName_t* names, uint32_t count, const char* name, uint32_t* index);
+static uint32_t getMaxSize(const ImgItem_t* item);
+static bool openSection(const char* name, uint32_t line);
+static bool appendBytes(const uint8_t* data, uint32_t len);
+static bool parseValue(const char* key, char* value);
+static bool parseInput(void);
+static bool writeItem(const ImgItem_t* item);
+static bool verifyItem(const ImgItem_t* item);
+static void getImageRange(uint32_t* startAddr, uint32_t* endAddr);
+
+/* main function of the builder */
+int main(int argc, char* argv[])
+{
+	FlsSimu_Stats_t flash;
+	FILE* out = stdout;
+	FILE* fp;
+	uint32_t startAddr;
+	uint32_t endAddr;
+	uint32_t buildUs;
+	uint32_t mountUs;
+	uint32_t startTime;
+	uint32_t failures = 0;
+	uint32_t idx;
+
+	if(false == parseArgs(argc, argv))
+	{
+		fprintf(stderr, "Usage: %s INPUT.ini --image FILE [--layout area|flash] [--trim] [--output FILE]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if(false == parseInput())
+	{
+		return EXIT_FAILURE;
+	}
+
+	/* the values are written by the NVManager like on the first boot of the device */
+	SysTimeSimu = 0;
+	FlsDrv_Init();
+	startTime = SysTime_getMicroseconds();
+	nvm_init();
+
+	for(idx = 0; idx < ItemCount; idx++)
+	{
+		if(false == writeItem(&Items[idx]))
+		{
+			fprintf(stderr, "%s:%u: the value can't be written\n", Params.input, (unsigned)Items[idx].line);
+			return EXIT_FAILURE;
+		}
+	}
+#ifdef NVM_USE_WEAR_BUDGET
+	if(false == nvm_write_flush())
+	{
+		fprintf(stderr, "The deferred writes can't be programmed!\n");
+		return EXIT_FAILURE;
+	}
+#endif
+#ifdef NVM_USE_BACKGROUND_ERASE
+	while(false == nvm_erase_step())
+	{
+		/* the image has no pending erase */
+	}
+#endif
+	buildUs = SysTime_getMicroseconds() - startTime;
+	FlsSimu_getStats(&flash);
+
+	/* the device boots from the image */
+	memset(&NvmManagerDescriptor, 0, sizeof(NvmManagerDescriptor));
+	startTime = SysTime_getMicroseconds();
+	nvm_init();
+	mountUs = SysTime_getMicroseconds() - startTime;
+
+	for(idx = 0; idx < ItemCount; idx++)
+	{
+		if(false == verifyItem(&Items[idx]))
+		{
+			fprintf(stderr, "%s:%u: the value is not read back from the image\n", Params.input, (unsigned)Items[idx].line);
+			failures++;
+		}
+	}
+	failures += (true == nvm_get_error()) ? 1 : 0;
+
+	getImageRange(&startAddr, &endAddr);
+
+	fp = fopen(Params.image, "wb");
+	if( (NULL == fp) || ((endAddr - startAddr) != fwrite(&FlashSimu[startAddr], 1, endAddr - startAddr, fp)) )
+	{
+		fprintf(stderr, "Can't write %s!\n", Params.image);
+		return EXIT_FAILURE;
+	}
+	fclose(fp);
+
+	if(NULL != Params.output)
+	{
+		out = fopen(Params.output, "w");
+		if(NULL == out)
+		{
+			fprintf(stderr, "Can't open %s!\n", Params.output);
+			return EXIT_FAILURE;
+		}
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"tool\": \"nvm_image_builder\",\n");
+	fprintf(out, "  \"input\": \"%s\", \"image\": \"%s\", \"layout\": \"%s\", \"trim\": %s,\n", Params.input, Params.image,
+	        (IMG_LAYOUT_FLASH == Params.layout) ? "flash" : "area", (true == Params.bTrim) ? "true" : "false");
+	fprintf(out, "  \"start_address\": %u, \"size\": %u, \"values\": %u, \"programmed_bytes\": %u, \"write_pointer\": %u,\n",
+	        (unsigned)startAddr, (unsigned)(endAddr - startAddr), (unsigned)ItemCount, (unsigned)flash.programBytes,
+	        (unsigned)NvmManagerDescriptor.writePointer);
+	fprintf(out, "  \"first_boot_writes_us\": %u, \"mount_us\": %u, \"failures\": %u\n", (unsigned)buildUs, (unsigned)mountUs,
+	        (unsigned)failures);
+	fprintf(out, "}\n");
+
+	if(stdout != out)
+	{
+		fclose(out);
+	}
+
+	return (0 == failures) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Parse the command line into the parameters of the builder */
+static bool parseArgs(int argc, char* argv[])
+{
+	int idx;
+
+	for(idx = 1; idx < argc; idx++)
+	{
+		if( (0 == strcmp(argv[idx], "--image")) && ((idx + 1) < argc) )
+		{
+			Params.image = argv[++idx];
+		}
+		else if( (0 == strcmp(argv[idx], "--layout")) && ((idx + 1) < argc) )
+		{
+			idx++;
+			if(0 == strcmp(argv[idx], "area"))
+			{
+				Params.layout = IMG_LAYOUT_AREA;
+			}
+			else if(0 == strcmp(argv[idx], "flash"))
+			{
+				Params.layout = IMG_LAYOUT_FLASH;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if(0 == strcmp(argv[idx], "--trim"))
+		{
+			Params.bTrim = true;
+		}
+		else if( (0 == strcmp(argv[idx], "--output")) && ((idx + 1) < argc) )
+		{
+			Params.output = argv[++idx];
+		}
+		else if( ('-' != argv[idx][0]) && (NULL == Params.input) )
+		{
+			Params.input = argv[idx];
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return (NULL != Params.input) && (NULL != Params.image);
+}
+
+/* Remove the white space at the beginning and at the end of a text */
+static char* trim(char* text)
+{
+	char* end;
+
+	while(0 != isspace((unsigned char)*text))
+	{
+		text++;
+	}
+
+	end = text + strlen(text);
+	while( (end > text) && (0 != isspace((unsigned char)end[-1])) )
+	{
+		end--;
+	}
+	*end = '\0';
+
+	return text;
+}
+
+/* Find the index of a name */
+static bool findName(const ImgName_t* names, uint32_t count, const char* name, uint32_t* index)
+{
+	uint32_t idx;
+
+	for(idx = 0; idx < count; idx++)
+	{
+		if(0 == strcmp(names[idx].name, name))
+		{
+			*index = names[idx].index;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Get the maximal size of the value of an item */
+static uint32_t getMaxSize(const ImgItem_t* item)
+{
+	switch(item->kind)
+	{
+	case IMG_ITEM_BLOCK:
+		return NvmBlocks[item->index].size;
+#ifdef NVM_USE_LARGE_OBJECTS
+	case IMG_ITEM_LO:
+		return NvmLargeObjects[item->index].maxSize;
+#endif
+#ifdef NVM_USE_KV_STORE
+	case IMG_ITEM_KV:
+	case IMG_ITEM_KV_ID:
+		return NVM_KV_MAX_DATA_SIZE;
+#endif
+	default:
+		return 0;
+	}
+}
+
+/* Start a new item with the name of a section. An unknown name or too many items are an error */
+static bool openSection(const char* name, uint32_t line)
+{
+	ImgItem_t* item = &Items[ItemCount];
+
+	if(IMG_MAX_ITEMS == ItemCount)
+	{
+		fprintf(stderr, "%s:%u: more than %u values\n", Params.input, (unsigned)line, (unsigned)IMG_MAX_ITEMS);
+		return false;
+	}
+
+	memset(item, 0, sizeof(ImgItem_t));
+	item->kind = IMG_ITEM_NONE;
+	item->offset = ItemDataSize;
+	item->line = line;
+
+	if(true == findName(BlockNames, sizeof(BlockNames) / sizeof(BlockNames[0]), name, &item->index))
+	{
+		item->kind = IMG_ITEM_BLOCK;
+	}
+#ifdef NVM_USE_LARGE_OBJECTS
+	else if(true == findName(LoNames, sizeof(LoNames) / sizeof(LoNames[0]), name, &item->index))
+	{
+		item->kind = IMG_ITEM_LO;
+	}
+#endif
+#ifdef NVM_USE_KV_STORE
+	else if( (0 == strncmp(name, IMG_KV_PREFIX, strlen(IMG_KV_PREFIX))) && (0 < strlen(name + strlen(IMG_KV_PREFIX))) &&
+	         (NVM_KV_MAX_KEY_SIZE >= strlen(name + strlen(IMG_KV_PREFIX))) )
+	{
+		item->kind = IMG_ITEM_KV;
+		strcpy(item->key, name + strlen(IMG_KV_PREFIX));
+	}
+	else if(0 == strncmp(name, IMG_KV_ID_PREFIX, strlen(IMG_KV_ID_PREFIX)))
+	{
+		item->kind = IMG_ITEM_KV_ID;
+		item->index = (uint32_t)strtoul(name + strlen(IMG_KV_ID_PREFIX), NULL, 0);
+	}
+#endif
+
+	if(IMG_ITEM_NONE == item->kind)
+	{
+		return false;
+	}
+
+	/* the data of a logical block is padded with zeros up to its size and stays valid for a deferred write */
+	if(IMG_ITEM_BLOCK == item->kind)
+	{
+		if((ItemDataSize + NvmBlocks[item->index].size) > sizeof(ItemData))
+		{
+			return false;
+		}
+		ItemDataSize += NvmBlocks[item->index].size;
+	}
+
+	ItemCount++;
+
+	return true;
+}
+
+/* Append bytes to the value of the current item */
+static bool appendBytes(const uint8_t* data, uint32_t len)
+{
+	ImgItem_t* item = &Items[ItemCount - 1];
+	uint32_t endOffset = item->offset + item->size + len;
+
+	if( ((item->size + len) > getMaxSize(item)) || (endOffset > sizeof(ItemData)) )
+	{
+		return false;
+	}
+
+	memcpy(&ItemData[item->offset + item->size], data, len);
+	item->size += len;
+	ItemDataSize = (endOffset > ItemDataSize) ? endOffset : ItemDataSize;
+
+	return true;
+}
+
+/* Parse one "key = value" line of a section into the value of the current item:
+   hex = 01 02 0A         bytes in hex, the separators are optional
+   string = "text\n"      text with C escapes, the quotes are optional
+   u8|u16|u32 = 1, 0x20   little-endian integers
+   fill = 0x00            the value is filled with the byte up to the size of the block
+   file = path            content of a binary file */
+static bool parseValue(const char* key, char* value)
+{
+	uint8_t bytes[IMG_MAX_LINE * sizeof(uint32_t)];
+	uint32_t len = 0;
+	uint32_t width;
+	uint32_t number;
+	uint32_t idx;
+	char* next;
+	FILE* fp;
+	int ch;
+
+	if(0 == strcmp(key, "hex"))
+	{
+		while('\0' != *value)
+		{
+			if( (0 != isxdigit((unsigned char)value[0])) && (0 != isxdigit((unsigned char)value[1])) )
+			{
+				ch = value[2];
+				value[2] = '\0';
+				bytes[len++] = (uint8_t)strtoul(value, NULL, 16);
+				value[2] = (char)ch;
+				value += 2;
+			}
+			else if( (0 != isspace((unsigned char)*value)) || (':' == *value) || (',' == *value) )
+			{
+				value++;
+			}
+			else
+			{
+				return false;
+			}
+		}
+	}
+	else if(0 == strcmp(key, "string"))
+	{
+		len = (uint32_t)strlen(value);
+		if( (len >= 2) && ('"' == value[0]) && ('"' == value[len - 1]) )
+		{
+			value[len - 1] = '\0';
+			value++;
+		}
+
+		for(len = 0; '\0' != *value; value++)
+		{
+			if( ('\\' == value[0]) && ('\0' != value[1]) )
+			{
+				value++;
+				switch(*value)
+				{
+				case 'n': bytes[len++] = '\n'; break;
+				case 'r': bytes[len++] = '\r'; break;
+				case 't': bytes[len++] = '\t'; break;
+				case '0': bytes[len++] = '\0'; break;
+				case 'x':
+					bytes[len++] = (uint8_t)strtoul(value + 1, &next, 16);
+					value = next - 1;
+					break;
+				default: bytes[len++] = (uint8_t)*value; break;
+				}
+			}
+			else
+			{
+				bytes[len++] = (uint8_t)*value;
+			}
+		}
+	}
+	else if( (0 == strcmp(key, "u8")) || (0 == strcmp(key, "u16")) || (0 == strcmp(key, "u32")) )
+	{
+		width = (uint32_t)strtoul(key + 1, NULL, 10) / 8;
+
+		while('\0' != *(value = trim(value)))
+		{
+			number = (uint32_t)strtoul(value, &next, 0);
+			if(next == value)
+			{
+				return false;
+			}
+			for(idx = 0; idx < width; idx++)
+			{
+				bytes[len++] = (uint8_t)(number >> (idx * 8));
+			}
+			value = (',' == *next) ? (next + 1) : next;
+		}
+	}
+	else if(0 == strcmp(key, "fill"))
+	{
+		number = (uint32_t)strtoul(value, NULL, 0);
+		while(Items[ItemCount - 1].size < getMaxSize(&Items[ItemCount - 1]))
+		{
+			bytes[0] = (uint8_t)number;
+			if(false == appendBytes(bytes, 1))
+			{
+				return false;
+			}
+		}
+	}
+	else if(0 == strcmp(key, "file"))
+	{
+		fp = fopen(value, "rb");
+		if(NULL == fp)
+		{
+			return false;
+		}
+		while(EOF != (ch = fgetc(fp)))
+		{
+			bytes[0] = (uint8_t)ch;
+			if(false == appendBytes(bytes, 1))
+			{
+				fclose(fp);
+				return false;
+			}
+		}
+		fclose(fp);
+	}
+	else
+	{
+		return false;
+	}
+
+	return appendBytes(bytes, len);
+}
+
+/* Parse the INI file into the items */
+static bool parseInput(void)
+{
+	char buffer[IMG_MAX_LINE];
+	char* text;
+	char* value;
+	char* end;
+	uint32_t line = 0;
+	FILE* fp = fopen(Params.input, "r");
+
+	if(NULL == fp)
+	{
+		fprintf(stderr, "Can't open %s!\n", Params.input);
+		return false;
+	}
+
+	while(NULL != fgets(buffer, sizeof(buffer), fp))
+	{
+		line++;
+		text = trim(buffer);
+
+		/* empty lines and comments */
+		if( ('\0' == *text) || (';' == *text) || ('#' == *text) )
+		{
+			continue;
+		}
+
+		if('[' == *text)
+		{
+			end = strchr(text, ']');
+			if(NULL != end)
+			{
+				*end = '\0';
+			}
+			if( (NULL == end) || (false == openSection(trim(text + 1), line)) )
+			{
+				fprintf(stderr, "%s:%u: invalid section\n", Params.input, (unsigned)line);
+				fclose(fp);
+				return false;
+			}
+			continue;
+		}
+
+		value = strchr(text, '=');
+		if( (0 == ItemCount) || (NULL == value) )
+		{
+			fprintf(stderr, "%s:%u: a \"key = value\" line of a section is expected\n", Params.input, (unsigned)line);
+			fclose(fp);
+			return false;
+		}
+
+		*value = '\0';
+		if(false == parseValue(trim(text), trim(value + 1)))
+		{
+			fprintf(stderr, "%s:%u: invalid value or the value is longer than %u bytes\n", Params.input, (unsigned)line,
+			        (unsigned)getMaxSize(&Items[ItemCount - 1]));
+			fclose(fp);
+			return false;
+		}
+	}
+
+	fclose(fp);
+
+	return true;
+}
+
+/* Write an item through the interface of the NVManager */
+static bool writeItem(const ImgItem_t* item)
+{
+	switch(item->kind)
+	{
+	case IMG_ITEM_BLOCK:
+		return nvm_write((NvmBlocksId_t)item->index, &ItemData[item->offset], (uint16_t)NvmBlocks[item->index].size);
+#ifdef NVM_USE_LARGE_OBJECTS
+	case IMG_ITEM_LO:
+		return (true == nvm_lo_write((NvmLargeObjectsId_t)item->index, 0, &ItemData[item->offset], (uint16_t)item->size)) &&
+		       (true == nvm_lo_set_size((NvmLargeObjectsId_t)item->index, (uint16_t)item->size));
+#endif
+#ifdef NVM_USE_KV_STORE
+	case IMG_ITEM_KV:
+		return nvm_kv_put(item->key, &ItemData[item->offset], (uint16_t)item->size);
+	case IMG_ITEM_KV_ID:
+		return nvm_kv_put_id(item->index, &ItemData[item->offset], (uint16_t)item->size);
+#endif
+	default:
+		return false;
+	}
+}
+
+/* Read an item back from the image and compare it with its value. An item, which is overwritten by a later section, is not checked */
+static bool verifyItem(const ImgItem_t* item)
+{
+	static uint8_t readData[IMG_MAX_DATA_SIZE];
+	uint16_t readSize = 0;
+	uint32_t idx;
+
+	for(idx = (uint32_t)(item - Items) + 1; idx < ItemCount; idx++)
+	{
+		if( (Items[idx].kind == item->kind) && (Items[idx].index == item->index) && (0 == strcmp(Items[idx].key, item->key)) )
+		{
+			return true;
+		}
+	}
+
+	switch(item->kind)
+	{
+	case IMG_ITEM_BLOCK:
+		if( (false == nvm_read((NvmBlocksId_t)item->index, readData, &readSize)) || (readSize != NvmBlocks[item->index].size) )
+		{
+			return false;
+		}
+		for(idx = item->size; idx < readSize; idx++)
+		{
+			if(0 != readData[idx])
+			{
+				return false;
+			}
+		}
+		break;
+#ifdef NVM_USE_LARGE_OBJECTS
+	case IMG_ITEM_LO:
+		if( (false == nvm_lo_read((NvmLargeObjectsId_t)item->index, 0, readData, sizeof(readData), &readSize)) || (readSize != item->size) )
+		{
+			return false;
+		}
+		break;
+#endif
+#ifdef NVM_USE_KV_STORE
+	case IMG_ITEM_KV:
+		if( (false == nvm_kv_get(item->key, readData, sizeof(readData), &readSize)) || (readSize != item->size) )
+		{
+			return false;
+		}
+		break;
+	case IMG_ITEM_KV_ID:
+		if( (false == nvm_kv_get_id(item->index, readData, sizeof(readData), &readSize)) || (readSize != item->size) )
+		{
+			return false;
+		}
+		break;
+#endif
+	default:
+		return false;
+	}
+
+	return (0 == memcmp(readData, &ItemData[item->offset], item->size));
+}
+
+/* Get the range of the flash, which is written into the image. The erased sectors at its end are left out with --trim */
+static void getImageRange(uint32_t* startAddr, uint32_t* endAddr)
+{
+	*startAddr = NVM_MANAGER_START_ADDR;
+	*endAddr = NVM_MANAGER_END_ADDR;
+#ifdef NVM_USE_EMERGENCY_FLUSH
+	*startAddr = (NVM_EMERGENCY_START_ADDR < *startAddr) ? NVM_EMERGENCY_START_ADDR : *startAddr;
+	*endAddr = (NVM_EMERGENCY_END_ADDR > *endAddr) ? NVM_EMERGENCY_END_ADDR : *endAddr;
+#endif
+
+	if(IMG_LAYOUT_FLASH == Params.layout)
+	{
+		*startAddr = 0;
+		*endAddr = TOTAL_FLASH_SIZE;
+	}
+
+	while( (true == Params.bTrim) && (*endAddr > *startAddr) &&
+	       (true == FlsDrv_blankCheck(*endAddr - FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE)) )
+	{
+		*endAddr -= FLASH_SECTOR_SIZE;
+	}
+}
@@ -0,0 +1,834 @@
+/*
+ ============================================================================
+ Name        : image_inspector.c
+ Author      : Martin Patarinski
+ Version     :
+ Copyright   : Open source. Further copyright shall be approved by the author
+ Description : Offline inspector of a flash dump (i.e. FlashSimu.bin, an
+               image of image_builder or a readout of a device). The page
+               headers and the records are decoded with the configuration
+               of this build (nvm_cfg.h) like the search after power-on,
+               but the dump is never changed. The live, stale and corrupt
+               bytes of every sector, the records of every block, the wear
+               info and the write pointer are printed as text or JSON
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stubs/stubs.h"
+#include "src/nvm.h"
+
+#define INSP_NONE                  0xFFFFFFFF
+#define INSP_KV_RECORD             eNvmBlockCount // a record of the key-value store
+#define INSP_MAX_RECORDS           ((NVM_MANAGER_END_ADDR - NVM_MANAGER_START_ADDR) / (BLOCK_HEADER_SIZE + NVM_CRC_LEN))
+#define INSP_MAX_CORRUPT           64             // corrupt records, which are listed one by one
+
+/* Layouts of the dump */
+typedef enum
+{
+	INSP_LAYOUT_AUTO,  /* the whole flash, if the file is bigger than the NVM area, otherwise the NVM area */
+	INSP_LAYOUT_AREA,  /* the NVM area (and the emergency region) from its start address, like image_builder */
+	INSP_LAYOUT_FLASH  /* the whole flash from address 0, like FlsSimu_open */
+} InspLayout_t;
+
+/* States of a logical page by its header */
+typedef enum
+{
+	INSP_PAGE_ERASED,  /* the whole page is erased */
+	INSP_PAGE_WRITTEN, /* the page is written and not read yet */
+	INSP_PAGE_OLDEST,  /* the garbage collection of the page has been cut, so it has the complete data */
+	INSP_PAGE_READ,    /* the page is released and waits for its erase */
+	INSP_PAGE_INVALID  /* the header is torn or damaged */
+} InspPageState_t;
+
+/* Kinds of the bytes of a sector */
+typedef enum
+{
+	INSP_BYTES_LIVE,    /* the header of the page with data and the latest instances of the records */
+	INSP_BYTES_STALE,   /* older instances, tombstones and the pages without data */
+	INSP_BYTES_CORRUPT, /* torn or damaged records */
+	INSP_BYTES_ERASED
+} InspBytes_t;
+
+/* A type for the parameters of the inspector */
+typedef struct
+{
+	const char* image;         /* flash dump */
+	InspLayout_t layout;
+	bool bJson;                /* JSON instead of text */
+	const char* output;        /* output file or NULL for stdout */
+} InspParams_t;
+
+/* A valid record of the dump */
+typedef struct
+{
+	uint32_t addr;
+	uint32_t size;             /* header, data and checksum */
+	uint32_t bIdx;             /* block or INSP_KV_RECORD */
+	uint16_t occCntr;
+	uint8_t kvFlags;
+	bool bLive;
+} InspRecord_t;
+
+/* A torn or damaged area, which is skipped until the next valid record */
+typedef struct
+{
+	uint32_t addr;
+	uint32_t size;
+} InspCorrupt_t;
+
+typedef struct
+{
+	InspPageState_t state;
+	uint32_t records;
+	uint32_t corrupt;
+	uint32_t endAddr;          /* the page is erased after this address */
+} InspPage_t;
+
+typedef struct
+{
+	uint32_t bytes[INSP_BYTES_ERASED + 1];
+} InspSector_t;
+
+typedef struct
+{
+	uint32_t records;          /* valid records in all pages */
+	uint16_t occMin;
+	uint16_t occMax;
+	uint32_t liveRecord;       /* index of the latest instance or INSP_NONE */
+} InspBlock_t;
+
+/* A type for the results of an inspection */
+typedef struct
+{
+	uint32_t imageSize;
+	uint32_t startAddr;        /* flash address of the first byte of the dump */
+	uint32_t activePage;       /* page with data, which is taken by nvm_init, or INSP_NONE */
+	uint32_t writePointer;
+	InspPage_t pages[NVM_PAGE_COUNT];
+	InspSector_t sectors[NVM_SECTOR_COUNT];
+	InspBlock_t blocks[eNvmBlockCount];
+	uint32_t corruptCount;     /* corrupt areas in all pages */
+	uint32_t activeCorrupt;    /* corrupt areas in the page with data */
+	InspCorrupt_t corrupt[INSP_MAX_CORRUPT];
+	uint32_t kvRecords;
+	uint32_t kvKeys;           /* keys with a value */
+	uint32_t kvTombstones;     /* deleted keys, which are dropped by the next garbage collection */
+	bool bWearInfo;
+	uint32_t eraseCount;
+	uint32_t operatingTime;
+	uint32_t emergencyRecords;
+	uint32_t emergencyPending; /* records of an emergency flush, which are merged by the next nvm_init */
+} InspResult_t;
+
+static InspParams_t Params = { NULL, INSP_LAYOUT_AUTO, false, NULL };
+
+static InspRecord_t Records[INSP_MAX_RECORDS];
+static uint32_t RecordCount = 0;
+static InspResult_t Result;
+
+static const char* PageStates[] = { "erased", "written", "oldest", "read", "invalid" };
+/* Names of the logical blocks like into NvmBlocksId_t */
+#define INSP_BLOCK_NAME(name, pattern, size)  #name,
+static const char* BlockNames[] = { NVM_BLOCK_LIST(INSP_BLOCK_NAME) };
+
+static bool parseArgs(int argc, char* argv[]);
+static bool loadImage(void);
+static bool isErased(uint32_t addr, uint32_t len);
+static InspPageState_t getPageState(uint32_t pageIdx);
+static bool findBlock(uint16_t pattern, uint32_t* bIdx);
+static bool isCrcValid(uint32_t addr, uint32_t dataSize);
+static bool getRecord(uint32_t addr, uint32_t pageEndAddr, InspRecord_t* record);
+static void addBytes(uint32_t addr, uint32_t len, InspBytes_t kind);
+static void inspectPage(uint32_t pageIdx);
+static bool isKeyEqual(const InspRecord_t* a, const InspRecord_t* b);
+static void markLiveRecords(uint32_t first, uint32_t last);
+static void inspectEmergency(void);
+static void printText(FILE* out);
+static void printJson(FILE* out);
+
+/* main function of the inspector */
+int main(int argc, char* argv[])
+{
+	FILE* out = stdout;
+	uint32_t pageIdx;
+	uint32_t idx;
+
+	if(false == parseArgs(argc, argv))
+	{
+		fprintf(stderr, "Usage: %s IMAGE [--layout auto|area|flash] [--format text|json] [--output FILE]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if(false == loadImage())
+	{
+		return EXIT_FAILURE;
+	}
+
+	Result.activePage = INSP_NONE;
+	Result.writePointer = INSP_NONE;
+	for(idx = 0; idx < eNvmBlockCount; idx++)
+	{
+		Result.blocks[idx].liveRecord = INSP_NONE;
+	}
+
+	/* the page with data is chosen like by nvm_init: an oldest page wins, otherwise the last written one */
+	for(pageIdx = 0; pageIdx < NVM_PAGE_COUNT; pageIdx++)
+	{
+		Result.pages[pageIdx].state = getPageState(pageIdx);
+
+		if( (INSP_PAGE_OLDEST == Result.pages[pageIdx].state) ||
+		    ((INSP_PAGE_WRITTEN == Result.pages[pageIdx].state) &&
+		     ((INSP_NONE == Result.activePage) || (INSP_PAGE_OLDEST != Result.pages[Result.activePage].state))) )
+		{
+			Result.activePage = pageIdx;
+		}
+	}
+
+	for(pageIdx = 0; pageIdx < NVM_PAGE_COUNT; pageIdx++)
+	{
+		inspectPage(pageIdx);
+	}
+
+	inspectEmergency();
+
+	if(NULL != Params.output)
+	{
+		out = fopen(Params.output, "w");
+		if(NULL == out)
+		{
+			fprintf(stderr, "Can't open %s!\n", Params.output);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(true == Params.bJson)
+	{
+		printJson(out);
+	}
+	else
+	{
+		printText(out);
+	}
+
+	if(stdout != out)
+	{
+		fclose(out);
+	}
+
+	/* a torn record after a power cut is recovered by nvm_init, but a dump for the production shall be clean */
+	return (0 == Result.activeCorrupt) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Parse the command line into the parameters of the inspector */
+static bool parseArgs(int argc, char* argv[])
+{
+	int idx;
+
+	for(idx = 1; idx < argc; idx++)
+	{
+		if( (0 == strcmp(argv[idx], "--layout")) && ((idx + 1) < argc) )
+		{
+			idx++;
+			if(0 == strcmp(argv[idx], "auto"))
+			{
+				Params.layout = INSP_LAYOUT_AUTO;
+			}
+			else if(0 == strcmp(argv[idx], "area"))
+			{
+				Params.layout = INSP_LAYOUT_AREA;
+			}
+			else if(0 == strcmp(argv[idx], "flash"))
+			{
+				Params.layout = INSP_LAYOUT_FLASH;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if( (0 == strcmp(argv[idx], "--format")) && ((idx + 1) < argc) )
+		{
+			idx++;
+			if(0 == strcmp(argv[idx], "json"))
+			{
+				Params.bJson = true;
+			}
+			else if(0 != strcmp(argv[idx], "text"))
+			{
+				return false;
+			}
+		}
+		else if( (0 == strcmp(argv[idx], "--output")) && ((idx + 1) < argc) )
+		{
+			Params.output = argv[++idx];
+		}
+		else if( ('-' != argv[idx][0]) && (NULL == Params.image) )
+		{
+			Params.image = argv[idx];
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return (NULL != Params.image);
+}
+
+/* Load the dump into the simulated flash. The file itself is only read */
+static bool loadImage(void)
+{
+	uint32_t areaStartAddr = NVM_MANAGER_START_ADDR;
+	uint32_t areaEndAddr = NVM_MANAGER_END_ADDR;
+	long fileSize;
+	FILE* fp;
+
+#ifdef NVM_USE_EMERGENCY_FLUSH
+	areaStartAddr = (NVM_EMERGENCY_START_ADDR < areaStartAddr) ? NVM_EMERGENCY_START_ADDR : areaStartAddr;
+	areaEndAddr = (NVM_EMERGENCY_END_ADDR > areaEndAddr) ? NVM_EMERGENCY_END_ADDR : areaEndAddr;
+#endif
+
+	/* the rest of the flash stays erased and the table of the checksum is generated */
+	FlsDrv_Init();
+
+	fp = fopen(Params.image, "rb");
+	if(NULL == fp)
+	{
+		fprintf(stderr, "Can't open %s!\n", Params.image);
+		return false;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	fileSize = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	if(INSP_LAYOUT_AUTO == Params.layout)
+	{
+		Params.layout = (fileSize > (long)(areaEndAddr - areaStartAddr)) ? INSP_LAYOUT_FLASH : INSP_LAYOUT_AREA;
+	}
+	Result.startAddr = (INSP_LAYOUT_FLASH == Params.layout) ? 0 : areaStartAddr;
+
+	if( (fileSize < 0) || (fileSize > (long)(TOTAL_FLASH_SIZE - Result.startAddr)) )
+	{
+		fprintf(stderr, "%s is bigger than the flash!\n", Params.image);
+		fclose(fp);
+		return false;
+	}
+
+	Result.imageSize = (uint32_t)fileSize;
+	if(Result.imageSize != fread(&FlashSimu[Result.startAddr], 1, Result.imageSize, fp))
+	{
+		fprintf(stderr, "Can't read %s!\n", Params.image);
+		fclose(fp);
+		return false;
+	}
+	fclose(fp);
+
+	return true;
+}
+
+/* Check whether all bytes of a range are erased */
+static bool isErased(uint32_t addr, uint32_t len)
+{
+	uint32_t idx;
+
+	for(idx = 0; idx < len; idx++)
+	{
+		if(0xFF != FlashSimu[addr + idx])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Get the state of a logical page from its header like nvm_init. A torn oldest or read mark counts as soon as any bit is cleared */
+static InspPageState_t getPageState(uint32_t pageIdx)
+{
+	const uint8_t* header = &FlashSimu[NVM_MANAGER_START_ADDR + (pageIdx * LOGICAL_PAGE_SIZE)];
+
+	if(true == isErased(NVM_MANAGER_START_ADDR + (pageIdx * LOGICAL_PAGE_SIZE), LOGICAL_PAGE_SIZE))
+	{
+		return INSP_PAGE_ERASED;
+	}
+
+	if(0 != memcmp(header, PAGE_MARK_AS_WRITTEN, PAGE_HEADER_HALF_SIZE))
+	{
+		return INSP_PAGE_INVALID;
+	}
+
+	if(0xFF != header[PAGE_HEADER_SIZE - PAGE_HEADER_ONE_BYTE])
+	{
+		return INSP_PAGE_READ;
+	}
+
+	return (0xFF != header[PAGE_HEADER_HALF_SIZE]) ? INSP_PAGE_OLDEST : INSP_PAGE_WRITTEN;
+}
+
+/* Find the logical block with a pattern */
+static bool findBlock(uint16_t pattern, uint32_t* bIdx)
+{
+	uint32_t idx;
+
+	for(idx = 0; idx < eNvmBlockCount; idx++)
+	{
+		if(pattern == NvmBlocks[idx].pattern)
+		{
+			*bIdx = idx;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Check the checksum of a record like nvm_init. A checksum of erased flash is valid only after written data */
+static bool isCrcValid(uint32_t addr, uint32_t dataSize)
+{
+	uint32_t storedCrc;
+
+	memcpy(&storedCrc, &FlashSimu[addr + BLOCK_HEADER_SIZE + dataSize], NVM_CRC_LEN);
+
+	return (storedCrc == CRC32_Update(0, &FlashSimu[addr + BLOCK_HEADER_SIZE], dataSize)) &&
+	       ((NVM_CRC_ERASED != storedCrc) || (false == isErased(addr + BLOCK_HEADER_SIZE, dataSize)));
+}
+
+/* Decode a valid record: its header is known, it ends into the page and its checksum matches */
+static bool getRecord(uint32_t addr, uint32_t pageEndAddr, InspRecord_t* record)
+{
+	uint16_t pattern;
+	uint32_t dataSize;
+#ifdef NVM_USE_KV_STORE
+	NvmKvHeader_t kvHeader;
+#endif
+
+	if( ((addr + BLOCK_HEADER_SIZE) > pageEndAddr) || (true == isErased(addr, BLOCK_HEADER_SIZE)) )
+	{
+		return false;
+	}
+
+	memset(record, 0, sizeof(InspRecord_t));
+	memcpy(&pattern, &FlashSimu[addr], BLOCK_HEADER_HALF_SIZE);
+	memcpy(&record->occCntr, &FlashSimu[addr + BLOCK_HEADER_HALF_SIZE], BLOCK_HEADER_HALF_SIZE);
+
+#ifdef NVM_USE_KV_STORE
+	if(NVM_KV_PATTERN == pattern)
+	{
+		memcpy(&kvHeader, &FlashSimu[addr + BLOCK_HEADER_SIZE], NVM_KV_HEADER_SIZE);
+		if( (0 == kvHeader.keyLen) || (kvHeader.keyLen > NVM_KV_MAX_KEY_SIZE) || (kvHeader.dataLen > NVM_KV_MAX_DATA_SIZE) )
+		{
+			return false;
+		}
+		record->bIdx = INSP_KV_RECORD;
+		record->kvFlags = kvHeader.flags;
+		dataSize = NVM_KV_HEADER_SIZE + kvHeader.keyLen + kvHeader.dataLen;
+	}
+	else
+#endif
+	if(true == findBlock(pattern, &record->bIdx))
+	{
+		dataSize = NvmBlocks[record->bIdx].size;
+	}
+	else
+	{
+		return false;
+	}
+
+	record->addr = addr;
+	record->size = BLOCK_HEADER_SIZE + dataSize + NVM_CRC_LEN;
+
+	return ((addr + record->size) <= pageEndAddr) && (true == isCrcValid(addr, dataSize));
+}
+
+/* Add a range of bytes of the NVM area to the sectors */
+static void addBytes(uint32_t addr, uint32_t len, InspBytes_t kind)
+{
+	uint32_t sectorIdx;
+	uint32_t part;
+
+	while(len > 0)
+	{
+		sectorIdx = GET_SECTOR_IDX(addr);
+		part = FLASH_SECTOR_SIZE - ((addr - NVM_MANAGER_START_ADDR) % FLASH_SECTOR_SIZE);
+		part = (part < len) ? part : len;
+
+		Result.sectors[sectorIdx].bytes[kind] += part;
+		addr += part;
+		len -= part;
+	}
+}
+
+/* Decode the records of a logical page like the search after power-on and classify its bytes */
+static void inspectPage(uint32_t pageIdx)
+{
+	uint32_t pageAddr = NVM_MANAGER_START_ADDR + (pageIdx * LOGICAL_PAGE_SIZE);
+	uint32_t pageEndAddr = pageAddr + LOGICAL_PAGE_SIZE;
+	InspPage_t* page = &Result.pages[pageIdx];
+	bool bActive = (pageIdx == Result.activePage);
+	uint32_t first = RecordCount;
+	uint32_t addr = pageAddr + PAGE_HEADER_SIZE;
+	uint32_t next;
+	uint32_t idx;
+	InspRecord_t record;
+	InspBlock_t* block;
+
+	if(INSP_PAGE_ERASED == page->state)
+	{
+		page->endAddr = pageAddr;
+		addBytes(pageAddr, LOGICAL_PAGE_SIZE, INSP_BYTES_ERASED);
+		return;
+	}
+
+	/* all bytes after this address are erased, so the last record ends at or after it */
+	for(page->endAddr = pageEndAddr; (page->endAddr > addr) && (0xFF == FlashSimu[page->endAddr - 1]); page->endAddr--)
+	{
+	}
+
+	while(addr < page->endAddr)
+	{
+		if(true == getRecord(addr, pageEndAddr, &record))
+		{
+			Records[RecordCount++] = record;
+			page->records++;
+			addr += record.size;
+			continue;
+		}
+
+		/* the size of a damaged record can not be trusted and the records are not aligned, so every address is checked */
+		for(next = addr + 1; (next < page->endAddr) && (false == getRecord(next, pageEndAddr, &record)); next++)
+		{
+		}
+
+		if(Result.corruptCount < INSP_MAX_CORRUPT)
+		{
+			Result.corrupt[Result.corruptCount].addr = addr;
+			Result.corrupt[Result.corruptCount].size = next - addr;
+		}
+		Result.corruptCount++;
+		Result.activeCorrupt += (true == bActive) ? 1u : 0u;
+		page->corrupt++;
+		addBytes(addr, next - addr, INSP_BYTES_CORRUPT);
+		addr = next;
+	}
+
+	if(true == bActive)
+	{
+		/* a full page is overflowed by the next write, like after the search of nvm_init */
+		Result.writePointer = (addr >= pageEndAddr) ? (pageEndAddr - BLOCK_HEADER_HALF_SIZE) : addr;
+		markLiveRecords(first, RecordCount);
+	}
+
+	addBytes(pageAddr, PAGE_HEADER_SIZE, (true == bActive) ? INSP_BYTES_LIVE : INSP_BYTES_STALE);
+	addBytes(addr, pageEndAddr - addr, INSP_BYTES_ERASED);
+
+	for(idx = first; idx < RecordCount; idx++)
+	{
+		addBytes(Records[idx].addr, Records[idx].size, (true == Records[idx].bLive) ? INSP_BYTES_LIVE : INSP_BYTES_STALE);
+
+		if(INSP_KV_RECORD == Records[idx].bIdx)
+		{
+			Result.kvRecords++;
+			continue;
+		}
+
+		block = &Result.blocks[Records[idx].bIdx];
+		if(0 == block->records)
+		{
+			block->occMin = Records[idx].occCntr;
+			block->occMax = Records[idx].occCntr;
+		}
+		block->occMin = (Records[idx].occCntr < block->occMin) ? Records[idx].occCntr : block->occMin;
+		block->occMax = (Records[idx].occCntr > block->occMax) ? Records[idx].occCntr : block->occMax;
+		block->records++;
+	}
+}
+
+/* Compare the keys of two key-value records */
+static bool isKeyEqual(const InspRecord_t* a, const InspRecord_t* b)
+{
+#ifdef NVM_USE_KV_STORE
+	const uint8_t* headerA = &FlashSimu[a->addr + BLOCK_HEADER_SIZE];
+	const uint8_t* headerB = &FlashSimu[b->addr + BLOCK_HEADER_SIZE];
+
+	return ((a->kvFlags & NVM_KV_FLAG_ID_KEY) == (b->kvFlags & NVM_KV_FLAG_ID_KEY)) && (headerA[0] == headerB[0]) &&
+	       (0 == memcmp(headerA + NVM_KV_HEADER_SIZE, headerB + NVM_KV_HEADER_SIZE, headerA[0]));
+#else
+	(void)a;
+	(void)b;
+	return false;
+#endif
+}
+
+/* Mark the latest instances of the records of the page with data. The record with the biggest occurrence counter is the latest one
+   and the first one wins on equal counters, like into the search after power-on */
+static void markLiveRecords(uint32_t first, uint32_t last)
+{
+	InspRecord_t* record;
+	InspBlock_t* block;
+	uint32_t idx;
+	uint32_t other;
+	bool bLatest;
+
+	for(idx = first; idx < last; idx++)
+	{
+		record = &Records[idx];
+
+		if(INSP_KV_RECORD != record->bIdx)
+		{
+			block = &Result.blocks[record->bIdx];
+			if(record->occCntr > ((INSP_NONE == block->liveRecord) ? 0u : Records[block->liveRecord].occCntr))
+			{
+				block->liveRecord = idx;
+			}
+			continue;
+		}
+
+		bLatest = true;
+		for(other = first; (other < last) && (true == bLatest); other++)
+		{
+			if( (other != idx) && (INSP_KV_RECORD == Records[other].bIdx) && (true == isKeyEqual(record, &Records[other])) &&
+			    ((Records[other].occCntr > record->occCntr) || ((Records[other].occCntr == record->occCntr) && (other < idx))) )
+			{
+				bLatest = false;
+			}
+		}
+
+		if(true == bLatest)
+		{
+#ifdef NVM_USE_KV_STORE
+			/* a tombstone is dropped by the garbage collection */
+			record->bLive = (0 == (record->kvFlags & NVM_KV_FLAG_DELETED));
+#endif
+			Result.kvKeys += (true == record->bLive) ? 1u : 0u;
+			Result.kvTombstones += (true == record->bLive) ? 0u : 1u;
+		}
+	}
+
+	for(idx = 0; idx < eNvmBlockCount; idx++)
+	{
+		if(INSP_NONE != Result.blocks[idx].liveRecord)
+		{
+			Records[Result.blocks[idx].liveRecord].bLive = true;
+		}
+	}
+
+#ifdef NVM_USE_WEAR_BUDGET
+	if(INSP_NONE != Result.blocks[eNvmWearInfo].liveRecord)
+	{
+		NvmWearInfo_t wearInfo;
+
+		memcpy(&wearInfo, &FlashSimu[Records[Result.blocks[eNvmWearInfo].liveRecord].addr + BLOCK_HEADER_SIZE], sizeof(wearInfo));
+		Result.bWearInfo = true;
+		Result.eraseCount = wearInfo.eraseCount;
+		Result.operatingTime = wearInfo.operatingTime;
+	}
+#endif
+}
+
+/* Count the records of the emergency region like nvm_init, which merges the new ones into the NVM area */
+static void inspectEmergency(void)
+{
+#ifdef NVM_USE_EMERGENCY_FLUSH
+	uint32_t addr = NVM_EMERGENCY_START_ADDR;
+	uint32_t bIdx;
+	uint16_t pattern;
+	uint16_t occCntr;
+
+	while((addr + BLOCK_HEADER_SIZE) <= NVM_EMERGENCY_END_ADDR)
+	{
+		memcpy(&pattern, &FlashSimu[addr], BLOCK_HEADER_HALF_SIZE);
+		memcpy(&occCntr, &FlashSimu[addr + BLOCK_HEADER_HALF_SIZE], BLOCK_HEADER_HALF_SIZE);
+
+		/* erased memory or a record, which was not written completely */
+		if( (false == findBlock(pattern, &bIdx)) ||
+		    ((addr + BLOCK_HEADER_SIZE + NvmBlocks[bIdx].size + NVM_CRC_LEN) > NVM_EMERGENCY_END_ADDR) )
+		{
+			break;
+		}
+
+		Result.emergencyRecords++;
+		if( (NVM_EMERGENCY_RECORD_MERGED != occCntr) && (true == isCrcValid(addr, NvmBlocks[bIdx].size)) )
+		{
+			Result.emergencyPending++;
+		}
+
+		addr += BLOCK_HEADER_SIZE + NvmBlocks[bIdx].size + NVM_CRC_LEN;
+	}
+#endif
+}
+
+/* Print the results as text */
+static void printText(FILE* out)
+{
+	const InspBlock_t* block;
+	uint32_t pageAddr;
+	uint32_t idx;
+
+	fprintf(out, "Image          : %s (%s layout, %u bytes from 0x%08X)\n", Params.image,
+	        (INSP_LAYOUT_FLASH == Params.layout) ? "flash" : "area", (unsigned)Result.imageSize, (unsigned)Result.startAddr);
+
+	if(INSP_NONE == Result.activePage)
+	{
+		fprintf(out, "Page with data : none - nvm_init erases the NVM area\n");
+	}
+	else
+	{
+		pageAddr = NVM_MANAGER_START_ADDR + (Result.activePage * LOGICAL_PAGE_SIZE);
+		fprintf(out, "Page with data : 0x%08X (%s), write pointer 0x%08X, %u bytes free\n", (unsigned)pageAddr,
+		        PageStates[Result.pages[Result.activePage].state], (unsigned)Result.writePointer,
+		        (unsigned)(pageAddr + LOGICAL_PAGE_SIZE - Result.writePointer));
+	}
+
+#ifdef NVM_USE_WEAR_BUDGET
+	if(true == Result.bWearInfo)
+	{
+		fprintf(out, "Wear info      : %u page erases (%.1f per sector), operating time %u s\n", (unsigned)Result.eraseCount,
+		        (double)Result.eraseCount / (double)NVM_PAGE_COUNT, (unsigned)Result.operatingTime);
+	}
+	else
+	{
+		fprintf(out, "Wear info      : not found\n");
+	}
+#endif
+#ifdef NVM_USE_KV_STORE
+	fprintf(out, "Key-value store: %u records, %u keys, %u deleted keys\n", (unsigned)Result.kvRecords, (unsigned)Result.kvKeys,
+	        (unsigned)Result.kvTombstones);
+#endif
+#ifdef NVM_USE_EMERGENCY_FLUSH
+	fprintf(out, "Emergency flush: %u records, %u to be merged\n", (unsigned)Result.emergencyRecords, (unsigned)Result.emergencyPending);
+#endif
+	fprintf(out, "Corrupt areas  : %u, %u of them into the page with data\n", (unsigned)Result.corruptCount, (unsigned)Result.activeCorrupt);
+
+	fprintf(out, "\nPage        State    Records  Corrupt  Erased after\n");
+	for(idx = 0; idx < NVM_PAGE_COUNT; idx++)
+	{
+		fprintf(out, "0x%08X  %-8s %7u  %7u  0x%08X\n", (unsigned)(NVM_MANAGER_START_ADDR + (idx * LOGICAL_PAGE_SIZE)),
+		        PageStates[Result.pages[idx].state], (unsigned)Result.pages[idx].records, (unsigned)Result.pages[idx].corrupt,
+		        (unsigned)Result.pages[idx].endAddr);
+	}
+
+	fprintf(out, "\nSector         Live    Stale  Corrupt   Erased\n");
+	for(idx = 0; idx < NVM_SECTOR_COUNT; idx++)
+	{
+		fprintf(out, "0x%08X  %7u  %7u  %7u  %7u\n", (unsigned)(NVM_MANAGER_START_ADDR + (idx * FLASH_SECTOR_SIZE)),
+		        (unsigned)Result.sectors[idx].bytes[INSP_BYTES_LIVE], (unsigned)Result.sectors[idx].bytes[INSP_BYTES_STALE],
+		        (unsigned)Result.sectors[idx].bytes[INSP_BYTES_CORRUPT], (unsigned)Result.sectors[idx].bytes[INSP_BYTES_ERASED]);
+	}
+
+	fprintf(out, "\nBlock               Size  Records  Occurrences  Latest\n");
+	for(idx = 0; idx < eNvmBlockCount; idx++)
+	{
+		block = &Result.blocks[idx];
+		fprintf(out, "%-18s %5u  %7u", BlockNames[idx], (unsigned)NvmBlocks[idx].size, (unsigned)block->records);
+
+		if(0 == block->records)
+		{
+			fprintf(out, "  -            -\n");
+		}
+		else if(INSP_NONE == block->liveRecord)
+		{
+			fprintf(out, "  %5u-%-5u  -\n", (unsigned)block->occMin, (unsigned)block->occMax);
+		}
+		else
+		{
+			fprintf(out, "  %5u-%-5u  0x%08X (%u)\n", (unsigned)block->occMin, (unsigned)block->occMax,
+			        (unsigned)Records[block->liveRecord].addr, (unsigned)Records[block->liveRecord].occCntr);
+		}
+	}
+
+	if(0 < Result.corruptCount)
+	{
+		fprintf(out, "\nCorrupt area  Size\n");
+		for(idx = 0; (idx < Result.corruptCount) && (idx < INSP_MAX_CORRUPT); idx++)
+		{
+			fprintf(out, "0x%08X    %u\n", (unsigned)Result.corrupt[idx].addr, (unsigned)Result.corrupt[idx].size);
+		}
+		if(Result.corruptCount > INSP_MAX_CORRUPT)
+		{
+			fprintf(out, "... %u more\n", (unsigned)(Result.corruptCount - INSP_MAX_CORRUPT));
+		}
+	}
+}
+
+/* Print the results as JSON */
+static void printJson(FILE* out)
+{
+	const InspBlock_t* block;
+	uint32_t pageAddr = NVM_MANAGER_START_ADDR + (Result.activePage * LOGICAL_PAGE_SIZE);
+	uint32_t idx;
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"tool\": \"nvm_image_inspector\",\n");
+	fprintf(out, "  \"image\": \"%s\", \"layout\": \"%s\", \"size\": %u, \"start_address\": %u,\n", Params.image,
+	        (INSP_LAYOUT_FLASH == Params.layout) ? "flash" : "area", (unsigned)Result.imageSize, (unsigned)Result.startAddr);
+
+	if(INSP_NONE == Result.activePage)
+	{
+		fprintf(out, "  \"active_page\": null, \"write_pointer\": null, \"free_bytes\": 0,\n");
+	}
+	else
+	{
+		fprintf(out, "  \"active_page\": %u, \"write_pointer\": %u, \"free_bytes\": %u,\n", (unsigned)pageAddr,
+		        (unsigned)Result.writePointer, (unsigned)(pageAddr + LOGICAL_PAGE_SIZE - Result.writePointer));
+	}
+
+	fprintf(out, "  \"wear_info\": %s, \"erase_count\": %u, \"erases_per_sector\": %.2f, \"operating_time_s\": %u,\n",
+	        (true == Result.bWearInfo) ? "true" : "false", (unsigned)Result.eraseCount, (double)Result.eraseCount / (double)NVM_PAGE_COUNT,
+	        (unsigned)Result.operatingTime);
+	fprintf(out, "  \"kv_records\": %u, \"kv_keys\": %u, \"kv_deleted_keys\": %u, \"emergency_records\": %u, \"emergency_pending\": %u,\n",
+	        (unsigned)Result.kvRecords, (unsigned)Result.kvKeys, (unsigned)Result.kvTombstones, (unsigned)Result.emergencyRecords,
+	        (unsigned)Result.emergencyPending);
+	fprintf(out, "  \"corrupt_areas\": %u, \"active_corrupt_areas\": %u,\n", (unsigned)Result.corruptCount, (unsigned)Result.activeCorrupt);
+
+	fprintf(out, "  \"pages\": [\n");
+	for(idx = 0; idx < NVM_PAGE_COUNT; idx++)
+	{
+		fprintf(out, "    {\"address\": %u, \"state\": \"%s\", \"records\": %u, \"corrupt\": %u, \"erased_after\": %u}%s\n",
+		        (unsigned)(NVM_MANAGER_START_ADDR + (idx * LOGICAL_PAGE_SIZE)), PageStates[Result.pages[idx].state],
+		        (unsigned)Result.pages[idx].records, (unsigned)Result.pages[idx].corrupt, (unsigned)Result.pages[idx].endAddr,
+		        ((idx + 1) < NVM_PAGE_COUNT) ? "," : "");
+	}
+	fprintf(out, "  ],\n");
+
+	fprintf(out, "  \"sectors\": [\n");
+	for(idx = 0; idx < NVM_SECTOR_COUNT; idx++)
+	{
+		fprintf(out, "    {\"address\": %u, \"live\": %u, \"stale\": %u, \"corrupt\": %u, \"erased\": %u}%s\n",
+		        (unsigned)(NVM_MANAGER_START_ADDR + (idx * FLASH_SECTOR_SIZE)), (unsigned)Result.sectors[idx].bytes[INSP_BYTES_LIVE],
+		        (unsigned)Result.sectors[idx].bytes[INSP_BYTES_STALE], (unsigned)Result.sectors[idx].bytes[INSP_BYTES_CORRUPT],
+		        (unsigned)Result.sectors[idx].bytes[INSP_BYTES_ERASED], ((idx + 1) < NVM_SECTOR_COUNT) ? "," : "");
+	}
+	fprintf(out, "  ],\n");
+
+	fprintf(out, "  \"blocks\": [\n");
+	for(idx = 0; idx < eNvmBlockCount; idx++)
+	{
+		block = &Result.blocks[idx];
+		fprintf(out, "    {\"name\": \"%s\", \"size\": %u, \"records\": %u, \"occurrence_min\": %u, \"occurrence_max\": %u, ", BlockNames[idx],
+		        (unsigned)NvmBlocks[idx].size, (unsigned)block->records, (unsigned)block->occMin, (unsigned)block->occMax);
+		if(INSP_NONE == block->liveRecord)
+		{
+			fprintf(out, "\"latest_address\": null, \"latest_occurrence\": null}");
+		}
+		else
+		{
+			fprintf(out, "\"latest_address\": %u, \"latest_occurrence\": %u}", (unsigned)Records[block->liveRecord].addr,
+			        (unsigned)Records[block->liveRecord].occCntr);
+		}
+		fprintf(out, "%s\n", ((idx + 1) < eNvmBlockCount) ? "," : "");
+	}
+	fprintf(out, "  ],\n");
+
+	fprintf(out, "  \"corrupt\": [");
+	for(idx = 0; (idx < Result.corruptCount) && (idx < INSP_MAX_CORRUPT); idx++)
+	{
+		fprintf(out, "%s{\"address\": %u, \"size\": %u}", (0 < idx) ? ", " : "", (unsigned)Result.corrupt[idx].addr,
+		        (unsigned)Result.corrupt[idx].size);
+	}
+	fprintf(out, "]\n");
+	fprintf(out, "}\n");
+}
@@ -0,0 +1,620 @@
+/*
+ ============================================================================
+ Name        : lifetime_sim.c
+ Author      : Martin Patarinski
+ Version     :
+ Copyright   : Open source. Further copyright shall be approved by the author
+ Description : Monte Carlo simulation of the lifetime of many devices with
+               the NVManager. Every device runs a stochastic workload with
+               power cuts for simulated years. The distributions of the time
+               until the first worn sector, the write amplification and the
+               recovery time are printed as JSON
+ ============================================================================
+ */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L /* fork, waitpid, sysconf */
+#define LIFE_USE_FORK // the devices are simulated by parallel worker processes
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef LIFE_USE_FORK
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "stubs/stubs.h"
+#include "src/nvm.h"
+
+#define LIFE_DEFAULT_DEVICES       64
+#define LIFE_DEFAULT_YEARS         5.0
+#define LIFE_DEFAULT_RATE          500.0  // mean nvm_write calls per day of a device
+#define LIFE_DEFAULT_SPREAD        0.5    // sigma of the lognormal usage of the devices
+#define LIFE_DEFAULT_CUTS          12.0   // power cuts per year
+#define LIFE_DEFAULT_ZIPF_S        1.0
+#define LIFE_DEFAULT_SEED          1
+#define LIFE_UNCHANGED_PERCENT     10     // writes of unchanged data, i.e. a setting written again with the same value
+#define LIFE_MAX_JOBS              256
+#define LIFE_SECONDS_PER_YEAR      31557600.0
+#define LIFE_MAX_YEARS             100.0  // SysTime_getSeconds is 32-bit
+#define LIFE_NEVER_YEARS           1.0e9  // no sector is erased, so it never wears out
+#ifdef NVM_USE_WEAR_BUDGET
+#define LIFE_DEFAULT_ENDURANCE     NVM_RATED_ERASE_CYCLES
+#else
+#define LIFE_DEFAULT_ENDURANCE     100000uL
+#endif
+#define LIFE_BLOCK_COUNT           15     // eNvmBlock1..eNvmBlock15
+
+/* A type for the parameters of a simulation */
+typedef struct
+{
+	uint32_t devices;          /* simulated devices */
+	double years;              /* simulated time of every device */
+	double rate;               /* mean writes per day */
+	double spread;             /* sigma of the lognormal distribution of the writes per day between the devices */
+	double cutsPerYear;        /* mean power cuts per year */
+	double zipfS;              /* exponent of the Zipf distribution of the blocks */
+	uint32_t endurance;        /* erase cycles of a sector */
+	uint32_t seed;             /* seed of the random generator, so the runs are reproducible */
+	uint32_t jobs;             /* parallel worker processes */
+	const char* output;        /* JSON file or NULL for stdout */
+} LifeParams_t;
+
+/* A type for the result of one device */
+typedef struct
+{
+	double wornYears;          /* time until the first sector reaches the endurance */
+	bool bWornReached;         /* false if wornYears is extrapolated from the erase rate at the end of the simulation */
+	double writeAmplification; /* programmed flash bytes per requested data byte */
+	uint32_t writes;
+	uint32_t powerCuts;        /* reboots after a power cut */
+	uint32_t tornWrites;       /* power cuts, which have interrupted a program operation */
+	uint32_t corruptions;      /* blocks, which are not recovered with the data of a write */
+	uint32_t rolledBackWrites; /* completed writes, which are lost by a power cut, i.e. deferred by the endurance budget */
+} LifeDevice_t;
+
+/* A type for the results of a worker process */
+typedef struct
+{
+	FILE* devices;             /* LifeDevice_t of every simulated device */
+	FILE* recoveries;          /* recovery time of every power cut in us (uint32_t) */
+} LifeWorker_t;
+
+static LifeParams_t Params = { LIFE_DEFAULT_DEVICES, LIFE_DEFAULT_YEARS, LIFE_DEFAULT_RATE, LIFE_DEFAULT_SPREAD, LIFE_DEFAULT_CUTS,
+                               LIFE_DEFAULT_ZIPF_S, LIFE_DEFAULT_ENDURANCE, LIFE_DEFAULT_SEED, 1, NULL };
+
+/* Blocks of the workload from the most to the least frequent one - the counters of the coffee machine are the hottest */
+static const NvmBlocksId_t LifeBlocks[LIFE_BLOCK_COUNT] = {
+	eNvmBlock3, eNvmBlock14, eNvmBlock4, eNvmBlock5, eNvmBlock6, eNvmBlock8, eNvmBlock7, eNvmBlock9,
+	eNvmBlock2, eNvmBlock10, eNvmBlock11, eNvmBlock1, eNvmBlock15, eNvmBlock13, eNvmBlock12
+};
+static double ZipfCdf[LIFE_BLOCK_COUNT];
+
+/* Data of the application. The buffers stay valid, because a deferred write is programmed later from them */
+static uint8_t BlockData[eNvmBlockCount][MAX_DR_SIZE];
+static uint32_t BlockVersion[eNvmBlockCount];   /* latest written version, 0 means never written */
+static uint32_t BlockVerified[eNvmBlockCount];  /* version read after the latest power cut */
+
+static uint32_t RandomState = 1;
+
+static bool parseArgs(int argc, char* argv[]);
+static uint32_t lifeRandom(void);
+static double lifeUniform(void);
+static double lifeNormal(void);
+static void generateData(NvmBlocksId_t bIdx, uint32_t version, uint8_t* data);
+static bool recoverBlock(NvmBlocksId_t bIdx, LifeDevice_t* result);
+static uint32_t reboot(LifeDevice_t* result);
+static void simulateDevice(uint32_t devIdx, LifeDevice_t* result, FILE* recoveries);
+static void runWorker(uint32_t workerIdx, const LifeWorker_t* worker);
+static int compareDouble(const void* a, const void* b);
+static double percentile(const double* sorted, uint32_t count, uint32_t percent);
+static void printDistribution(FILE* out, const char* name, double* values, uint32_t count, const char* format, bool bLast);
+
+/* main function of the simulation */
+int main(int argc, char* argv[])
+{
+	LifeWorker_t workers[LIFE_MAX_JOBS];
+	LifeDevice_t device;
+	FILE* out = stdout;
+	double* wornYears;
+	double* amplification;
+	double* recoveryUs = NULL;
+	uint32_t recoveryCount = 0;
+	uint32_t recovery;
+	uint32_t deviceCount = 0;
+	uint32_t wornReached = 0;
+	uint32_t writes = 0;
+	uint32_t powerCuts = 0;
+	uint32_t tornWrites = 0;
+	uint32_t corruptions = 0;
+	uint32_t rolledBackWrites = 0;
+	uint32_t idx;
+	double sum = 0.0;
+#ifdef LIFE_USE_FORK
+	pid_t pid;
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+	Params.jobs = (cores > 0) ? (uint32_t)cores : 1;
+#endif
+
+	if(false == parseArgs(argc, argv))
+	{
+		fprintf(stderr, "Usage: %s [--devices N] [--years Y] [--rate WRITES_PER_DAY] [--spread SIGMA] [--cuts PER_YEAR] [--zipf S]\n"
+		                "          [--endurance CYCLES] [--seed N] [--jobs N] [--output FILE]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Params.jobs = (Params.jobs < Params.devices) ? Params.jobs : Params.devices;
+	Params.jobs = (Params.jobs < LIFE_MAX_JOBS) ? Params.jobs : LIFE_MAX_JOBS;
+
+	/* the block with the lowest index is the most frequent one */
+	for(idx = 0; idx < LIFE_BLOCK_COUNT; idx++)
+	{
+		sum += 1.0 / pow((double)(idx + 1), Params.zipfS);
+		ZipfCdf[idx] = sum;
+	}
+	for(idx = 0; idx < LIFE_BLOCK_COUNT; idx++)
+	{
+		ZipfCdf[idx] /= sum;
+	}
+
+	/* every worker simulates every jobs-th device, so the results do not depend on the number of workers */
+	for(idx = 0; idx < Params.jobs; idx++)
+	{
+		workers[idx].devices = tmpfile();
+		workers[idx].recoveries = tmpfile();
+		if( (NULL == workers[idx].devices) || (NULL == workers[idx].recoveries) )
+		{
+			fprintf(stderr, "Can't create the result files!\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	for(idx = 0; idx < Params.jobs; idx++)
+	{
+#ifdef LIFE_USE_FORK
+		/* the NVManager and the flash simulator are not reentrant, so every worker is a process with its own instance of them */
+		pid = fork();
+		if(0 == pid)
+		{
+			runWorker(idx, &workers[idx]);
+			_exit(EXIT_SUCCESS);
+		}
+		else if(pid < 0)
+		{
+			runWorker(idx, &workers[idx]);
+		}
+#else
+		runWorker(idx, &workers[idx]);
+#endif
+	}
+#ifdef LIFE_USE_FORK
+	while(wait(NULL) > 0)
+	{
+		/* wait for all workers */
+	}
+#endif
+
+	wornYears = (double*)malloc(sizeof(double) * Params.devices);
+	amplification = (double*)malloc(sizeof(double) * Params.devices);
+	if( (NULL == wornYears) || (NULL == amplification) )
+	{
+		return EXIT_FAILURE;
+	}
+
+	for(idx = 0; idx < Params.jobs; idx++)
+	{
+		rewind(workers[idx].devices);
+		while( (deviceCount < Params.devices) && (1 == fread(&device, sizeof(device), 1, workers[idx].devices)) )
+		{
+			wornYears[deviceCount] = device.wornYears;
+			amplification[deviceCount] = device.writeAmplification;
+			deviceCount++;
+			wornReached += (true == device.bWornReached) ? 1 : 0;
+			writes += device.writes;
+			powerCuts += device.powerCuts;
+			tornWrites += device.tornWrites;
+			corruptions += device.corruptions;
+			rolledBackWrites += device.rolledBackWrites;
+		}
+		fclose(workers[idx].devices);
+
+		rewind(workers[idx].recoveries);
+		while(1 == fread(&recovery, sizeof(recovery), 1, workers[idx].recoveries))
+		{
+			if(0 == (recoveryCount % 1024))
+			{
+				recoveryUs = (double*)realloc(recoveryUs, sizeof(double) * (recoveryCount + 1024));
+				if(NULL == recoveryUs)
+				{
+					return EXIT_FAILURE;
+				}
+			}
+			recoveryUs[recoveryCount++] = (double)recovery;
+		}
+		fclose(workers[idx].recoveries);
+	}
+
+	if(deviceCount != Params.devices)
+	{
+		fprintf(stderr, "Only %u of %u devices are simulated!\n", (unsigned)deviceCount, (unsigned)Params.devices);
+		return EXIT_FAILURE;
+	}
+
+	if(NULL != Params.output)
+	{
+		out = fopen(Params.output, "w");
+		if(NULL == out)
+		{
+			fprintf(stderr, "Can't open %s!\n", Params.output);
+			return EXIT_FAILURE;
+		}
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"benchmark\": \"nvm_lifetime\",\n");
+	fprintf(out, "  \"parameters\": {\"devices\": %u, \"years\": %.2f, \"writes_per_day\": %.1f, \"spread\": %.2f, \"cuts_per_year\": %.1f, "
+	             "\"zipf_s\": %.2f, \"endurance\": %u, \"seed\": %u, \"jobs\": %u},\n",
+	        (unsigned)Params.devices, Params.years, Params.rate, Params.spread, Params.cutsPerYear, Params.zipfS, (unsigned)Params.endurance,
+	        (unsigned)Params.seed, (unsigned)Params.jobs);
+	fprintf(out, "  \"writes\": %u, \"power_cuts\": %u, \"torn_writes\": %u, \"corruptions\": %u, \"rolled_back_writes\": %u,\n",
+	        (unsigned)writes, (unsigned)powerCuts, (unsigned)tornWrites, (unsigned)corruptions, (unsigned)rolledBackWrites);
+	fprintf(out, "  \"worn_within_simulation\": %u,\n", (unsigned)wornReached);
+	printDistribution(out, "time_to_first_worn_sector_years", wornYears, deviceCount, "%.2f", false);
+	printDistribution(out, "write_amplification", amplification, deviceCount, "%.3f", false);
+	printDistribution(out, "recovery_time_us", recoveryUs, recoveryCount, "%.0f", true);
+	fprintf(out, "}\n");
+
+	if(stdout != out)
+	{
+		fclose(out);
+	}
+	free(wornYears);
+	free(amplification);
+	free(recoveryUs);
+
+	return (0 == corruptions) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Parse the command line into the parameters of the simulation */
+static bool parseArgs(int argc, char* argv[])
+{
+	int idx;
+
+	for(idx = 1; idx < argc; idx++)
+	{
+		if( (0 == strcmp(argv[idx], "--devices")) && ((idx + 1) < argc) )
+		{
+			Params.devices = (uint32_t)strtoul(argv[++idx], NULL, 0);
+		}
+		else if( (0 == strcmp(argv[idx], "--years")) && ((idx + 1) < argc) )
+		{
+			Params.years = strtod(argv[++idx], NULL);
+		}
+		else if( (0 == strcmp(argv[idx], "--rate")) && ((idx + 1) < argc) )
+		{
+			Params.rate = strtod(argv[++idx], NULL);
+		}
+		else if( (0 == strcmp(argv[idx], "--spread")) && ((idx + 1) < argc) )
+		{
+			Params.spread = strtod(argv[++idx], NULL);
+		}
+		else if( (0 == strcmp(argv[idx], "--cuts")) && ((idx + 1) < argc) )
+		{
+			Params.cutsPerYear = strtod(argv[++idx], NULL);
+		}
+		else if( (0 == strcmp(argv[idx], "--zipf")) && ((idx + 1) < argc) )
+		{
+			Params.zipfS = strtod(argv[++idx], NULL);
+		}
+		else if( (0 == strcmp(argv[idx], "--endurance")) && ((idx + 1) < argc) )
+		{
+			Params.endurance = (uint32_t)strtoul(argv[++idx], NULL, 0);
+		}
+		else if( (0 == strcmp(argv[idx], "--seed")) && ((idx + 1) < argc) )
+		{
+			Params.seed = (uint32_t)strtoul(argv[++idx], NULL, 0);
+		}
+		else if( (0 == strcmp(argv[idx], "--jobs")) && ((idx + 1) < argc) )
+		{
+			Params.jobs = (uint32_t)strtoul(argv[++idx], NULL, 0);
+		}
+		else if( (0 == strcmp(argv[idx], "--output")) && ((idx + 1) < argc) )
+		{
+			Params.output = argv[++idx];
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return (0 < Params.devices) && (0 < Params.jobs) && (0.0 < Params.years) && (LIFE_MAX_YEARS >= Params.years) &&
+	       (0.0 < Params.rate) && (0.0 <= Params.cutsPerYear) && (0 < Params.endurance);
+}
+
+/* Random generator of the simulation (xorshift32) */
+static uint32_t lifeRandom(void)
+{
+	RandomState ^= RandomState << 13;
+	RandomState ^= RandomState >> 17;
+	RandomState ^= RandomState << 5;
+
+	return RandomState;
+}
+
+/* Uniform random number in (0, 1) */
+static double lifeUniform(void)
+{
+	return ((double)lifeRandom() + 0.5) / 4294967296.0;
+}
+
+/* Standard normal random number (Box-Muller) */
+static double lifeNormal(void)
+{
+	double u1 = lifeUniform();
+	double u2 = lifeUniform();
+
+	return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+}
+
+/* Generate the data of a version of a block. The version is at the beginning of the data, little-endian,
+   so it is recognized after the recovery */
+static void generateData(NvmBlocksId_t bIdx, uint32_t version, uint8_t* data)
+{
+	uint32_t state = (version * 2654435761u) ^ ((uint32_t)(bIdx + 1) * 0x85EBCA6Bu);
+	uint32_t idx;
+
+	state = (0 != state) ? state : 1;
+
+	for(idx = 0; idx < NvmBlocks[bIdx].size; idx++)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		data[idx] = (idx < sizeof(version)) ? (uint8_t)(version >> (idx * 8)) : (uint8_t)state;
+	}
+}
+
+/* Read a block after a power cut. It has to contain a version between the one read after the previous power cut
+   and the latest written one. The application continues with the recovered version */
+static bool recoverBlock(NvmBlocksId_t bIdx, LifeDevice_t* result)
+{
+	uint8_t readData[MAX_DR_SIZE];
+	uint16_t readSize = 0;
+	uint32_t versionBits = (NvmBlocks[bIdx].size < sizeof(uint32_t)) ? (NvmBlocks[bIdx].size * 8) : 32;
+	uint32_t versionMask = (32 == versionBits) ? 0xFFFFFFFFu : ((1u << versionBits) - 1u);
+	uint32_t version = 0;
+	uint32_t idx;
+
+	if(false == nvm_read(bIdx, readData, &readSize))
+	{
+		/* only a block without a verified version may be missing */
+		if(0 != BlockVerified[bIdx])
+		{
+			return false;
+		}
+	}
+	else
+	{
+		for(idx = 0; idx < (versionBits / 8); idx++)
+		{
+			version |= (uint32_t)readData[idx] << (idx * 8);
+		}
+
+		/* the latest version, which ends with the stored bits */
+		version = BlockVersion[bIdx] - ((BlockVersion[bIdx] - version) & versionMask);
+		if( (version < BlockVerified[bIdx]) || (version > BlockVersion[bIdx]) )
+		{
+			return false;
+		}
+
+		generateData(bIdx, version, BlockData[bIdx]);
+		if(0 != memcmp(readData, BlockData[bIdx], NvmBlocks[bIdx].size))
+		{
+			return false;
+		}
+	}
+
+	result->rolledBackWrites += BlockVersion[bIdx] - version;
+	BlockVersion[bIdx] = version;
+	BlockVerified[bIdx] = version;
+	generateData(bIdx, version, BlockData[bIdx]);
+
+	return true;
+}
+
+/* Switch the power on after a cut, initialize the NVManager and check all blocks. Returns the recovery time in us */
+static uint32_t reboot(LifeDevice_t* result)
+{
+	uint32_t startTime;
+	uint32_t recoveryUs;
+	uint32_t idx;
+
+	FlsSimu_setPowerCut(FLS_SIMU_POWER_ON);
+
+	/* the RAM of the NVManager is lost */
+	memset(&NvmManagerDescriptor, 0, sizeof(NvmManagerDescriptor));
+
+	startTime = SysTime_getMicroseconds();
+	nvm_init();
+	recoveryUs = SysTime_getMicroseconds() - startTime;
+
+	for(idx = 0; idx < LIFE_BLOCK_COUNT; idx++)
+	{
+		if(false == recoverBlock(LifeBlocks[idx], result))
+		{
+			result->corruptions++;
+		}
+	}
+	result->powerCuts++;
+
+	return recoveryUs;
+}
+
+/* Simulate one device from erased flash until the end of the simulated time or until the first sector is worn */
+static void simulateDevice(uint32_t devIdx, LifeDevice_t* result, FILE* recoveries)
+{
+	const double endTime = Params.years * LIFE_SECONDS_PER_YEAR;
+	FlsSimu_Stats_t flash;
+	NvmBlocksId_t bIdx;
+	double simTime = 0.0;
+	double meanIntervalS;
+	double requestedBytes = 0.0;
+	uint32_t maxErases = 0;
+	uint32_t recoveryUs;
+	uint32_t idx;
+	bool bCut;
+
+	/* every device has its own random sequence */
+	RandomState = (Params.seed * 0x9E3779B9u) ^ ((devIdx + 1) * 0x85EBCA6Bu);
+	RandomState = (0 != RandomState) ? RandomState : 1;
+
+	/* the usage of the devices is lognormal distributed around the mean rate */
+	meanIntervalS = 86400.0 / (Params.rate * exp((Params.spread * lifeNormal()) - (0.5 * Params.spread * Params.spread)));
+
+	memset(result, 0, sizeof(LifeDevice_t));
+	memset(BlockData, 0, sizeof(BlockData));
+	memset(BlockVersion, 0, sizeof(BlockVersion));
+	memset(BlockVerified, 0, sizeof(BlockVerified));
+	SysTimeSimu = 0;
+	FlsDrv_Init();
+	nvm_init();
+
+	while(simTime < endTime)
+	{
+		/* exponential time between two writes, the cyclic tasks of the application run meanwhile */
+		simTime -= meanIntervalS * log(lifeUniform());
+		SysTimeSimu = (uint32_t)simTime;
+#ifdef NVM_USE_WEAR_BUDGET
+		nvm_write_step();
+#endif
+#ifdef NVM_USE_BACKGROUND_ERASE
+		nvm_erase_step();
+#endif
+
+		/* a power cut of the interval hits the next write at a random byte of it or of its garbage collection.
+		   It is after the write, if the write programs less */
+		bCut = (lifeUniform() < (1.0 - exp(-(Params.cutsPerYear * meanIntervalS) / LIFE_SECONDS_PER_YEAR)));
+
+		for(idx = 0; (idx < (LIFE_BLOCK_COUNT - 1)) && (lifeUniform() >= ZipfCdf[idx]); idx++)
+		{
+			/* search the block of the random number */
+		}
+		bIdx = LifeBlocks[idx];
+
+		if(true == bCut)
+		{
+			FlsSimu_setPowerCut(lifeRandom() % (2 * (BLOCK_HEADER_SIZE + NvmBlocks[bIdx].size + NVM_CRC_LEN)));
+		}
+
+		if((lifeRandom() % 100) >= LIFE_UNCHANGED_PERCENT)
+		{
+			BlockVersion[bIdx]++;
+			generateData(bIdx, BlockVersion[bIdx], BlockData[bIdx]);
+		}
+
+		if(true == nvm_write(bIdx, BlockData[bIdx], (uint16_t)NvmBlocks[bIdx].size))
+		{
+			requestedBytes += NvmBlocks[bIdx].size;
+		}
+		result->writes++;
+
+		if(true == bCut)
+		{
+			recoveryUs = reboot(result);
+			fwrite(&recoveryUs, sizeof(recoveryUs), 1, recoveries);
+		}
+
+		FlsSimu_getStats(&flash);
+		for(idx = 0; idx < FLS_SIMU_SECTOR_COUNT; idx++)
+		{
+			maxErases = (flash.sectorErases[idx] > maxErases) ? flash.sectorErases[idx] : maxErases;
+		}
+
+		if(maxErases >= Params.endurance)
+		{
+			result->bWornReached = true;
+			break;
+		}
+	}
+
+	FlsSimu_getStats(&flash);
+	result->tornWrites = flash.powerCuts;
+	result->writeAmplification = (requestedBytes > 0.0) ? ((double)flash.programBytes / requestedBytes) : 0.0;
+
+	/* the time until the endurance is reached is projected with the erase rate of the hottest sector */
+	if(true == result->bWornReached)
+	{
+		result->wornYears = simTime / LIFE_SECONDS_PER_YEAR;
+	}
+	else if(0 < maxErases)
+	{
+		result->wornYears = ((simTime / LIFE_SECONDS_PER_YEAR) * (double)Params.endurance) / (double)maxErases;
+	}
+	else
+	{
+		result->wornYears = LIFE_NEVER_YEARS;
+	}
+}
+
+/* Simulate the devices of a worker and write their results into its files */
+static void runWorker(uint32_t workerIdx, const LifeWorker_t* worker)
+{
+	LifeDevice_t result;
+	uint32_t devIdx;
+
+	for(devIdx = workerIdx; devIdx < Params.devices; devIdx += Params.jobs)
+	{
+		simulateDevice(devIdx, &result, worker->recoveries);
+		fwrite(&result, sizeof(result), 1, worker->devices);
+	}
+
+	fflush(worker->devices);
+	fflush(worker->recoveries);
+}
+
+/* Comparison of two values for qsort */
+static int compareDouble(const void* a, const void* b)
+{
+	double valA = *(const double*)a;
+	double valB = *(const double*)b;
+
+	return (valA > valB) - (valA < valB);
+}
+
+/* Percentile of sorted values (nearest rank) */
+static double percentile(const double* sorted, uint32_t count, uint32_t percent)
+{
+	return sorted[((count - 1) * percent) / 100];
+}
+
+/* Print the minimum, the percentiles and the maximum of the values */
+static void printDistribution(FILE* out, const char* name, double* values, uint32_t count, const char* format, bool bLast)
+{
+	const uint32_t percents[] = { 1, 10, 50, 90, 99 };
+	uint32_t idx;
+
+	fprintf(out, "  \"%s\": {\"count\": %u", name, (unsigned)count);
+
+	if(0 < count)
+	{
+		qsort(values, count, sizeof(double), compareDouble);
+
+		fprintf(out, ", \"min\": ");
+		fprintf(out, format, values[0]);
+		for(idx = 0; idx < (sizeof(percents) / sizeof(percents[0])); idx++)
+		{
+			fprintf(out, ", \"p%u\": ", (unsigned)percents[idx]);
+			fprintf(out, format, percentile(values, count, percents[idx]));
+		}
+		fprintf(out, ", \"max\": ");
+		fprintf(out, format, values[count - 1]);
+	}
+
+	fprintf(out, "}%s\n", (true == bLast) ? "" : ",");
+}
@@ -0,0 +1,203 @@
+/*
+ ============================================================================
+ Name        : pattern_seed.c
+ Author      : Martin Patarinski
+ Version     :
+ Copyright   : Open source. Further copyright shall be approved by the author
+ Description : Finder of the seed of the hash index of the block patterns.
+               The patterns are expanded from NVM_BLOCK_LIST of this build
+               (nvm_cfg.h) and the first odd multiplier, which maps them to
+               different entries of NVM_PATTERN_INDEX_SIZE, is printed as
+               NVM_PATTERN_HASH_SEED. The NVManager is not linked, so the
+               tool builds also when the current seed fails the build of
+               nvm_cfg.c
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "src/nvm_cfg.h"
+
+#define SEED_FIRST                 0x9E3779B1u // 2^32 divided by the golden ratio (Fibonacci hashing)
+#define SEED_MAX_TRIES             0x01000000u
+
+/* A type for the parameters of the finder */
+typedef struct
+{
+	bool bCheck;               /* only check NVM_PATTERN_HASH_SEED */
+	uint32_t firstSeed;        /* the search starts from this multiplier */
+} SeedParams_t;
+
+static SeedParams_t Params = { false, SEED_FIRST };
+
+/* The patterns of all logical blocks in the order of NvmBlocksId_t */
+#define SEED_BLOCK_PATTERN(name, pattern, size)  (pattern),
+static const uint16_t Patterns[] = { NVM_BLOCK_LIST(SEED_BLOCK_PATTERN) };
+#define SEED_BLOCK_NAME(name, pattern, size)     #name,
+static const char* BlockNames[] = { NVM_BLOCK_LIST(SEED_BLOCK_NAME) };
+
+static bool parseArgs(int argc, char* argv[]);
+static uint32_t getSlot(uint16_t pattern, uint32_t seed);
+static bool checkPatterns(void);
+static bool isSeedValid(uint32_t seed, bool bReport);
+
+/* main function of the finder */
+int main(int argc, char* argv[])
+{
+	uint32_t seed = 0;
+	uint32_t tries;
+
+	if(false == parseArgs(argc, argv))
+	{
+		fprintf(stderr, "Usage: %s [--check] [--first SEED]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if( (0 != (NVM_PATTERN_INDEX_SIZE & (NVM_PATTERN_INDEX_SIZE - 1))) || (eNvmBlockCount > NVM_PATTERN_INDEX_SIZE) )
+	{
+		fprintf(stderr, "NVM_PATTERN_INDEX_SIZE (%u) has to be a power of two and at least %u!\n", (unsigned)NVM_PATTERN_INDEX_SIZE,
+		        (unsigned)eNvmBlockCount);
+		return EXIT_FAILURE;
+	}
+
+	/* a duplicate pattern collides with every seed */
+	if(false == checkPatterns())
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(true == Params.bCheck)
+	{
+		if(false == isSeedValid(NVM_PATTERN_HASH_SEED, true))
+		{
+			fprintf(stderr, "NVM_PATTERN_HASH_SEED 0x%08X has collisions, run %s for a new one!\n", (unsigned)NVM_PATTERN_HASH_SEED, argv[0]);
+			return EXIT_FAILURE;
+		}
+
+		printf("NVM_PATTERN_HASH_SEED 0x%08X maps %u patterns to %u entries without collisions\n", (unsigned)NVM_PATTERN_HASH_SEED,
+		       (unsigned)eNvmBlockCount, (unsigned)NVM_PATTERN_INDEX_SIZE);
+		return EXIT_SUCCESS;
+	}
+
+	/* only odd multipliers keep all bits of the pattern */
+	for(tries = 0; tries < SEED_MAX_TRIES; tries++)
+	{
+		seed = (Params.firstSeed | 1u) + (tries * 2u);
+		if(true == isSeedValid(seed, false))
+		{
+			break;
+		}
+	}
+
+	if(SEED_MAX_TRIES == tries)
+	{
+		fprintf(stderr, "No seed found, increase NVM_PATTERN_INDEX_SIZE!\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("#define NVM_PATTERN_HASH_SEED       0x%08Xu\n", (unsigned)seed);
+
+	return EXIT_SUCCESS;
+}
+
+/* Parse the command line into the parameters of the finder */
+static bool parseArgs(int argc, char* argv[])
+{
+	int idx;
+	char* end;
+
+	for(idx = 1; idx < argc; idx++)
+	{
+		if(0 == strcmp(argv[idx], "--check"))
+		{
+			Params.bCheck = true;
+		}
+		else if( (0 == strcmp(argv[idx], "--first")) && ((idx + 1) < argc) )
+		{
+			idx++;
+			Params.firstSeed = (uint32_t)strtoul(argv[idx], &end, 0);
+			if( (end == argv[idx]) || ('\0' != *end) )
+			{
+				return false;
+			}
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Get the entry of a pattern into the hash index like GET_PATTERN_SLOT with another seed */
+static uint32_t getSlot(uint16_t pattern, uint32_t seed)
+{
+	return (((uint32_t)pattern * seed) >> 16) & (NVM_PATTERN_INDEX_SIZE - 1u);
+}
+
+/* Check that every pattern is used once and is not reserved */
+static bool checkPatterns(void)
+{
+	uint32_t idx;
+	uint32_t other;
+
+	for(idx = 0; idx < eNvmBlockCount; idx++)
+	{
+#ifdef NVM_USE_KV_STORE
+		if(NVM_KV_PATTERN == Patterns[idx])
+		{
+			fprintf(stderr, "%s uses the pattern of the key-value store 0x%04X!\n", BlockNames[idx], (unsigned)Patterns[idx]);
+			return false;
+		}
+#endif
+		if(0xFFFF == Patterns[idx])
+		{
+			fprintf(stderr, "%s uses the pattern of erased flash!\n", BlockNames[idx]);
+			return false;
+		}
+
+		for(other = 0; other < idx; other++)
+		{
+			if(Patterns[other] == Patterns[idx])
+			{
+				fprintf(stderr, "%s and %s have the same pattern 0x%04X!\n", BlockNames[other], BlockNames[idx], (unsigned)Patterns[idx]);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/* Check whether a seed maps all patterns to different entries of the hash index */
+static bool isSeedValid(uint32_t seed, bool bReport)
+{
+	uint16_t entries[NVM_PATTERN_INDEX_SIZE];
+	uint32_t slot;
+	uint32_t idx;
+	bool bValid = true;
+
+	memset(entries, 0, sizeof(entries));
+
+	for(idx = 0; idx < eNvmBlockCount; idx++)
+	{
+		slot = getSlot(Patterns[idx], seed);
+
+		if(0 != entries[slot])
+		{
+			if(false == bReport)
+			{
+				return false;
+			}
+			fprintf(stderr, "%s and %s collide into entry %u\n", BlockNames[entries[slot] - 1], BlockNames[idx], (unsigned)slot);
+			bValid = false;
+			continue;
+		}
+
+		entries[slot] = (uint16_t)(idx + 1);
+	}
+
+	return bValid;
+}
@@ -0,0 +1,499 @@
+/*
+ ============================================================================
+ Name        : powercut_harness.c
+ Author      : Martin Patarinski
+ Version     :
+ Copyright   : Open source. Further copyright shall be approved by the author
+ Description : Power-loss fault injection of the NVManager. The power is cut
+               systematically at every byte of every write and erase of a
+               scenario (a write, a page overflow with garbage collection and
+               the erase of the released page). After every cut the device is
+               rebooted, the blocks are checked against the latest committed
+               data and the mount and recovery times are printed as JSON
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stubs/stubs.h"
+#include "src/nvm.h"
+
+#define CUT_DEFAULT_STRIDE         1      // cut at every byte of a write
+#define CUT_DEFAULT_ERASE_STRIDE   64     // cut at every 64th byte of an erase
+#define CUT_DEFAULT_TORN_BITS      0x5A   // bits of the interrupted byte, which are already programmed or erased
+#define CUT_BLOCK_COUNT            15     // eNvmBlock1..eNvmBlock15
+#define CUT_TARGET_BLOCK           eNvmBlock1 // the biggest block, which is never deferred by the endurance budget
+#define CUT_MAX_SETUP_WRITES       10000
+#define CUT_MAX_REPORTED_FAILURES  10
+
+/* Scenarios of the injection */
+typedef enum
+{
+	CUT_SCENARIO_WRITE,    /* a write into a page with enough space */
+	CUT_SCENARIO_OVERFLOW, /* a write, which overflows the page: erase and garbage collection, then the erase of the released page */
+	CUT_SCENARIO_COUNT
+} CutScenario_t;
+
+/* A type for the parameters of the injection */
+typedef struct
+{
+	int scenario;              /* CutScenario_t or -1 for all */
+	uint32_t stride;           /* distance of the cut points into a write */
+	uint32_t eraseStride;      /* distance of the cut points into an erase */
+	uint8_t tornBits;          /* bits of the interrupted byte, which are changed before the cut */
+	const char* output;        /* JSON file or NULL for stdout */
+} CutParams_t;
+
+/* A type for the results of a scenario */
+typedef struct
+{
+	uint32_t programCuts;      /* cut points into writes */
+	uint32_t eraseCuts;        /* cut points into erases */
+	uint32_t failures;         /* cut points, after which a block is lost, has wrong data or the interrupted write can't be repeated */
+	uint32_t errorsDetected;   /* cut points, after which nvm_get_error reports the damaged record */
+	uint32_t programViolations;/* bytes programmed over programmed bits after the reboot */
+	double* mountUs;           /* nvm_init after the cut */
+	double* recoveryUs;        /* nvm_init and the repeated write until it is committed */
+	uint32_t count;
+} CutResult_t;
+
+static const char* const ScenarioNames[CUT_SCENARIO_COUNT] = { "write", "overflow" };
+
+static CutParams_t Params = { -1, CUT_DEFAULT_STRIDE, CUT_DEFAULT_ERASE_STRIDE, CUT_DEFAULT_TORN_BITS, NULL };
+
+/* The flash and the committed data before the interrupted operation */
+static uint8_t Snapshot[TOTAL_FLASH_SIZE];
+static uint32_t SnapshotTime;
+static uint32_t BlockVersion[eNvmBlockCount];
+
+/* Data of the application. The buffers stay valid, because a deferred write is programmed later from them */
+static uint8_t BlockData[eNvmBlockCount][MAX_DR_SIZE];
+
+static bool parseArgs(int argc, char* argv[]);
+static void generateData(NvmBlocksId_t bIdx, uint32_t version, uint8_t* data);
+static bool writeBlock(NvmBlocksId_t bIdx, uint32_t version);
+static void reboot(void);
+static bool prepareScenario(CutScenario_t scenario);
+static bool checkBlocks(uint32_t targetVersion, bool bCommitted);
+static bool injectCut(CutScenario_t scenario, const FlsSimu_PowerCut_t* cut, CutResult_t* result);
+static bool addSample(CutResult_t* result, double mountUs, double recoveryUs);
+static int compareDouble(const void* a, const void* b);
+static double percentile(const double* sorted, uint32_t count, uint32_t percent);
+static void printDistribution(FILE* out, const char* name, double* values, uint32_t count, bool bLast);
+
+/* main function of the harness */
+int main(int argc, char* argv[])
+{
+	CutResult_t results[CUT_SCENARIO_COUNT];
+	FlsSimu_PowerCut_t cut;
+	FILE* out = stdout;
+	uint32_t failures = 0;
+	uint32_t stride;
+	int scenario;
+	int kind;
+	bool bFirst = true;
+
+	if(false == parseArgs(argc, argv))
+	{
+		fprintf(stderr, "Usage: %s [--scenario write|overflow|all] [--stride BYTES] [--erase-stride BYTES] [--torn MASK] [--output FILE]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	memset(results, 0, sizeof(results));
+
+	for(scenario = 0; scenario < CUT_SCENARIO_COUNT; scenario++)
+	{
+		if( (-1 != Params.scenario) && (scenario != Params.scenario) )
+		{
+			continue;
+		}
+
+		if(false == prepareScenario((CutScenario_t)scenario))
+		{
+			fprintf(stderr, "The scenario %s can't be prepared!\n", ScenarioNames[scenario]);
+			return EXIT_FAILURE;
+		}
+
+		/* the writes and the erases are interrupted one after another, until the scenario has no more operations of the kind */
+		for(kind = FLS_SIMU_CUT_PROGRAM; kind <= FLS_SIMU_CUT_ERASE; kind <<= 1)
+		{
+			stride = (FLS_SIMU_CUT_PROGRAM == kind) ? Params.stride : Params.eraseStride;
+			cut.kinds = (uint8_t)kind;
+			cut.tornBits = Params.tornBits;
+
+			for(cut.operation = 0; ; cut.operation++)
+			{
+				for(cut.offset = 0; true == injectCut((CutScenario_t)scenario, &cut, &results[scenario]); cut.offset += stride)
+				{
+					if(FLS_SIMU_CUT_PROGRAM == kind)
+					{
+						results[scenario].programCuts++;
+					}
+					else
+					{
+						results[scenario].eraseCuts++;
+					}
+				}
+
+				if(0 == cut.offset)
+				{
+					break;
+				}
+			}
+		}
+
+		failures += results[scenario].failures;
+	}
+
+	if(NULL != Params.output)
+	{
+		out = fopen(Params.output, "w");
+		if(NULL == out)
+		{
+			fprintf(stderr, "Can't open %s!\n", Params.output);
+			return EXIT_FAILURE;
+		}
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"benchmark\": \"nvm_powercut\",\n");
+	fprintf(out, "  \"parameters\": {\"stride\": %u, \"erase_stride\": %u, \"torn_bits\": %u},\n",
+	        (unsigned)Params.stride, (unsigned)Params.eraseStride, (unsigned)Params.tornBits);
+	fprintf(out, "  \"scenarios\": {\n");
+
+	for(scenario = 0; scenario < CUT_SCENARIO_COUNT; scenario++)
+	{
+		if( (-1 != Params.scenario) && (scenario != Params.scenario) )
+		{
+			continue;
+		}
+
+		fprintf(out, "%s    \"%s\": {\n", (true == bFirst) ? "" : ",\n", ScenarioNames[scenario]);
+		fprintf(out, "      \"program_cuts\": %u, \"erase_cuts\": %u, \"failures\": %u, \"errors_detected\": %u, \"program_violations\": %u,\n",
+		        (unsigned)results[scenario].programCuts, (unsigned)results[scenario].eraseCuts, (unsigned)results[scenario].failures,
+		        (unsigned)results[scenario].errorsDetected, (unsigned)results[scenario].programViolations);
+		printDistribution(out, "mount_time_us", results[scenario].mountUs, results[scenario].count, false);
+		printDistribution(out, "recovery_time_us", results[scenario].recoveryUs, results[scenario].count, true);
+		fprintf(out, "    }");
+		bFirst = false;
+
+		free(results[scenario].mountUs);
+		free(results[scenario].recoveryUs);
+	}
+
+	fprintf(out, "\n  }\n");
+	fprintf(out, "}\n");
+
+	if(stdout != out)
+	{
+		fclose(out);
+	}
+
+	return (0 == failures) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Parse the command line into the parameters of the harness */
+static bool parseArgs(int argc, char* argv[])
+{
+	int idx;
+	int scenario;
+
+	for(idx = 1; idx < argc; idx++)
+	{
+		if( (0 == strcmp(argv[idx], "--scenario")) && ((idx + 1) < argc) )
+		{
+			idx++;
+			Params.scenario = (0 == strcmp(argv[idx], "all")) ? -1 : CUT_SCENARIO_COUNT;
+			for(scenario = 0; scenario < CUT_SCENARIO_COUNT; scenario++)
+			{
+				if(0 == strcmp(argv[idx], ScenarioNames[scenario]))
+				{
+					Params.scenario = scenario;
+				}
+			}
+		}
+		else if( (0 == strcmp(argv[idx], "--stride")) && ((idx + 1) < argc) )
+		{
+			Params.stride = (uint32_t)strtoul(argv[++idx], NULL, 0);
+		}
+		else if( (0 == strcmp(argv[idx], "--erase-stride")) && ((idx + 1) < argc) )
+		{
+			Params.eraseStride = (uint32_t)strtoul(argv[++idx], NULL, 0);
+		}
+		else if( (0 == strcmp(argv[idx], "--torn")) && ((idx + 1) < argc) )
+		{
+			Params.tornBits = (uint8_t)strtoul(argv[++idx], NULL, 0);
+		}
+		else if( (0 == strcmp(argv[idx], "--output")) && ((idx + 1) < argc) )
+		{
+			Params.output = argv[++idx];
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return (CUT_SCENARIO_COUNT != Params.scenario) && (0 < Params.stride) && (0 < Params.eraseStride);
+}
+
+/* Generate the data of a version of a block, so every version of every block has different data */
+static void generateData(NvmBlocksId_t bIdx, uint32_t version, uint8_t* data)
+{
+	uint32_t state = (version * 2654435761u) ^ ((uint32_t)(bIdx + 1) * 0x85EBCA6Bu);
+	uint32_t idx;
+
+	state = (0 != state) ? state : 1;
+
+	for(idx = 0; idx < NvmBlocks[bIdx].size; idx++)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		data[idx] = (uint8_t)state;
+	}
+}
+
+/* Write a version of a block and complete the work of the cyclic tasks, so the data is committed and no erase is pending.
+   Returns true if the data is committed */
+static bool writeBlock(NvmBlocksId_t bIdx, uint32_t version)
+{
+	bool result;
+
+	generateData(bIdx, version, BlockData[bIdx]);
+	result = nvm_write(bIdx, BlockData[bIdx], (uint16_t)NvmBlocks[bIdx].size);
+#ifdef NVM_USE_WEAR_BUDGET
+	result &= nvm_write_flush();
+#endif
+#ifdef NVM_USE_BACKGROUND_ERASE
+	while(false == nvm_erase_step())
+	{
+		/* the idle task polls the erase */
+	}
+#endif
+
+	return result;
+}
+
+/* Switch the power on and initialize the NVManager. The RAM of the NVManager is lost */
+static void reboot(void)
+{
+	FlsSimu_setPowerCut(FLS_SIMU_POWER_ON);
+	memset(&NvmManagerDescriptor, 0, sizeof(NvmManagerDescriptor));
+	nvm_init();
+}
+
+/* Bring the flash into the state before the interrupted operation of the scenario and keep it as the snapshot */
+static bool prepareScenario(CutScenario_t scenario)
+{
+	uint32_t generation;
+	uint32_t writes;
+	uint32_t idx;
+
+	memset(BlockVersion, 0, sizeof(BlockVersion));
+	SysTimeSimu = 0;
+	FlsDrv_Init();
+	reboot();
+
+	for(idx = 0; idx < CUT_BLOCK_COUNT; idx++)
+	{
+		BlockVersion[idx] = 1;
+		if(false == writeBlock((NvmBlocksId_t)idx, BlockVersion[idx]))
+		{
+			return false;
+		}
+	}
+
+	memcpy(Snapshot, FlashSimu, TOTAL_FLASH_SIZE);
+	SnapshotTime = SysTimeSimu;
+
+	if(CUT_SCENARIO_OVERFLOW == scenario)
+	{
+		/* the target block is written until a write overflows the page. The state before this write is kept */
+		for(writes = 0; writes < CUT_MAX_SETUP_WRITES; writes++)
+		{
+			memcpy(Snapshot, FlashSimu, TOTAL_FLASH_SIZE);
+			generation = nvm_get_generation();
+
+			if(false == writeBlock(CUT_TARGET_BLOCK, BlockVersion[CUT_TARGET_BLOCK] + 1))
+			{
+				return false;
+			}
+
+			if(generation != nvm_get_generation())
+			{
+				return true;
+			}
+
+			BlockVersion[CUT_TARGET_BLOCK]++;
+		}
+
+		return false;
+	}
+
+	return true;
+}
+
+/* Check that every block contains its committed version. The target block may contain also the next version, if its write
+   was interrupted, and has to contain it, if the write was committed before the cut */
+static bool checkBlocks(uint32_t targetVersion, bool bCommitted)
+{
+	uint8_t readData[MAX_DR_SIZE];
+	uint8_t expected[MAX_DR_SIZE];
+	uint16_t readSize = 0;
+	uint32_t idx;
+	bool bNewVersion;
+
+	for(idx = 0; idx < CUT_BLOCK_COUNT; idx++)
+	{
+		if( (false == nvm_read((NvmBlocksId_t)idx, readData, &readSize)) || (readSize != NvmBlocks[idx].size) )
+		{
+			return false;
+		}
+
+		generateData((NvmBlocksId_t)idx, (CUT_TARGET_BLOCK == idx) ? targetVersion : BlockVersion[idx], expected);
+		bNewVersion = (0 == memcmp(readData, expected, readSize));
+
+		if(CUT_TARGET_BLOCK != idx)
+		{
+			if(false == bNewVersion)
+			{
+				return false;
+			}
+		}
+		else if(false == bNewVersion)
+		{
+			generateData((NvmBlocksId_t)idx, BlockVersion[idx], expected);
+			if( (true == bCommitted) || (0 != memcmp(readData, expected, readSize)) )
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/* Repeat the interrupted operation of the scenario from the snapshot with a power cut, reboot and check the recovery.
+   Returns false if the operation of the cut point does not exist, i.e. the power is not cut */
+static bool injectCut(CutScenario_t scenario, const FlsSimu_PowerCut_t* cut, CutResult_t* result)
+{
+	FlsSimu_Stats_t before;
+	FlsSimu_Stats_t after;
+	const uint32_t targetVersion = BlockVersion[CUT_TARGET_BLOCK] + 1;
+	uint32_t startTime;
+	uint32_t mountUs;
+	bool bCommitted;
+	bool bPassed;
+
+	/* the device boots with the flash of the snapshot */
+	memcpy(FlashSimu, Snapshot, TOTAL_FLASH_SIZE);
+	SysTimeSimu = SnapshotTime;
+	reboot();
+
+	FlsSimu_getStats(&before);
+	FlsSimu_setPowerCutAt(cut);
+	bCommitted = writeBlock(CUT_TARGET_BLOCK, targetVersion);
+	FlsSimu_getStats(&after);
+
+	if(before.powerCuts == after.powerCuts)
+	{
+		FlsSimu_setPowerCutAt(NULL);
+		return false;
+	}
+
+	/* the mount finds the latest committed data and the application repeats the interrupted write */
+	startTime = SysTime_getMicroseconds();
+	reboot();
+	mountUs = SysTime_getMicroseconds() - startTime;
+
+	FlsSimu_getStats(&before);
+	bPassed = checkBlocks(targetVersion, bCommitted);
+	result->errorsDetected += (true == nvm_get_error()) ? 1 : 0;
+
+	bPassed &= writeBlock(CUT_TARGET_BLOCK, targetVersion);
+	if(false == addSample(result, mountUs, SysTime_getMicroseconds() - startTime))
+	{
+		fprintf(stderr, "Out of memory!\n");
+		exit(EXIT_FAILURE);
+	}
+	bPassed &= checkBlocks(targetVersion, true);
+
+	/* nothing is left behind for the next power-on */
+	reboot();
+	bPassed &= checkBlocks(targetVersion, true);
+	FlsSimu_getStats(&after);
+	result->programViolations += after.programViolations - before.programViolations;
+
+	if(false == bPassed)
+	{
+		if(result->failures < CUT_MAX_REPORTED_FAILURES)
+		{
+			fprintf(stderr, "%s: the %s %u is cut at byte %u and block %u is not recovered\n", ScenarioNames[scenario],
+			        (FLS_SIMU_CUT_PROGRAM == cut->kinds) ? "write" : "erase", (unsigned)cut->operation, (unsigned)cut->offset,
+			        (unsigned)(CUT_TARGET_BLOCK + 1));
+		}
+		result->failures++;
+	}
+
+	return true;
+}
+
+/* Add the times of a cut point to the results */
+static bool addSample(CutResult_t* result, double mountUs, double recoveryUs)
+{
+	if(0 == (result->count % 1024))
+	{
+		result->mountUs = (double*)realloc(result->mountUs, sizeof(double) * (result->count + 1024));
+		result->recoveryUs = (double*)realloc(result->recoveryUs, sizeof(double) * (result->count + 1024));
+		if( (NULL == result->mountUs) || (NULL == result->recoveryUs) )
+		{
+			return false;
+		}
+	}
+
+	result->mountUs[result->count] = mountUs;
+	result->recoveryUs[result->count] = recoveryUs;
+	result->count++;
+
+	return true;
+}
+
+/* Comparison of two values for qsort */
+static int compareDouble(const void* a, const void* b)
+{
+	double valA = *(const double*)a;
+	double valB = *(const double*)b;
+
+	return (valA > valB) - (valA < valB);
+}
+
+/* Percentile of sorted values (nearest rank) */
+static double percentile(const double* sorted, uint32_t count, uint32_t percent)
+{
+	return sorted[((count - 1) * percent) / 100];
+}
+
+/* Print the minimum, the percentiles and the maximum of the values */
+static void printDistribution(FILE* out, const char* name, double* values, uint32_t count, bool bLast)
+{
+	const uint32_t percents[] = { 50, 90, 99 };
+	uint32_t idx;
+
+	fprintf(out, "      \"%s\": {\"count\": %u", name, (unsigned)count);
+
+	if(0 < count)
+	{
+		qsort(values, count, sizeof(double), compareDouble);
+
+		fprintf(out, ", \"min\": %.0f", values[0]);
+		for(idx = 0; idx < (sizeof(percents) / sizeof(percents[0])); idx++)
+		{
+			fprintf(out, ", \"p%u\": %.0f", (unsigned)percents[idx], percentile(values, count, percents[idx]));
+		}
+		fprintf(out, ", \"max\": %.0f", values[count - 1]);
+	}
+
+	fprintf(out, "}%s\n", (true == bLast) ? "" : ",");
+}
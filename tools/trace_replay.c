@@ -0,0 +1,426 @@
+/*
+ ============================================================================
+ Name        : trace_replay.c
+ Author      : Martin Patarinski
+ Version     :
+ Copyright   : Open source. Further copyright shall be approved by the author
+ Description : Replay of a trace of the recorder (NVM_USE_RECORDER) against
+               the flash simulator with the configuration of this build.
+               The wear and the latencies are printed as JSON
+ ============================================================================
+ */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L /* nanosleep */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "stubs/stubs.h"
+#include "src/nvm.h"
+
+/* A type for the parameters of a replay */
+typedef struct
+{
+	const char* trace;         /* trace file of the recorder */
+	const char* image;         /* flash image at the start of the trace or NULL for erased flash */
+	const char* output;        /* JSON file or NULL for stdout */
+	bool bOriginalTiming;      /* the simulated time advances like between the recorded calls */
+	bool bRealTime;            /* the replay also waits between the calls like the original */
+} ReplayParams_t;
+
+/* A type for a decoded record */
+typedef struct
+{
+	uint8_t op;
+	bool bResult;
+	uint8_t bIdx;
+	uint16_t size;
+	uint32_t timeDiffUs;
+	uint32_t dataCrc;
+} ReplayRecord_t;
+
+/* A type for the results of a replay */
+typedef struct
+{
+	uint32_t records;
+	uint32_t inits;
+	uint32_t writes;
+	uint32_t reads;
+	uint32_t skipped;          /* records of blocks, which are not configured or written only by the NVManager */
+	uint32_t sizeMismatches;   /* records with another block size than the configuration */
+	uint32_t divergences;      /* calls with another result than the recorded one */
+	uint32_t readMismatches;   /* reads, which do not return the data of the latest replayed write */
+	uint32_t requestedBytes;
+	double traceTimeS;         /* duration of the original trace */
+	uint32_t maxMountTimeUs;
+	uint32_t* writeLatencies;
+	uint32_t* readLatencies;
+} ReplayResult_t;
+
+static ReplayParams_t Params = { NULL, NULL, NULL, false, false };
+
+/* Data of every block. It is generated from the recorded checksum, so equal recorded data gives equal replayed data. The buffers
+   stay valid, because a deferred write is programmed later from them */
+static uint8_t BlockData[eNvmBlockCount][MAX_DR_SIZE];
+static uint32_t BlockCrc[eNvmBlockCount];
+static bool BlockWritten[eNvmBlockCount];
+
+static bool parseArgs(int argc, char* argv[]);
+static uint32_t readLe(const uint8_t* buf, uint32_t len);
+static void decodeRecord(const uint8_t* buf, ReplayRecord_t* record);
+static void generateData(NvmBlocksId_t bIdx, uint32_t dataCrc, uint8_t* data);
+static void advanceTime(uint32_t timeDiffUs);
+static void replayRecord(const ReplayRecord_t* record, ReplayResult_t* result);
+static int compareU32(const void* a, const void* b);
+static void printLatencies(FILE* out, const char* name, uint32_t* latencies, uint32_t count);
+static void printResult(FILE* out, ReplayResult_t* result, const FlsSimu_Stats_t* flash);
+
+/* main function of the replay */
+int main(int argc, char* argv[])
+{
+	uint8_t header[NVM_REC_HEADER_SIZE];
+	uint8_t buf[NVM_REC_SIZE];
+	ReplayRecord_t record;
+	ReplayResult_t result;
+	FlsSimu_Stats_t flash;
+	FILE* trace;
+	FILE* out = stdout;
+	long traceSize;
+	uint32_t recordCount;
+
+	if(false == parseArgs(argc, argv))
+	{
+		fprintf(stderr, "Usage: %s TRACE [--timing full|original] [--realtime] [--image FILE] [--output FILE]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	trace = fopen(Params.trace, "rb");
+	if(NULL == trace)
+	{
+		fprintf(stderr, "Can't open %s!\n", Params.trace);
+		return EXIT_FAILURE;
+	}
+
+	if( (NVM_REC_HEADER_SIZE != fread(header, 1, NVM_REC_HEADER_SIZE, trace)) || (0 != memcmp(header, NVM_REC_MAGIC, 4)) ||
+	    (NVM_REC_VERSION != readLe(&header[4], 2)) || (NVM_REC_SIZE != readLe(&header[6], 2)) )
+	{
+		fprintf(stderr, "%s is not a trace of the recorder!\n", Params.trace);
+		fclose(trace);
+		return EXIT_FAILURE;
+	}
+
+	fseek(trace, 0, SEEK_END);
+	traceSize = ftell(trace);
+	fseek(trace, NVM_REC_HEADER_SIZE, SEEK_SET);
+	recordCount = (uint32_t)((traceSize - NVM_REC_HEADER_SIZE) / NVM_REC_SIZE);
+
+	memset(&result, 0, sizeof(result));
+	result.writeLatencies = (uint32_t*)malloc(sizeof(uint32_t) * (recordCount + 1));
+	result.readLatencies = (uint32_t*)malloc(sizeof(uint32_t) * (recordCount + 1));
+	if( (NULL == result.writeLatencies) || (NULL == result.readLatencies) )
+	{
+		fclose(trace);
+		return EXIT_FAILURE;
+	}
+
+	if( (NULL != Params.image) && (false == FlsSimu_open(Params.image)) )
+	{
+		fprintf(stderr, "Can't open %s!\n", Params.image);
+		fclose(trace);
+		return EXIT_FAILURE;
+	}
+	FlsDrv_Init();
+
+	/* the trace starts with the initialization of the device, there is no call before it */
+	while(NVM_REC_SIZE == fread(buf, 1, NVM_REC_SIZE, trace))
+	{
+		decodeRecord(buf, &record);
+		replayRecord(&record, &result);
+	}
+	fclose(trace);
+
+#ifdef NVM_USE_WEAR_BUDGET
+	nvm_write_flush();
+#endif
+	FlsSimu_getStats(&flash);
+	FlsSimu_close();
+
+	if(NULL != Params.output)
+	{
+		out = fopen(Params.output, "w");
+		if(NULL == out)
+		{
+			fprintf(stderr, "Can't open %s!\n", Params.output);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printResult(out, &result, &flash);
+
+	if(stdout != out)
+	{
+		fclose(out);
+	}
+	free(result.writeLatencies);
+	free(result.readLatencies);
+
+	return ((0 == result.readMismatches) && (0 == flash.programViolations)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Parse the command line into the parameters of the replay */
+static bool parseArgs(int argc, char* argv[])
+{
+	int idx;
+
+	for(idx = 1; idx < argc; idx++)
+	{
+		if( (0 == strcmp(argv[idx], "--timing")) && ((idx + 1) < argc) )
+		{
+			idx++;
+			if(0 == strcmp(argv[idx], "original"))
+			{
+				Params.bOriginalTiming = true;
+			}
+			else if(0 != strcmp(argv[idx], "full"))
+			{
+				return false;
+			}
+		}
+		else if(0 == strcmp(argv[idx], "--realtime"))
+		{
+			Params.bOriginalTiming = true;
+			Params.bRealTime = true;
+		}
+		else if( (0 == strcmp(argv[idx], "--image")) && ((idx + 1) < argc) )
+		{
+			Params.image = argv[++idx];
+		}
+		else if( (0 == strcmp(argv[idx], "--output")) && ((idx + 1) < argc) )
+		{
+			Params.output = argv[++idx];
+		}
+		else if( ('-' != argv[idx][0]) && (NULL == Params.trace) )
+		{
+			Params.trace = argv[idx];
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return (NULL != Params.trace);
+}
+
+/* Read a little-endian field */
+static uint32_t readLe(const uint8_t* buf, uint32_t len)
+{
+	uint32_t value = 0;
+
+	while(len > 0)
+	{
+		len--;
+		value = (value << 8) | buf[len];
+	}
+
+	return value;
+}
+
+/* Decode a record of the trace */
+static void decodeRecord(const uint8_t* buf, ReplayRecord_t* record)
+{
+	record->op = buf[0] & (uint8_t)~NVM_REC_FAILED;
+	record->bResult = (0 == (buf[0] & NVM_REC_FAILED));
+	record->bIdx = buf[1];
+	record->size = (uint16_t)readLe(&buf[2], 2);
+	record->timeDiffUs = readLe(&buf[4], 4);
+	record->dataCrc = readLe(&buf[8], 4);
+}
+
+/* Generate the data of a block from the recorded checksum (xorshift32 seeded with it) */
+static void generateData(NvmBlocksId_t bIdx, uint32_t dataCrc, uint8_t* data)
+{
+	uint32_t state = (0 != dataCrc) ? dataCrc : 0x4E564D54u;
+	uint32_t idx;
+
+	for(idx = 0; idx < NvmBlocks[bIdx].size; idx++)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		data[idx] = (uint8_t)state;
+	}
+}
+
+/* Advance the time between two calls like into the original trace and run the cyclic tasks of the application */
+static void advanceTime(uint32_t timeDiffUs)
+{
+	static uint32_t remainderUs = 0;
+#ifdef CLOCK_MONOTONIC
+	struct timespec delay;
+#endif
+
+	if(true == Params.bOriginalTiming)
+	{
+		remainderUs += timeDiffUs % 1000000u;
+		SysTimeSimu += (timeDiffUs / 1000000u) + (remainderUs / 1000000u);
+		remainderUs %= 1000000u;
+
+#ifdef NVM_USE_WEAR_BUDGET
+		nvm_write_step();
+#endif
+#ifdef NVM_USE_BACKGROUND_ERASE
+		nvm_erase_step();
+#endif
+	}
+
+#ifdef CLOCK_MONOTONIC
+	if(true == Params.bRealTime)
+	{
+		delay.tv_sec = timeDiffUs / 1000000u;
+		delay.tv_nsec = (long)(timeDiffUs % 1000000u) * 1000L;
+		nanosleep(&delay, NULL);
+	}
+#endif
+}
+
+/* Replay one call and compare its result with the recorded one */
+static void replayRecord(const ReplayRecord_t* record, ReplayResult_t* result)
+{
+	uint8_t readData[MAX_DR_SIZE];
+	uint8_t expectedData[MAX_DR_SIZE];
+	uint16_t readSize = 0;
+	uint32_t startTime;
+	uint32_t latency;
+	NvmBlocksId_t bIdx = (NvmBlocksId_t)record->bIdx;
+	bool bResult;
+
+	result->records++;
+	result->traceTimeS += (double)record->timeDiffUs / 1000000.0;
+	advanceTime(record->timeDiffUs);
+
+	if( (NVM_REC_INIT == record->op) || (NVM_REC_INIT_LAZY == record->op) )
+	{
+		startTime = SysTime_getMicroseconds();
+#ifdef NVM_USE_LAZY_MOUNT
+		if(NVM_REC_INIT_LAZY == record->op)
+		{
+			nvm_init_lazy();
+		}
+		else
+#endif
+		{
+			nvm_init();
+		}
+		latency = SysTime_getMicroseconds() - startTime;
+		result->maxMountTimeUs = (latency > result->maxMountTimeUs) ? latency : result->maxMountTimeUs;
+		result->inits++;
+		return;
+	}
+
+	if( (bIdx >= NVM_USER_BLOCK_COUNT) || ((NVM_REC_WRITE != record->op) && (NVM_REC_READ != record->op)) )
+	{
+		result->skipped++;
+		return;
+	}
+
+	if(record->size != NvmBlocks[bIdx].size)
+	{
+		result->sizeMismatches++;
+	}
+
+	if(NVM_REC_WRITE == record->op)
+	{
+		generateData(bIdx, record->dataCrc, BlockData[bIdx]);
+
+		startTime = SysTime_getMicroseconds();
+		bResult = nvm_write(bIdx, BlockData[bIdx], (uint16_t)NvmBlocks[bIdx].size);
+		result->writeLatencies[result->writes++] = SysTime_getMicroseconds() - startTime;
+
+		if(true == bResult)
+		{
+			result->requestedBytes += NvmBlocks[bIdx].size;
+			BlockCrc[bIdx] = record->dataCrc;
+			BlockWritten[bIdx] = true;
+		}
+	}
+	else
+	{
+		startTime = SysTime_getMicroseconds();
+		bResult = nvm_read(bIdx, readData, &readSize);
+		result->readLatencies[result->reads++] = SysTime_getMicroseconds() - startTime;
+
+		/* the replayed data is known only for the blocks, which are written into the trace */
+		if( (true == bResult) && (true == BlockWritten[bIdx]) )
+		{
+			generateData(bIdx, BlockCrc[bIdx], expectedData);
+			if(0 != memcmp(readData, expectedData, NvmBlocks[bIdx].size))
+			{
+				result->readMismatches++;
+			}
+		}
+	}
+
+	if(bResult != record->bResult)
+	{
+		result->divergences++;
+	}
+}
+
+/* Comparison of two latencies for qsort */
+static int compareU32(const void* a, const void* b)
+{
+	uint32_t valA = *(const uint32_t*)a;
+	uint32_t valB = *(const uint32_t*)b;
+
+	return (valA > valB) - (valA < valB);
+}
+
+/* Print the p50/p99/max latency of the calls */
+static void printLatencies(FILE* out, const char* name, uint32_t* latencies, uint32_t count)
+{
+	if(0 == count)
+	{
+		fprintf(out, "  \"%s\": {\"p50\": 0, \"p99\": 0, \"max\": 0},\n", name);
+		return;
+	}
+
+	qsort(latencies, count, sizeof(uint32_t), compareU32);
+	fprintf(out, "  \"%s\": {\"p50\": %u, \"p99\": %u, \"max\": %u},\n", name, (unsigned)latencies[(count - 1) / 2],
+	        (unsigned)latencies[((count - 1) * 99) / 100], (unsigned)latencies[count - 1]);
+}
+
+/* Print the results of the replay as JSON */
+static void printResult(FILE* out, ReplayResult_t* result, const FlsSimu_Stats_t* flash)
+{
+	uint32_t erases = 0;
+	uint32_t maxSectorErases = 0;
+	uint32_t idx;
+
+	for(idx = 0; idx < FLS_SIMU_SECTOR_COUNT; idx++)
+	{
+		erases += flash->sectorErases[idx];
+		maxSectorErases = (flash->sectorErases[idx] > maxSectorErases) ? flash->sectorErases[idx] : maxSectorErases;
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"benchmark\": \"nvm_replay\",\n");
+	fprintf(out, "  \"trace\": \"%s\", \"timing\": \"%s\",\n", Params.trace, (true == Params.bOriginalTiming) ? "original" : "full");
+	fprintf(out, "  \"records\": %u, \"inits\": %u, \"writes\": %u, \"reads\": %u, \"skipped\": %u, \"size_mismatches\": %u,\n",
+	        (unsigned)result->records, (unsigned)result->inits, (unsigned)result->writes, (unsigned)result->reads, (unsigned)result->skipped,
+	        (unsigned)result->sizeMismatches);
+	fprintf(out, "  \"divergences\": %u, \"read_mismatches\": %u, \"trace_time_s\": %.3f,\n", (unsigned)result->divergences,
+	        (unsigned)result->readMismatches, result->traceTimeS);
+	printLatencies(out, "write_latency_us", result->writeLatencies, result->writes);
+	printLatencies(out, "read_latency_us", result->readLatencies, result->reads);
+	fprintf(out, "  \"max_mount_time_us\": %u, \"erases\": %u, \"erases_per_1k_writes\": %.2f, \"max_sector_erases\": %u,\n",
+	        (unsigned)result->maxMountTimeUs, (unsigned)erases, (0 < result->writes) ? (((double)erases * 1000.0) / (double)result->writes) : 0.0,
+	        (unsigned)maxSectorErases);
+	fprintf(out, "  \"write_amplification\": %.3f, \"program_violations\": %u, \"flash_busy_time_us\": %u\n",
+	        (0 < result->requestedBytes) ? ((double)flash->programBytes / (double)result->requestedBytes) : 0.0,
+	        (unsigned)flash->programViolations, (unsigned)flash->busyTimeUs);
+	fprintf(out, "}\n");
+}
@@ -0,0 +1,96 @@
+/*
+ ============================================================================
+ Name        : unit_test_block.cpp
+ Author      : Martin Patarinski
+ Version     :
+ Copyright   : Open source. Further copyright shall be approved by the author
+ Description : Unit test of the typed C++ interface (nvm_block.hpp) on
+               erased flash
+ ============================================================================
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "stubs/stubs.h"
+#include "src/nvm_block.hpp"
+
+#define UT_CHECK(exp) { \
+	if(exp) {printf("\x1B[32m Check passed!");} else {TestFailedCounter++; printf("\x1B[31m Check FAILED!");} TestCounter++; printf("\x1B[0m\n");\
+}
+
+#pragma pack(push, 1)
+/* Payload of eNvmBlock7 */
+struct TemperatureCfg
+{
+	float target;
+	float offset;
+	uint16_t hysteresis;
+	uint8_t sensor;
+	uint8_t reserved[4];
+};
+
+/* Payload of eNvmBlock2 */
+struct PowerOnData
+{
+	uint16_t marker;
+	uint32_t powerOnCount;
+	uint32_t lastOnTime;
+};
+#pragma pack(pop)
+
+using Temperature = nvm::NvmBlock<eNvmBlock7, TemperatureCfg>;
+using PowerOn = nvm::NvmBlock<eNvmBlock2, PowerOnData>;
+using WriteCycles = nvm::NvmBlock<eNvmBlock14, uint32_t>;
+
+/* the layout is known at compile time */
+static_assert(Temperature::info.size == NVM_BLOCK_7_SIZE, "size of eNvmBlock7");
+static_assert(WriteCycles::info.recordSize == (BLOCK_HEADER_SIZE + NVM_BLOCK_14_SIZE + NVM_CRC_LEN), "record of eNvmBlock14");
+static_assert(nvm::BlockTable[eNvmBlock1].pattern == 0xCC01, "pattern of eNvmBlock1");
+
+static uint32_t TestCounter = 0;
+static uint32_t TestFailedCounter = 0;
+
+int main()
+{
+	TemperatureCfg temperature = { 92.5f, -0.5f, 3, 1, { 0 } };
+	PowerOnData powerOn = { 0xCC01, 17, 3600 };
+	uint32_t writeCycles = 1234;
+	TemperatureCfg readTemperature;
+	PowerOnData readPowerOn;
+	uint32_t readWriteCycles = 0;
+	uint32_t idx;
+	bool bTableMatches = true;
+
+	printf("Started execution of the Unit test of the typed C++ interface!\n");
+
+	FlsDrv_Init();
+	nvm_init();
+
+	/* the constexpr table is expanded from the same configuration as NvmBlocks */
+	for(idx = 0; idx < eNvmBlockCount; idx++)
+	{
+		bTableMatches = bTableMatches && (nvm::BlockTable[idx].pattern == NvmBlocks[idx].pattern) &&
+		                (nvm::BlockTable[idx].size == NvmBlocks[idx].size);
+	}
+	UT_CHECK(true == bTableMatches)
+
+	UT_CHECK(true == Temperature::write(temperature))
+	UT_CHECK(true == PowerOn::write(powerOn))
+	UT_CHECK(true == WriteCycles::write(writeCycles))
+
+	/* the payloads are read in place after the next power-on */
+	nvm_init();
+	memset(&readTemperature, 0, sizeof(readTemperature));
+	memset(&readPowerOn, 0, sizeof(readPowerOn));
+	UT_CHECK(true == Temperature::read(readTemperature))
+	UT_CHECK(0 == memcmp(&readTemperature, &temperature, sizeof(temperature)))
+	UT_CHECK(true == PowerOn::read(readPowerOn))
+	UT_CHECK( (17 == readPowerOn.powerOnCount) && (3600 == readPowerOn.lastOnTime) )
+	UT_CHECK( (true == WriteCycles::read(readWriteCycles)) && (1234 == readWriteCycles) )
+	UT_CHECK(false == nvm_get_error())
+
+	printf("%u checks, %u failed\n", (unsigned)TestCounter, (unsigned)TestFailedCounter);
+
+	return (0 == TestFailedCounter) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -15,6 +15,7 @@
 #include "src/nvm.h"
 
 #define LOAD_PREVIOUS_FLASH
+#define FLASH_IMAGE_PATH "FlashSimu.bin" // relative to the working directory, can be replaced by the first argument
 
 #define KNRM  "\x1B[0m"
 #define KRED  "\x1B[31m"
@@ -163,7 +164,7 @@ void TestCase3(void)
 	testDataReadSize = 0;
 	nvmRes = true;
 	/* check all configured NVM blocks by writing and reading each of them */
-	for(ctr=0; ctr<eNvmBlockCount; ctr++)
+	for(ctr=0; ctr<NVM_USER_BLOCK_COUNT; ctr++)
 	{
 		memset(testDataRead, 0, NvmBlocks[ctr].size);
 		
@@ -202,7 +203,7 @@ void TestCase4(void)
 	testDataReadSize = 0;
 
 	/* 1. Write all configured NVM blocks by writing */
-	for(ctr=0; ctr<eNvmBlockCount; ctr++)
+	for(ctr=0; ctr<NVM_USER_BLOCK_COUNT; ctr++)
 	{
 		nvmRes = true;
 		fillWithRandom(testData, NvmBlocks[ctr].size);
@@ -246,7 +247,7 @@ void TestCase4(void)
 
 	/* 4. Write all blocks and read data back to verify they are working correctly 
 	 * 		same as in Test Case 3 */
-	for(ctr=0; ctr<eNvmBlockCount; ctr++)
+	for(ctr=0; ctr<NVM_USER_BLOCK_COUNT; ctr++)
 	{
 		memset(testDataRead, 0, NvmBlocks[ctr].size);
 		nvmRes = true;
@@ -267,35 +268,1333 @@ void TestCase4(void)
 	printf("\n");
 }
 
-/* main function of the Unit test program */
-int main(void)
+#ifdef NVM_USE_READ_VIEW
+void TestCase5(void)
 {
-	FILE* fp = NULL;
-	int j=0;
+	printf("\n");
+	printf("Name: Test case 5\n");
+	printf("  Description: Test zero-copy read of a block directly from the memory-mapped flash\n");
+	printf("  Preconditions: The NVManager is initialized\n");
+	printf("  Test steps: Write data, get a view to it and then force a garbage collection\n");
+	printf("  Check results: The view contains the written data and the generation changes after the garbage collection\n");
+	printf("  Post steps: none\n");
 
-	printf("Started execution of the Unit test of the NVManager!\n");
+	const uint8_t* pView = NULL;
+	uint16_t viewSize = 0;
+	uint32_t generation = 0;
+	uint32_t ctr = 0;
+	bool nvmRes = true;
 
-	FlsDrv_Init();
-	printf("The flash driver is inialized.\n");
+	fillWithRandom(testData, NVM_BLOCK_7_SIZE);
+	nvmRes &= nvm_write(eNvmBlock7, testData, NVM_BLOCK_7_SIZE);
+	nvmRes &= nvm_read_view(eNvmBlock7, &pView, &viewSize);
+	generation = nvm_get_generation();
 
-#ifdef LOAD_PREVIOUS_FLASH //  if it is false, it will use always erased flash
-	bool bFillData = false;
-	// load flash simu from file
-	fp = fopen("..\\FlashSimu.bin", "rb");
-	if(fp == NULL) { printf("Can't open file to read! Using erased flash\n");	bFillData = true; }
+	printf("\n	* Checking whether the NVManager accepted the requests... ");
+	UT_CHECK(false != nvmRes)
+	printf("\n	* Checking whether the size of the view is correct... ");
+	UT_CHECK(NVM_BLOCK_7_SIZE == viewSize)
+	printf("\n	* Checking whether the view contains the written data... ");
+	UT_CHECK((NULL != pView) && (0 == memcmp(testData, pView, NVM_BLOCK_7_SIZE)))
+
+	/* write a big block until the page overflows */
+	for(ctr=0; ctr<(LOGICAL_PAGE_SIZE/NVM_BLOCK_1_SIZE)+1; ctr++)
+	{
+		fillWithRandom(testData, NVM_BLOCK_1_SIZE);
+		nvm_write(eNvmBlock1, testData, NVM_BLOCK_1_SIZE);
+	}
+	printf("\n	* Checking whether the generation is changed after the garbage collection... ");
+	UT_CHECK(generation != nvm_get_generation())
+
+	printf("\n	* Checking whether a view to an invalid block is rejected... ");
+	UT_CHECK(false == nvm_read_view(eNvmBlockCount, &pView, &viewSize))
+	printf("\n");
+}
+#endif
+
+#ifdef NVM_USE_LARGE_OBJECTS
+void TestCase6(void)
+{
+	printf("\n");
+	printf("Name: Test case 6\n");
+	printf("  Description: Test large objects, which are stored as several chunk blocks\n");
+	printf("  Preconditions: The NVManager is initialized\n");
+	printf("  Test steps: Write a large object in parts, read it back, update one chunk and force a garbage collection,\n");
+	printf("              then write a part, which ends inside a chunk before the end of the object\n");
+	printf("  Check results: The read data is the same as the written one and the not updated chunks are not programmed again.\n");
+	printf("                 The part, which would fill data of the object with zeros, is rejected\n");
+	printf("  Post steps: none\n");
+
+	static uint8_t loData[NVM_LO_1_SIZE];
+	static uint8_t loDataRead[NVM_LO_1_SIZE];
+	uint16_t loSize = 0;
+	uint16_t readSize = 0;
+	uint32_t chunkPointer = 0;
+	uint32_t ctr = 0;
+	bool nvmRes = true;
+
+	/* 1. stream the object in two parts, the second one ends in the middle of a chunk */
+	fillWithRandom(loData, NVM_LO_1_SIZE - 4);
+	nvmRes &= nvm_lo_write(eNvmLo1, 0, loData, 3*NVM_LO_CHUNK_SIZE);
+	nvmRes &= nvm_lo_write(eNvmLo1, 3*NVM_LO_CHUNK_SIZE, loData + 3*NVM_LO_CHUNK_SIZE, NVM_LO_1_SIZE - 3*NVM_LO_CHUNK_SIZE - 0x10);
+	nvmRes &= nvm_lo_get_size(eNvmLo1, &loSize);
+	printf("\n	* Checking whether the NVManager accepted the requests... ");
+	UT_CHECK(false != nvmRes)
+	printf("\n	* Checking whether the size of the large object is correct... ");
+	UT_CHECK((NVM_LO_1_SIZE - 0x10) == loSize)
+
+	memset(loDataRead, 0, NVM_LO_1_SIZE);
+	nvmRes &= nvm_lo_read(eNvmLo1, 0, loDataRead, NVM_LO_1_SIZE, &readSize);
+	printf("\n	* Checking whether the whole large object is read back correctly... ");
+	UT_CHECK((false != nvmRes) && (loSize == readSize) && (0 == memcmp(loData, loDataRead, loSize)))
+
+	/* 2. read a part, which is not aligned to the chunks */
+	memset(loDataRead, 0, NVM_LO_1_SIZE);
+	nvmRes &= nvm_lo_read(eNvmLo1, NVM_LO_CHUNK_SIZE - 5, loDataRead, NVM_LO_CHUNK_SIZE + 10, &readSize);
+	printf("\n	* Checking whether a part of the large object is read back correctly... ");
+	UT_CHECK((false != nvmRes) && ((NVM_LO_CHUNK_SIZE + 10) == readSize) && (0 == memcmp(loData + NVM_LO_CHUNK_SIZE - 5, loDataRead, readSize)))
+
+	/* 3. update one chunk only */
+	chunkPointer = NvmBlocks[eNvmLo1Chunk1].readPointer;
+	fillWithRandom(loData + 2*NVM_LO_CHUNK_SIZE, NVM_LO_CHUNK_SIZE - 4);
+	nvmRes &= nvm_lo_write(eNvmLo1, 0, loData, loSize);
+	printf("\n	* Checking whether the unchanged chunk is not programmed again... ");
+	UT_CHECK(chunkPointer == NvmBlocks[eNvmLo1Chunk1].readPointer)
+
+	/* 4. force garbage collection */
+	for(ctr=0; ctr<(LOGICAL_PAGE_SIZE/NVM_BLOCK_1_SIZE)+1; ctr++)
+	{
+		fillWithRandom(testData, NVM_BLOCK_1_SIZE);
+		nvm_write(eNvmBlock1, testData, NVM_BLOCK_1_SIZE);
+	}
+	memset(loDataRead, 0, NVM_LO_1_SIZE);
+	nvmRes &= nvm_lo_read(eNvmLo1, 0, loDataRead, NVM_LO_1_SIZE, &readSize);
+	printf("\n	* Checking whether the large object is correct after the garbage collection... ");
+	UT_CHECK((false != nvmRes) && (loSize == readSize) && (0 == memcmp(loData, loDataRead, loSize)))
+
+	/* 5. truncate the object */
+	nvmRes &= nvm_lo_set_size(eNvmLo1, 0x20);
+	nvmRes &= nvm_lo_read(eNvmLo1, 0, loDataRead, NVM_LO_1_SIZE, &readSize);
+	printf("\n	* Checking whether the large object is truncated... ");
+	UT_CHECK((false != nvmRes) && (0x20 == readSize))
+
+	printf("\n	* Checking whether a part, which is not aligned to the chunks, is rejected for writing... ");
+	UT_CHECK(false == nvm_lo_write(eNvmLo1, 1, loData, NVM_LO_CHUNK_SIZE))
+
+	/* 6. the object ends inside its first chunk, after a part of 0x10 bytes */
+	nvmRes &= nvm_lo_write(eNvmLo1, 0, loData, 0xC8);
+	printf("\n	* Checking whether a part, which ends inside a chunk before the end of the object, is rejected... ");
+	UT_CHECK((false != nvmRes) && (false == nvm_lo_write(eNvmLo1, 0, loData + 0x100, 0x10)) && 
+	         (true == nvm_lo_read(eNvmLo1, 0, loDataRead, NVM_LO_1_SIZE, &readSize)) && (0xC8 == readSize) && (0 == memcmp(loData, loDataRead, 0xC8)))
+	printf("\n	* Checking whether a part, which ends at the end of the object, is written... ");
+	UT_CHECK((true == nvm_lo_write(eNvmLo1, 0, loData + 0x100, 0xC8)) && (true == nvm_lo_read(eNvmLo1, 0, loDataRead, NVM_LO_1_SIZE, &readSize)) && 
+	         (0xC8 == readSize) && (0 == memcmp(loData + 0x100, loDataRead, 0xC8)))
+	printf("\n");
+}
+#endif
+
+#ifdef NVM_USE_KV_STORE
+void TestCase7(void)
+{
+	printf("\n");
+	printf("Name: Test case 7\n");
+	printf("  Description: Test the runtime key-value store with string and integer keys\n");
+	printf("  Preconditions: The NVManager is initialized\n");
+	printf("  Test steps: Put, update and delete keys, force a garbage collection and initialize the NVManager again\n");
+	printf("  Check results: Every key returns its latest value, deleted keys are not found and nothing is lost by the garbage collection and the initialization\n");
+	printf("  Post steps: none\n");
+
+	static uint8_t kvData[NVM_KV_INDEX_SIZE/2][0x28]; /* fillWithRandom writes up to 8 bytes more than requested */
+	uint8_t kvDataRead[NVM_KV_MAX_DATA_SIZE];
+	uint16_t readSize = 0;
+	uint32_t writePointer = 0;
+	uint32_t ctr = 0;
+	bool nvmRes = true;
+
+	/* 1. integer keys and a string key */
+	for(ctr=0; ctr<NVM_KV_INDEX_SIZE/2; ctr++)
+	{
+		fillWithRandom(kvData[ctr], 1 + (ctr % 0x20));
+		nvmRes &= nvm_kv_put_id(1000 + ctr, kvData[ctr], 1 + (ctr % 0x20));
+	}
+	nvmRes &= nvm_kv_put("ntp.server", (const uint8_t*)"pool.ntp.org", 12);
+	printf("\n	* Checking whether the NVManager accepted the requests... ");
+	UT_CHECK(false != nvmRes)
+
+	nvmRes &= nvm_kv_get_id(1005, kvDataRead, sizeof(kvDataRead), &readSize);
+	printf("\n	* Checking whether the value of an integer key is read back correctly... ");
+	UT_CHECK((false != nvmRes) && (6 == readSize) && (0 == memcmp(kvData[5], kvDataRead, readSize)))
+
+	nvmRes &= nvm_kv_get("ntp.server", kvDataRead, sizeof(kvDataRead), &readSize);
+	printf("\n	* Checking whether the value of a string key is read back correctly... ");
+	UT_CHECK((false != nvmRes) && (12 == readSize) && (0 == memcmp("pool.ntp.org", kvDataRead, readSize)))
+
+	printf("\n	* Checking whether an unknown key and a too small buffer are rejected... ");
+	UT_CHECK((false == nvm_kv_get("ntp.port", kvDataRead, sizeof(kvDataRead), &readSize)) && (false == nvm_kv_get_id(1005, kvDataRead, 2, &readSize)))
+
+	/* 2. an unchanged value is not programmed, a changed and a deleted one are */
+	writePointer = NvmManagerDescriptor.writePointer;
+	nvmRes &= nvm_kv_put_id(1005, kvData[5], 6);
+	printf("\n	* Checking whether an unchanged value is not programmed again... ");
+	UT_CHECK(writePointer == NvmManagerDescriptor.writePointer)
+
+	nvmRes &= nvm_kv_put("ntp.server", (const uint8_t*)"time.example.com", 16);
+	nvmRes &= nvm_kv_delete_id(1007);
+	printf("\n	* Checking whether an updated key returns the new value and a deleted key is not found... ");
+	UT_CHECK((false != nvm_kv_get("ntp.server", kvDataRead, sizeof(kvDataRead), &readSize)) && (16 == readSize) &&
+			 (0 == memcmp("time.example.com", kvDataRead, readSize)) && (false == nvm_kv_get_id(1007, kvDataRead, sizeof(kvDataRead), &readSize)))
+
+	/* 3. force garbage collection and initialize again */
+	for(ctr=0; ctr<(LOGICAL_PAGE_SIZE/NVM_BLOCK_1_SIZE)+1; ctr++)
+	{
+		fillWithRandom(testData, NVM_BLOCK_1_SIZE);
+		nvm_write(eNvmBlock1, testData, NVM_BLOCK_1_SIZE);
+	}
+	nvm_init();
+
+	nvmRes = true;
+	for(ctr=0; ctr<NVM_KV_INDEX_SIZE/2; ctr++)
+	{
+		if(1007 != (1000 + ctr))
+		{
+			nvmRes &= nvm_kv_get_id(1000 + ctr, kvDataRead, sizeof(kvDataRead), &readSize);
+			nvmRes &= (readSize == (1 + (ctr % 0x20))) && (0 == memcmp(kvData[ctr], kvDataRead, readSize));
+		}
+	}
+	printf("\n	* Checking whether all keys are correct after the garbage collection and the initialization... ");
+	UT_CHECK((false != nvmRes) && (false != nvm_kv_get("ntp.server", kvDataRead, sizeof(kvDataRead), &readSize)) && (16 == readSize))
+	printf("\n	* Checking whether the deleted key remains deleted... ");
+	UT_CHECK(false == nvm_kv_get_id(1007, kvDataRead, sizeof(kvDataRead), &readSize))
+
+	/* 4. clean up, so that the keys do not occupy the index in the next execution */
+	for(ctr=0; ctr<NVM_KV_INDEX_SIZE/2; ctr++)
+	{
+		nvmRes &= nvm_kv_delete_id(1000 + ctr);
+	}
+	nvmRes &= nvm_kv_delete("ntp.server");
+	printf("\n	* Checking whether the keys are deleted... ");
+	UT_CHECK((false != nvmRes) && (false == nvm_kv_get_id(1000, kvDataRead, sizeof(kvDataRead), &readSize)))
+	printf("\n");
+}
+#endif
+
+void TestCase8(void)
+{
+	printf("\n");
+	printf("Name: Test case 8\n");
+	printf("  Description: Test the utilization of the logical pages and the limit of the live data\n");
+	printf("  Preconditions: The NVManager is initialized\n");
+	printf("  Test steps: Compare the utilization with the written blocks, then write new data until it does not fit into one page\n");
+	printf("  Check results: The utilization is exact and the write, that does not fit, is rejected without losing the stored data\n");
+	printf("  Post steps: none\n");
+
+	uint8_t testDataRead[MAX_DR_SIZE];
+	uint32_t validBytes = 0;
+	uint32_t expectedBytes = 0;
+	uint32_t activePage = GET_PAGE_IDX(NvmManagerDescriptor.writePointer);
+	uint32_t ctr = 0;
+#ifdef NVM_USE_KV_STORE
+	uint32_t kvRecordSize = BLOCK_HEADER_SIZE + NVM_KV_HEADER_SIZE + sizeof(uint32_t) + NVM_KV_MAX_DATA_SIZE + NVM_CRC_LEN;
+#endif
+	bool nvmRes = true;
+
+	for(ctr=0; ctr<eNvmBlockCount; ctr++)
+	{
+		if(READ_POINTER_NOT_SET != NvmBlocks[ctr].readPointer)
+		{
+			expectedBytes += NvmBlocks[ctr].size + BLOCK_HEADER_SIZE + NVM_CRC_LEN;
+		}
+	}
+	nvmRes &= nvm_get_page_utilization(activePage, &validBytes);
+	printf("\n	* Checking whether the utilization of the active page is the size of the live blocks... ");
+	UT_CHECK((false != nvmRes) && (expectedBytes == validBytes))
+	nvmRes &= nvm_get_page_utilization((activePage + 1) % NVM_PAGE_COUNT, &validBytes);
+	printf("\n	* Checking whether the other page has no live data... ");
+	UT_CHECK((false != nvmRes) && (0 == validBytes) && (false == nvm_get_page_utilization(NVM_PAGE_COUNT, &validBytes)))
+
+#ifdef NVM_USE_KV_STORE
+	/* fill the page with live data until a value is rejected */
+	fillWithRandom(testData, NVM_KV_MAX_DATA_SIZE);
+	for(ctr=0; (ctr<NVM_KV_INDEX_SIZE) && (true == nvm_kv_put_id(2000 + ctr, testData, NVM_KV_MAX_DATA_SIZE)); ctr++)
+	{
+		expectedBytes += kvRecordSize;
+	}
+	nvm_get_page_utilization(GET_PAGE_IDX(NvmManagerDescriptor.writePointer), &validBytes);
+	printf("\n	* Checking whether a value, which does not fit, is rejected... ");
+	UT_CHECK((ctr < NVM_KV_INDEX_SIZE) && (expectedBytes == validBytes) && ((LOGICAL_PAGE_SIZE - PAGE_HEADER_SIZE - validBytes) < kvRecordSize))
+
+	nvmRes &= nvm_read(eNvmBlock2, testDataRead, &testDataReadSize);
+	nvmRes &= nvm_kv_get_id(2000, testDataRead, sizeof(testDataRead), &testDataReadSize);
+	printf("\n	* Checking whether the stored data is not lost... ");
+	UT_CHECK((false != nvmRes) && (false == nvm_get_error()) && (0 == memcmp(testData, testDataRead, NVM_KV_MAX_DATA_SIZE)))
+
+	while(ctr > 0)
+	{
+		ctr--;
+		nvmRes &= nvm_kv_delete_id(2000 + ctr);
+		expectedBytes -= kvRecordSize;
+	}
+	nvm_get_page_utilization(GET_PAGE_IDX(NvmManagerDescriptor.writePointer), &validBytes);
+	printf("\n	* Checking whether the deleted values are not live data any more... ");
+	UT_CHECK((false != nvmRes) && (expectedBytes == validBytes))
+#endif
+	printf("\n");
+}
+
+#ifdef NVM_USE_EMERGENCY_FLUSH
+/* Test the emergency flush of the SWC NVManager */
+void TestCase9(void)
+{
+	printf("\n");
+	printf("Name: Test case 9\n");
+	printf("  Description: Test the emergency flush of dirty blocks and their merging by the next initialization\n");
+	printf("  Preconditions: The NVManager is initialized\n");
+	printf("  Test steps: Mark two blocks as dirty, flush them and initialize the NVManager. Then write one of them normally and initialize again.\n");
+	printf("              Flush a block and write it without a reset, flush a block twice and place an old record into the region\n");
+	printf("  Check results: The flushed data is read after the initialization, the region is erased, a normal write is not overridden\n");
+	printf("                 by an older flushed record and the latest of two flushed records is merged\n");
+	printf("  Post steps: none\n");
+
+	uint8_t dirtyData[2][0x28];
+	uint8_t testDataRead[MAX_DR_SIZE];
+	uint8_t staleRecord[BLOCK_HEADER_SIZE + NVM_BLOCK_7_SIZE + NVM_CRC_LEN];
+	uint32_t writePointer = NvmManagerDescriptor.writePointer;
+	uint32_t staleCrc;
+	bool nvmRes = true;
+
+	fillWithRandom(dirtyData[0], NVM_BLOCK_3_SIZE);
+	fillWithRandom(dirtyData[1], NVM_BLOCK_7_SIZE);
+	nvmRes &= nvm_set_dirty(eNvmBlock3, dirtyData[0]);
+	nvmRes &= nvm_set_dirty(eNvmBlock7, dirtyData[1]);
+	nvmRes &= nvm_emergency_flush();
+	printf("\n	* Checking whether the flush does not write into the NVM area... ");
+	UT_CHECK((false != nvmRes) && (writePointer == NvmManagerDescriptor.writePointer) && (NVM_EMERGENCY_FLUSH_TIME_NS > 0))
+
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock3, testDataRead, &testDataReadSize);
+	nvmRes &= (0 == memcmp(dirtyData[0], testDataRead, NVM_BLOCK_3_SIZE));
+	nvmRes &= nvm_read(eNvmBlock7, testDataRead, &testDataReadSize);
+	nvmRes &= (0 == memcmp(dirtyData[1], testDataRead, NVM_BLOCK_7_SIZE));
+	printf("\n	* Checking whether the flushed blocks are merged and the region is erased... ");
+	UT_CHECK((false != nvmRes) && (false != FlsDrv_blankCheck(NVM_EMERGENCY_START_ADDR, NVM_EMERGENCY_SIZE)))
+
+	/* a written block is not dirty any more */
+	nvmRes &= nvm_set_dirty(eNvmBlock7, dirtyData[1]);
+	fillWithRandom(testData, NVM_BLOCK_7_SIZE);
+	nvmRes &= nvm_write(eNvmBlock7, testData, NVM_BLOCK_7_SIZE);
+	nvmRes &= nvm_emergency_flush();
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock7, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether a normal write is not overridden by the flush... ");
+	UT_CHECK((false != nvmRes) && (0 == memcmp(testData, testDataRead, NVM_BLOCK_7_SIZE)))
+
+	/* the brown-out recovers without a reset, so the application writes newer data after the flush */
+	nvmRes &= nvm_set_dirty(eNvmBlock7, dirtyData[1]);
+	nvmRes &= nvm_emergency_flush();
+	fillWithRandom(testData, NVM_BLOCK_7_SIZE);
+	nvmRes &= nvm_write(eNvmBlock7, testData, NVM_BLOCK_7_SIZE);
+	printf("\n	* Checking whether the flushed records are merged before the next normal write... ");
+	UT_CHECK((false != nvmRes) && (false != FlsDrv_blankCheck(NVM_EMERGENCY_START_ADDR, NVM_EMERGENCY_SIZE)))
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock7, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether a write after the flush is not overridden by the next initialization... ");
+	UT_CHECK((false != nvmRes) && (0 == memcmp(testData, testDataRead, NVM_BLOCK_7_SIZE)))
+
+	/* a record, whose generation is the occurrence counter of the latest instance, is older than it (i.e. a power cut before its mark) */
+	memcpy(staleRecord, &NvmBlocks[eNvmBlock7].pattern, BLOCK_HEADER_HALF_SIZE);
+	memcpy(staleRecord + BLOCK_HEADER_HALF_SIZE, &NvmBlocks[eNvmBlock7].occurrenceCntr, BLOCK_HEADER_HALF_SIZE);
+	memcpy(staleRecord + BLOCK_HEADER_SIZE, dirtyData[1], NVM_BLOCK_7_SIZE);
+	staleCrc = CRC32_Update(0, dirtyData[1], NVM_BLOCK_7_SIZE);
+	memcpy(staleRecord + BLOCK_HEADER_SIZE + NVM_BLOCK_7_SIZE, &staleCrc, NVM_CRC_LEN);
+	nvmRes &= FlsDrv_writeBytes(NVM_EMERGENCY_START_ADDR, staleRecord, sizeof(staleRecord));
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock7, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether a record older than the latest instance is not merged... ");
+	UT_CHECK((false != nvmRes) && (0 == memcmp(testData, testDataRead, NVM_BLOCK_7_SIZE)) &&
+	         (false != FlsDrv_blankCheck(NVM_EMERGENCY_START_ADDR, NVM_EMERGENCY_SIZE)))
+
+	/* the second brown-out comes before any write */
+	nvmRes &= nvm_set_dirty(eNvmBlock3, dirtyData[1]);
+	nvmRes &= nvm_emergency_flush();
+	nvmRes &= nvm_set_dirty(eNvmBlock3, dirtyData[0]);
+	nvmRes &= nvm_emergency_flush();
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock3, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether the latest of two flushed records is merged... ");
+	UT_CHECK((false != nvmRes) && (0 == memcmp(dirtyData[0], testDataRead, NVM_BLOCK_3_SIZE)))
+
+	printf("\n	* Checking whether the dirty blocks are limited... ");
+	UT_CHECK((false == nvm_set_dirty(eNvmBlockCount, dirtyData[0])) && (false == nvm_set_dirty(eNvmBlock1, NULL)))
+	printf("\n");
+}
+#endif
+
+#ifdef NVM_USE_BACKGROUND_ERASE
+/* Test the erasing in the background of the SWC NVManager */
+void TestCase10(void)
+{
+	printf("\n");
+	printf("Name: Test case 10\n");
+	printf("  Description: Test the erasing of the released page in the background\n");
+	printf("  Preconditions: The NVManager is initialized\n");
+	printf("  Test steps: Write a block until the page overflows, read a block during the erase, merge a flushed block with a write\n");
+	printf("              during the erase and continue the erase until it is finished\n");
+	printf("  Check results: The read suspends the erase and returns the correct data, the merge marks its record and erases the region,\n");
+	printf("                 the released page is erased\n");
+	printf("  Post steps: none\n");
+
+	uint8_t testDataRead[MAX_DR_SIZE];
+	uint8_t flashByte = 0;
+#ifdef NVM_USE_EMERGENCY_FLUSH
+	uint8_t dirtyData[0x28];
+#endif
+	uint32_t pageAddr = GET_PAGE_ADDR(NvmManagerDescriptor.writePointer);
+	uint32_t steps = 0;
+	bool nvmRes = true;
+
+	fillWithRandom(testData, NVM_BLOCK_9_SIZE);
+	nvmRes &= nvm_write(eNvmBlock9, testData, NVM_BLOCK_9_SIZE);
+	while( (false != nvmRes) && (pageAddr == GET_PAGE_ADDR(NvmManagerDescriptor.writePointer)) )
+	{
+		fillWithRandom(testDataRead, NVM_BLOCK_1_SIZE);
+		nvmRes &= nvm_write(eNvmBlock1, testDataRead, NVM_BLOCK_1_SIZE);
+	}
+	printf("\n	* Checking whether the released page is erased in the background... ");
+	UT_CHECK((false != nvmRes) && (pageAddr == NvmManagerDescriptor.erasePageAddr) && (false != NvmManagerDescriptor.bEraseRunning) &&
+	         (false == FlsDrv_readBytes(NvmBlocks[eNvmBlock9].readPointer, &flashByte, 1)))
+
+	nvmRes &= nvm_read(eNvmBlock9, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether a block is read during the erase... ");
+	UT_CHECK((false != nvmRes) && (0 == memcmp(testData, testDataRead, NVM_BLOCK_9_SIZE)) && (false != NvmManagerDescriptor.bEraseRunning))
+
+	while( (false == nvm_erase_step()) && (steps < 1000) )
+	{
+		steps++;
+	}
+	printf("\n	* Checking whether the released page is erased... ");
+	UT_CHECK((steps > 0) && (steps < 1000) && (false != FlsDrv_blankCheck(pageAddr, LOGICAL_PAGE_SIZE)))
+
+#ifdef NVM_USE_EMERGENCY_FLUSH
+	/* the merge mark is programmed while the erase of the next released page is running */
+	pageAddr = GET_PAGE_ADDR(NvmManagerDescriptor.writePointer);
+	while( (false != nvmRes) && (pageAddr == GET_PAGE_ADDR(NvmManagerDescriptor.writePointer)) )
+	{
+		fillWithRandom(testDataRead, NVM_BLOCK_1_SIZE);
+		nvmRes &= nvm_write(eNvmBlock1, testDataRead, NVM_BLOCK_1_SIZE);
+	}
+	nvmRes &= NvmManagerDescriptor.bEraseRunning;
+	fillWithRandom(dirtyData, NVM_BLOCK_3_SIZE);
+	nvmRes &= nvm_set_dirty(eNvmBlock3, dirtyData);
+	nvmRes &= nvm_emergency_flush();
+	nvmRes &= nvm_write(eNvmBlock9, testData, NVM_BLOCK_9_SIZE);
+	nvmRes &= nvm_read(eNvmBlock3, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether the flushed records are merged during the erase... ");
+	UT_CHECK((false != nvmRes) && (0 == memcmp(dirtyData, testDataRead, NVM_BLOCK_3_SIZE)) &&
+	         (NVM_EMERGENCY_START_ADDR == NvmManagerDescriptor.emergencyWritePointer) &&
+	         (false != FlsDrv_blankCheck(NVM_EMERGENCY_START_ADDR, NVM_EMERGENCY_SIZE)))
+#endif
+	printf("\n");
+}
+#endif
+
+/* Test the recovery of the SWC NVManager */
+void TestCase11(void)
+{
+	printf("\n");
+	printf("Name: Test case 11\n");
+	printf("  Description: Test the recovery from damaged records and failed writes\n");
+	printf("  Preconditions: The NVManager is initialized\n");
+	printf("  Test steps: Damage the data and the header of the latest instances of blocks, initialize the NVManager and make a write fail\n");
+	printf("  Check results: Only the damaged instances are lost, the previous instances and all other blocks are kept\n");
+	printf("  Post steps: Force a garbage collection, so that the damaged records are dropped\n");
+
+	uint8_t testDataRead[MAX_DR_SIZE];
+	uint8_t previousData[MAX_DR_SIZE];
+	uint8_t otherData[MAX_DR_SIZE];
+	uint8_t damage[2] = { 0x00, 0x00 };
+	uint32_t damagedAddr;
+	uint32_t pageAddr;
+	bool nvmRes = true;
+
+	/* the page overflow would move the previous instances into the other page, so the test starts on a new page */
+	nvm_init();
+	pageAddr = GET_PAGE_ADDR(NvmManagerDescriptor.writePointer);
+	while( (false != nvmRes) && (pageAddr == GET_PAGE_ADDR(NvmManagerDescriptor.writePointer)) )
+	{
+		fillWithRandom(testDataRead, NVM_BLOCK_1_SIZE);
+		nvmRes &= nvm_write(eNvmBlock1, testDataRead, NVM_BLOCK_1_SIZE);
+	}
+
+	fillWithRandom(previousData, NVM_BLOCK_3_SIZE);
+	nvmRes &= nvm_write(eNvmBlock3, previousData, NVM_BLOCK_3_SIZE);
+	fillWithRandom(testData, NVM_BLOCK_3_SIZE);
+	nvmRes &= nvm_write(eNvmBlock3, testData, NVM_BLOCK_3_SIZE);
+	damagedAddr = NvmBlocks[eNvmBlock3].readPointer;
+	fillWithRandom(otherData, NVM_BLOCK_7_SIZE);
+	nvmRes &= nvm_write(eNvmBlock7, otherData, NVM_BLOCK_7_SIZE);
+
+#ifdef NVM_USE_BACKGROUND_ERASE
+	/* the flash is not accessible during the erase of the released page */
+	while(false == nvm_erase_step())
+	{
+	}
+#endif
+
+	/* the checksum of the latest instance does not match */
+	FlsDrv_writeBytes(damagedAddr + BLOCK_HEADER_SIZE, damage, 1);
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock3, testDataRead, &testDataReadSize);
+	nvmRes &= (0 == memcmp(previousData, testDataRead, NVM_BLOCK_3_SIZE));
+	nvmRes &= nvm_read(eNvmBlock7, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether a damaged instance falls back to the previous one... ");
+	UT_CHECK((false != nvmRes) && (false != nvm_get_error()) && (0 == memcmp(otherData, testDataRead, NVM_BLOCK_7_SIZE)))
+
+	/* the pattern of the latest instance is unknown, so its size is unknown too */
+	nvmRes &= nvm_write(eNvmBlock3, testData, NVM_BLOCK_3_SIZE);
+	damagedAddr = NvmBlocks[eNvmBlock3].readPointer;
+	fillWithRandom(otherData, NVM_BLOCK_7_SIZE);
+	nvmRes &= nvm_write(eNvmBlock7, otherData, NVM_BLOCK_7_SIZE);
+	FlsDrv_writeBytes(damagedAddr, damage, 2);
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock3, testDataRead, &testDataReadSize);
+	nvmRes &= (0 == memcmp(previousData, testDataRead, NVM_BLOCK_3_SIZE));
+	nvmRes &= nvm_read(eNvmBlock7, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether the records after a damaged header are found... ");
+	UT_CHECK((false != nvmRes) && (0 == memcmp(otherData, testDataRead, NVM_BLOCK_7_SIZE)))
+
+	/* the flash is busy with an erase, which is not started by the NVManager, so the programming fails */
+	FlsDrv_eraseStart(NVM_MANAGER_END_ADDR + FLASH_SECTOR_SIZE);
+	printf("\n	* Checking whether a failed write keeps the stored data... ");
+	UT_CHECK((false == nvm_write(eNvmBlock3, testData, NVM_BLOCK_3_SIZE)) && (READ_POINTER_NOT_SET != NvmBlocks[eNvmBlock7].readPointer))
+	while(FLS_ERASE_IDLE != FlsDrv_eraseStatus())
+	{
+	}
+
+	nvmRes &= nvm_write(eNvmBlock3, testData, NVM_BLOCK_3_SIZE);
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock3, testDataRead, &testDataReadSize);
+	nvmRes &= (0 == memcmp(testData, testDataRead, NVM_BLOCK_3_SIZE));
+	nvmRes &= nvm_read(eNvmBlock7, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether the NVManager continues after the failed write... ");
+	UT_CHECK((false != nvmRes) && (0 == memcmp(otherData, testDataRead, NVM_BLOCK_7_SIZE)))
+
+	/* the damaged records are not live data */
+	pageAddr = GET_PAGE_ADDR(NvmManagerDescriptor.writePointer);
+	while( (false != nvmRes) && (pageAddr == GET_PAGE_ADDR(NvmManagerDescriptor.writePointer)) )
+	{
+		fillWithRandom(testDataRead, NVM_BLOCK_1_SIZE);
+		nvmRes &= nvm_write(eNvmBlock1, testDataRead, NVM_BLOCK_1_SIZE);
+	}
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock7, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether the damaged records are dropped by the garbage collection... ");
+	UT_CHECK((false != nvmRes) && (false == nvm_get_error()) && (0 == memcmp(otherData, testDataRead, NVM_BLOCK_7_SIZE)))
+	printf("\n");
+}
+
+#ifdef NVM_USE_LAZY_MOUNT
+/* Test the lazy initialization of the SWC NVManager */
+void TestCase12(void)
+{
+	printf("\n");
+	printf("Name: Test case 12\n");
+	printf("  Description: Test the lazy initialization with search of the records on demand\n");
+	printf("  Preconditions: The NVManager is initialized\n");
+	printf("  Test steps: Initialize lazily, read a block, search the rest of the records step by step, then initialize lazily again and write a block\n");
+	printf("  Check results: The block is read before all records are searched and the final state is the same as after the complete initialization\n");
+	printf("  Post steps: none\n");
+
+	uint8_t testDataRead[MAX_DR_SIZE];
+	uint8_t otherData[MAX_DR_SIZE];
+	uint32_t writePointer;
+	uint32_t validBytes = 0;
+	uint32_t expectedBytes = 0;
+	uint32_t steps = 0;
+	bool nvmRes = true;
+
+	fillWithRandom(testData, NVM_BLOCK_2_SIZE);
+	nvmRes &= nvm_write(eNvmBlock2, testData, NVM_BLOCK_2_SIZE);
+	fillWithRandom(otherData, NVM_BLOCK_7_SIZE);
+	nvmRes &= nvm_write(eNvmBlock7, otherData, NVM_BLOCK_7_SIZE);
+	nvm_init();
+	writePointer = NvmManagerDescriptor.writePointer;
+	nvmRes &= nvm_get_page_utilization(GET_PAGE_IDX(writePointer), &expectedBytes);
+
+	nvm_init_lazy();
+	nvmRes &= nvm_read(eNvmBlock2, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether a block is read before all records are searched... ");
+	UT_CHECK((false != nvmRes) && (false == NvmManagerDescriptor.bMountComplete) && (0 == memcmp(testData, testDataRead, NVM_BLOCK_2_SIZE)))
+
+	while( (false == nvm_mount_step()) && (steps < 1000) )
+	{
+		steps++;
+	}
+	nvmRes &= nvm_read(eNvmBlock7, testDataRead, &testDataReadSize);
+	nvmRes &= nvm_get_page_utilization(GET_PAGE_IDX(writePointer), &validBytes);
+	printf("\n	* Checking whether the search step by step gives the same state as the complete initialization... ");
+	UT_CHECK((false != nvmRes) && (steps > 0) && (steps < 1000) && (writePointer == NvmManagerDescriptor.writePointer) && 
+	         (expectedBytes == validBytes) && (0 == memcmp(otherData, testDataRead, NVM_BLOCK_7_SIZE)))
+
+	nvm_init_lazy();
+	fillWithRandom(testData, NVM_BLOCK_7_SIZE);
+	nvmRes &= nvm_write(eNvmBlock7, testData, NVM_BLOCK_7_SIZE);
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock7, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether a write searches the rest of the records first... ");
+	UT_CHECK((false != nvmRes) && (writePointer != NvmManagerDescriptor.writePointer) && (0 == memcmp(testData, testDataRead, NVM_BLOCK_7_SIZE)))
+	printf("\n");
+}
+#endif
+
+#ifdef NVM_USE_WEAR_BUDGET
+/* Test the endurance budget of the SWC NVManager */
+void TestCase13(void)
+{
+	printf("\n");
+	printf("Name: Test case 13\n");
+	printf("  Description: Test the coalescing of the writes of throttleable blocks and the projection of the remaining life\n");
+	printf("  Preconditions: The NVManager is initialized\n");
+	printf("  Test steps: Write a throttleable and a critical block within and after the coalescing window with erases within and over the budget.\n");
+	printf("              The buffer of a deferred write is changed after the write\n");
+	printf("  Check results: Only the latest data of the throttleable block is programmed after its window, which is stretched over the budget.\n");
+	printf("                 The deferred data is not changed with the buffer of the caller\n");
+	printf("  Post steps: The erase count and the operating time are restored\n");
+
+	uint8_t testDataRead[MAX_DR_SIZE];
+	uint8_t otherData[MAX_DR_SIZE];
+	uint8_t deferredData[MAX_DR_SIZE];
+	uint8_t criticalData[MAX_DR_SIZE];
+	uint32_t eraseCount = NvmManagerDescriptor.eraseCount;
+	uint32_t operatingTime = NvmManagerDescriptor.operatingTime;
+	uint32_t bootTime = NvmManagerDescriptor.bootTime;
+	uint32_t window = NvmWriteWindows[eNvmBlock10];
+	uint32_t readPointer;
+	uint32_t remainingLife = 0;
+	bool nvmRes = true;
+
+	/* 1. the erases are within the budget, so the window is not stretched */
+	NvmManagerDescriptor.eraseCount = 0;
+	SysTimeSimu += window * NVM_WEAR_MAX_STRETCH;
+	fillWithRandom(testData, NVM_BLOCK_10_SIZE);
+	nvmRes &= nvm_write(eNvmBlock10, testData, NVM_BLOCK_10_SIZE);
+	readPointer = NvmBlocks[eNvmBlock10].readPointer;
+	fillWithRandom(deferredData, NVM_BLOCK_10_SIZE);
+	nvmRes &= nvm_write(eNvmBlock10, deferredData, NVM_BLOCK_10_SIZE);
+	/* the buffer of the deferred write is reused by the caller */
+	memcpy(otherData, deferredData, NVM_BLOCK_10_SIZE);
+	fillWithRandom(deferredData, NVM_BLOCK_10_SIZE);
+	nvmRes &= nvm_read(eNvmBlock10, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether a write within the coalescing window is deferred with a copy of the data and read back... ");
+	UT_CHECK((false != nvmRes) && (readPointer == NvmBlocks[eNvmBlock10].readPointer) && (false == nvm_write_step()) && 
+	         (0 == memcmp(otherData, testDataRead, NVM_BLOCK_10_SIZE)))
+
+	SysTimeSimu += window;
+	nvmRes &= nvm_write_step();
+	nvmRes &= nvm_read(eNvmBlock10, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether the latest data is programmed after the window... ");
+	UT_CHECK((false != nvmRes) && (readPointer != NvmBlocks[eNvmBlock10].readPointer) && (0 == memcmp(otherData, testDataRead, NVM_BLOCK_10_SIZE)))
+
+	/* 2. the erases run ahead of the budget, so the window is stretched, but not for a critical block */
+	NvmManagerDescriptor.eraseCount = 4 * ((((NvmManagerDescriptor.operatingTime + SysTimeSimu) - NvmManagerDescriptor.bootTime) / NVM_WEAR_BUDGET_PERIOD_S) + 1);
+	readPointer = NvmBlocks[eNvmBlock10].readPointer;
+	fillWithRandom(testData, NVM_BLOCK_10_SIZE);
+	nvmRes &= nvm_write(eNvmBlock10, testData, NVM_BLOCK_10_SIZE);
+	SysTimeSimu += window;
+	printf("\n	* Checking whether the window is stretched over the budget... ");
+	UT_CHECK((false != nvmRes) && (false == nvm_write_step()) && (readPointer == NvmBlocks[eNvmBlock10].readPointer))
+
+	readPointer = NvmBlocks[eNvmBlock2].readPointer;
+	fillWithRandom(criticalData, NVM_BLOCK_2_SIZE);
+	nvmRes &= nvm_write(eNvmBlock2, criticalData, NVM_BLOCK_2_SIZE);
+	nvmRes &= nvm_write(eNvmBlock2, testData, NVM_BLOCK_2_SIZE);
+	printf("\n	* Checking whether a critical block bypasses the throttle... ");
+	UT_CHECK((false != nvmRes) && (readPointer != NvmBlocks[eNvmBlock2].readPointer))
+
+	SysTimeSimu += window * NVM_WEAR_MAX_STRETCH;
+	nvmRes &= nvm_write_step();
+	nvmRes &= nvm_read(eNvmBlock10, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether the data is programmed after the stretched window... ");
+	UT_CHECK((false != nvmRes) && (readPointer != NvmBlocks[eNvmBlock10].readPointer) && (0 == memcmp(testData, testDataRead, NVM_BLOCK_10_SIZE)))
+
+	printf("\n	* Checking whether the wear info is not written through the interface... ");
+	UT_CHECK(false == nvm_write(eNvmWearInfo, testData, NVM_WEAR_INFO_SIZE))
+
+	/* 3. projection of the remaining life */
+	NvmManagerDescriptor.eraseCount = 0;
+	nvmRes &= nvm_get_remaining_life(&remainingLife);
+	printf("\n	* Checking whether the remaining life is not limited without erases... ");
+	UT_CHECK((false != nvmRes) && (NVM_REMAINING_LIFE_MAX == remainingLife))
+
+	NvmManagerDescriptor.eraseCount = 1000;
+	NvmManagerDescriptor.operatingTime = 1000 * 1000;
+	NvmManagerDescriptor.bootTime = SysTimeSimu;
+	nvmRes &= nvm_get_remaining_life(&remainingLife);
+	printf("\n	* Checking whether the remaining life is projected from the erase rate... ");
+	UT_CHECK((false != nvmRes) && ((1000 * (NVM_RATED_PAGE_ERASES - 1000)) == remainingLife))
+
+	NvmManagerDescriptor.eraseCount = NVM_RATED_PAGE_ERASES;
+	nvmRes &= nvm_get_remaining_life(&remainingLife);
+	printf("\n	* Checking whether the remaining life is over at the rated endurance... ");
+	UT_CHECK((false != nvmRes) && (0 == remainingLife))
+
+	/* 4. the wear info is kept over the initialization */
+	NvmManagerDescriptor.eraseCount = eraseCount;
+	NvmManagerDescriptor.operatingTime = operatingTime;
+	NvmManagerDescriptor.bootTime = bootTime;
+	fillWithRandom(testData, NVM_BLOCK_10_SIZE);
+	nvmRes &= nvm_write(eNvmBlock10, testData, NVM_BLOCK_10_SIZE);
+	nvmRes &= nvm_write_flush();
+	operatingTime = (operatingTime + SysTimeSimu) - bootTime;
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock10, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether the deferred data and the wear info are kept over the initialization... ");
+	UT_CHECK((false != nvmRes) && (eraseCount == NvmManagerDescriptor.eraseCount) && (operatingTime == NvmManagerDescriptor.operatingTime) && 
+	         (0 == memcmp(testData, testDataRead, NVM_BLOCK_10_SIZE)))
+	printf("\n");
+}
+#endif
+
+#ifdef NVM_USE_STATS
+/* Test the runtime counters of the SWC NVManager */
+void TestCase14(void)
+{
+	printf("\n");
+	printf("Name: Test case 14\n");
+	printf("  Description: Test the runtime counters and the write amplification\n");
+	printf("  Preconditions: The NVManager is initialized\n");
+	printf("  Test steps: Initialize, write a changed and an unchanged block, then force a garbage collection and let a programming fail\n");
+	printf("  Check results: The requests, the programming, the erases and the relocations are counted and the usage of the page is consistent.\n");
+	printf("                 The write amplification is the one of workload_bench and the failed programming is not counted\n");
+	printf("  Post steps: none\n");
 
-	for(j=0; j<TOTAL_FLASH_SIZE/BUFF_FLASH_PAGE_SIZE; j++)
+	NvmStats_t stats;
+	NvmStats_t failedStats;
+	uint32_t pageAddr;
+	uint32_t erases = 0;
+	uint32_t ctr;
+	bool nvmRes = true;
+
+	nvm_init();
+	fillWithRandom(testData, NVM_BLOCK_2_SIZE);
+	nvmRes &= nvm_write(eNvmBlock2, testData, NVM_BLOCK_2_SIZE);
+	nvmRes &= nvm_write(eNvmBlock2, testData, NVM_BLOCK_2_SIZE);
+	nvmRes &= nvm_get_stats(&stats);
+	printf("\n	* Checking whether the changed and the unchanged write are counted... ");
+	UT_CHECK((false != nvmRes) && (2 == stats.writesRequested) && (1 == stats.writesSkipped) && (1 == stats.recordsProgrammed) && 
+	         ((2 * NVM_BLOCK_2_SIZE) == stats.bytesRequested) && ((NVM_BLOCK_2_SIZE + BLOCK_HEADER_SIZE + NVM_CRC_LEN) == stats.bytesProgrammed) &&
+	         (((stats.bytesProgrammed * 100) / stats.bytesRequested) == stats.writeAmplification) && (0 == stats.gcRuns))
+
+	/* write a big block until the page changes */
+	pageAddr = GET_PAGE_ADDR(NvmManagerDescriptor.writePointer);
+	for(ctr = 0; (ctr < 100) && (pageAddr == GET_PAGE_ADDR(NvmManagerDescriptor.writePointer)); ctr++)
+	{
+		fillWithRandom(testData, NVM_BLOCK_1_SIZE);
+		nvmRes &= nvm_write(eNvmBlock1, testData, NVM_BLOCK_1_SIZE);
+	}
+#ifdef NVM_USE_BACKGROUND_ERASE
+	while(false == nvm_erase_step())
+	{
+		/* the released page is erased */
+	}
+#endif
+	nvmRes &= nvm_get_stats(&stats);
+	for(ctr = 0; ctr < NVM_SECTOR_COUNT; ctr++)
+	{
+		erases += stats.sectorErases[ctr];
+	}
+	printf("\n	* Checking whether the garbage collection and the erases are counted... ");
+	UT_CHECK((false != nvmRes) && (1 == stats.gcRuns) && (0 < stats.gcRecordsRelocated) && (0 < stats.gcBytesRelocated) && 
+	         (erases >= (LOGICAL_PAGE_SIZE / FLASH_SECTOR_SIZE)) && (stats.bytesProgrammed > (stats.bytesRequested + stats.gcBytesRelocated)) && 
+	         (100 < stats.writeAmplification))
+	printf("\n	* Checking whether the usage of the page is consistent... ");
+	UT_CHECK((LOGICAL_PAGE_SIZE == (PAGE_HEADER_SIZE + stats.liveBytes + stats.dirtyBytes + stats.freeBytes)) && 
+	         (stats.writesRequested == (stats.writesSkipped + stats.recordsProgrammed - stats.gcRecordsRelocated)))
+
+	/* the flash is busy with an erase, which is not started by the NVManager, so the programming fails */
+	FlsDrv_eraseStart(NVM_MANAGER_END_ADDR + FLASH_SECTOR_SIZE);
+	nvmRes &= (false == nvm_write(eNvmBlock2, testData, NVM_BLOCK_2_SIZE));
+	while(FLS_ERASE_IDLE != FlsDrv_eraseStatus())
+	{
+	}
+	nvmRes &= nvm_get_stats(&failedStats);
+	printf("\n	* Checking whether a failed programming is not counted as programmed or requested... ");
+	UT_CHECK((false != nvmRes) && ((stats.writesRequested + 1) == failedStats.writesRequested) && (stats.recordsProgrammed == failedStats.recordsProgrammed) && 
+	         (stats.bytesProgrammed == failedStats.bytesProgrammed) && (stats.bytesRequested == failedStats.bytesRequested))
+
+	printf("\n	* Checking whether the counters are rejected without a destination... ");
+	UT_CHECK(false == nvm_get_stats(NULL))
+	printf("\n");
+}
+#endif
+
+#ifdef NVM_USE_TRACE
+static uint32_t TraceBegins[NVM_TRACE_OP_COUNT];
+static uint32_t TraceEnds[NVM_TRACE_OP_COUNT];
+static uint32_t TraceTicks = 0;
+static bool bTraceNested = true;
+
+/* Trace callback, which counts the events of every operation */
+static void traceCallback(NvmTraceOp_t op, NvmTraceEvent_t event, uint32_t timestamp, uint32_t arg)
+{
+	(void)timestamp;
+	(void)arg;
+
+	if(NVM_TRACE_EVENT_BEGIN == event)
+	{
+		TraceBegins[op]++;
+	}
+	else
+	{
+		TraceEnds[op]++;
+		/* an operation can not end before it begins */
+		bTraceNested &= (TraceEnds[op] <= TraceBegins[op]);
+	}
+}
+
+/* Trace clock, which ticks on every call */
+static uint32_t traceClock(void)
+{
+	return TraceTicks++;
+}
+
+/* Sum of the counters of a latency histogram */
+static uint32_t traceHistogramSum(NvmTraceOp_t op)
+{
+	uint32_t histogram[NVM_TRACE_HIST_BUCKETS];
+	uint32_t sum = 0;
+	uint32_t ctr;
+
+	if(false == nvm_trace_get_histogram(op, histogram))
+	{
+		return 0;
+	}
+
+	for(ctr = 0; ctr < NVM_TRACE_HIST_BUCKETS; ctr++)
+	{
+		sum += histogram[ctr];
+	}
+
+	return sum;
+}
+
+/* Test the trace points of the SWC NVManager */
+void TestCase15(void)
+{
+	printf("\n");
+	printf("Name: Test case 15\n");
+	printf("  Description: Test the trace points and the latency histograms\n");
+	printf("  Preconditions: The NVManager is initialized\n");
+	printf("  Test steps: Register a callback and a clock, write a changed block, force a garbage collection and initialize again\n");
+	printf("  Check results: Every traced operation begins and ends and its latency is counted once\n");
+	printf("  Post steps: The callback and the clock are unregistered\n");
+
+	uint32_t histogram[NVM_TRACE_HIST_BUCKETS];
+	uint32_t pageAddr;
+	uint32_t ctr;
+	bool nvmRes = true;
+
+	nvm_init();
+	memset(TraceBegins, 0, sizeof(TraceBegins));
+	memset(TraceEnds, 0, sizeof(TraceEnds));
+	nvm_trace_register(traceCallback, traceClock);
+
+	fillWithRandom(testData, NVM_BLOCK_2_SIZE);
+	nvmRes &= nvm_write(eNvmBlock2, testData, NVM_BLOCK_2_SIZE);
+	printf("\n	* Checking whether a write is traced... ");
+	UT_CHECK((false != nvmRes) && (1 == TraceBegins[NVM_TRACE_WRITE]) && (1 == TraceEnds[NVM_TRACE_WRITE]) && 
+	         (1 == TraceEnds[NVM_TRACE_DUP_CHECK]) && (0 < TraceEnds[NVM_TRACE_PROGRAM]) && (0 < TraceEnds[NVM_TRACE_READ]) && 
+	         (1 == traceHistogramSum(NVM_TRACE_WRITE)) && (TraceEnds[NVM_TRACE_PROGRAM] == traceHistogramSum(NVM_TRACE_PROGRAM)))
+
+	/* write a big block until the page changes */
+	pageAddr = GET_PAGE_ADDR(NvmManagerDescriptor.writePointer);
+	for(ctr = 0; (ctr < 100) && (pageAddr == GET_PAGE_ADDR(NvmManagerDescriptor.writePointer)); ctr++)
+	{
+		fillWithRandom(testData, NVM_BLOCK_1_SIZE);
+		nvmRes &= nvm_write(eNvmBlock1, testData, NVM_BLOCK_1_SIZE);
+	}
+#ifdef NVM_USE_BACKGROUND_ERASE
+	while(false == nvm_erase_step())
+	{
+		/* the released page is erased */
+	}
+#endif
+	printf("\n	* Checking whether the garbage collection is traced... ");
+	UT_CHECK((false != nvmRes) && (1 == TraceEnds[NVM_TRACE_GC]) && (1 == traceHistogramSum(NVM_TRACE_GC)) && 
+	         ((ctr + 1) == TraceEnds[NVM_TRACE_WRITE]))
+
+	nvm_init();
+	printf("\n	* Checking whether the initialization is traced and every operation is ended... ");
+	UT_CHECK((1 == TraceEnds[NVM_TRACE_MOUNT]) && (1 == traceHistogramSum(NVM_TRACE_MOUNT)) && (false != bTraceNested) && 
+	         (0 == memcmp(TraceBegins, TraceEnds, sizeof(TraceBegins))))
+
+	printf("\n	* Checking whether an unknown operation is rejected... ");
+	UT_CHECK(false == nvm_trace_get_histogram(NVM_TRACE_OP_COUNT, histogram))
+
+	nvm_trace_register(NULL, NULL);
+	printf("\n	* Checking whether the histograms are cleared by the registration... ");
+	UT_CHECK((0 == traceHistogramSum(NVM_TRACE_WRITE)) && (0 == traceHistogramSum(NVM_TRACE_READ)))
+	printf("\n");
+}
+#endif
+
+/* Test the SWC NVManager on the flash simulator */
+void TestCase16(void)
+{
+	printf("\n");
+	printf("Name: Test case 16\n");
+	printf("  Description: Test the NOR flash simulator and the flash operations of the NVManager\n");
+	printf("  Preconditions: The flash driver is initialized and all test cases before are executed\n");
+	printf("  Test steps: Check the operations of all test cases, program over programmed data, across a program page and erase without alignment\n");
+	printf("  Check results: The NVManager never sets a programmed bit, the programming clears bits only, the operations are counted and timed\n");
+	printf("  Post steps: The sector of the test is erased\n");
+
+	const uint32_t testAddr = TOTAL_FLASH_SIZE - BUFF_FLASH_PAGE_SIZE;
+	const FlsSimu_Timing_t timing = { 0, 0, 1000, 0, 2000 };
+	FlsSimu_Stats_t before;
+	FlsSimu_Stats_t after;
+	uint8_t pattern[2] = { 0xF0, 0x3C };
+	uint8_t result[2] = { 0, 0 };
+	uint32_t erases = 0;
+	uint32_t ctr;
+
+	FlsSimu_getStats(&before);
+	for(ctr = NVM_MANAGER_START_ADDR / BUFF_FLASH_PAGE_SIZE; ctr < NVM_MANAGER_END_ADDR / BUFF_FLASH_PAGE_SIZE; ctr++)
+	{
+		erases += before.sectorErases[ctr];
+	}
+	printf("\n	* Checking whether the NVManager programs erased bits only... ");
+	UT_CHECK((0 == before.programViolations) && (0 < before.programs) && (0 < erases) && (0 < before.busyTimeUs))
+
+	FlsSimu_setTiming(&timing);
+	FlsDrv_eraseBlock4K(testAddr);
+	FlsDrv_writeBytes(testAddr, pattern, 2);
+	pattern[0] = 0x0F;
+	pattern[1] = 0x3C;
+	FlsDrv_writeBytes(testAddr, pattern, 2);
+	FlsDrv_readBytes(testAddr, result, 2);
+	FlsSimu_getStats(&after);
+	printf("\n	* Checking whether the programming clears bits only... ");
+	UT_CHECK((0x00 == result[0]) && (0x3C == result[1]) && (1 == after.programViolations))
+
+	FlsDrv_writeBytes(testAddr + FLS_SIMU_PROGRAM_PAGE_SIZE - 1, pattern, 2);
+	FlsSimu_getStats(&after);
+	printf("\n	* Checking whether a write across a program page is split and the latency is modelled... ");
+	UT_CHECK(((before.programs + 4) == after.programs) && ((before.sectorErases[testAddr / BUFF_FLASH_PAGE_SIZE] + 1) == after.sectorErases[testAddr / BUFF_FLASH_PAGE_SIZE]) && 
+	         ((before.busyTimeUs + 6) == after.busyTimeUs))
+
+	printf("\n	* Checking whether an operation outside of the flash or of an unaligned sector is rejected... ");
+	UT_CHECK((false == FlsDrv_eraseBlock4K(testAddr + 1)) && (false == FlsDrv_eraseStart(testAddr + 1)) && 
+	         (false == FlsDrv_writeBytes(TOTAL_FLASH_SIZE - 1, pattern, 2)) && (false == FlsDrv_readBytes(TOTAL_FLASH_SIZE, result, 1)))
+
+	FlsDrv_eraseBlock4K(testAddr);
+	FlsSimu_setTiming(NULL);
+	printf("\n");
+}
+
+#ifdef NVM_USE_RECORDER
+#define TEST_RECORDS_MAX 8
+static uint8_t TestRecords[TEST_RECORDS_MAX][NVM_REC_SIZE];
+static uint32_t TestRecordCount = 0;
+
+/* Sink of the recorder, which keeps the first records */
+static void recordSink(const uint8_t* record, uint32_t len)
+{
+	if( (TestRecordCount < TEST_RECORDS_MAX) && (NVM_REC_SIZE == len) )
+	{
+		memcpy(TestRecords[TestRecordCount], record, NVM_REC_SIZE);
+	}
+	TestRecordCount++;
+}
+
+/* Little-endian field of a record */
+static uint32_t recordField(uint32_t recIdx, uint32_t offset, uint32_t len)
+{
+	uint32_t value = 0;
+
+	while(len > 0)
+	{
+		len--;
+		value = (value << 8) | TestRecords[recIdx][offset + len];
+	}
+
+	return value;
+}
+
+/* Test the recorder of the SWC NVManager */
+void TestCase17(void)
+{
+	printf("\n");
+	printf("Name: Test case 17\n");
+	printf("  Description: Test the recording of the calls of the API\n");
+	printf("  Preconditions: none\n");
+	printf("  Test steps: Register a sink, initialize, write a block twice with the same data, read it and read a block out of range,\n");
+	printf("              then write a chunk and a half of an empty large object\n");
+	printf("  Check results: Every call is recorded with its block, size, checksum of the data and result, calls out of range are not recorded.\n");
+	printf("                 The chunks of the large object are recorded as writes of their blocks between the read and the write of its size\n");
+	printf("  Post steps: The sink is unregistered\n");
+
+	uint8_t testDataRead[MAX_DR_SIZE];
+#ifdef NVM_USE_LARGE_OBJECTS
+	uint8_t loData[2*NVM_LO_CHUNK_SIZE];
+#endif
+	bool nvmRes = true;
+
+	TestRecordCount = 0;
+	nvm_record_register(recordSink);
+	nvm_init();
+	fillWithRandom(testData, NVM_BLOCK_2_SIZE);
+	nvmRes &= nvm_write(eNvmBlock2, testData, NVM_BLOCK_2_SIZE);
+	nvmRes &= nvm_write(eNvmBlock2, testData, NVM_BLOCK_2_SIZE);
+	nvmRes &= nvm_read(eNvmBlock2, testDataRead, &testDataReadSize);
+	nvmRes &= (false == nvm_read(eNvmBlockCount, testDataRead, &testDataReadSize));
+	nvm_record_register(NULL);
+	nvmRes &= nvm_write(eNvmBlock2, testData, NVM_BLOCK_2_SIZE);
+
+	printf("\n	* Checking whether the calls are recorded in order... ");
+	UT_CHECK((false != nvmRes) && (4 == TestRecordCount) && (NVM_REC_INIT == TestRecords[0][0]) && (NVM_REC_WRITE == TestRecords[1][0]) && 
+	         (NVM_REC_WRITE == TestRecords[2][0]) && (NVM_REC_READ == TestRecords[3][0]) && (0 == recordField(0, 4, 4)))
+	printf("\n	* Checking whether the block, the size and the checksum of the data are recorded... ");
+	UT_CHECK((eNvmBlock2 == TestRecords[1][1]) && (NVM_BLOCK_2_SIZE == recordField(1, 2, 2)) && 
+	         (CRC32_Calculate(testData, NVM_BLOCK_2_SIZE) == recordField(1, 8, 4)) && (0 == memcmp(TestRecords[1], TestRecords[2], 4)) && 
+	         (recordField(1, 8, 4) == recordField(2, 8, 4)) && (recordField(1, 8, 4) == recordField(3, 8, 4)))
+
+#ifdef NVM_USE_LARGE_OBJECTS
+	/* the shorter second chunk is programmed with a filling of zeros */
+	nvmRes &= nvm_lo_set_size(eNvmLo1, 0);
+	fillWithRandom(loData, NVM_LO_CHUNK_SIZE + 0x10);
+	memcpy(testDataRead, loData + NVM_LO_CHUNK_SIZE, 0x10);
+	memset(testDataRead + 0x10, 0, NVM_LO_CHUNK_SIZE - 0x10);
+	TestRecordCount = 0;
+	nvm_record_register(recordSink);
+	nvmRes &= nvm_lo_write(eNvmLo1, 0, loData, NVM_LO_CHUNK_SIZE + 0x10);
+	nvm_record_register(NULL);
+
+	printf("\n	* Checking whether the chunks of a large object are recorded as writes of their blocks... ");
+	UT_CHECK((false != nvmRes) && (4 == TestRecordCount) && (NVM_REC_READ == TestRecords[0][0]) && (eNvmLo1Index == TestRecords[0][1]) &&
+	         (NVM_REC_WRITE == TestRecords[1][0]) && (eNvmLo1Chunk1 == TestRecords[1][1]) &&
+	         (NVM_REC_WRITE == TestRecords[2][0]) && (eNvmLo1Chunk2 == TestRecords[2][1]) && (NVM_LO_CHUNK_SIZE == recordField(2, 2, 2)) &&
+	         (CRC32_Calculate(loData, NVM_LO_CHUNK_SIZE) == recordField(1, 8, 4)) &&
+	         (CRC32_Calculate(testDataRead, NVM_LO_CHUNK_SIZE) == recordField(2, 8, 4)) &&
+	         (NVM_REC_WRITE == TestRecords[3][0]) && (eNvmLo1Index == TestRecords[3][1]))
+#endif
+	printf("\n");
+}
+#endif
+
+/* Test the power cuts of the SWC NVManager */
+void TestCase18(void)
+{
+	printf("\n");
+	printf("Name: Test case 18\n");
+	printf("  Description: Test the recovery after power cuts during a write and during the garbage collection\n");
+	printf("  Preconditions: The flash driver is initialized\n");
+	printf("  Test steps: Cut the power after the header of a record of 4 bytes, fill the page and cut the power during the transfer of the blocks,\n");
+	printf("              then during the programming of the mark of the page\n");
+	printf("  Check results: The torn record and the torn mark are handled and all blocks have the data of the latest completed write after the initialization\n");
+	printf("  Post steps: The power is on\n");
+
+	static uint8_t expected[eNvmBlock15 + 1][MAX_DR_SIZE];
+	uint8_t testDataRead[MAX_DR_SIZE];
+	FlsSimu_Stats_t before;
+	FlsSimu_Stats_t after;
+	FlsSimu_PowerCut_t cut;
+	NvmBlocksId_t bIdx;
+	bool nvmRes = true;
+
+	nvm_init();
+	FlsSimu_getStats(&before);
+	for(bIdx = eNvmBlock1; bIdx <= eNvmBlock15; bIdx++)
+	{
+		fillWithRandom(expected[bIdx], NvmBlocks[bIdx].size);
+		nvmRes &= nvm_write(bIdx, expected[bIdx], (uint16_t)NvmBlocks[bIdx].size);
+	}
+#ifdef NVM_USE_WEAR_BUDGET
+	nvmRes &= nvm_write_flush();
+#endif
+
+	/* the checksum of 4 erased bytes is 0xFFFFFFFF, so the torn record would look valid */
+	memset(testData, 0x5A, NVM_BLOCK_14_SIZE);
+	FlsSimu_setPowerCut(BLOCK_HEADER_SIZE);
+	(void)nvm_write(eNvmBlock14, testData, NVM_BLOCK_14_SIZE);
+	FlsSimu_setPowerCut(FLS_SIMU_POWER_ON);
+	nvm_init();
+	printf("\n	* Checking whether a record torn after its header is ignored... ");
+	UT_CHECK((false != nvmRes) && (true == nvm_read(eNvmBlock14, testDataRead, &testDataReadSize)) && 
+	         (0 == memcmp(testDataRead, expected[eNvmBlock14], NVM_BLOCK_14_SIZE)))
+
+	/* the next write of the block needs a garbage collection */
+	while((GET_OFFSET_IN_PAGE(NvmManagerDescriptor.writePointer) + BLOCK_HEADER_SIZE + NVM_BLOCK_1_SIZE + NVM_CRC_LEN) <= LOGICAL_PAGE_SIZE)
+	{
+		fillWithRandom(expected[eNvmBlock1], NVM_BLOCK_1_SIZE);
+		nvmRes &= nvm_write(eNvmBlock1, expected[eNvmBlock1], NVM_BLOCK_1_SIZE);
+	}
+
+	/* the power is cut after the marking of the pages and a part of the transferred blocks */
+	fillWithRandom(testData, NVM_BLOCK_1_SIZE);
+	FlsSimu_setPowerCut(PAGE_HEADER_ONE_BYTE + PAGE_HEADER_HALF_SIZE + 0x40);
+	(void)nvm_write(eNvmBlock1, testData, NVM_BLOCK_1_SIZE);
+	FlsSimu_setPowerCut(FLS_SIMU_POWER_ON);
+	nvm_init();
+	FlsSimu_getStats(&after);
+
+	for(bIdx = eNvmBlock1; bIdx <= eNvmBlock15; bIdx++)
+	{
+		nvmRes &= nvm_read(bIdx, testDataRead, &testDataReadSize);
+		nvmRes &= (0 == memcmp(testDataRead, expected[bIdx], NvmBlocks[bIdx].size));
+	}
+	printf("\n	* Checking whether all blocks are recovered after a power cut during the garbage collection... ");
+	UT_CHECK((false != nvmRes) && (true == NvmManagerDescriptor.bIsInitialized) && ((before.powerCuts + 2) == after.powerCuts))
+
+	nvmRes &= nvm_write(eNvmBlock1, testData, NVM_BLOCK_1_SIZE);
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock1, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether the interrupted garbage collection is repeated by the next write... ");
+	UT_CHECK((false != nvmRes) && (0 == memcmp(testDataRead, testData, NVM_BLOCK_1_SIZE)))
+
+	/* the power is cut while the first write of the next garbage collection - the oldest mark - is programmed */
+	memcpy(expected[eNvmBlock1], testData, NVM_BLOCK_1_SIZE);
+	while((GET_OFFSET_IN_PAGE(NvmManagerDescriptor.writePointer) + BLOCK_HEADER_SIZE + NVM_BLOCK_1_SIZE + NVM_CRC_LEN) <= LOGICAL_PAGE_SIZE)
+	{
+		fillWithRandom(expected[eNvmBlock1], NVM_BLOCK_1_SIZE);
+		nvmRes &= nvm_write(eNvmBlock1, expected[eNvmBlock1], NVM_BLOCK_1_SIZE);
+	}
+	cut.kinds = FLS_SIMU_CUT_PROGRAM;
+	cut.operation = 0;
+	cut.offset = 0;
+	cut.tornBits = 0x02; /* only one of the bits, which the mark clears */
+	FlsSimu_setPowerCutAt(&cut);
+	(void)nvm_write(eNvmBlock1, testData, NVM_BLOCK_1_SIZE);
+	FlsSimu_setPowerCut(FLS_SIMU_POWER_ON);
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock1, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether a torn mark of the page is recognized... ");
+	UT_CHECK((false != nvmRes) && (0 == memcmp(testDataRead, expected[eNvmBlock1], NVM_BLOCK_1_SIZE)) && 
+	         (0xFF != FlashSimu[GET_PAGE_ADDR(NvmManagerDescriptor.writePointer) + PAGE_HEADER_HALF_SIZE]))
+	printf("\n");
+}
+
+/* Test the search of the end of the written data after power-on */
+void TestCase19(void)
+{
+	printf("\n");
+	printf("Name: Test case 19\n");
+	printf("  Description: Test the binary search of the erased end of the page with data after power-on\n");
+	printf("  Preconditions: The flash driver is initialized\n");
+	printf("  Test steps: Initialize on a page, which is partly erased after a garbage collection, then write a block,\n");
+	printf("              whose checksum ends with two erased bytes, and initialize again\n");
+	printf("  Check results: Every erased byte of the page is read once (NVM_USE_LAZY_MOUNT) and the write pointer is after the last record,\n");
+	printf("                 which ends after the found boundary\n");
+	printf("  Post steps: none\n");
+
+	uint8_t testDataRead[MAX_DR_SIZE];
+#ifdef NVM_USE_LAZY_MOUNT
+	FlsSimu_Stats_t before;
+	FlsSimu_Stats_t after;
+#endif
+	uint32_t pageAddr;
+	uint32_t recordEnd;
+	uint32_t value;
+	uint32_t crc;
+	bool nvmRes = true;
+
+	/* the page changes, so most of it is erased */
+	nvm_init();
+	pageAddr = GET_PAGE_ADDR(NvmManagerDescriptor.writePointer);
+	while( (false != nvmRes) && (pageAddr == GET_PAGE_ADDR(NvmManagerDescriptor.writePointer)) )
+	{
+		fillWithRandom(testData, NVM_BLOCK_1_SIZE);
+		nvmRes &= nvm_write(eNvmBlock1, testData, NVM_BLOCK_1_SIZE);
+	}
+#ifdef NVM_USE_BACKGROUND_ERASE
+	while(false == nvm_erase_step())
+	{
+		/* the released page is erased */
+	}
+#endif
+#ifdef NVM_USE_LAZY_MOUNT
+	/* only the page with data and its erased end are searched. A probe into the written records reads at most one chunk */
+	FlsSimu_getStats(&before);
+	nvm_init_lazy();
+	FlsSimu_getStats(&after);
+	printf("\n	* Checking whether the erased bytes are read only once by the binary search... ");
+	UT_CHECK((false != nvmRes) && ((after.readBytes - before.readBytes) <= 
+	         ((NvmManagerDescriptor.mountPageEndAddr - NvmManagerDescriptor.mountEndAddr) + (16 * NVM_CHUNK_SIZE))))
+#endif
+
+	/* the checksum is stored little endian, so its last two bytes are erased */
+	nvmRes &= nvm_read(eNvmBlock14, testDataRead, &testDataReadSize);
+	memcpy(&value, testDataRead, NVM_BLOCK_14_SIZE);
+	do
+	{
+		value++;
+		crc = CRC32_Calculate((uint8_t*)&value, NVM_BLOCK_14_SIZE);
+	} while( (0xFFFF0000u != (crc & 0xFFFF0000u)) || (0x0000FF00u == (crc & 0x0000FF00u)) );
+	nvmRes &= nvm_write(eNvmBlock14, (uint8_t*)&value, NVM_BLOCK_14_SIZE);
+	recordEnd = NvmBlocks[eNvmBlock14].readPointer + BLOCK_HEADER_SIZE + NVM_BLOCK_14_SIZE + NVM_CRC_LEN;
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock14, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether the last record, whose checksum ends with erased bytes, is found... ");
+	UT_CHECK((false != nvmRes) && ((recordEnd - 2) == NvmManagerDescriptor.mountEndAddr) && (recordEnd == NvmManagerDescriptor.writePointer) && 
+	         (0 == memcmp(&value, testDataRead, NVM_BLOCK_14_SIZE)))
+
+	nvmRes &= nvm_write(eNvmBlock2, testData, NVM_BLOCK_2_SIZE);
+	nvm_init();
+	nvmRes &= nvm_read(eNvmBlock2, testDataRead, &testDataReadSize);
+	printf("\n	* Checking whether the next record is written after it... ");
+	UT_CHECK((false != nvmRes) && (recordEnd == NvmBlocks[eNvmBlock2].readPointer) && (0 == memcmp(testData, testDataRead, NVM_BLOCK_2_SIZE)))
+	printf("\n");
+}
+
+/* Test a failed page switch of the SWC NVManager */
+void TestCase20(void)
+{
+	printf("\n");
+	printf("Name: Test case 20\n");
+	printf("  Description: Test the write, which needs a page switch, when the erase or the programming of the flash fails\n");
+	printf("  Preconditions: The flash driver is initialized\n");
+	printf("  Test steps: Fill the page, let the next write fail while the flash is busy with another erase, then cut the power\n");
+	printf("              during the transfer of the blocks into the next page and write again after the power is on\n");
+	printf("  Check results: The failed writes are reported, no data is erased and all blocks are read without an initialization.\n");
+	printf("                 The next write switches the page and all blocks are kept over the initialization\n");
+	printf("  Post steps: The power is on\n");
+
+	static uint8_t expected[eNvmBlock15 + 1][MAX_DR_SIZE];
+	uint8_t testDataRead[MAX_DR_SIZE];
+	FlsSimu_PowerCut_t cut;
+	NvmBlocksId_t bIdx;
+	uint32_t pageAddr;
+	bool bFailed;
+	bool nvmRes = true;
+
+	nvm_init();
+	for(bIdx = eNvmBlock1; bIdx <= eNvmBlock15; bIdx++)
+	{
+		fillWithRandom(expected[bIdx], NvmBlocks[bIdx].size);
+		nvmRes &= nvm_write(bIdx, expected[bIdx], (uint16_t)NvmBlocks[bIdx].size);
+	}
+#ifdef NVM_USE_WEAR_BUDGET
+	nvmRes &= nvm_write_flush();
+#endif
+
+	/* the next write of the block needs a page switch */
+	while((GET_OFFSET_IN_PAGE(NvmManagerDescriptor.writePointer) + BLOCK_HEADER_SIZE + NVM_BLOCK_1_SIZE + NVM_CRC_LEN) <= LOGICAL_PAGE_SIZE)
+	{
+		fillWithRandom(expected[eNvmBlock1], NVM_BLOCK_1_SIZE);
+		nvmRes &= nvm_write(eNvmBlock1, expected[eNvmBlock1], NVM_BLOCK_1_SIZE);
+	}
+#ifdef NVM_USE_BACKGROUND_ERASE
+	while(false == nvm_erase_step())
+	{
+		/* the released page is erased */
+	}
+#endif
+	pageAddr = GET_PAGE_ADDR(NvmManagerDescriptor.writePointer);
+
+	/* 1. the flash is busy with an erase, which is not started by the NVManager, so the next page is neither erased nor marked */
+	fillWithRandom(testData, NVM_BLOCK_1_SIZE);
+	nvmRes &= FlsDrv_eraseStart(NVM_MANAGER_END_ADDR + FLASH_SECTOR_SIZE);
+	bFailed = (false == nvm_write(eNvmBlock1, testData, NVM_BLOCK_1_SIZE));
+	while(FLS_ERASE_IDLE != FlsDrv_eraseStatus())
+	{
+	}
+	bFailed &= (false != nvm_get_error());
+	for(bIdx = eNvmBlock1; bIdx <= eNvmBlock15; bIdx++)
+	{
+		nvmRes &= nvm_read(bIdx, testDataRead, &testDataReadSize);
+		nvmRes &= (0 == memcmp(testDataRead, expected[bIdx], NvmBlocks[bIdx].size));
+	}
+	printf("\n	* Checking whether a failed erase or marking of the next page keeps all blocks... ");
+	UT_CHECK((false != nvmRes) && (false != bFailed) && (pageAddr == GET_PAGE_ADDR(NvmManagerDescriptor.writePointer)))
+
+	/* 2. the power is cut at the second block transferred into the next page, so the programming fails from then on */
+	cut.kinds = FLS_SIMU_CUT_PROGRAM;
+	cut.operation = 3;
+	cut.offset = 0;
+	cut.tornBits = 0;
+	FlsSimu_setPowerCutAt(&cut);
+	bFailed = (false == nvm_write(eNvmBlock1, testData, NVM_BLOCK_1_SIZE));
+	FlsSimu_setPowerCut(FLS_SIMU_POWER_ON);
+	for(bIdx = eNvmBlock1; bIdx <= eNvmBlock15; bIdx++)
+	{
+		nvmRes &= nvm_read(bIdx, testDataRead, &testDataReadSize);
+		nvmRes &= (0 == memcmp(testDataRead, expected[bIdx], NvmBlocks[bIdx].size));
+	}
+	printf("\n	* Checking whether a failed transfer into the next page keeps all blocks... ");
+	UT_CHECK((false != nvmRes) && (false != bFailed) && (pageAddr == GET_PAGE_ADDR(NvmManagerDescriptor.writePointer)))
+
+	/* 3. the page switch is repeated */
+	nvmRes &= nvm_write(eNvmBlock1, testData, NVM_BLOCK_1_SIZE);
+	memcpy(expected[eNvmBlock1], testData, NVM_BLOCK_1_SIZE);
+	bFailed = (pageAddr != GET_PAGE_ADDR(NvmManagerDescriptor.writePointer));
+	nvm_init();
+	for(bIdx = eNvmBlock1; bIdx <= eNvmBlock15; bIdx++)
 	{
-		fread(FlashSimu[j], 1, BUFF_FLASH_PAGE_SIZE, fp);
+		nvmRes &= nvm_read(bIdx, testDataRead, &testDataReadSize);
+		nvmRes &= (0 == memcmp(testDataRead, expected[bIdx], NvmBlocks[bIdx].size));
 	}
-	printf("%sThe previous content of the flash is loaded. %s \n", KYEL, KNRM);
-	fclose(fp);
+	printf("\n	* Checking whether the next write switches the page and all blocks are kept over the initialization... ");
+	UT_CHECK((false != nvmRes) && (false != bFailed) && (false == nvm_get_error()))
+	printf("\n");
+}
+
+/* main function of the Unit test program */
+int main(int argc, char* argv[])
+{
+	const char* imagePath = (argc > 1) ? argv[1] : FLASH_IMAGE_PATH;
+
+	printf("Started execution of the Unit test of the NVManager!\n");
+
+#ifdef LOAD_PREVIOUS_FLASH //  if it is false, it will use always erased flash
+	// the flash simu keeps its content into the file
+	if(false == FlsSimu_open(imagePath)) { printf("Can't open %s! Using erased flash\n", imagePath); }
+	else { printf("%sThe previous content of the flash is loaded. %s \n", KYEL, KNRM); }
+#else
+	(void)imagePath;
 #endif
 
+	FlsDrv_Init();
+	printf("The flash driver is inialized.\n");
+
 	TestCase1();
 	TestCase2();
 	TestCase3();
 	TestCase4();
+#ifdef NVM_USE_READ_VIEW
+	TestCase5();
+#endif
+#ifdef NVM_USE_LARGE_OBJECTS
+	TestCase6();
+#endif
+#ifdef NVM_USE_KV_STORE
+	TestCase7();
+#endif
+	TestCase8();
+#ifdef NVM_USE_EMERGENCY_FLUSH
+	TestCase9();
+#endif
+#ifdef NVM_USE_BACKGROUND_ERASE
+	TestCase10();
+#endif
+	TestCase11();
+#ifdef NVM_USE_LAZY_MOUNT
+	TestCase12();
+#endif
+#ifdef NVM_USE_WEAR_BUDGET
+	TestCase13();
+#endif
+#ifdef NVM_USE_STATS
+	TestCase14();
+#endif
+#ifdef NVM_USE_TRACE
+	TestCase15();
+#endif
+	TestCase16();
+#ifdef NVM_USE_RECORDER
+	TestCase17();
+#endif
+	TestCase18();
+	TestCase19();
+	TestCase20();
 
 	printf("\nUnit test summary:");
 	printf("\n%d test cases have been executed.", TestCounter);
@@ -309,17 +1608,8 @@ int main(void)
 	}
 	printf("%s The execution of the Unit test has ended.\n", KNRM);
 
-
-
 	/* save flash simu to file */
-	fp = fopen("..\\FlashSimu.bin", "wb");
-	if(fp == NULL) { printf("Can't open file to write!\n");	return 1; }
-
-	for(j=0; j<TOTAL_FLASH_SIZE/LOGICAL_PAGE_SIZE; j++)
-	{
-		fwrite(FlashSimu[j], 1, LOGICAL_PAGE_SIZE, fp);
-	}
-	fclose(fp);
+	if(false == FlsSimu_close()) { printf("Can't write %s!\n", imagePath); return 1; }
 
-	return EXIT_SUCCESS;
+	return (TestFailedCounter > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
 }